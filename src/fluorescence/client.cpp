@@ -27,6 +27,7 @@
 #include <misc/config.hpp>
 #include <misc/log.hpp>
 #include <misc/patcherupdater.hpp>
+#include <misc/profiler.hpp>
 
 #include <ui/manager.hpp>
 #include <ui/gumpmenus.hpp>
@@ -34,6 +35,7 @@
 #include <ui/gumpmenu.hpp>
 
 #include <data/manager.hpp>
+#include <data/completionqueue.hpp>
 
 #include <world/manager.hpp>
 #include <world/sectormanager.hpp>
@@ -121,11 +123,13 @@ bool Client::handleStateChange() {
 
     // start new state
     switch(requestedState_) {
-    case STATE_PRE_LOGIN:
+    case STATE_PRE_LOGIN: {
+        ProfilePhase phase("open login gump");
         //uiManager->openPythonGump("test");
         uiManager->openPythonGump("login");
 
         break;
+    }
 
     case STATE_PLAYING:
         uiManager->restoreDesktop();
@@ -170,29 +174,43 @@ void Client::saveConfig() {
 
 bool Client::initBase(const std::vector<CL_String8>& args) {
     LOG_INFO << "Parsing command line" << std::endl;
-    if (!config_.parseCommandLine(args)) {
-        return false;
+    {
+        ProfilePhase phase("parse command line");
+        if (!config_.parseCommandLine(args)) {
+            return false;
+        }
     }
 
     LOG_INFO << "Initializing basic data loaders" << std::endl;
-    if (!data::Manager::create()) {
-        cleanUp();
-        return false;
+    {
+        ProfilePhase phase("data::Manager::create");
+        if (!data::Manager::create()) {
+            cleanUp();
+            return false;
+        }
     }
 
     LOG_INFO << "Initializing basic ui" << std::endl;
-    if (!ui::Manager::create()) {
-        cleanUp();
-        return false;
+    {
+        ProfilePhase phase("ui::Manager::create");
+        if (!ui::Manager::create()) {
+            cleanUp();
+            return false;
+        }
     }
 
     return true;
 }
 
 bool Client::initFull() {
+    ProfilePhase fullPhase("shard setup");
+
     LOG_INFO << "Parsing shard config" << std::endl;
-    if (!config_.parseShardConfig()) {
-        return false;
+    {
+        ProfilePhase phase("parse shard config");
+        if (!config_.parseShardConfig()) {
+            return false;
+        }
     }
 
     //config_.dumpMap();
@@ -200,6 +218,7 @@ bool Client::initFull() {
     LOG_INFO << "Setting up data loaders" << std::endl;
     // TODO: change from try/catch to boolean return only
     try {
+        ProfilePhase phase("data::Manager::setShardConfig");
         if (!data::Manager::getSingleton()->setShardConfig(config_)) {
             return false;
         }
@@ -208,18 +227,27 @@ bool Client::initFull() {
     }
 
     LOG_INFO << "Setting up ui" << std::endl;
-    if (!ui::Manager::getSingleton()->setShardConfig(config_)) {
-        return false;
+    {
+        ProfilePhase phase("ui::Manager::setShardConfig");
+        if (!ui::Manager::getSingleton()->setShardConfig(config_)) {
+            return false;
+        }
     }
 
     LOG_INFO << "Initializing world" << std::endl;
-    if (!world::Manager::create(config_)) {
-        return false;
+    {
+        ProfilePhase phase("world::Manager::create");
+        if (!world::Manager::create(config_)) {
+            return false;
+        }
     }
 
     LOG_INFO << "Initializing network" << std::endl;
-    if (!net::Manager::create(config_)) {
-        return false;
+    {
+        ProfilePhase phase("net::Manager::create");
+        if (!net::Manager::create(config_)) {
+            return false;
+        }
     }
 
     return true;
@@ -257,6 +285,9 @@ int Client::main(const std::vector<CL_String8>& args) {
     setlocale(LC_ALL, "");
     setlocale(LC_NUMERIC, "C");
 
+    // closed by finish() once the first gump was drawn
+    StartupProfiler::getSingleton()->begin("startup");
+
     config_.initDefaults();
 
     // patcher can't update itself directly => make sure the new files are copied to the main folder
@@ -276,6 +307,7 @@ int Client::main(const std::vector<CL_String8>& args) {
     if (config_.isLoaded()) {
         setState(STATE_PRE_LOGIN);
     } else {
+        ProfilePhase phase("open shard list");
         ui::GumpMenus::openShardList();
         LOG_INFO << "Selecting shard through user interface" << std::endl;
     }
@@ -304,6 +336,9 @@ int Client::main(const std::vector<CL_String8>& args) {
             state_ = requestedState_;
         }
 
+        // notify everything waiting for loader threads, before the frame uses the loaded data
+        data::CompletionQueue::getSingleton()->drain();
+
         switch(state_) {
         case STATE_SHARD_SELECTION:
             doStateShardSelection();
@@ -322,6 +357,11 @@ int Client::main(const std::vector<CL_String8>& args) {
             doStatePlaying(elapsedMillis);
             break;
         }
+
+        if (state_ == STATE_SHARD_SELECTION || state_ == STATE_PRE_LOGIN) {
+            // the first frame with the shard list or the login gump ends the startup
+            StartupProfiler::getSingleton()->finish();
+        }
     }
 
     cleanUp();
@@ -337,11 +377,13 @@ void Client::doStatePlaying(unsigned int elapsedMillis) {
     static ui::Manager* uiManager = ui::Manager::getSingleton();
     static net::Manager* netManager = net::Manager::getSingleton();
     static world::Manager* worldManager = world::Manager::getSingleton();
+    static data::Manager* dataManager = data::Manager::getSingleton();
 
     netManager->step();
     uiManager->stepInput(elapsedMillis);
     uiManager->stepAudio();
     worldManager->step(elapsedMillis);
+    dataManager->step();
     uiManager->stepDraw();
 }
 
@@ -439,7 +481,10 @@ bool Client::createShard(const UnicodeString& name, const UnicodeString& pathStr
         return false;
     } else {
         configStream << "<?xml version=\"1.0\"?>\n<fluo>\n<files";
-        if (highSeas) {
+        if (boost::filesystem::exists(path / "artLegacyMUL.uop")) {
+            // newer clients ship art, gumps and maps in uop files
+            configStream << " format=\"uop\"";
+        } else if (highSeas) {
             configStream << " format=\"mul-hs\"";
         }
         configStream << ">\n<mul-directory path=\"" << path.string();
@@ -29,15 +29,19 @@
 namespace fluo {
 namespace data {
 
-AnimLoader::AnimLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath, unsigned int highDetailCount, unsigned int lowDetailCount) :
-    highDetailCount_(highDetailCount), lowDetailCount_(lowDetailCount) {
+AnimLoader::AnimLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath, unsigned int highDetailCount, unsigned int lowDetailCount,
+        boost::shared_ptr<DecodeCache> decodeCache) :
+    highDetailCount_(highDetailCount), lowDetailCount_(lowDetailCount), decodeCache_(decodeCache), ioScheduler_(IoScheduler::getSingleton()) {
 
     boost::shared_ptr<IndexedOnDemandFileLoader<unsigned int, ui::Animation> > loader(new IndexedOnDemandFileLoader<unsigned int, ui::Animation>(idxPath, mulPath,
                 boost::bind(&AnimLoader::readCallback, this, _1, _2, _3, _4, _5, _6)));
+    if (decodeCache_) {
+        loader->setCacheCallback(boost::bind(&AnimLoader::loadCached, this, _1, _2));
+    }
     cache_.init(loader);
 }
 
-boost::shared_ptr<ui::Animation> AnimLoader::getAnimation(unsigned int bodyId, unsigned int animId, unsigned int direction) {
+boost::shared_ptr<ui::Animation> AnimLoader::getAnimation(unsigned int bodyId, unsigned int animId, unsigned int direction, unsigned int priority) {
     unsigned int realId = 0;
     if (bodyId < highDetailCount_) {
         realId = bodyId*110;
@@ -49,7 +53,7 @@ boost::shared_ptr<ui::Animation> AnimLoader::getAnimation(unsigned int bodyId, u
 
     realId += 5*animId + direction;
 
-    boost::shared_ptr<ui::Animation> ret = cache_.get(realId);
+    boost::shared_ptr<ui::Animation> ret = cache_.get(realId, 0, priority);
     return ret;
 }
 
@@ -63,96 +67,140 @@ unsigned int AnimLoader::getAnimType(unsigned int bodyId) const {
     }
 }
 
+bool AnimLoader::loadCached(unsigned int index, boost::shared_ptr<ui::Animation> anim) {
+    return decodeCache_->loadAnimation(index, anim);
+}
+
 void AnimLoader::readCallback(unsigned int index, int8_t* buf, unsigned int len, boost::shared_ptr<ui::Animation> anim, unsigned int extra, unsigned int userData) {
     //LOGARG_DEBUG(LOGTYPE_DATA, "AnimLoader::readCallback index=%u len=%u", index, len);
 
-    uint16_t* palette = reinterpret_cast<uint16_t*>(buf);
+    if (len < FRAME_OFFSETS_START) {
+        LOG_WARN << "Animation " << index << " too short: len=" << len << std::endl;
+        anim->setReadFailed();
+        return;
+    }
 
     uint32_t frameCount = *reinterpret_cast<uint32_t*>(buf + 0x200);
-    uint32_t* frameOffsets = reinterpret_cast<uint32_t*>(buf + 0x200 + 4);
+    uint32_t* frameOffsets = reinterpret_cast<uint32_t*>(buf + FRAME_OFFSETS_START);
 
     //LOGARG_DEBUG(LOGTYPE_DATA, "framecount=%u", frameCount);
 
+    // the frames are decoded in parallel, so everything is checked before the first one is started
+    if (frameCount > (len - FRAME_OFFSETS_START) / 4) {
+        LOG_WARN << "Animation " << index << " has invalid frame count " << frameCount << ", len=" << len << std::endl;
+        anim->setReadFailed();
+        return;
+    }
 
     for (unsigned int frameIdx = 0; frameIdx < frameCount; ++frameIdx) {
-        if (frameOffsets[frameIdx] == 0) { // some animations are buggy, e.g. 0x13e3 (smithhammer) action 5
-            // try to use the last texture
-            if (frameIdx > 0) {
-                anim->addFrame(anim->getFrame(frameIdx - 1));
-            } else {
-                ui::AnimationFrame curFrame;
-                curFrame.centerX_ = 0;
-                curFrame.centerY_ = 0;
-                curFrame.texture_->initPixelBuffer(1, 1);
-                curFrame.texture_->setUsage(ui::Texture::USAGE_WORLD);
-            }
+        if (frameOffsets[frameIdx] != 0 && static_cast<uint64_t>(frameOffsets[frameIdx]) + 0x200 + FRAME_HEADER_SIZE > len) {
+            LOG_WARN << "Animation " << index << " frame " << frameIdx << " has invalid offset " << frameOffsets[frameIdx] << ", len=" << len << std::endl;
+            anim->setReadFailed();
+            return;
+        }
+    }
+
+    // the palette is converted once, runs are then expanded by a simple table lookup
+    uint32_t palette[256];
+    Util::convertRow1555(reinterpret_cast<uint16_t*>(buf), palette, 256);
 
-            continue;
+    // textures are only created for frames that are decoded, see decodeFrame
+    std::vector<ui::AnimationFrame> frames(frameCount, ui::AnimationFrame(boost::shared_ptr<ui::Texture>()));
+    boost::function<void (unsigned int)> decodeJob = boost::bind(&AnimLoader::decodeFrame, this, buf, frameOffsets, palette, boost::ref(frames), _1);
+    if (len >= PARALLEL_DECODE_MIN_SIZE) {
+        ioScheduler_->parallelDecode(frameCount, decodeJob);
+    } else {
+        for (unsigned int frameIdx = 0; frameIdx < frameCount; ++frameIdx) {
+            decodeJob(frameIdx);
         }
-        uint8_t* ptr = reinterpret_cast<uint8_t*>(buf) + 0x200 + frameOffsets[frameIdx];
-        //int8_t* frameStart = ptr;
+    }
 
-        // frame header
-        ui::AnimationFrame curFrame;
-        curFrame.centerX_ = *reinterpret_cast<int16_t*>(ptr);
-        ptr += 2;
-        curFrame.centerY_ = *reinterpret_cast<int16_t*>(ptr);
-        ptr += 2;
+    for (unsigned int frameIdx = 0; frameIdx < frameCount; ++frameIdx) {
+        if (frameOffsets[frameIdx] == 0) { // some animations are buggy, e.g. 0x13e3 (smithhammer) action 5
+            // try to use the last texture. frameIdx - 1 is not necessarily the last one, if an earlier frame was skipped
+            if (anim->getFrameCount() > 0) {
+                anim->addFrame(anim->getFrame(anim->getFrameCount() - 1));
+            }
+        } else {
+            anim->addFrame(frames[frameIdx]);
+        }
+    }
 
-        unsigned int width = *reinterpret_cast<uint16_t*>(ptr);
-        ptr += 2;
-        unsigned int height = *reinterpret_cast<uint16_t*>(ptr);
-        ptr += 2;
+    if (decodeCache_) {
+        decodeCache_->storeAnimation(index, anim);
+    }
+}
 
+void AnimLoader::decodeFrame(int8_t* buf, const uint32_t* frameOffsets, const uint32_t* palette, std::vector<ui::AnimationFrame>& frames, unsigned int frameIdx) {
+    if (frameOffsets[frameIdx] == 0) {
+        // handled by readCallback
+        return;
+    }
 
-        //LOGARG_DEBUG(LOGTYPE_DATA, "loop frame=%u offset=%u centerX=%u centerY=%u width=%u height=%u", frameIdx, frameOffsets[frameIdx], curFrame.centerX_, curFrame.centerY_, width, height);
+    ui::AnimationFrame& curFrame = frames[frameIdx];
 
-        curFrame.texture_->setUsage(ui::Texture::USAGE_WORLD);
-        curFrame.texture_->initPixelBuffer(width, height);
-        uint32_t* pixBufPtr = curFrame.texture_->getPixelBufferData();
+    uint8_t* ptr = reinterpret_cast<uint8_t*>(buf) + 0x200 + frameOffsets[frameIdx];
+    //int8_t* frameStart = ptr;
 
-        uint32_t header = *reinterpret_cast<uint32_t*>(ptr);
-        ptr += 4;
-        while (header != 0x7FFF7FFFu) {
-            // read next run
-            int xOffset = (header >> 22) & 0x3FF;
-            int yOffset = (header >> 12) & 0x3FF;
-
-            // keep track of sign
-            if ((xOffset & 0x200) == 0x200) {
-                //xOffset |= 0xFFFFFC00;
-                xOffset |= 0xFFFFFE00;
-            }
+    // frame header
+    curFrame.centerX_ = *reinterpret_cast<int16_t*>(ptr);
+    ptr += 2;
+    curFrame.centerY_ = *reinterpret_cast<int16_t*>(ptr);
+    ptr += 2;
 
-            if ((yOffset & 0x200) == 0x200) {
-                //yOffset |= 0xFFFFFC00;
-                yOffset |= 0xFFFFFE00;
-            }
+    unsigned int width = *reinterpret_cast<uint16_t*>(ptr);
+    ptr += 2;
+    unsigned int height = *reinterpret_cast<uint16_t*>(ptr);
+    ptr += 2;
 
-            unsigned int yPixel = curFrame.centerY_ + yOffset + height;
-            unsigned int xRun = header & 0xFFF;
 
-            //LOGARG_DEBUG(LOGTYPE_DATA, "xOffset=%i yOffset=%i run=%u ypixel=%u", xOffset, yOffset, xRun, yPixel);
+    //LOGARG_DEBUG(LOGTYPE_DATA, "loop frame=%u offset=%u centerX=%u centerY=%u width=%u height=%u", frameIdx, frameOffsets[frameIdx], curFrame.centerX_, curFrame.centerY_, width, height);
 
-            for (unsigned int px = 0; px < xRun; ++px) {
-                uint16_t readPixel = palette[*ptr];
-                ++ptr;
+    curFrame.texture_.reset(new ui::Texture());
+    curFrame.texture_->setUsage(ui::Texture::USAGE_WORLD);
+    curFrame.texture_->initPixelBuffer(width, height);
+    uint32_t* pixBufPtr = curFrame.texture_->getPixelBufferData();
 
-                unsigned int xPixel = curFrame.centerX_ + xOffset + px;
+    uint32_t header = *reinterpret_cast<uint32_t*>(ptr);
+    ptr += 4;
+    while (header != 0x7FFF7FFFu) {
+        // read next run
+        int xOffset = (header >> 22) & 0x3FF;
+        int yOffset = (header >> 12) & 0x3FF;
 
-                pixBufPtr[yPixel * width + xPixel] = Util::getColorRGBA(readPixel);
-            }
+        // keep track of sign
+        if ((xOffset & 0x200) == 0x200) {
+            //xOffset |= 0xFFFFFC00;
+            xOffset |= 0xFFFFFE00;
+        }
 
-            header = *reinterpret_cast<uint32_t*>(ptr);
-            ptr += 4;
+        if ((yOffset & 0x200) == 0x200) {
+            //yOffset |= 0xFFFFFC00;
+            yOffset |= 0xFFFFFE00;
         }
 
-        //LOGARG_DEBUG(LOGTYPE_DATA, "read %u bytes", ptr - frameStart);
+        unsigned int yPixel = curFrame.centerY_ + yOffset + height;
+        unsigned int xRun = header & 0xFFF;
+
+        //LOGARG_DEBUG(LOGTYPE_DATA, "xOffset=%i yOffset=%i run=%u ypixel=%u", xOffset, yOffset, xRun, yPixel);
 
-        curFrame.texture_->setReadComplete();
+        uint32_t* runPtr = pixBufPtr + (yPixel * width) + curFrame.centerX_ + xOffset;
+        for (unsigned int px = 0; px < xRun; ++px) {
+            runPtr[px] = palette[ptr[px]];
+        }
+        ptr += xRun;
 
-        anim->addFrame(curFrame);
+        header = *reinterpret_cast<uint32_t*>(ptr);
+        ptr += 4;
     }
+
+    //LOGARG_DEBUG(LOGTYPE_DATA, "read %u bytes", ptr - frameStart);
+
+    curFrame.texture_->setReadComplete();
+}
+
+void AnimLoader::setRetentionBudget(unsigned int bytes) {
+    cache_.setRetentionBudget(bytes);
 }
 
 }
@@ -22,6 +22,8 @@
 
 #include "weakptrcache.hpp"
 #include "indexedondemandfileloader.hpp"
+#include "decodecache.hpp"
+#include "ioscheduler.hpp"
 
 #include <boost/filesystem.hpp>
 
@@ -29,22 +31,41 @@ namespace fluo {
 
 namespace ui {
     class Animation;
+    struct AnimationFrame;
 }
 
 namespace data {
 
 class AnimLoader {
 public:
-    AnimLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath, unsigned int highDetailCount, unsigned int lowDetailCount);
+    AnimLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath, unsigned int highDetailCount, unsigned int lowDetailCount,
+            boost::shared_ptr<DecodeCache> decodeCache = boost::shared_ptr<DecodeCache>());
 
-    boost::shared_ptr<ui::Animation> getAnimation(unsigned int bodyId, unsigned int animId, unsigned int direction);
+    boost::shared_ptr<ui::Animation> getAnimation(unsigned int bodyId, unsigned int animId, unsigned int direction, unsigned int priority = LoadPriority::VISIBLE);
     unsigned int getAnimType(unsigned int bodyId) const;
 
+    /// Keeps recently used items in memory up to the given size, see WeakPtrCache::setRetentionBudget
+    void setRetentionBudget(unsigned int bytes);
+
     void readCallback(unsigned int index, int8_t* buf, unsigned int len, boost::shared_ptr<ui::Animation> anim, unsigned int extra, unsigned int userData);
+    bool loadCached(unsigned int index, boost::shared_ptr<ui::Animation> anim);
 
 private:
+    /// Frames of smaller animations are decoded on the calling thread only, handing them out to the pool costs more than it saves
+    static const unsigned int PARALLEL_DECODE_MIN_SIZE = 32 * 1024;
+
+    /// Behind the palette (0x200 bytes) and the frame count
+    static const unsigned int FRAME_OFFSETS_START = 0x204;
+    /// Center, size and the first run header
+    static const unsigned int FRAME_HEADER_SIZE = 12;
+
+    void decodeFrame(int8_t* buf, const uint32_t* frameOffsets, const uint32_t* palette, std::vector<ui::AnimationFrame>& frames, unsigned int frameIdx);
+
     unsigned int highDetailCount_;
     unsigned int lowDetailCount_;
+    // declared before the cache, so that it outlives the decode jobs cancelled by the loader destructor
+    boost::shared_ptr<DecodeCache> decodeCache_;
+    boost::shared_ptr<IoScheduler> ioScheduler_;
     WeakPtrCache<unsigned int, ui::Animation, IndexedOnDemandFileLoader> cache_;
 };
 
@@ -0,0 +1,169 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include "animprefetcher.hpp"
+#include "workerpool.hpp"
+
+#include <misc/log.hpp>
+#include <ui/animation.hpp>
+
+#include <typedefs.hpp>
+
+namespace fluo {
+namespace data {
+
+AnimPrefetcher::AnimPrefetcher(unsigned int maxHeldCount, unsigned int requestsPerStep, const LoadCallback& loadCallback) :
+        maxHeldCount_(maxHeldCount), requestsPerStep_(requestsPerStep), loadCallback_(loadCallback),
+        requestCount_(0), showReadyCount_(0), showLoadingCount_(0), showMissCount_(0) {
+}
+
+void AnimPrefetcher::prefetch(unsigned int bodyId, unsigned int animId) {
+    Key key(bodyId, animId);
+
+    std::map<Key, HeldList::iterator>::iterator heldIter = heldIndex_.find(key);
+    if (heldIter != heldIndex_.end()) {
+        // still needed, move to the back
+        held_.splice(held_.end(), held_, heldIter->second);
+        return;
+    }
+
+    if (!queuedKeys_.insert(key).second) {
+        return;
+    }
+
+    queue_.push_back(key);
+
+    // requests that waited too long are outdated anyway
+    while (queue_.size() > maxHeldCount_) {
+        queuedKeys_.erase(queue_.front());
+        queue_.pop_front();
+    }
+}
+
+void AnimPrefetcher::prefetchMobile(const MobileState& state) {
+    std::vector<unsigned int> actions;
+    switch (state.animType_) {
+        case AnimType::HIGH_DETAIL:
+            actions.push_back(0);
+            actions.push_back(1);
+            break;
+        case AnimType::LOW_DETAIL:
+            actions.push_back(0);
+            actions.push_back(1);
+            actions.push_back(2);
+            break;
+        default:
+        case AnimType::PEOPLE:
+            if (state.mounted_) {
+                actions.push_back(23);
+                actions.push_back(24);
+                actions.push_back(25);
+            } else {
+                actions.push_back(state.armed_ ? 1 : 0);
+                actions.push_back(state.armed_ ? 3 : 2);
+                actions.push_back(4);
+                actions.push_back(15);
+                actions.push_back(state.twoHanded_ ? 8 : 7);
+            }
+            break;
+    }
+
+    // the body first, it is the most visible part
+    for (unsigned int i = 0; i < actions.size(); ++i) {
+        prefetch(state.bodyId_, actions[i]);
+    }
+
+    for (unsigned int i = 0; i < state.equipmentAnimIds_.size(); ++i) {
+        for (unsigned int j = 0; j < actions.size(); ++j) {
+            prefetch(state.equipmentAnimIds_[i], actions[j]);
+        }
+    }
+
+    if (state.mountAnimId_ != 0) {
+        // mounts only walk, run and stand, see world::DynamicItem::animate
+        if (state.mountAnimType_ == AnimType::HIGH_DETAIL) {
+            prefetch(state.mountAnimId_, 0);
+            prefetch(state.mountAnimId_, 1);
+        } else {
+            prefetch(state.mountAnimId_, 1);
+            prefetch(state.mountAnimId_, 2);
+        }
+    }
+}
+
+void AnimPrefetcher::step() {
+    for (unsigned int i = 0; i < requestsPerStep_ && !queue_.empty(); ++i) {
+        Key key = queue_.front();
+        queue_.pop_front();
+        queuedKeys_.erase(key);
+
+        HeldAnimation cur;
+        cur.key_ = key;
+        cur.directions_ = loadCallback_(key.first, key.second, LoadPriority::PREFETCH);
+        held_.push_back(cur);
+        heldIndex_[key] = --held_.end();
+        ++requestCount_;
+
+        while (held_.size() > maxHeldCount_) {
+            heldIndex_.erase(held_.front().key_);
+            held_.pop_front();
+        }
+    }
+}
+
+void AnimPrefetcher::onShow(unsigned int bodyId, unsigned int animId) {
+    std::map<Key, HeldList::iterator>::iterator heldIter = heldIndex_.find(Key(bodyId, animId));
+    if (heldIter == heldIndex_.end()) {
+        ++showMissCount_;
+        return;
+    }
+
+    const std::vector<boost::shared_ptr<ui::Animation> >& directions = heldIter->second->directions_;
+    for (unsigned int i = 0; i < directions.size(); ++i) {
+        if (directions[i] && !directions[i]->isReadComplete()) {
+            ++showLoadingCount_;
+            return;
+        }
+    }
+
+    ++showReadyCount_;
+}
+
+void AnimPrefetcher::printStats() {
+    LOG_DEBUG << "AnimPrefetcher stats: requests=" << requestCount_ << " held=" << held_.size() << " queued=" << queue_.size() << std::endl;
+    LOG_DEBUG << "Shown animations: prefetched and complete=" << showReadyCount_ << " prefetched and loading=" << showLoadingCount_ <<
+            " not prefetched=" << showMissCount_ << std::endl;
+}
+
+unsigned int AnimPrefetcher::getShowReadyCount() const {
+    return showReadyCount_;
+}
+
+unsigned int AnimPrefetcher::getShowLoadingCount() const {
+    return showLoadingCount_;
+}
+
+unsigned int AnimPrefetcher::getShowMissCount() const {
+    return showMissCount_;
+}
+
+}
+}
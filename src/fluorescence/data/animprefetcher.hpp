@@ -0,0 +1,120 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_DATA_ANIMPREFETCHER_HPP
+#define FLUO_DATA_ANIMPREFETCHER_HPP
+
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+
+#include <vector>
+#include <list>
+#include <map>
+#include <set>
+#include <deque>
+
+namespace fluo {
+
+namespace ui {
+    class Animation;
+}
+
+namespace data {
+
+/**
+ * \brief Loads animations of mobiles in range before they are first shown
+ *
+ * world::Mobile describes its body, equipment and mount with prefetchMobile, which queues the actions it is likely to
+ * perform next. At most requestsPerStep of them are started per frame, with LoadPriority::PREFETCH, and the
+ * maxHeldCount most recently requested ones are kept in memory.
+ */
+class AnimPrefetcher {
+public:
+    /// Loads all directions of an animation, see Manager::getAnim
+    typedef boost::function<std::vector<boost::shared_ptr<ui::Animation> > (unsigned int, unsigned int, unsigned int)> LoadCallback;
+
+    struct MobileState {
+        MobileState() : bodyId_(0), animType_(0), armed_(false), twoHanded_(false), mounted_(false), mountAnimId_(0), mountAnimType_(0) { }
+
+        unsigned int bodyId_;
+        unsigned int animType_;
+        bool armed_;
+        bool twoHanded_;
+        bool mounted_;
+
+        /// Animation bodies of the equipped items, they play the same actions as the mobile
+        std::vector<unsigned int> equipmentAnimIds_;
+
+        /// 0 if not mounted or the mount is unknown
+        unsigned int mountAnimId_;
+        unsigned int mountAnimType_;
+    };
+
+    AnimPrefetcher(unsigned int maxHeldCount, unsigned int requestsPerStep, const LoadCallback& loadCallback);
+
+    /// Queues a load of all directions of this animation
+    void prefetch(unsigned int bodyId, unsigned int animId);
+
+    /// Queues walk, run and idle for the current state of the mobile, for its equipment and for its mount. For
+    /// people, also the war mode variants, as fights start without much warning
+    void prefetchMobile(const MobileState& state);
+
+    /// Starts the next queued loads. Called once per frame
+    void step();
+
+    /// Records whether an animation about to be shown was prefetched, and if it was complete already
+    void onShow(unsigned int bodyId, unsigned int animId);
+
+    void printStats();
+
+    unsigned int getShowReadyCount() const;
+    unsigned int getShowLoadingCount() const;
+    unsigned int getShowMissCount() const;
+
+private:
+    typedef std::pair<unsigned int, unsigned int> Key;
+
+    struct HeldAnimation {
+        Key key_;
+        std::vector<boost::shared_ptr<ui::Animation> > directions_;
+    };
+
+    typedef std::list<HeldAnimation> HeldList;
+
+    unsigned int maxHeldCount_;
+    unsigned int requestsPerStep_;
+    LoadCallback loadCallback_;
+
+    HeldList held_; ///< Most recently requested at the back
+    std::map<Key, HeldList::iterator> heldIndex_;
+
+    std::deque<Key> queue_;
+    std::set<Key> queuedKeys_;
+
+    unsigned int requestCount_;
+    unsigned int showReadyCount_;
+    unsigned int showLoadingCount_;
+    unsigned int showMissCount_;
+};
+
+}
+}
+
+#endif
@@ -28,10 +28,15 @@
 namespace fluo {
 namespace data {
 
-ArtLoader::ArtLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath) {
+ArtLoader::ArtLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath, boost::shared_ptr<DecodeCache> decodeCache,
+        boost::shared_ptr<SharedMemoryCache> sharedCache) :
+        decodeCache_(decodeCache), sharedCache_(sharedCache) {
 
     boost::shared_ptr<IndexedOnDemandFileLoader<unsigned int, ui::Texture> > loader(new IndexedOnDemandFileLoader<unsigned int, ui::Texture>(idxPath, mulPath,
                 boost::bind(&ArtLoader::readCallback, this, _1, _2, _3, _4, _5, _6)));
+    if (decodeCache_ || sharedCache_) {
+        loader->setCacheCallback(boost::bind(&ArtLoader::loadCached, this, _1, _2));
+    }
     cache_.init(loader);
 
     // fix default graphics
@@ -45,18 +50,49 @@ boost::shared_ptr<ui::Texture> ArtLoader::getMapTexture(unsigned int id) {
         id = 0;
     }
 
+    if (texturePack_) {
+        boost::shared_ptr<ui::Texture> ret = texturePack_->getTexture(TexturePack::Source::ART, id);
+        if (ret) {
+            return ret;
+        }
+    }
+
     return cache_.get(id);
 }
 
-boost::shared_ptr<ui::Texture> ArtLoader::getItemTexture(unsigned int id) {
+boost::shared_ptr<ui::Texture> ArtLoader::getItemTexture(unsigned int id, bool needPixels) {
     id += 0x4000;
 
+    if (texturePack_ && !needPixels) {
+        boost::shared_ptr<ui::Texture> ret = texturePack_->getTexture(TexturePack::Source::ART, id);
+        if (ret) {
+            return ret;
+        }
+    }
+
     return cache_.get(id);
 }
 
+bool ArtLoader::loadCached(unsigned int index, boost::shared_ptr<ui::Texture> tex) {
+    tex->setUsage(ui::Texture::USAGE_WORLD);
+
+    if (sharedCache_ && sharedCache_->loadTexture(SharedMemoryCache::Source::ART, index, tex)) {
+        return true;
+    }
+
+    if (decodeCache_ && decodeCache_->loadTexture(index, tex)) {
+        if (sharedCache_) {
+            sharedCache_->storeTexture(SharedMemoryCache::Source::ART, index, tex);
+        }
+        return true;
+    }
+
+    return false;
+}
+
 void ArtLoader::readCallback(unsigned int index, int8_t* buf, unsigned int len, boost::shared_ptr<ui::Texture> tex, unsigned int extra, unsigned int userData) {
     tex->setUsage(ui::Texture::USAGE_WORLD);
-    
+
     unsigned short height = 44;
     unsigned short width = 44;
 
@@ -85,21 +121,15 @@ void ArtLoader::readCallback(unsigned int index, int8_t* buf, unsigned int len,
             --curX;
             lineWidth += 2;
             //LOGARG_DEBUG(LOGTYPE_DATA, "zeile y=%u x=%u width=%u", curY, curX, lineWidth);
-            for (unsigned int i = 0; i < lineWidth; i++) {
-                uint32_t pixel = Util::getColorRGBA(*inputPtr);
-                ++inputPtr;
-                pixBufPtr[(curY * 44) + curX + i] = pixel;
-            }
+            Util::convertRow1555(inputPtr, pixBufPtr + (curY * 44) + curX, lineWidth);
+            inputPtr += lineWidth;
             ++curY;
         }
 
         for (unsigned int i = 0; i < 22; ++i) {
             //LOGARG_DEBUG(LOGTYPE_DATA, "zeile y=%u x=%u width=%u", curY, curX, lineWidth);
-            for (unsigned int i = 0; i < lineWidth; i++) {
-                uint32_t pixel = Util::getColorRGBA(*inputPtr);
-                ++inputPtr;
-                pixBufPtr[(curY * 44) + curX + i] = pixel;
-            }
+            Util::convertRow1555(inputPtr, pixBufPtr + (curY * 44) + curX, lineWidth);
+            inputPtr += lineWidth;
             ++curY;
             ++curX;
             lineWidth -= 2;
@@ -119,19 +149,23 @@ void ArtLoader::readCallback(unsigned int index, int8_t* buf, unsigned int len,
             while (runLength) {
                 x += xOffset;
 
-                while (runLength) {
-                    uint16_t color = *inputPtr++;
-
-                    pixBufPtr[(y * width) + x] = Util::getColorRGBA(color);
-                    x++;
-                    runLength--;
-                }
+                Util::convertRow1555(inputPtr, pixBufPtr + (y * width) + x, runLength);
+                inputPtr += runLength;
+                x += runLength;
 
                 xOffset = *inputPtr++;
                 runLength = *inputPtr++;
             }
         }
     }
+
+    if (decodeCache_) {
+        decodeCache_->storeTexture(index, tex);
+    }
+
+    if (sharedCache_) {
+        sharedCache_->storeTexture(SharedMemoryCache::Source::ART, index, tex);
+    }
 }
 
 void ArtLoader::printStats() {
@@ -139,5 +173,13 @@ void ArtLoader::printStats() {
     cache_.printStats();
 }
 
+void ArtLoader::setRetentionBudget(unsigned int bytes) {
+    cache_.setRetentionBudget(bytes);
+}
+
+void ArtLoader::setTexturePack(boost::shared_ptr<TexturePack> pack) {
+    texturePack_ = pack;
+}
+
 }
 }
@@ -20,8 +20,11 @@
 #ifndef FLUO_DATA_ARTLOADER_HPP
 #define FLUO_DATA_ARTLOADER_HPP
 
-#include "weakptrcache.hpp"
+#include "denseweakptrcache.hpp"
 #include "indexedondemandfileloader.hpp"
+#include "decodecache.hpp"
+#include "sharedmemorycache.hpp"
+#include "texturepack.hpp"
 
 #include <boost/filesystem.hpp>
 
@@ -35,19 +38,34 @@ namespace data {
 
 class ArtLoader {
 public:
-    ArtLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath);
+    ArtLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath,
+            boost::shared_ptr<DecodeCache> decodeCache = boost::shared_ptr<DecodeCache>(),
+            boost::shared_ptr<SharedMemoryCache> sharedCache = boost::shared_ptr<SharedMemoryCache>());
 
 
     boost::shared_ptr<ui::Texture> getMapTexture(unsigned int id);
 
-    boost::shared_ptr<ui::Texture> getItemTexture(unsigned int id);
+    /// Textures taken from the texture pack have no pixel buffer, needPixels decodes the art anyway
+    boost::shared_ptr<ui::Texture> getItemTexture(unsigned int id, bool needPixels = false);
 
     void readCallback(unsigned int index, int8_t* buf, unsigned int len, boost::shared_ptr<ui::Texture>, unsigned int extra, unsigned int userData);
+    bool loadCached(unsigned int index, boost::shared_ptr<ui::Texture> tex);
 
     void printStats();
 
+    /// Keeps recently used items in memory up to the given size, see DenseWeakPtrCache::setRetentionBudget
+    void setRetentionBudget(unsigned int bytes);
+
+    /// Textures found in the pack are taken from its atlas pages instead of art.mul
+    void setTexturePack(boost::shared_ptr<TexturePack> pack);
+
 private:
-    WeakPtrCache<unsigned int, ui::Texture, IndexedOnDemandFileLoader> cache_;
+    boost::shared_ptr<TexturePack> texturePack_;
+
+    // declared before the cache, so that it outlives the decode jobs cancelled by the loader destructor
+    boost::shared_ptr<DecodeCache> decodeCache_;
+    boost::shared_ptr<SharedMemoryCache> sharedCache_;
+    DenseWeakPtrCache<ui::Texture, IndexedOnDemandFileLoader> cache_;
 };
 
 }
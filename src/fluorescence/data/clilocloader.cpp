@@ -20,159 +20,250 @@
 
 #include "clilocloader.hpp"
 
+#include "fullfileloader.hpp"
+
+#include <boost/bind.hpp>
+#include <algorithm>
+
 #include <unicode/regex.h>
 
-#include <net/packetreader.hpp>
 #include <misc/log.hpp>
 
 namespace fluo {
 namespace data {
 
-ClilocLoader::ClilocLoader() : bufferSize_(0), buffer_(NULL) {
+ClilocLoader::ClilocLoader() {
 }
 
-ClilocLoader::~ClilocLoader() {
-    if (buffer_) {
-        free(buffer_);
-        buffer_ = NULL;
+unsigned int ClilocLoader::findEntry(unsigned int id) const {
+    std::vector<uint32_t>::const_iterator iter = std::lower_bound(ids_.begin(), ids_.end(), id);
+    if (iter != ids_.end() && *iter == id) {
+        return iter - ids_.begin();
+    } else {
+        return ids_.size();
     }
 }
 
 bool ClilocLoader::hasEntry(unsigned int id) const {
-    return entryMap_.find(id) != entryMap_.end();
+    return findEntry(id) != ids_.size();
+}
+
+ClilocCacheEntry& ClilocLoader::getCacheEntry(unsigned int idx) {
+    ClilocEntry& entry = entries_[idx];
+    if (entry.cacheIdx_ == ClilocEntry::NOT_CACHED) {
+        entry.cacheIdx_ = cache_.size();
+        cache_.push_back(ClilocCacheEntry());
+        cache_.back().text_ = StringConverter::fromUtf8(&arena_[entry.offset_], entry.len_);
+        cache_.back().hasPlaceholders_ = cache_.back().text_.indexOf((UChar)'~') >= 0;
+    }
+
+    return cache_[entry.cacheIdx_];
 }
 
 UnicodeString ClilocLoader::get(unsigned int id) {
-    std::map<unsigned int, ClilocEntry>::iterator iter = entryMap_.find(id);
-    if (iter != entryMap_.end()) {
-        if (iter->second.useCount_ == USE_COUNT_CACHE_LIMIT) {
-            // cache it now
-            iter->second.useCount_ = USE_COUNT_CACHE_LIMIT + 1;
-            iter->second.cachedString_ = readEntry(iter->second);
-            return iter->second.cachedString_;
-        } else if (iter->second.useCount_ > USE_COUNT_CACHE_LIMIT) {
-            // already cached
-            return iter->second.cachedString_;
-        } else {
-            ++iter->second.useCount_;
-            return readEntry(iter->second);
-        }
+    unsigned int idx = findEntry(id);
+    if (idx == ids_.size()) {
+        return UnicodeString("##CLILOCERROR");
     }
 
-    return UnicodeString("##CLILOCERROR");
+    return getCacheEntry(idx).text_;
 }
 
 UnicodeString ClilocLoader::get(unsigned int id, const UnicodeString& paramString) {
-    static UnicodeString params[9];
-    static UnicodeString paramRegex[9] = {
-        "~1_[^~]+~", "~2_[^~]+~", "~3_[^~]+~", "~4_[^~]+~", "~5_[^~]+~",
-        "~6_[^~]+~", "~7_[^~]+~", "~8_[^~]+~", "~9_[^~]+~",
-    };
+    if (paramString.length() == 0) {
+        return get(id);
+    }
 
-    UnicodeString str = get(id);
+    // split at tabs. A trailing tab gives an empty last argument, and the last argument gets the rest of the string
+    // if there are more than MAX_ARGUMENTS
+    UnicodeString params[MAX_ARGUMENTS];
+    unsigned int paramCount = 0;
+    int32_t start = 0;
+    while (paramCount < MAX_ARGUMENTS - 1) {
+        int32_t tab = paramString.indexOf((UChar)'\t', start);
+        if (tab < 0) {
+            break;
+        }
+        params[paramCount].setTo(paramString, start, tab - start);
+        ++paramCount;
+        start = tab + 1;
+    }
+    params[paramCount].setTo(paramString, start);
+    ++paramCount;
 
-    if (paramString.length() > 0) {
-        UErrorCode status = U_ZERO_ERROR;
-        RegexMatcher paramSplitter("\\t", 0, status);
-        unsigned int paramCount = paramSplitter.split(paramString, params, 9, status);
+    return fillTemplate(id, params, paramCount);
+}
 
-        for (unsigned int i = 0; i < paramCount; ++i) {
-            RegexMatcher curParamMatcher(paramRegex[i], str, 0, status);
+UnicodeString ClilocLoader::get(unsigned int id, const std::vector<UnicodeString>& params) {
+    if (params.empty()) {
+        return get(id);
+    }
 
-            str = curParamMatcher.replaceAll(params[i], status);
+    // arguments beyond the ninth have no placeholder
+    unsigned int paramCount = params.size() < MAX_ARGUMENTS ? params.size() : MAX_ARGUMENTS;
+    return fillTemplate(id, &params[0], paramCount);
+}
+
+void ClilocLoader::replacePlaceholders(UnicodeString& str, unsigned int argument, const UnicodeString& value) {
+    // leftmost matches first, the search continues behind the replaced placeholder
+    UnicodeString ret;
+    int32_t literalStart = 0;
+    int32_t pos = 0;
+    int32_t len = str.length();
+    while (pos + 4 <= len) {
+        if (str[pos] == '~' && str[pos + 1] == '0' + argument && str[pos + 2] == '_' && str[pos + 3] != '~') {
+            int32_t close = str.indexOf((UChar)'~', pos + 4);
+            if (close < 0) {
+                // no later placeholder can be closed either
+                break;
+            }
+
+            ret.append(str, literalStart, pos - literalStart);
+            ret.append(value);
+            pos = close + 1;
+            literalStart = pos;
+        } else {
+            ++pos;
         }
     }
 
-    return str;
+    if (literalStart > 0) {
+        ret.append(str, literalStart, len - literalStart);
+        str = ret;
+    }
 }
 
-UnicodeString ClilocLoader::get(unsigned int id, const std::vector<UnicodeString>& params) {
-    static UnicodeString paramRegex[9] = {
+UnicodeString ClilocLoader::fillTemplateRegex(const UnicodeString& text, const UnicodeString* params, unsigned int paramCount) {
+    static UnicodeString paramRegex[MAX_ARGUMENTS] = {
         "~1_[^~]+~", "~2_[^~]+~", "~3_[^~]+~", "~4_[^~]+~", "~5_[^~]+~",
         "~6_[^~]+~", "~7_[^~]+~", "~8_[^~]+~", "~9_[^~]+~",
     };
 
-    UnicodeString str = get(id);
-
-    if (params.size() > 0) {
-        UErrorCode status = U_ZERO_ERROR;
+    UnicodeString str = text;
+    UErrorCode status = U_ZERO_ERROR;
+    for (unsigned int i = 0; i < paramCount; ++i) {
+        RegexMatcher curParamMatcher(paramRegex[i], str, 0, status);
 
-        for (unsigned int i = 0; i < params.size(); ++i) {
-            RegexMatcher curParamMatcher(paramRegex[i], str, 0, status);
-
-            str = curParamMatcher.replaceAll(params[i], status);
-        }
+        str = curParamMatcher.replaceAll(params[i], status);
     }
 
     return str;
 }
 
-void ClilocLoader::indexFile(const boost::filesystem::path& path, bool isEnu) {
-    unsigned int startBufferSize = bufferSize_;
+UnicodeString ClilocLoader::fillTemplate(unsigned int id, const UnicodeString* params, unsigned int paramCount) {
+    unsigned int idx = findEntry(id);
+    if (idx == ids_.size()) {
+        return UnicodeString("##CLILOCERROR");
+    }
 
-    boost::filesystem::ifstream* stream = isEnu ? &enuStream_ : &languageStream_;
-    stream->open(path, std::ios::binary);
+    const ClilocCacheEntry& entry = getCacheEntry(idx);
+    if (!entry.hasPlaceholders_) {
+        return entry.text_;
+    }
 
-    unsigned int filesize = boost::filesystem::file_size(path);
+    for (unsigned int i = 0; i < paramCount; ++i) {
+        if (params[i].indexOf((UChar)'$') >= 0 || params[i].indexOf((UChar)'\\') >= 0) {
+            return fillTemplateRegex(entry.text_, params, paramCount);
+        }
+    }
 
-    stream->seekg(6);
-    uint8_t indexBuffer[7];
-    uint32_t id;
-    uint16_t len;
+    // an argument may contain a placeholder of a later argument, so they are applied one after the other
+    UnicodeString ret = entry.text_;
+    for (unsigned int i = 0; i < paramCount; ++i) {
+        replacePlaceholders(ret, i + 1, params[i]);
+    }
 
-    while (stream->tellg() != (std::streampos)filesize) {
-        if (stream->tellg() == (std::streampos)-1) {
-            LOG_ERROR << "Received value -1 from stream->tellg() in ClilocLoader::indexFile" << std::endl;
-            break;
-        }
-        stream->read(reinterpret_cast<char*>(indexBuffer), 7);
-        ClilocEntry curEntry;
+    return ret;
+}
 
-        id = indexBuffer[0];
-        id |= ((uint32_t)indexBuffer[1]) << 8;
-        id |= ((uint32_t)indexBuffer[2]) << 16;
-        id |= ((uint32_t)indexBuffer[3]) << 24;
+void ClilocLoader::indexFile(const boost::filesystem::path& path, bool isEnu) {
+    FullFileLoader loader(path);
+    loader.read(boost::bind(&ClilocLoader::readCallbackFile, this, _1, _2));
+}
 
-        len = indexBuffer[5];
-        len |= ((uint16_t)indexBuffer[6]) << 8;
+namespace {
+struct ClilocEntryIdLess {
+    bool operator()(const std::pair<uint32_t, ClilocEntry>& a, const std::pair<uint32_t, ClilocEntry>& b) const {
+        return a.first < b.first;
+    }
+};
+}
 
-        curEntry.id_ = id;
-        curEntry.len_ = len;
-        curEntry.streampos_ = stream->tellg();
-        curEntry.fromEnu_ = isEnu;
+void ClilocLoader::readCallbackFile(int8_t* buf, unsigned int len) {
+    const uint8_t* ubuf = reinterpret_cast<const uint8_t*>(buf);
 
-        if (len > 0) {
-            entryMap_[curEntry.id_] = curEntry;
+    // entry payloads are appended to the arena
+    arena_.reserve(arena_.size() + len);
 
-            //LOG_DEBUG << "filesize: " << filesize << " cur=" << stream->tellg() << " len=" << curEntry.len_ << std::hex << " iB[5]=" << (unsigned int)indexBuffer[5] << " iB[6]=" << (unsigned int)indexBuffer[6] << std::dec << std::endl;
+    std::vector<std::pair<uint32_t, ClilocEntry> > fileEntries;
+    fileEntries.reserve(len / 16);
 
-            stream->seekg(curEntry.len_, std::ios::cur);
-            bufferSize_ = (std::max)(bufferSize_, curEntry.len_);
-        }
-    }
+    // 6 byte header, then entries of id (4 bytes), flag (1 byte), length (2 bytes) and utf8 payload
+    unsigned int pos = 6;
+    while (pos + 7 <= len) {
+        uint32_t id = ubuf[pos] | (ubuf[pos + 1] << 8) | (ubuf[pos + 2] << 16) | (ubuf[pos + 3] << 24);
+        uint32_t entryLen = ubuf[pos + 5] | (ubuf[pos + 6] << 8);
+        pos += 7;
 
-    if (bufferSize_ > startBufferSize) {
-        buffer_ = reinterpret_cast<int8_t*>(realloc(buffer_, bufferSize_));
-    }
-}
+        if (pos + entryLen > len) {
+            LOG_ERROR << "Cliloc file truncated at entry " << id << std::endl;
+            break;
+        }
 
-UnicodeString ClilocLoader::readEntry(const ClilocEntry& entry) {
-    boost::filesystem::ifstream* stream = entry.fromEnu_ ? &enuStream_ : &languageStream_;
+        if (entryLen > 0) {
+            ClilocEntry entry;
+            entry.offset_ = arena_.size();
+            entry.len_ = entryLen;
+            arena_.insert(arena_.end(), buf + pos, buf + pos + entryLen);
+            fileEntries.push_back(std::make_pair(id, entry));
+        }
 
-    stream->seekg(entry.streampos_);
-    stream->read(reinterpret_cast<char*>(buffer_), entry.len_);
+        pos += entryLen;
+    }
 
-    unsigned int indexHelper = 0;
-    UnicodeString ret;
-    net::PacketReader::readUtf8Fixed(buffer_, entry.len_, indexHelper, ret, entry.len_);
+    // cliloc files are sorted already, but do not rely on it. Of duplicate ids, the last entry wins
+    std::stable_sort(fileEntries.begin(), fileEntries.end(), ClilocEntryIdLess());
+
+    std::vector<uint32_t> ids;
+    std::vector<ClilocEntry> entries;
+    ids.reserve(ids_.size() + fileEntries.size());
+    entries.reserve(ids_.size() + fileEntries.size());
+
+    // merge with the entries of previously indexed files
+    unsigned int oldIdx = 0;
+    unsigned int newIdx = 0;
+    while (oldIdx < ids_.size() || newIdx < fileEntries.size()) {
+        bool takeNew;
+        if (newIdx == fileEntries.size()) {
+            takeNew = false;
+        } else if (oldIdx == ids_.size()) {
+            takeNew = true;
+        } else {
+            takeNew = fileEntries[newIdx].first <= ids_[oldIdx];
+        }
 
-    unsigned int x = 0;
-    ++x;
-    x = ret.length();
+        if (takeNew) {
+            uint32_t id = fileEntries[newIdx].first;
+            while (newIdx + 1 < fileEntries.size() && fileEntries[newIdx + 1].first == id) {
+                ++newIdx;
+            }
+            if (oldIdx < ids_.size() && ids_[oldIdx] == id) {
+                ++oldIdx;
+            }
+
+            ids.push_back(id);
+            entries.push_back(fileEntries[newIdx].second);
+            ++newIdx;
+        } else {
+            ids.push_back(ids_[oldIdx]);
+            entries.push_back(entries_[oldIdx]);
+            ++oldIdx;
+        }
+    }
 
-    return ret;
+    ids_.swap(ids);
+    entries_.swap(entries);
 }
 
-
 }
 }
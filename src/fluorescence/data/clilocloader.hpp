@@ -20,11 +20,10 @@
 #ifndef FLUO_DATA_CLILOCLOADER_HPP
 #define FLUO_DATA_CLILOCLOADER_HPP
 
-#include <map>
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
 #include <boost/filesystem/path.hpp>
-#include <boost/filesystem/fstream.hpp>
 
 #include <misc/string.hpp>
 
@@ -32,22 +31,39 @@ namespace fluo {
 namespace data {
 
 struct ClilocEntry {
-    ClilocEntry() : id_(0), len_(0), streampos_(0), useCount_(0), fromEnu_(true) {
+    ClilocEntry() : offset_(0), len_(0), cacheIdx_(NOT_CACHED) {
     }
 
-    unsigned int id_;
-    unsigned int len_;
-    unsigned int streampos_;
-    unsigned int useCount_; // if the string is accessed often, cache it
-    UnicodeString cachedString_;
-    bool fromEnu_;
+    static const uint32_t NOT_CACHED = 0xFFFFFFFFu;
+
+    uint32_t offset_; // utf8 payload in the string arena
+    uint32_t len_;
+    uint32_t cacheIdx_; // index in cache_, once the string was requested
+};
+
+struct ClilocCacheEntry {
+    ClilocCacheEntry() : hasPlaceholders_(false) {
+    }
+
+    UnicodeString text_;
+    bool hasPlaceholders_; // text_ contains a ~, otherwise arguments do not change it
 };
 
+/**
+ * \brief Loads cliloc files completely into memory
+ *
+ * The utf8 payloads of all entries are stored in a single arena, the entries are sorted by id and looked up with a binary search.
+ * UnicodeStrings are only created when an entry is first requested, and then kept.
+ *
+ * Arguments replace the ~N_NAME~ placeholders in the same way the regular expressions ~N_[^~]+~ did before, one argument after
+ * the other, but with a plain scan of the string. Arguments containing $ or \ are still applied with the regular expressions, because
+ * the replacement interprets them.
+ */
 class ClilocLoader {
 public:
     ClilocLoader();
-    ~ClilocLoader();
 
+    /// Entries of later files replace entries with the same id from earlier ones
     void indexFile(const boost::filesystem::path& path, bool isEnu);
 
     bool hasEntry(unsigned int id) const;
@@ -57,17 +73,28 @@ public:
     UnicodeString get(unsigned int id, const std::vector<UnicodeString>& params);
 
 private:
-    std::map<unsigned int, ClilocEntry> entryMap_;
+    void readCallbackFile(int8_t* buf, unsigned int len);
+
+    // returns ids_.size() if there is no entry for this id
+    unsigned int findEntry(unsigned int id) const;
+
+    ClilocCacheEntry& getCacheEntry(unsigned int idx);
+
+    static const unsigned int MAX_ARGUMENTS = 9;
+
+    UnicodeString fillTemplate(unsigned int id, const UnicodeString* params, unsigned int paramCount);
 
-    static const unsigned int USE_COUNT_CACHE_LIMIT = 3;
+    /// Same as replacing the regular expression ~argument_[^~]+~ with value
+    static void replacePlaceholders(UnicodeString& str, unsigned int argument, const UnicodeString& value);
+    static UnicodeString fillTemplateRegex(const UnicodeString& text, const UnicodeString* params, unsigned int paramCount);
 
-    UnicodeString readEntry(const ClilocEntry& entry);
+    // sorted, parallel to entries_
+    std::vector<uint32_t> ids_;
+    std::vector<ClilocEntry> entries_;
 
-    boost::filesystem::ifstream languageStream_;
-    boost::filesystem::ifstream enuStream_;
+    std::vector<char> arena_;
 
-    unsigned int bufferSize_;
-    int8_t* buffer_;
+    std::vector<ClilocCacheEntry> cache_;
 };
 
 }
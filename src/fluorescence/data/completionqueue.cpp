@@ -0,0 +1,110 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "completionqueue.hpp"
+
+#include <misc/log.hpp>
+
+#include <boost/bind.hpp>
+
+namespace fluo {
+namespace data {
+
+CompletionQueue* CompletionQueue::getSingleton() {
+    static CompletionQueue singleton;
+    return &singleton;
+}
+
+CompletionQueue::CompletionQueue() : head_(NULL), waiterCount_(0) {
+}
+
+CompletionQueue::~CompletionQueue() {
+    Node* cur = head_.exchange(NULL);
+    while (cur) {
+        Node* next = cur->next_;
+        delete cur;
+        cur = next;
+    }
+}
+
+void CompletionQueue::post(const Callback& callback) {
+    Node* node = new Node();
+    node->callback_ = callback;
+    node->next_ = head_.load(std::memory_order_relaxed);
+
+    // on failure, next_ is updated to the current head.
+    // Sequentially consistent, like the accesses in waitForPost: either the waiter sees the new head, or we see the waiter
+    while (!head_.compare_exchange_weak(node->next_, node, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+    }
+
+    if (waiterCount_.load() > 0) {
+        boost::mutex::scoped_lock lock(waitMutex_);
+        waitCondition_.notify_all();
+    }
+}
+
+unsigned int CompletionQueue::drain() {
+    // take all nodes at once, so there is no interference with concurrent posts
+    Node* cur = head_.exchange(NULL, std::memory_order_acquire);
+    if (!cur) {
+        return 0;
+    }
+
+    // reverse to posting order
+    Node* ordered = NULL;
+    while (cur) {
+        Node* next = cur->next_;
+        cur->next_ = ordered;
+        ordered = cur;
+        cur = next;
+    }
+
+    unsigned int count = 0;
+    while (ordered) {
+        Node* next = ordered->next_;
+        try {
+            ordered->callback_();
+        } catch (const std::exception& ex) {
+            LOG_ERROR << "Exception in completion callback: " << ex.what() << std::endl;
+        }
+        delete ordered;
+        ordered = next;
+        ++count;
+    }
+
+    return count;
+}
+
+bool CompletionQueue::hasPosts() const {
+    return head_.load() != NULL;
+}
+
+bool CompletionQueue::waitForPost(unsigned int timeoutMillis) {
+    boost::mutex::scoped_lock lock(waitMutex_);
+    waiterCount_.fetch_add(1);
+
+    // a post after the first check has to take the mutex to notify, which it only gets once we are waiting
+    bool ret = waitCondition_.timed_wait(lock, boost::posix_time::milliseconds(timeoutMillis), boost::bind(&CompletionQueue::hasPosts, this));
+
+    waiterCount_.fetch_sub(1);
+    return ret;
+}
+
+}
+}
@@ -0,0 +1,86 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FLUO_DATA_COMPLETIONQUEUE_HPP
+#define FLUO_DATA_COMPLETIONQUEUE_HPP
+
+#include <atomic>
+
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace fluo {
+namespace data {
+
+/**
+ * \brief Hands notifications from loader threads to the main thread
+ *
+ * Any thread can post callbacks without taking a lock, the main loop runs them once per frame by calling drain.
+ * Used by OnDemandReadable to notify objects waiting for a read to complete. Tools without a main loop (e.g. fluo-packer)
+ * block in waitForPost until there is something to drain.
+ */
+class CompletionQueue {
+public:
+    typedef boost::function<void ()> Callback;
+
+    static CompletionQueue* getSingleton();
+
+    ~CompletionQueue();
+
+    /// Can be called from any thread
+    void post(const Callback& callback);
+
+    /**
+     * Main thread only. Runs all callbacks posted so far in posting order and returns their number.
+     * Callbacks posted while draining are run by the next call
+     */
+    unsigned int drain();
+
+    /**
+     * Main thread only. Blocks until a callback is waiting to be drained or the timeout elapsed.
+     * Returns true if there is something to drain
+     */
+    bool waitForPost(unsigned int timeoutMillis);
+
+private:
+    CompletionQueue();
+    CompletionQueue(const CompletionQueue& copy) { }
+    CompletionQueue& operator=(const CompletionQueue& copy) { return *this; }
+
+    struct Node {
+        Callback callback_;
+        Node* next_;
+    };
+
+    // most recently posted node first
+    std::atomic<Node*> head_;
+
+    // post only takes the mutex if somebody waits in waitForPost
+    std::atomic<unsigned int> waiterCount_;
+    boost::mutex waitMutex_;
+    boost::condition_variable waitCondition_;
+
+    bool hasPosts() const;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,332 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "decodecache.hpp"
+
+#include <boost/filesystem/fstream.hpp>
+
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <ctime>
+
+#include <ui/texture.hpp>
+#include <ui/animation.hpp>
+#include <misc/log.hpp>
+
+namespace fluo {
+namespace data {
+
+namespace bfs = boost::filesystem;
+
+namespace {
+// increase whenever the format of the cached data changes
+const uint64_t FORMAT_VERSION = 1;
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+uint64_t fnvHash(uint64_t hash, const void* data, unsigned int len) {
+    const uint8_t* ptr = reinterpret_cast<const uint8_t*>(data);
+    for (unsigned int i = 0; i < len; ++i) {
+        hash ^= ptr[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+uint64_t fnvHash(uint64_t hash, uint64_t value) {
+    return fnvHash(hash, &value, sizeof(value));
+}
+}
+
+DecodeCache::DecodeCache(const bfs::path& directory, const std::string& name,
+        const std::vector<bfs::path>& indexFiles, const std::vector<bfs::path>& dataFiles,
+        unsigned int maxMegabytes, unsigned int maxAgeDays) :
+        name_(name), hitCount_(0), storeCount_(0), tempFileCounter_(0) {
+
+    std::stringstream ss;
+    ss << name << "-" << std::hex << std::setw(16) << std::setfill('0') << hashFiles(indexFiles, dataFiles);
+    path_ = directory / ss.str();
+
+    bfs::create_directories(path_);
+    // the modification time of the directory marks when this version was last used
+    bfs::last_write_time(path_, std::time(NULL));
+
+    removeOutdated(directory, ss.str(), (uint64_t)maxMegabytes * 1024 * 1024, maxAgeDays);
+
+    LOG_INFO << "Decode cache for " << name_ << " in " << path_ << std::endl;
+}
+
+DecodeCache::~DecodeCache() {
+    LOG_DEBUG << "Decode cache " << name_ << ": hits=" << hitCount_ << " stored=" << storeCount_ << std::endl;
+}
+
+uint64_t DecodeCache::hashFiles(const std::vector<bfs::path>& indexFiles, const std::vector<bfs::path>& dataFiles) {
+    uint64_t hash = fnvHash(FNV_OFFSET_BASIS, FORMAT_VERSION);
+
+    std::vector<char> buf(64 * 1024);
+    for (unsigned int i = 0; i < indexFiles.size(); ++i) {
+        bfs::ifstream stream(indexFiles[i], std::ios_base::binary);
+        while (stream) {
+            stream.read(&buf[0], buf.size());
+            hash = fnvHash(hash, &buf[0], stream.gcount());
+        }
+    }
+
+    for (unsigned int i = 0; i < dataFiles.size(); ++i) {
+        hash = fnvHash(hash, bfs::file_size(dataFiles[i]));
+        hash = fnvHash(hash, bfs::last_write_time(dataFiles[i]));
+    }
+
+    return hash;
+}
+
+void DecodeCache::removeOutdated(const bfs::path& directory, const std::string& current, uint64_t maxBytes, unsigned int maxAgeDays) {
+    std::string prefix = name_ + "-";
+
+    // other versions of this file's cache, most recently used first
+    std::vector<std::pair<std::time_t, bfs::path> > versions;
+    bfs::directory_iterator iter(directory);
+    bfs::directory_iterator end;
+    for (; iter != end; ++iter) {
+        std::string leaf = iter->path().leaf();
+        // the hash has a fixed length, so e.g. anim2 directories do not match the prefix anim-
+        if (bfs::is_directory(iter->status()) && leaf.size() == prefix.size() + 16 && leaf.compare(0, prefix.size(), prefix) == 0 && leaf != current) {
+            versions.push_back(std::make_pair(bfs::last_write_time(iter->path()), iter->path()));
+        }
+    }
+
+    if (versions.empty()) {
+        return;
+    }
+
+    std::sort(versions.begin(), versions.end(), std::greater<std::pair<std::time_t, bfs::path> >());
+
+    std::time_t now = std::time(NULL);
+    uint64_t totalBytes = getDirectorySize(path_);
+
+    for (unsigned int i = 0; i < versions.size(); ++i) {
+        uint64_t size = getDirectorySize(versions[i].second);
+        if (now - versions[i].first <= (std::time_t)maxAgeDays * 24 * 60 * 60 && totalBytes + size <= maxBytes) {
+            totalBytes += size;
+            continue;
+        }
+
+        LOG_INFO << "Removing outdated decode cache " << versions[i].second << std::endl;
+        try {
+            bfs::remove_all(versions[i].second);
+        } catch (const bfs::filesystem_error& ex) {
+            LOG_WARN << "Unable to remove outdated decode cache: " << ex.what() << std::endl;
+        }
+    }
+}
+
+uint64_t DecodeCache::getDirectorySize(const bfs::path& directory) {
+    uint64_t ret = 0;
+
+    bfs::recursive_directory_iterator iter(directory);
+    bfs::recursive_directory_iterator end;
+    for (; iter != end; ++iter) {
+        if (bfs::is_regular_file(iter->status())) {
+            ret += bfs::file_size(iter->path());
+        }
+    }
+
+    return ret;
+}
+
+bfs::path DecodeCache::getFilePath(unsigned int id) const {
+    std::stringstream dirName;
+    dirName << (id / 1024);
+    std::stringstream fileName;
+    fileName << id;
+    return path_ / dirName.str() / fileName.str();
+}
+
+bool DecodeCache::readFile(unsigned int id, std::vector<uint32_t>& data) {
+    bfs::path path = getFilePath(id);
+    if (!bfs::exists(path)) {
+        return false;
+    }
+
+    unsigned int size = bfs::file_size(path);
+    if (size == 0 || size % sizeof(uint32_t) != 0) {
+        return false;
+    }
+
+    data.resize(size / sizeof(uint32_t));
+    bfs::ifstream stream(path, std::ios_base::binary);
+    stream.read(reinterpret_cast<char*>(&data[0]), size);
+    return stream.good();
+}
+
+void DecodeCache::writeFile(unsigned int id, const std::vector<uint32_t>& data) {
+    bfs::path path = getFilePath(id);
+
+    std::stringstream tempName;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        tempName << path.string() << ".tmp" << tempFileCounter_++;
+        ++storeCount_;
+    }
+
+    // write to a temporary file first, so that other threads never see a partially written file
+    try {
+        bfs::create_directories(path.parent_path());
+
+        bfs::ofstream stream(tempName.str(), std::ios_base::binary | std::ios_base::trunc);
+        stream.write(reinterpret_cast<const char*>(&data[0]), data.size() * sizeof(uint32_t));
+        stream.close();
+
+        if (stream.fail()) {
+            bfs::remove(tempName.str());
+        } else {
+            if (bfs::exists(path)) {
+                // rename does not replace existing files on windows
+                bfs::remove(path);
+            }
+            bfs::rename(tempName.str(), path);
+        }
+    } catch (const bfs::filesystem_error& ex) {
+        LOG_WARN << "Unable to write decode cache file " << path << ": " << ex.what() << std::endl;
+    }
+}
+
+bool DecodeCache::loadTexture(unsigned int id, boost::shared_ptr<ui::Texture> tex) {
+    std::vector<uint32_t> data;
+    if (!readFile(id, data) || data.size() < 2) {
+        return false;
+    }
+
+    unsigned int width = data[0];
+    unsigned int height = data[1];
+    if (data.size() != 2 + width * height) {
+        return false;
+    }
+
+    tex->initPixelBuffer(width, height);
+    if (width * height > 0) {
+        memcpy(tex->getPixelBufferData(), &data[2], width * height * sizeof(uint32_t));
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    ++hitCount_;
+    return true;
+}
+
+void DecodeCache::storeTexture(unsigned int id, boost::shared_ptr<ui::Texture> tex) {
+    unsigned int width = tex->getPixelBuffer().get_width();
+    unsigned int height = tex->getPixelBuffer().get_height();
+
+    std::vector<uint32_t> data(2 + width * height);
+    data[0] = width;
+    data[1] = height;
+    if (width * height > 0) {
+        memcpy(&data[2], tex->getPixelBufferData(), width * height * sizeof(uint32_t));
+    }
+
+    writeFile(id, data);
+}
+
+bool DecodeCache::loadAnimation(unsigned int id, boost::shared_ptr<ui::Animation> anim) {
+    std::vector<uint32_t> data;
+    if (!readFile(id, data)) {
+        return false;
+    }
+
+    // validate everything first, the animation can not be reset if the data is broken
+    unsigned int frameCount = data[0];
+    unsigned int offset = 1;
+    for (unsigned int i = 0; i < frameCount; ++i) {
+        if (offset + 5 > data.size() || (data[offset] != 0 && i == 0)) {
+            return false;
+        }
+        offset += 5 + (data[offset] == 0 ? data[offset + 3] * data[offset + 4] : 0);
+    }
+    if (offset != data.size()) {
+        return false;
+    }
+
+    offset = 1;
+    for (unsigned int i = 0; i < frameCount; ++i) {
+        bool repeated = data[offset] != 0;
+        if (repeated) {
+            anim->addFrame(anim->getFrame(i - 1));
+            offset += 5;
+            continue;
+        }
+
+        ui::AnimationFrame curFrame;
+        curFrame.centerX_ = static_cast<int32_t>(data[offset + 1]);
+        curFrame.centerY_ = static_cast<int32_t>(data[offset + 2]);
+        unsigned int width = data[offset + 3];
+        unsigned int height = data[offset + 4];
+        offset += 5;
+
+        curFrame.texture_->setUsage(ui::Texture::USAGE_WORLD);
+        curFrame.texture_->initPixelBuffer(width, height);
+        if (width * height > 0) {
+            memcpy(curFrame.texture_->getPixelBufferData(), &data[offset], width * height * sizeof(uint32_t));
+        }
+        offset += width * height;
+
+        curFrame.texture_->setReadComplete();
+        anim->addFrame(curFrame);
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    ++hitCount_;
+    return true;
+}
+
+void DecodeCache::storeAnimation(unsigned int id, boost::shared_ptr<ui::Animation> anim) {
+    unsigned int frameCount = anim->getFrameCount();
+
+    std::vector<uint32_t> data;
+    data.push_back(frameCount);
+
+    for (unsigned int i = 0; i < frameCount; ++i) {
+        ui::AnimationFrame curFrame = anim->getFrame(i);
+
+        // frames sharing the texture of their predecessor are only stored once
+        bool repeated = i > 0 && anim->getFrame(i - 1).texture_ == curFrame.texture_;
+        unsigned int width = repeated ? 0 : curFrame.texture_->getPixelBuffer().get_width();
+        unsigned int height = repeated ? 0 : curFrame.texture_->getPixelBuffer().get_height();
+
+        data.push_back(repeated ? 1 : 0);
+        data.push_back(static_cast<uint32_t>(curFrame.centerX_));
+        data.push_back(static_cast<uint32_t>(curFrame.centerY_));
+        data.push_back(width);
+        data.push_back(height);
+
+        if (!repeated && width * height > 0) {
+            unsigned int offset = data.size();
+            data.resize(offset + width * height);
+            memcpy(&data[offset], curFrame.texture_->getPixelBufferData(), width * height * sizeof(uint32_t));
+        }
+    }
+
+    writeFile(id, data);
+}
+
+}
+}
@@ -0,0 +1,99 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FLUO_DATA_DECODECACHE_HPP
+#define FLUO_DATA_DECODECACHE_HPP
+
+#include <boost/shared_ptr.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <vector>
+#include <string>
+
+#include <stdint.h>
+
+namespace fluo {
+
+namespace ui {
+    class Texture;
+    class Animation;
+}
+
+namespace data {
+
+/**
+ * \brief Stores decoded textures and animations on disk, so that they do not have to be decoded again on the next start
+ *
+ * The cache of each data file lives in its own directory, named after the file and a hash of its source files
+ * (contents of the index file, size and modification time of the data file). If the shard's files change, a new
+ * directory is used. The directories of other versions are kept, e.g. for a second shard using other files, until
+ * they were not used for maxAgeDays or all versions of the file together exceed maxMegabytes. The least recently
+ * used ones are removed first.
+ *
+ * All methods can be called from multiple decode threads at once.
+ */
+class DecodeCache {
+public:
+    /**
+     * \param directory Base directory for all decode caches
+     * \param name Name of the cached data file, e.g. "art"
+     * \param indexFiles Files whose complete contents are hashed
+     * \param dataFiles Files of which only the size and modification time are hashed
+     * \param maxMegabytes Size limit for all versions of this file's cache. The current version is never removed
+     * \param maxAgeDays Other versions not used for this long are removed
+     */
+    DecodeCache(const boost::filesystem::path& directory, const std::string& name,
+            const std::vector<boost::filesystem::path>& indexFiles, const std::vector<boost::filesystem::path>& dataFiles,
+            unsigned int maxMegabytes, unsigned int maxAgeDays);
+    ~DecodeCache();
+
+    /// Returns true and fills the texture if the id is cached. The texture usage has to be set by the caller
+    bool loadTexture(unsigned int id, boost::shared_ptr<ui::Texture> tex);
+    void storeTexture(unsigned int id, boost::shared_ptr<ui::Texture> tex);
+
+    /// Returns true and adds all frames to the animation if the id is cached
+    bool loadAnimation(unsigned int id, boost::shared_ptr<ui::Animation> anim);
+    void storeAnimation(unsigned int id, boost::shared_ptr<ui::Animation> anim);
+
+    /// Hashes the complete contents of indexFiles and the size and modification time of dataFiles
+    static uint64_t hashFiles(const std::vector<boost::filesystem::path>& indexFiles, const std::vector<boost::filesystem::path>& dataFiles);
+
+private:
+    std::string name_;
+    boost::filesystem::path path_;
+
+    boost::mutex mutex_;
+    unsigned int hitCount_;
+    unsigned int storeCount_;
+    unsigned int tempFileCounter_;
+
+    boost::filesystem::path getFilePath(unsigned int id) const;
+
+    bool readFile(unsigned int id, std::vector<uint32_t>& data);
+    void writeFile(unsigned int id, const std::vector<uint32_t>& data);
+
+    void removeOutdated(const boost::filesystem::path& directory, const std::string& current, uint64_t maxBytes, unsigned int maxAgeDays);
+    static uint64_t getDirectorySize(const boost::filesystem::path& directory);
+};
+
+}
+}
+
+#endif
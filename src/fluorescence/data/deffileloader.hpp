@@ -21,10 +21,16 @@
 #define FLUO_DATA_DEFFILELOADER_HPP
 
 #include <map>
+#include <vector>
+#include <string>
+#include <string.h>
 #include <boost/filesystem/path.hpp>
 #include <boost/function.hpp>
 
 #include <misc/exception.hpp>
+#include <misc/log.hpp>
+
+#include "deffileparser.hpp"
 
 namespace fluo {
 namespace data {
@@ -39,88 +45,48 @@ public:
     DefFileLoader() {
     }
 
-    DefFileLoader(const boost::filesystem::path& path, const char* pattern, StringParseFunction stringParseFunction = StringParseFunction()) {
-        std::ifstream ifs(path.string().c_str());
-        if (!ifs.is_open() || !ifs.good()) {
-            LOG_ERROR << "Unable to open DefFileLoader for path: " << path.string() << std::endl;
+    /**
+     * \param cachePath If not empty, the parsed records are cached in this file. See DefFileParser
+     */
+    DefFileLoader(const boost::filesystem::path& path, const char* pattern, StringParseFunction stringParseFunction = StringParseFunction(),
+            const boost::filesystem::path& cachePath = boost::filesystem::path()) {
+        DefFileRecords records;
+        if (!DefFileParser::load(path, pattern, cachePath, records)) {
             return;
         }
 
         unsigned int patternCount = strlen(pattern);
-        char strBuf[256];
-        while (ifs.good()) {
-            if (ifs.peek() == '#' || ifs.peek() == '\n' || ifs.peek() == '\r') {
-                ifs.ignore(1000, '\n');
-                continue;
-            }
+        if (records.count_ > 0 && strchr(pattern, 's') && !stringParseFunction) {
+            LOG_ERROR << "No string parse function given for pattern " << pattern << " for file " << path << std::endl;
+            throw Exception("Error parsing def file");
+        }
 
+        std::vector<int>::const_iterator numberIter = records.numbers_.begin();
+        std::vector<std::string>::const_iterator stringIter = records.strings_.begin();
+
+        for (unsigned int recordIdx = 0; recordIdx < records.count_; ++recordIdx) {
             ValueType curValue;
             int* ptr = reinterpret_cast<int*>(&curValue);
 
             for (unsigned int patternIdx = 0; patternIdx < patternCount; ++patternIdx) {
-                if (!ifs.good()) {
-                    break;
-                }
-
                 switch (pattern[patternIdx]) {
-                    case 'i': {
-                        int newNum = 0;
-                        ifs >> newNum;
-                        *ptr = newNum;
+                    case 'i':
+                    case 'r':
+                        *ptr = *numberIter;
+                        ++numberIter;
                         ++ptr;
-
                         break;
-                    }
-
-                    case 'r': {
-                        ifs.ignore(100, '{');
-                        ifs.get(strBuf, 256, '}');
-                        ifs.ignore(1);
-                        std::istringstream iss(strBuf);
-
-                        std::vector<int> randNrs;
-                        while (iss.good()) {
-                            int newRand;
-                            iss >> newRand;
-                            if (!iss.fail()) {
-                                randNrs.push_back(newRand);
-                            }
-                            iss.ignore(100, ',');
-                        }
-
-                        if (randNrs.size() == 0 && ifs.good()) {
-                            LOG_ERROR << "Unable to extract number from random group {" << strBuf << "} in file " << path << std::endl;
-                            throw Exception("Error parsing def file");
-                        } else if (randNrs.size() >= 1) {
-                            *ptr = randNrs[0];
-                            ++ptr;
-                        }
-                        // TODO: random information is discarded here
 
+                    case 's':
+                        stringParseFunction(curValue, patternIdx, stringIter->c_str(), ptr);
+                        ++stringIter;
                         break;
-                    }
-
-                    case 's': {
-                        ifs >> strBuf;
-                        if (stringParseFunction) {
-                            stringParseFunction(curValue, patternIdx, strBuf, ptr);
-                        } else {
-                            LOG_ERROR << "No string parse function given for pattern " << pattern << " for file " << path << std::endl;
-                            throw Exception("Error parsing def file");
-                        }
-                        break;
-                    }
                 }
             }
 
-            if (!ifs.fail()) {
-                // reading new value was ok, insert now
-                int id = *(reinterpret_cast<int*>(&curValue));
-                //LOG_DEBUG << "store id " << id << std::endl;
-                table_[id] = curValue;
-            }
-
-            ifs.ignore(1000, '\n');
+            int id = *(reinterpret_cast<int*>(&curValue));
+            //LOG_DEBUG << "store id " << id << std::endl;
+            table_[id] = curValue;
         }
     }
 
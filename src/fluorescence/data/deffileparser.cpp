@@ -0,0 +1,391 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include "deffileparser.hpp"
+
+#include <string.h>
+#include <limits.h>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <misc/exception.hpp>
+#include <misc/log.hpp>
+
+namespace bfs = boost::filesystem;
+
+namespace fluo {
+namespace data {
+
+namespace {
+
+// whitespace as skipped by operator>>
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline void skipSpace(const char* buf, unsigned int len, unsigned int& pos) {
+    while (pos < len && isSpace(buf[pos])) {
+        ++pos;
+    }
+}
+
+// skips up to and including the next newline, but at most 1000 characters
+inline void skipLine(const char* buf, unsigned int len, unsigned int& pos) {
+    unsigned int end = (std::min)(len, pos + 1000);
+    while (pos < end) {
+        if (buf[pos++] == '\n') {
+            break;
+        }
+    }
+}
+
+// optional sign followed by digits, like operator>>(int&)
+bool parseInt(const char* buf, unsigned int len, unsigned int& pos, int& value) {
+    skipSpace(buf, len, pos);
+
+    unsigned int cur = pos;
+    bool negative = false;
+    if (cur < len && (buf[cur] == '-' || buf[cur] == '+')) {
+        negative = buf[cur] == '-';
+        ++cur;
+    }
+
+    if (cur >= len || buf[cur] < '0' || buf[cur] > '9') {
+        return false;
+    }
+
+    long long result = 0;
+    while (cur < len && buf[cur] >= '0' && buf[cur] <= '9') {
+        result = result * 10 + (buf[cur] - '0');
+        if (result > (long long)INT_MAX + 1) {
+            return false;
+        }
+        ++cur;
+    }
+
+    if (negative) {
+        result = -result;
+    }
+    if (result > INT_MAX || result < INT_MIN) {
+        return false;
+    }
+
+    value = result;
+    pos = cur;
+    return true;
+}
+
+template<typename T>
+bool readCacheValue(const std::vector<char>& buf, unsigned int& pos, T& value) {
+    if (pos + sizeof(T) > buf.size()) {
+        return false;
+    }
+    memcpy(&value, &buf[pos], sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+template<typename T>
+void writeCacheValue(std::vector<char>& buf, const T& value) {
+    const char* ptr = reinterpret_cast<const char*>(&value);
+    buf.insert(buf.end(), ptr, ptr + sizeof(T));
+}
+
+}
+
+bool DefFileParser::load(const bfs::path& path, const char* pattern, const bfs::path& cachePath, DefFileRecords& records) {
+    if (!cachePath.empty() && loadCache(cachePath, path, pattern, records)) {
+        return true;
+    }
+
+    std::vector<char> buf;
+    bfs::ifstream stream(path, std::ios_base::binary);
+    if (stream.is_open()) {
+        stream.seekg(0, std::ios_base::end);
+        buf.resize(stream.tellg());
+        stream.seekg(0, std::ios_base::beg);
+        if (!buf.empty()) {
+            stream.read(&buf[0], buf.size());
+        }
+    }
+
+    if (!stream.is_open() || !stream.good()) {
+        LOG_ERROR << "Unable to open DefFileLoader for path: " << path.string() << std::endl;
+        return false;
+    }
+
+    parse(buf.empty() ? NULL : &buf[0], buf.size(), pattern, path, records);
+
+    if (!cachePath.empty()) {
+        storeCache(cachePath, path, pattern, records);
+    }
+
+    return true;
+}
+
+void DefFileParser::parse(const char* buf, unsigned int len, const char* pattern, const bfs::path& path, DefFileRecords& records) {
+    unsigned int patternCount = strlen(pattern);
+    unsigned int pos = 0;
+
+    while (pos < len) {
+        if (buf[pos] == '#' || buf[pos] == '\n' || buf[pos] == '\r') {
+            skipLine(buf, len, pos);
+            continue;
+        }
+
+        unsigned int recordStart = pos;
+        unsigned int numberCount = records.numbers_.size();
+        unsigned int stringCount = records.strings_.size();
+        bool complete = true;
+
+        for (unsigned int patternIdx = 0; patternIdx < patternCount && complete; ++patternIdx) {
+            switch (pattern[patternIdx]) {
+                case 'i': {
+                    int value;
+                    if (parseInt(buf, len, pos, value)) {
+                        records.numbers_.push_back(value);
+                    } else {
+                        complete = false;
+                    }
+
+                    break;
+                }
+
+                case 'r': {
+                    // skip to the opening brace, but at most 100 characters
+                    unsigned int braceEnd = (std::min)(len, pos + 100);
+                    while (pos < braceEnd) {
+                        if (buf[pos++] == '{') {
+                            break;
+                        }
+                    }
+
+                    unsigned int groupStart = pos;
+                    unsigned int groupEnd = (std::min)(len, pos + 255);
+                    while (pos < groupEnd && buf[pos] != '}') {
+                        ++pos;
+                    }
+                    unsigned int groupLen = pos - groupStart;
+                    bool truncated = pos >= len;
+                    if (!truncated) {
+                        // closing brace
+                        ++pos;
+                    }
+
+                    if (groupLen == 0) {
+                        complete = false;
+                        break;
+                    }
+
+                    // TODO: random information is discarded here
+                    unsigned int groupPos = groupStart;
+                    int value;
+                    if (parseInt(buf, groupStart + groupLen, groupPos, value)) {
+                        records.numbers_.push_back(value);
+                    } else if (truncated) {
+                        complete = false;
+                    } else {
+                        LOG_ERROR << "Unable to extract number from random group {" << std::string(buf + groupStart, groupLen) << "} in file " << path << std::endl;
+                        throw Exception("Error parsing def file");
+                    }
+
+                    break;
+                }
+
+                case 's': {
+                    skipSpace(buf, len, pos);
+                    unsigned int tokenStart = pos;
+                    while (pos < len && !isSpace(buf[pos])) {
+                        ++pos;
+                    }
+
+                    if (pos > tokenStart) {
+                        records.strings_.push_back(std::string(buf + tokenStart, pos - tokenStart));
+                    } else {
+                        complete = false;
+                    }
+
+                    break;
+                }
+            }
+        }
+
+        if (!complete) {
+            records.numbers_.resize(numberCount);
+            records.strings_.resize(stringCount);
+
+            // like the stream based parser, stop at the first malformed record
+            skipSpace(buf, len, pos);
+            if (pos < len) {
+                LOG_WARN << "Stopped parsing " << path << " at malformed record at offset " << recordStart << std::endl;
+            }
+            break;
+        }
+
+        ++records.count_;
+        skipLine(buf, len, pos);
+    }
+}
+
+bool DefFileParser::loadCache(const bfs::path& cachePath, const bfs::path& path, const char* pattern, DefFileRecords& records) {
+    std::vector<char> buf;
+    try {
+        if (!bfs::exists(cachePath) || !bfs::exists(path)) {
+            return false;
+        }
+
+        buf.resize(bfs::file_size(cachePath));
+        bfs::ifstream stream(cachePath, std::ios_base::binary);
+        if (!buf.empty()) {
+            stream.read(&buf[0], buf.size());
+        }
+        if (!stream.good()) {
+            return false;
+        }
+
+        unsigned int pos = 0;
+        char magic[4];
+        uint32_t version;
+        uint64_t fileSize;
+        int64_t modificationTime;
+        uint32_t patternLength;
+        if (!readCacheValue(buf, pos, magic) || memcmp(magic, "FDEF", 4) != 0 ||
+                !readCacheValue(buf, pos, version) || version != CACHE_VERSION ||
+                !readCacheValue(buf, pos, fileSize) || fileSize != bfs::file_size(path) ||
+                !readCacheValue(buf, pos, modificationTime) || modificationTime != bfs::last_write_time(path) ||
+                !readCacheValue(buf, pos, patternLength) || patternLength != strlen(pattern) ||
+                pos + patternLength > buf.size() || memcmp(&buf[pos], pattern, patternLength) != 0) {
+            return false;
+        }
+        pos += patternLength;
+
+        // different shards might use different def files with the same size and time
+        std::string pathString = path.string();
+        uint32_t pathLength;
+        if (!readCacheValue(buf, pos, pathLength) || pathLength != pathString.size() ||
+                pos + pathLength > buf.size() || memcmp(&buf[pos], pathString.c_str(), pathLength) != 0) {
+            return false;
+        }
+        pos += pathLength;
+
+        uint32_t count;
+        uint32_t numberCount;
+        if (!readCacheValue(buf, pos, count) || !readCacheValue(buf, pos, numberCount) ||
+                pos + (uint64_t)numberCount * sizeof(int) > buf.size()) {
+            return false;
+        }
+
+        records.count_ = count;
+        records.numbers_.resize(numberCount);
+        if (numberCount > 0) {
+            memcpy(&records.numbers_[0], &buf[pos], numberCount * sizeof(int));
+            pos += numberCount * sizeof(int);
+        }
+
+        uint32_t stringCount;
+        if (!readCacheValue(buf, pos, stringCount)) {
+            return false;
+        }
+
+        records.strings_.resize(stringCount);
+        for (unsigned int i = 0; i < stringCount; ++i) {
+            uint32_t stringLength;
+            if (!readCacheValue(buf, pos, stringLength) || pos + stringLength > buf.size()) {
+                return false;
+            }
+            records.strings_[i].assign(&buf[pos], stringLength);
+            pos += stringLength;
+        }
+
+        // every record has the same number of fields of each type
+        unsigned int numberFields = 0;
+        unsigned int stringFields = 0;
+        for (const char* cur = pattern; *cur; ++cur) {
+            if (*cur == 's') {
+                ++stringFields;
+            } else if (*cur == 'i' || *cur == 'r') {
+                ++numberFields;
+            }
+        }
+
+        if (pos != buf.size() || numberCount != count * numberFields || stringCount != count * stringFields) {
+            return false;
+        }
+    } catch (const bfs::filesystem_error& ex) {
+        LOG_WARN << "Unable to read def cache " << cachePath << ": " << ex.what() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void DefFileParser::storeCache(const bfs::path& cachePath, const bfs::path& path, const char* pattern, const DefFileRecords& records) {
+    try {
+        std::vector<char> buf;
+        buf.insert(buf.end(), "FDEF", "FDEF" + 4);
+        writeCacheValue(buf, (uint32_t)CACHE_VERSION);
+        writeCacheValue(buf, (uint64_t)bfs::file_size(path));
+        writeCacheValue(buf, (int64_t)bfs::last_write_time(path));
+        writeCacheValue(buf, (uint32_t)strlen(pattern));
+        buf.insert(buf.end(), pattern, pattern + strlen(pattern));
+        std::string pathString = path.string();
+        writeCacheValue(buf, (uint32_t)pathString.size());
+        buf.insert(buf.end(), pathString.begin(), pathString.end());
+
+        writeCacheValue(buf, (uint32_t)records.count_);
+        writeCacheValue(buf, (uint32_t)records.numbers_.size());
+        if (!records.numbers_.empty()) {
+            const char* numberPtr = reinterpret_cast<const char*>(&records.numbers_[0]);
+            buf.insert(buf.end(), numberPtr, numberPtr + records.numbers_.size() * sizeof(int));
+        }
+
+        writeCacheValue(buf, (uint32_t)records.strings_.size());
+        for (unsigned int i = 0; i < records.strings_.size(); ++i) {
+            writeCacheValue(buf, (uint32_t)records.strings_[i].size());
+            buf.insert(buf.end(), records.strings_[i].begin(), records.strings_[i].end());
+        }
+
+        // write to a temporary file first, so that a crash never leaves a partially written cache
+        bfs::create_directories(cachePath.parent_path());
+        bfs::path tempPath = cachePath.string() + ".tmp";
+
+        bfs::ofstream stream(tempPath, std::ios_base::binary | std::ios_base::trunc);
+        stream.write(&buf[0], buf.size());
+        stream.close();
+
+        if (stream.fail()) {
+            bfs::remove(tempPath);
+        } else {
+            if (bfs::exists(cachePath)) {
+                // rename does not replace existing files on windows
+                bfs::remove(cachePath);
+            }
+            bfs::rename(tempPath, cachePath);
+        }
+    } catch (const bfs::filesystem_error& ex) {
+        LOG_WARN << "Unable to write def cache " << cachePath << ": " << ex.what() << std::endl;
+    }
+}
+
+}
+}
@@ -0,0 +1,72 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_DATA_DEFFILEPARSER_HPP
+#define FLUO_DATA_DEFFILEPARSER_HPP
+
+#include <vector>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
+namespace fluo {
+namespace data {
+
+/// Fields of all records of a def file, in file and pattern order
+struct DefFileRecords {
+    DefFileRecords() : count_(0) {
+    }
+
+    unsigned int count_;
+    std::vector<int> numbers_; ///< 'i' fields, and the first number of 'r' groups
+    std::vector<std::string> strings_; ///< 's' fields
+};
+
+/**
+ * \brief Parses def files for DefFileLoader
+ *
+ * The file is read completely and parsed in one pass. Each line holds one record, with fields according to a pattern:
+ * 'i' is a number, 'r' is a group of numbers in braces of which only the first is used, 's' is a string without whitespace.
+ * Lines starting with # are comments.
+ *
+ * If a cache path is given, the parsed fields are stored there in a binary file, together with the path, size and
+ * modification time of the def file. If those did not change on the next start, the fields are loaded from the cache instead.
+ */
+class DefFileParser {
+public:
+    /// Returns false if the file could not be read
+    static bool load(const boost::filesystem::path& path, const char* pattern, const boost::filesystem::path& cachePath, DefFileRecords& records);
+
+    /// \throw Exception if a random group contains no number
+    static void parse(const char* buf, unsigned int len, const char* pattern, const boost::filesystem::path& path, DefFileRecords& records);
+
+private:
+    static const uint32_t CACHE_VERSION = 1;
+
+    static bool loadCache(const boost::filesystem::path& cachePath, const boost::filesystem::path& path, const char* pattern,
+            DefFileRecords& records);
+    static void storeCache(const boost::filesystem::path& cachePath, const boost::filesystem::path& path, const char* pattern,
+            const DefFileRecords& records);
+};
+
+}
+}
+
+#endif
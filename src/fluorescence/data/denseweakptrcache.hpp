@@ -0,0 +1,270 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FLUO_DATA_DENSEWEAKPTRCACHE_HPP
+#define FLUO_DATA_DENSEWEAKPTRCACHE_HPP
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <vector>
+#include <list>
+
+#include <misc/log.hpp>
+
+#include "workerpool.hpp"
+#include "retentiontier.hpp"
+
+namespace fluo {
+namespace data {
+
+/**
+ * \brief Same as WeakPtrCache, but for small integer ids. The entries are stored in a vector indexed by the id
+ *
+ * The vector is sized from the entry count of the loader's index file, so the loader has to provide a size() method.
+ * Ids outside of this range are passed to the loader without caching.
+ */
+template <
+typename ValueType,
+template <typename, typename> class FileLoader
+>
+class DenseWeakPtrCache {
+private:
+    typedef RetentionTier<unsigned int, ValueType> RetentionType;
+
+    struct Entry {
+        Entry() : loaded_(false), retained_(false) {
+        }
+
+        boost::weak_ptr<ValueType> item_;
+        bool loaded_;
+        bool retained_;
+        typename RetentionType::Handle retentionHandle_; ///< Only valid if retained_ is true
+    };
+
+    typedef std::vector<Entry> VectorType;
+    typedef std::list<boost::shared_ptr<ValueType> > FixedListType;
+
+public:
+    DenseWeakPtrCache() : hitCount_(0), retainedHitCount_(0), missCount_(0) {
+    }
+
+    void init(boost::shared_ptr<FileLoader<unsigned int, ValueType> > loader) {
+        loader_ = loader;
+        cache_.clear();
+        cache_.resize(loader_->size());
+    }
+
+    /// Sets the byte budget for keeping recently used items alive. 0 disables retention
+    void setRetentionBudget(unsigned int bytes) {
+        retention_.setBudget(bytes);
+        evictRetained();
+    }
+
+    /// Fixes an item in the memory
+    void fixItem(unsigned int id) {
+        boost::shared_ptr<ValueType> toFix = get(id);
+        fixedList_.push_back(toFix);
+    }
+
+    /// Fixes an item in the memory
+    void fixItem(boost::shared_ptr<ValueType>& item) {
+        fixedList_.push_back(item);
+    }
+
+    /// Removes the memory fixation for a given id
+    void removeFixed(unsigned int id) {
+        boost::shared_ptr<ValueType> toRemove = get(id);
+        fixedList_.remove(toRemove);
+    }
+
+    /// Removes the memory fixation for a given item
+    void removeFixed(boost::shared_ptr<ValueType>& item) {
+        fixedList_.remove(item);
+    }
+
+    boost::shared_ptr<ValueType> getNoCreate(unsigned int id) {
+        if (id < cache_.size()) {
+            return cache_[id].item_.lock();
+        } else {
+            return boost::shared_ptr<ValueType>();
+        }
+    }
+
+    /**
+     * Returns the cached object, or starts loading it with the given LoadPriority.
+     * An object that is still being loaded with a lower priority is moved up to the given one.
+     */
+    boost::shared_ptr<ValueType> get(unsigned int id, unsigned int userData = 0, unsigned int priority = LoadPriority::VISIBLE) {
+        if (id >= cache_.size()) {
+            ++missCount_;
+            return loader_->get(id, userData, priority);
+        }
+
+        Entry& entry = cache_[id];
+        boost::shared_ptr<ValueType> smPtr = entry.item_.lock();
+        if (smPtr) {
+            ++hitCount_;
+            if (entry.retained_) {
+                if (smPtr.use_count() == 2 && retention_.isPinned(entry.retentionHandle_)) {
+                    // only smPtr and the retention tier hold the item
+                    ++retainedHitCount_;
+                }
+                retention_.touch(entry.retentionHandle_);
+            } else {
+                retain(id, entry, smPtr);
+            }
+
+            if (!smPtr->isReadComplete()) {
+                loader_->raisePriority(smPtr, priority);
+            }
+            return smPtr;
+        } else {
+            return load(id, entry, userData, priority);
+        }
+    }
+
+    bool hasId(unsigned int id) {
+        return id < cache_.size() && cache_[id].loaded_;
+    }
+
+    void printStats() {
+        unsigned int weakCount = 0;
+        unsigned int realCount = 0;
+        unsigned int avgWidth = 0;
+        unsigned int avgHeight = 0;
+        unsigned int maxWidth = 0;
+        unsigned int maxHeight = 0;
+
+        typename VectorType::iterator iter = cache_.begin();
+        typename VectorType::iterator end = cache_.end();
+
+        for (; iter != end; ++iter) {
+            if (!iter->loaded_) {
+                continue;
+            }
+
+            weakCount += 1;
+
+            // was loaded at some point - is it still valid?
+            boost::shared_ptr<ValueType> smPtr = iter->item_.lock();
+            if (smPtr) {
+                realCount += 1;
+                unsigned int width = smPtr->getWidth();
+                unsigned int height = smPtr->getHeight();
+
+                avgWidth += width;
+                avgHeight += height;
+
+                maxWidth = (std::max)(maxWidth, width);
+                maxHeight = (std::max)(maxHeight, height);
+            }
+        }
+
+        LOG_DEBUG << "DenseWeakPtrCache stats: capacity=" << cache_.size() << " weak=" << weakCount << " real=" << realCount << std::endl;
+        LOG_DEBUG << "Requests hits=" << hitCount_ << " (retained=" << retainedHitCount_ << ") misses=" << missCount_ <<
+                "  retention items=" << retention_.getItemCount() << " bytes=" << retention_.getUsedBytes() << "/" << retention_.getBudget() <<
+                " evictions=" << retention_.getEvictionCount() << std::endl;
+        if (realCount > 0) {
+            LOG_DEBUG << "Sizes avg=" << (avgWidth / realCount) << "/" << (avgHeight / realCount) << "  max=" << maxWidth << "/" << maxHeight << std::endl;
+        }
+    }
+
+    unsigned int getHitCount() const {
+        return hitCount_;
+    }
+
+    /// Hits on items that were only kept alive by the retention tier
+    unsigned int getRetainedHitCount() const {
+        return retainedHitCount_;
+    }
+
+    unsigned int getMissCount() const {
+        return missCount_;
+    }
+
+    unsigned int getRetainedItemCount() const {
+        return retention_.getItemCount();
+    }
+
+    unsigned int getRetainedBytes() const {
+        return retention_.getUsedBytes();
+    }
+
+    void clear() {
+        fixedList_.clear();
+        retention_.clear();
+
+        unsigned int size = cache_.size();
+        cache_.clear();
+        cache_.resize(size);
+    }
+
+private:
+    VectorType cache_;
+    FixedListType fixedList_; ///< Keeps a shared_ptr to fixed items. May contain duplicates
+    RetentionType retention_;
+
+    unsigned int hitCount_;
+    unsigned int retainedHitCount_;
+    unsigned int missCount_;
+
+    boost::shared_ptr<FileLoader<unsigned int, ValueType> > loader_;
+
+    boost::shared_ptr<ValueType> load(unsigned int id, Entry& entry, unsigned int userData, unsigned int priority) {
+        ++missCount_;
+        boost::shared_ptr<ValueType> smPtr = loader_->get(id, userData, priority);
+
+        entry.item_ = smPtr;
+        entry.loaded_ = true;
+        if (entry.retained_) {
+            // the retained item was replaced
+            retention_.remove(entry.retentionHandle_);
+            entry.retained_ = false;
+        }
+        retain(id, entry, smPtr);
+
+        return smPtr;
+    }
+
+    void retain(unsigned int id, Entry& entry, const boost::shared_ptr<ValueType>& smPtr) {
+        if (!retention_.isEnabled() || !smPtr) {
+            return;
+        }
+
+        entry.retentionHandle_ = retention_.insert(id, smPtr);
+        entry.retained_ = true;
+        evictRetained();
+    }
+
+    void evictRetained() {
+        while (retention_.isOverBudget()) {
+            unsigned int id = retention_.evictOldest();
+            if (id < cache_.size()) {
+                cache_[id].retained_ = false;
+            }
+        }
+    }
+};
+
+}
+}
+
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include "difindex.hpp"
+
+namespace fluo {
+namespace data {
+
+DifIndex::DifIndex() : blockCount_(0) {
+}
+
+void DifIndex::init(const uint32_t* blockIds, unsigned int entryCount, unsigned int blockCount) {
+    blockCount_ = blockCount;
+
+    unsigned int wordCount = (blockCount + 63) / 64;
+    bits_.assign(wordCount, 0);
+    rank_.assign(wordCount, 0);
+
+    for (unsigned int i = 0; i < entryCount; ++i) {
+        uint32_t blockIdx = blockIds[i];
+        if (blockIdx < blockCount) {
+            bits_[blockIdx >> 6] |= static_cast<uint64_t>(1) << (blockIdx & 63);
+        }
+    }
+
+    unsigned int setCount = 0;
+    for (unsigned int i = 0; i < wordCount; ++i) {
+        rank_[i] = setCount;
+        setCount += popCount(bits_[i]);
+    }
+
+    // later entries overwrite earlier ones for the same block
+    difEntries_.assign(setCount, 0);
+    for (unsigned int i = 0; i < entryCount; ++i) {
+        uint32_t blockIdx = blockIds[i];
+        if (blockIdx < blockCount) {
+            unsigned int word = blockIdx >> 6;
+            uint64_t bit = static_cast<uint64_t>(1) << (blockIdx & 63);
+            difEntries_[rank_[word] + popCount(bits_[word] & (bit - 1))] = i;
+        }
+    }
+}
+
+}
+}
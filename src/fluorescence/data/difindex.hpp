@@ -0,0 +1,87 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_DATA_DIFINDEX_HPP
+#define FLUO_DATA_DIFINDEX_HPP
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace fluo {
+namespace data {
+
+/**
+ * \brief Maps block ids to their entry in a mapdif/stadif file
+ *
+ * Stores one bit per block of the facet, plus the number of set bits before each 64 bit word. The dif entry of a block
+ * is then found by counting the set bits before it, without any search.
+ * If a block is listed more than once in the dif offsets file, the last entry wins.
+ */
+class DifIndex {
+public:
+    DifIndex();
+
+    /// blockIds is the content of a mapdifl/stadifl file. Ids >= blockCount are ignored
+    void init(const uint32_t* blockIds, unsigned int entryCount, unsigned int blockCount);
+
+    /// Returns true and sets difIdx if there is a dif entry for this block
+    inline bool find(unsigned int blockIdx, unsigned int& difIdx) const {
+        if (blockIdx >= blockCount_) {
+            return false;
+        }
+
+        unsigned int word = blockIdx >> 6;
+        uint64_t bit = static_cast<uint64_t>(1) << (blockIdx & 63);
+        if (!(bits_[word] & bit)) {
+            return false;
+        }
+
+        difIdx = difEntries_[rank_[word] + popCount(bits_[word] & (bit - 1))];
+        return true;
+    }
+
+private:
+    unsigned int blockCount_;
+
+    std::vector<uint64_t> bits_;
+
+    // number of set bits in bits_ before each word
+    std::vector<uint32_t> rank_;
+
+    // dif file entry of each set bit, in block id order
+    std::vector<uint32_t> difEntries_;
+
+    static inline unsigned int popCount(uint64_t val) {
+#ifdef __GNUC__
+        return __builtin_popcountll(val);
+#else
+        val = val - ((val >> 1) & 0x5555555555555555ULL);
+        val = (val & 0x3333333333333333ULL) + ((val >> 2) & 0x3333333333333333ULL);
+        val = (val + (val >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        return static_cast<unsigned int>((val * 0x0101010101010101ULL) >> 56);
+#endif
+    }
+};
+
+}
+}
+
+#endif
@@ -27,8 +27,8 @@ namespace data {
 EquipConvDefLoader::EquipConvDefLoader() {
 }
 
-EquipConvDefLoader::EquipConvDefLoader(const boost::filesystem::path& path) {
-    DefFileLoader<EquipConvDef> defLoader(path, "iiiii");
+EquipConvDefLoader::EquipConvDefLoader(const boost::filesystem::path& path, const boost::filesystem::path& cachePath) {
+    DefFileLoader<EquipConvDef> defLoader(path, "iiiii", NULL, cachePath);
 
     std::map<int, EquipConvDef>::const_iterator iter = defLoader.begin();
     std::map<int, EquipConvDef>::const_iterator end = defLoader.end();
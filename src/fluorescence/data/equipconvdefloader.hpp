@@ -31,7 +31,7 @@ namespace data {
 class EquipConvDefLoader {
 public:
     EquipConvDefLoader();
-    EquipConvDefLoader(const boost::filesystem::path& path);
+    EquipConvDefLoader(const boost::filesystem::path& path, const boost::filesystem::path& cachePath = boost::filesystem::path());
 
     bool hasValue(unsigned int bodyId, unsigned int itemId) const;
 
@@ -21,10 +21,19 @@
 #define FLUO_DATA_FIXEDSIZEONDEMANDFILELOADER_HPP
 
 #include "ondemandfileloader.hpp"
+#include "uopfile.hpp"
+
+#include <vector>
 
 namespace fluo {
 namespace data {
 
+/**
+ * \brief Loads entries of a fixed size, e.g. map blocks
+ *
+ * Uop files (e.g. map0LegacyMUL.uop) contain the mul file split into several entries. Their positions are looked up
+ * once when the loader is created, reads are then translated to the position in the uop file.
+ */
 template <
 typename KeyType,
 typename ValueType
@@ -32,17 +41,27 @@ typename ValueType
 class FixedSizeOnDemandFileLoader : public OnDemandFileLoader<KeyType, ValueType> {
 
 public:
-    FixedSizeOnDemandFileLoader(const boost::filesystem::path& path, unsigned int size, typename OnDemandFileLoader<KeyType, ValueType>::ReadCallback readCallback) :
-            OnDemandFileLoader<KeyType, ValueType>(path, readCallback), size_(size) {
+    FixedSizeOnDemandFileLoader(const boost::filesystem::path& path, unsigned int size, typename OnDemandFileLoader<KeyType, ValueType>::ReadCallback readCallback,
+            bool allowMapping = true) :
+            OnDemandFileLoader<KeyType, ValueType>(path, readCallback, allowMapping), size_(size) {
+        if (UopFile::isUopPath(path)) {
+            UopFile uopFile(path);
+            uopFile.buildChunkTable(uopChunks_);
+        }
     }
 
-    boost::shared_ptr<ValueType> get(unsigned int index, unsigned int userData) {
+    boost::shared_ptr<ValueType> get(unsigned int index, unsigned int userData, unsigned int priority = LoadPriority::VISIBLE) {
         unsigned int startOffset = index * size_;
-        return this->OnDemandFileLoader<KeyType, ValueType>::get(index, startOffset, size_, userData);
+        if (!uopChunks_.empty() && !UopFile::translateChunkOffset(uopChunks_, startOffset, size_, startOffset)) {
+            // handled like reading past the end of a mul file
+            startOffset = 0xFFFFFFFEu;
+        }
+        return this->OnDemandFileLoader<KeyType, ValueType>::get(index, startOffset, size_, userData, priority);
     }
 
 private:
     unsigned int size_;
+    std::vector<UopFile::Chunk> uopChunks_;
 
 };
 
@@ -28,10 +28,15 @@
 namespace fluo {
 namespace data {
 
-GumpArtLoader::GumpArtLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath) {
+GumpArtLoader::GumpArtLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath, boost::shared_ptr<DecodeCache> decodeCache,
+        boost::shared_ptr<SharedMemoryCache> sharedCache) :
+        decodeCache_(decodeCache), sharedCache_(sharedCache) {
 
     boost::shared_ptr<IndexedOnDemandFileLoader<unsigned int, ui::Texture> > loader(new IndexedOnDemandFileLoader<unsigned int, ui::Texture>(idxPath, mulPath,
                 boost::bind(&GumpArtLoader::readCallback, this, _1, _2, _3, _4, _5, _6)));
+    if (decodeCache_ || sharedCache_) {
+        loader->setCacheCallback(boost::bind(&GumpArtLoader::loadCached, this, _1, _2));
+    }
     cache_.init(loader);
 }
 
@@ -39,9 +44,26 @@ boost::shared_ptr<ui::Texture> GumpArtLoader::getTexture(unsigned int id) {
     return cache_.get(id);
 }
 
+bool GumpArtLoader::loadCached(unsigned int index, boost::shared_ptr<ui::Texture> tex) {
+    tex->setUsage(ui::Texture::USAGE_GUMP);
+
+    if (sharedCache_ && sharedCache_->loadTexture(SharedMemoryCache::Source::GUMPART, index, tex)) {
+        return true;
+    }
+
+    if (decodeCache_ && decodeCache_->loadTexture(index, tex)) {
+        if (sharedCache_) {
+            sharedCache_->storeTexture(SharedMemoryCache::Source::GUMPART, index, tex);
+        }
+        return true;
+    }
+
+    return false;
+}
+
 void GumpArtLoader::readCallback(unsigned int index, int8_t* buf, unsigned int len, boost::shared_ptr<ui::Texture> tex, unsigned int extra, unsigned int userData) {
     tex->setUsage(ui::Texture::USAGE_GUMP);
-    
+
     unsigned int width = (extra >> 16) & 0xFFFF;
     unsigned int height = extra & 0xFFFF;
 
@@ -82,11 +104,23 @@ void GumpArtLoader::readCallback(unsigned int index, int8_t* buf, unsigned int l
             color = Util::getColorRGBA(*value);
         }
     }
+
+    if (decodeCache_) {
+        decodeCache_->storeTexture(index, tex);
+    }
+
+    if (sharedCache_) {
+        sharedCache_->storeTexture(SharedMemoryCache::Source::GUMPART, index, tex);
+    }
 }
 
 bool GumpArtLoader::hasTexture(unsigned int id) {
     return cache_.hasId(id);
 }
 
+void GumpArtLoader::setRetentionBudget(unsigned int bytes) {
+    cache_.setRetentionBudget(bytes);
+}
+
 }
 }
@@ -20,8 +20,10 @@
 #ifndef FLUO_DATA_GUMPARTLOADER_HPP
 #define FLUO_DATA_GUMPARTLOADER_HPP
 
-#include "weakptrcache.hpp"
+#include "denseweakptrcache.hpp"
 #include "indexedondemandfileloader.hpp"
+#include "decodecache.hpp"
+#include "sharedmemorycache.hpp"
 
 #include <boost/filesystem.hpp>
 
@@ -35,16 +37,25 @@ namespace data {
 
 class GumpArtLoader {
 public:
-    GumpArtLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath);
+    GumpArtLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath,
+            boost::shared_ptr<DecodeCache> decodeCache = boost::shared_ptr<DecodeCache>(),
+            boost::shared_ptr<SharedMemoryCache> sharedCache = boost::shared_ptr<SharedMemoryCache>());
 
     boost::shared_ptr<ui::Texture> getTexture(unsigned int id);
 
     void readCallback(unsigned int index, int8_t* buf, unsigned int len, boost::shared_ptr<ui::Texture>, unsigned int extra, unsigned int userData);
+    bool loadCached(unsigned int index, boost::shared_ptr<ui::Texture> tex);
 
     bool hasTexture(unsigned int id);
 
+    /// Keeps recently used items in memory up to the given size, see DenseWeakPtrCache::setRetentionBudget
+    void setRetentionBudget(unsigned int bytes);
+
 private:
-    WeakPtrCache<unsigned int, ui::Texture, IndexedOnDemandFileLoader> cache_;
+    // declared before the cache, so that it outlives the decode jobs cancelled by the loader destructor
+    boost::shared_ptr<DecodeCache> decodeCache_;
+    boost::shared_ptr<SharedMemoryCache> sharedCache_;
+    DenseWeakPtrCache<ui::Texture, IndexedOnDemandFileLoader> cache_;
 };
 
 }
@@ -0,0 +1,131 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include "httpcache.hpp"
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <sstream>
+#include <iomanip>
+
+#include <misc/log.hpp>
+
+namespace fluo {
+namespace data {
+
+namespace bfs = boost::filesystem;
+
+namespace {
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+uint64_t fnvHash(const std::string& str) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (unsigned int i = 0; i < str.size(); ++i) {
+        hash ^= static_cast<uint8_t>(str[i]);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// header values can not contain line breaks, but servers are not always careful
+std::string stripLineBreaks(const std::string& str) {
+    std::string ret;
+    for (unsigned int i = 0; i < str.size(); ++i) {
+        if (str[i] != '\r' && str[i] != '\n') {
+            ret += str[i];
+        }
+    }
+    return ret;
+}
+}
+
+HttpCache::HttpCache(const bfs::path& directory) : directory_(directory) {
+    bfs::create_directories(directory_);
+    LOG_INFO << "Http cache in " << directory_ << std::endl;
+}
+
+bfs::path HttpCache::getFilePath(const std::string& url) const {
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << fnvHash(url);
+    return directory_ / ss.str();
+}
+
+bool HttpCache::load(const std::string& url, Validators& validators, std::vector<int8_t>& data) {
+    bfs::path path = getFilePath(url);
+    if (!bfs::exists(path)) {
+        return false;
+    }
+
+    bfs::ifstream stream(path, std::ios_base::binary);
+    std::string storedUrl;
+    std::getline(stream, storedUrl);
+    if (storedUrl != url) {
+        // hash collision
+        return false;
+    }
+
+    std::getline(stream, validators.etag_);
+    std::getline(stream, validators.lastModified_);
+
+    std::streampos dataStart = stream.tellg();
+    stream.seekg(0, std::ios_base::end);
+    std::streampos dataEnd = stream.tellg();
+    stream.seekg(dataStart);
+
+    data.resize(dataEnd - dataStart);
+    if (!data.empty()) {
+        stream.read(reinterpret_cast<char*>(&data[0]), data.size());
+    }
+
+    return !stream.fail();
+}
+
+void HttpCache::store(const std::string& url, const Validators& validators, const std::vector<int8_t>& data) {
+    bfs::path path = getFilePath(url);
+    bfs::path tempPath = path.string() + ".tmp";
+
+    // write to a temporary file first, so that a crash never leaves a partially written entry
+    try {
+        bfs::ofstream stream(tempPath, std::ios_base::binary | std::ios_base::trunc);
+        stream << url << "\n" << stripLineBreaks(validators.etag_) << "\n" << stripLineBreaks(validators.lastModified_) << "\n";
+        if (!data.empty()) {
+            stream.write(reinterpret_cast<const char*>(&data[0]), data.size());
+        }
+        stream.close();
+
+        if (stream.fail()) {
+            bfs::remove(tempPath);
+        } else {
+            if (bfs::exists(path)) {
+                // rename does not replace existing files on windows
+                bfs::remove(path);
+            }
+            bfs::rename(tempPath, path);
+        }
+    } catch (const bfs::filesystem_error& ex) {
+        LOG_WARN << "Unable to write http cache file " << path << ": " << ex.what() << std::endl;
+    }
+}
+
+}
+}
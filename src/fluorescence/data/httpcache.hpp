@@ -0,0 +1,69 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_DATA_HTTPCACHE_HPP
+#define FLUO_DATA_HTTPCACHE_HPP
+
+#include <boost/filesystem/path.hpp>
+
+#include <vector>
+#include <string>
+
+#include <stdint.h>
+
+namespace fluo {
+namespace data {
+
+/**
+ * \brief Keeps downloaded url contents on disk, together with their ETag and Last-Modified headers
+ *
+ * Each url is stored in one file, named after a hash of the url. The file starts with the url and the two
+ * validators, one per line, followed by the content.
+ *
+ * Only used by the HttpDownloader thread, so there is no locking.
+ */
+class HttpCache {
+public:
+    struct Validators {
+        std::string etag_;
+        std::string lastModified_;
+
+        bool empty() const {
+            return etag_.empty() && lastModified_.empty();
+        }
+    };
+
+    HttpCache(const boost::filesystem::path& directory);
+
+    /// Returns true if the url is cached. validators may be empty for entries kept only as offline fallback
+    bool load(const std::string& url, Validators& validators, std::vector<int8_t>& data);
+
+    void store(const std::string& url, const Validators& validators, const std::vector<int8_t>& data);
+
+private:
+    boost::filesystem::path directory_;
+
+    boost::filesystem::path getFilePath(const std::string& url) const;
+};
+
+}
+}
+
+#endif
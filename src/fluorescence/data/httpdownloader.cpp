@@ -0,0 +1,302 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include "httpdownloader.hpp"
+
+#include <boost/bind.hpp>
+
+#include <cctype>
+
+#include <misc/log.hpp>
+
+namespace fluo {
+namespace data {
+
+namespace {
+// how long the download thread waits for socket activity before checking for new requests
+const int MULTI_WAIT_MS = 50;
+
+bool isFileUrl(const std::string& url) {
+    return url.compare(0, 7, "file://") == 0;
+}
+
+bool startsWithNoCase(const std::string& str, const char* prefix) {
+    for (unsigned int i = 0; prefix[i] != '\0'; ++i) {
+        if (i >= str.size() || tolower(str[i]) != tolower(prefix[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string trim(const std::string& str) {
+    size_t start = str.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos) {
+        return "";
+    }
+    size_t end = str.find_last_not_of(" \t\r\n");
+    return str.substr(start, end - start + 1);
+}
+}
+
+HttpDownloader::HttpDownloader(unsigned int maxConnections) :
+        running_(true), maxConnections_(maxConnections > 0 ? maxConnections : 1) {
+    multiHandle_ = curl_multi_init();
+    thread_ = new boost::thread(boost::bind(&HttpDownloader::run, this));
+}
+
+HttpDownloader::~HttpDownloader() {
+    stop();
+
+    curl_multi_cleanup(multiHandle_);
+}
+
+void HttpDownloader::stop() {
+    if (!thread_) {
+        return;
+    }
+
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        running_ = false;
+        signal_.notify_all();
+    }
+
+    thread_->join();
+    delete thread_;
+    thread_ = NULL;
+}
+
+void HttpDownloader::enqueue(const UnicodeString& url, const CompletionCallback& completion, const WantedCallback& wanted,
+        unsigned int priority) {
+    if (priority >= LoadPriority::COUNT) {
+        priority = LoadPriority::COUNT - 1;
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    queues_[priority].push_back(Request(StringConverter::toUtf8String(url), completion, wanted));
+    signal_.notify_all();
+}
+
+void HttpDownloader::setMaxConnections(unsigned int maxConnections) {
+    boost::mutex::scoped_lock lock(mutex_);
+    maxConnections_ = maxConnections > 0 ? maxConnections : 1;
+}
+
+void HttpDownloader::setCache(boost::shared_ptr<HttpCache> cache) {
+    boost::mutex::scoped_lock lock(mutex_);
+    cache_ = cache;
+}
+
+bool HttpDownloader::popNext(Request& request) {
+    for (unsigned int i = 0; i < LoadPriority::COUNT; ++i) {
+        while (!queues_[i].empty()) {
+            request = queues_[i].front();
+            queues_[i].pop_front();
+
+            if (!request.wanted_ || request.wanted_()) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void HttpDownloader::run() {
+    while (true) {
+        std::vector<Request> toStart;
+        boost::shared_ptr<HttpCache> cache;
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            while (running_ && transfers_.empty() && queues_[0].empty() && queues_[1].empty() && queues_[2].empty()) {
+                signal_.wait(lock);
+            }
+
+            if (!running_) {
+                break;
+            }
+
+            Request request;
+            while (transfers_.size() + toStart.size() < maxConnections_ && popNext(request)) {
+                toStart.push_back(request);
+            }
+            cache = cache_;
+        }
+
+        for (unsigned int i = 0; i < toStart.size(); ++i) {
+            startTransfer(toStart[i], cache);
+        }
+
+        if (transfers_.empty()) {
+            continue;
+        }
+
+        int runningCount;
+        curl_multi_perform(multiHandle_, &runningCount);
+
+        CURLMsg* msg;
+        int msgsLeft;
+        while ((msg = curl_multi_info_read(multiHandle_, &msgsLeft))) {
+            if (msg->msg == CURLMSG_DONE) {
+                finishTransfer(msg->easy_handle, msg->data.result, cache);
+            }
+        }
+
+        if (!transfers_.empty()) {
+            curl_multi_wait(multiHandle_, NULL, 0, MULTI_WAIT_MS, NULL);
+        }
+    }
+
+    // shutting down, drop unfinished transfers without calling their callbacks
+    std::map<CURL*, Transfer*>::iterator iter = transfers_.begin();
+    std::map<CURL*, Transfer*>::iterator end = transfers_.end();
+    for (; iter != end; ++iter) {
+        curl_multi_remove_handle(multiHandle_, iter->first);
+        curl_easy_cleanup(iter->first);
+        curl_slist_free_all(iter->second->headers_);
+        delete iter->second;
+    }
+    transfers_.clear();
+}
+
+void HttpDownloader::startTransfer(const Request& request, boost::shared_ptr<HttpCache> cache) {
+    LOG_DEBUG << "Downloading " << request.url_ << std::endl;
+
+    Transfer* transfer = new Transfer();
+    transfer->request_ = request;
+    transfer->headers_ = NULL;
+    transfer->hasCached_ = false;
+
+    // local files are not worth caching
+    if (cache && !isFileUrl(request.url_)) {
+        HttpCache::Validators cachedValidators;
+        transfer->hasCached_ = cache->load(request.url_, cachedValidators, transfer->cachedData_);
+
+        if (transfer->hasCached_) {
+            if (!cachedValidators.etag_.empty()) {
+                std::string header = "If-None-Match: " + cachedValidators.etag_;
+                transfer->headers_ = curl_slist_append(transfer->headers_, header.c_str());
+            }
+            if (!cachedValidators.lastModified_.empty()) {
+                std::string header = "If-Modified-Since: " + cachedValidators.lastModified_;
+                transfer->headers_ = curl_slist_append(transfer->headers_, header.c_str());
+            }
+        }
+    }
+
+    CURL* handle = curl_easy_init();
+    transfer->handle_ = handle;
+
+    curl_easy_setopt(handle, CURLOPT_URL, request.url_.c_str());
+    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, HttpDownloader::curlWriteCallback);
+    curl_easy_setopt(handle, CURLOPT_WRITEDATA, transfer);
+    curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, HttpDownloader::curlHeaderCallback);
+    curl_easy_setopt(handle, CURLOPT_HEADERDATA, transfer);
+    curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
+    // signals do not mix with threads
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    if (transfer->headers_) {
+        curl_easy_setopt(handle, CURLOPT_HTTPHEADER, transfer->headers_);
+    }
+
+    transfers_[handle] = transfer;
+    curl_multi_add_handle(multiHandle_, handle);
+}
+
+void HttpDownloader::finishTransfer(CURL* handle, CURLcode result, boost::shared_ptr<HttpCache> cache) {
+    std::map<CURL*, Transfer*>::iterator iter = transfers_.find(handle);
+    if (iter == transfers_.end()) {
+        return;
+    }
+
+    Transfer* transfer = iter->second;
+    transfers_.erase(iter);
+
+    long responseCode = 0;
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &responseCode);
+
+    curl_multi_remove_handle(multiHandle_, handle);
+    curl_easy_cleanup(handle);
+    curl_slist_free_all(transfer->headers_);
+
+    const std::string& url = transfer->request_.url_;
+    if (result == CURLE_OK && responseCode == 304 && transfer->hasCached_) {
+        LOG_DEBUG << "Not modified, using cached copy of " << url << std::endl;
+        complete(transfer->request_, transfer->cachedData_, true);
+    } else if (result == CURLE_OK && (responseCode == 0 || (responseCode >= 200 && responseCode < 300))) {
+        // file urls do not have a response code
+        if (cache && !isFileUrl(url)) {
+            cache->store(url, transfer->validators_, transfer->data_);
+        }
+        complete(transfer->request_, transfer->data_, true);
+    } else {
+        if (result != CURLE_OK) {
+            LOG_WARN << "Download of " << url << " failed: " << curl_easy_strerror(result) << std::endl;
+        } else {
+            LOG_WARN << "Download of " << url << " failed with response code " << responseCode << std::endl;
+        }
+
+        if (transfer->hasCached_) {
+            LOG_INFO << "Using cached copy of " << url << std::endl;
+            complete(transfer->request_, transfer->cachedData_, true);
+        } else {
+            complete(transfer->request_, std::vector<int8_t>(), false);
+        }
+    }
+
+    delete transfer;
+}
+
+void HttpDownloader::complete(const Request& request, const std::vector<int8_t>& data, bool success) {
+    try {
+        request.completion_(data, success);
+    } catch (const std::exception& ex) {
+        LOG_ERROR << "Exception in download callback for " << request.url_ << ": " << ex.what() << std::endl;
+    }
+}
+
+size_t HttpDownloader::curlWriteCallback(void* ptr, size_t size, size_t nmemb, void* userdata) {
+    Transfer* transfer = reinterpret_cast<Transfer*>(userdata);
+    int8_t* bytes = reinterpret_cast<int8_t*>(ptr);
+    transfer->data_.insert(transfer->data_.end(), bytes, bytes + size * nmemb);
+    return size * nmemb;
+}
+
+size_t HttpDownloader::curlHeaderCallback(void* ptr, size_t size, size_t nmemb, void* userdata) {
+    Transfer* transfer = reinterpret_cast<Transfer*>(userdata);
+    std::string line(reinterpret_cast<const char*>(ptr), size * nmemb);
+
+    if (startsWithNoCase(line, "HTTP/")) {
+        // new response after a redirect, forget the headers of the previous one
+        transfer->validators_ = HttpCache::Validators();
+        transfer->data_.clear();
+    } else if (startsWithNoCase(line, "ETag:")) {
+        transfer->validators_.etag_ = trim(line.substr(5));
+    } else if (startsWithNoCase(line, "Last-Modified:")) {
+        transfer->validators_.lastModified_ = trim(line.substr(14));
+    }
+
+    return size * nmemb;
+}
+
+}
+}
@@ -0,0 +1,129 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_DATA_HTTPDOWNLOADER_HPP
+#define FLUO_DATA_HTTPDOWNLOADER_HPP
+
+#include <curl/curl.h>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <boost/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <misc/string.hpp>
+
+#include "workerpool.hpp"
+#include "httpcache.hpp"
+
+namespace fluo {
+namespace data {
+
+/**
+ * \brief Downloads urls on a single thread using curl's multi interface
+ *
+ * Up to maxConnections transfers run at the same time, so one slow server does not hold back the others.
+ * Queued requests are started in LoadPriority order, requests whose wanted callback returns false are dropped
+ * without being started.
+ *
+ * If a HttpCache is set, responses are stored there and revalidated with If-None-Match/If-Modified-Since
+ * on the next request. The cached copy is also used when the server can not be reached.
+ *
+ * Completion callbacks are called on the download thread, they should hand expensive work to another thread.
+ */
+class HttpDownloader {
+public:
+    typedef boost::function<void (const std::vector<int8_t>&, bool)> CompletionCallback;
+    typedef boost::function<bool ()> WantedCallback;
+
+    HttpDownloader(unsigned int maxConnections);
+    ~HttpDownloader();
+
+    void enqueue(const UnicodeString& url, const CompletionCallback& completion, const WantedCallback& wanted,
+            unsigned int priority = LoadPriority::VISIBLE);
+
+    /// Stops the download thread, no completion callback is called afterwards. Also done by the destructor
+    void stop();
+
+    void setMaxConnections(unsigned int maxConnections);
+    void setCache(boost::shared_ptr<HttpCache> cache);
+
+private:
+    HttpDownloader(const HttpDownloader& copy) { }
+    HttpDownloader& operator=(const HttpDownloader& copy) { return *this; }
+
+    struct Request {
+        std::string url_;
+        CompletionCallback completion_;
+        WantedCallback wanted_;
+
+        Request() {
+        }
+
+        Request(const std::string& url, const CompletionCallback& completion, const WantedCallback& wanted) :
+                url_(url), completion_(completion), wanted_(wanted) {
+        }
+    };
+
+    struct Transfer {
+        Request request_;
+        CURL* handle_;
+        curl_slist* headers_;
+        std::vector<int8_t> data_;
+        HttpCache::Validators validators_;
+
+        bool hasCached_;
+        std::vector<int8_t> cachedData_;
+    };
+
+    void run();
+    bool popNext(Request& request);
+
+    void startTransfer(const Request& request, boost::shared_ptr<HttpCache> cache);
+    void finishTransfer(CURL* handle, CURLcode result, boost::shared_ptr<HttpCache> cache);
+    void complete(const Request& request, const std::vector<int8_t>& data, bool success);
+
+    static size_t curlWriteCallback(void* ptr, size_t size, size_t nmemb, void* userdata);
+    static size_t curlHeaderCallback(void* ptr, size_t size, size_t nmemb, void* userdata);
+
+    boost::thread* thread_;
+    bool running_;
+    boost::mutex mutex_;
+    boost::condition_variable signal_;
+
+    unsigned int maxConnections_;
+    boost::shared_ptr<HttpCache> cache_;
+    std::deque<Request> queues_[LoadPriority::COUNT];
+
+    // only touched by the download thread
+    CURLM* multiHandle_;
+    std::map<CURL*, Transfer*> transfers_;
+};
+
+}
+}
+
+#endif
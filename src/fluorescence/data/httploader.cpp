@@ -19,6 +19,9 @@
 #include "httploader.hpp"
 
 #include <boost/bind.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <ClanLib/Core/IOData/iodevice_memory.h>
+#include <ClanLib/Core/System/databuffer.h>
 #include <ClanLib/Core/System/exception.h>
 #include <ClanLib/Display/Image/pixel_buffer.h>
 #include <ClanLib/Display/ImageProviders/provider_factory.h>
@@ -29,42 +32,45 @@
 namespace fluo {
 namespace data {
  
-HttpLoader::HttpLoader() : dataBuffer_(1024 * 100), memoryIO_(dataBuffer_) {
-    handle_ = curl_easy_init();
-    curl_easy_setopt(handle_, CURLOPT_WRITEFUNCTION, HttpLoader::curlRecvCallback);
-    
-    boost::shared_ptr<OnDemandUrlLoader<UnicodeString, ui::Texture> > threadedLoader(new OnDemandUrlLoader<UnicodeString, ui::Texture>(boost::bind(&HttpLoader::readTextureCallback, this, _1, _2)));
-    cache_.init(threadedLoader);
+HttpLoader::HttpLoader() {
+    urlLoader_.reset(new OnDemandHttpLoader<UnicodeString, ui::Texture>(boost::bind(&HttpLoader::readTextureCallback, this, _1, _2, _3)));
+    cache_.init(urlLoader_);
 }
 
-HttpLoader::~HttpLoader() {
-    curl_easy_cleanup(handle_);
+void HttpLoader::configure(unsigned int maxConnections, const boost::filesystem::path& cacheDirectory) {
+    urlLoader_->getDownloader().setMaxConnections(maxConnections);
+
+    if (!cacheDirectory.empty()) {
+        try {
+            boost::shared_ptr<HttpCache> httpCache(new HttpCache(cacheDirectory));
+            urlLoader_->getDownloader().setCache(httpCache);
+        } catch (const boost::filesystem::filesystem_error& ex) {
+            LOG_WARN << "Unable to create http cache in " << cacheDirectory << ": " << ex.what() << std::endl;
+        }
+    }
 }
 
 boost::shared_ptr<ui::Texture> HttpLoader::getTexture(const UnicodeString& url) {
     return cache_.get(url);
 }
 
-void HttpLoader::readTextureCallback(const UnicodeString& url, boost::shared_ptr<ui::Texture> tex) {
+void HttpLoader::readTextureCallback(const UnicodeString& url, boost::shared_ptr<ui::Texture> tex, const std::vector<int8_t>& data) {
     LOG_DEBUG << "Opening image from url " << StringConverter::toUtf8String(url).c_str() << std::endl;
-    
+
     tex->setUsage(ui::Texture::USAGE_GUMP);
-    
-    curl_easy_setopt(handle_,CURLOPT_WRITEDATA, this);
-    
-    curl_easy_setopt(handle_, CURLOPT_URL, StringConverter::toUtf8String(url).c_str());
-    memoryIO_.seek(0, CL_IODevice::seek_set);
-    
-    CURLcode err = curl_easy_perform(handle_);
-    if (err) {
-        LOG_ERROR << "CURL error: " << curl_easy_strerror(err) << std::endl;
+
+    if (data.empty()) {
+        LOG_ERROR << "Provided URL is empty: " << url << std::endl;
+        tex->setReadFailed();
+        return;
     }
-    
-    memoryIO_.seek(0, CL_IODevice::seek_set);
+
+    CL_DataBuffer dataBuffer(&data[0], data.size());
+    CL_IODevice_Memory memoryIO(dataBuffer);
     try {
         UnicodeString extension(url, url.lastIndexOf('.') + 1);
         LOG_DEBUG << "extension: " << extension << std::endl;
-        CL_PixelBuffer pxBuf = CL_ImageProviderFactory::load(memoryIO_, StringConverter::toUtf8String(extension));
+        CL_PixelBuffer pxBuf = CL_ImageProviderFactory::load(memoryIO, StringConverter::toUtf8String(extension));
         if (pxBuf.get_format() != cl_rgba8) {
             // LOG_DEBUG << "reformat required!" << std::endl;
             pxBuf = pxBuf.to_format(cl_rgba8);
@@ -72,14 +78,10 @@ void HttpLoader::readTextureCallback(const UnicodeString& url, boost::shared_ptr
         tex->setTexture(pxBuf);
     } catch (CL_Exception& ex) {
         LOG_ERROR << "Provided URL can not be interpreted as a picture: " << url << std::endl;
+        tex->setReadFailed();
     }
 }
 
-size_t HttpLoader::curlRecvCallback(void* ptr, size_t size, size_t nmemb, void* userdata) {
-    HttpLoader* self = (HttpLoader*)userdata;
-    return self->memoryIO_.write(ptr, size * nmemb, true);
-}
-
 }
 }
 
@@ -20,14 +20,12 @@
 #ifndef FLUO_DATA_HTTP_LOADER_HPP
 #define FLUO_DATA_HTTP_LOADER_HPP
 
-#include <curl/curl.h>
 #include <boost/shared_ptr.hpp>
-#include <ClanLib/Core/IOData/iodevice_memory.h>
-#include <ClanLib/Core/System/databuffer.h>
+#include <boost/filesystem/path.hpp>
 
 #include <misc/string.hpp>
 
-#include "ondemandurlloader.hpp"
+#include "ondemandhttploader.hpp"
 #include "weakptrcache.hpp"
 
 namespace fluo {
@@ -40,21 +38,17 @@ namespace data {
 class HttpLoader {
 public:
     HttpLoader();
-    ~HttpLoader();
-    
+
+    /// Sets the number of parallel downloads. An empty cacheDirectory disables the on-disk cache
+    void configure(unsigned int maxConnections, const boost::filesystem::path& cacheDirectory);
+
     boost::shared_ptr<ui::Texture> getTexture(const UnicodeString& url);
 
-    void readTextureCallback(const UnicodeString& url, boost::shared_ptr<ui::Texture> tex);
-    
+    void readTextureCallback(const UnicodeString& url, boost::shared_ptr<ui::Texture> tex, const std::vector<int8_t>& data);
+
 private:
-    CURL* handle_;
-    
-    CL_DataBuffer dataBuffer_;
-    CL_IODevice_Memory memoryIO_;
-    
-    static size_t curlRecvCallback(void* ptr, size_t size, size_t nmemb, void* stream);
-    
-    WeakPtrCache<UnicodeString, ui::Texture, OnDemandUrlLoader> cache_;
+    boost::shared_ptr<OnDemandHttpLoader<UnicodeString, ui::Texture> > urlLoader_;
+    WeakPtrCache<UnicodeString, ui::Texture, OnDemandHttpLoader> cache_;
 };    
 
 }
@@ -56,10 +56,8 @@ void HuesLoader::readCallback(int8_t* buf, unsigned int len) {
             ptr += 2;
         }
 
-        for (unsigned int j = 0; j < 32; ++j) {
-            hues_[i].colorTable_[j] = Util::getColorRGBA(*ptr);
-            ++ptr;
-        }
+        Util::convertRow1555(ptr, hues_[i].colorTable_, 32);
+        ptr += 32;
 
         hues_[i].tableStart = *ptr;
         ++ptr;
@@ -102,7 +100,8 @@ CL_Texture& HuesLoader::getHuesTexture() {
 }
 
 uint32_t HuesLoader::getFontRgbColor(unsigned int hue) const {
-    if (hue >= hueCount_) {
+    // hues are 1-based, hue 0 uses the first table as well
+    if (hue > hueCount_) {
         LOG_WARN << "Trying to access too high hue index " << hue << std::endl;
         hue = 0;
     } else if (hue >= 1) {
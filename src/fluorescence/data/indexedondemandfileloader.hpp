@@ -34,11 +34,11 @@ class IndexedOnDemandFileLoader {
 
 public:
     IndexedOnDemandFileLoader(const boost::filesystem::path& indexPath, const boost::filesystem::path& dataPath,
-            typename OnDemandFileLoader<KeyType, ValueType>::ReadCallback readCallback) :
-            indexLoader_(indexPath), dataLoader_(dataPath, readCallback) {
+            typename OnDemandFileLoader<KeyType, ValueType>::ReadCallback readCallback, bool allowMapping = true) :
+            indexLoader_(indexPath), dataLoader_(dataPath, readCallback, allowMapping) {
     }
 
-    boost::shared_ptr<ValueType> get(KeyType index, unsigned int userData) {
+    boost::shared_ptr<ValueType> get(KeyType index, unsigned int userData, unsigned int priority = LoadPriority::VISIBLE) {
         const IndexBlock indexBlock = indexLoader_.get(index);
 
         // e.g. static blocks containing no data use an offset of 0xFFFFFFFFu
@@ -47,10 +47,27 @@ public:
             boost::shared_ptr<ValueType> empty;
             return empty;
          } else {
-             return dataLoader_.get(index, indexBlock, userData);
+             return dataLoader_.get(index, indexBlock, userData, priority);
         }
     }
 
+    void setCacheCallback(const typename OnDemandFileLoader<KeyType, ValueType>::CacheCallback& callback) {
+        dataLoader_.setCacheCallback(callback);
+    }
+
+    void raisePriority(const boost::shared_ptr<ValueType>& item, unsigned int priority) {
+        dataLoader_.raisePriority(item, priority);
+    }
+
+    bool isMemoryMapped() const {
+        return dataLoader_.isMemoryMapped();
+    }
+
+    /// Number of entries in the index file
+    unsigned int size() const {
+        return indexLoader_.size();
+    }
+
 private:
     IndexLoader indexLoader_;
     OnDemandFileLoader<KeyType, ValueType> dataLoader_;
@@ -20,17 +20,31 @@
 
 #include "indexloader.hpp"
 #include "fullfileloader.hpp"
+#include "uopfile.hpp"
 
 #include <misc/log.hpp>
 
 #include <boost/bind.hpp>
 
+#include <algorithm>
+
 namespace fluo {
 namespace data {
 
 IndexLoader::IndexLoader(const boost::filesystem::path& path) : indexBlocks_(NULL) {
-    FullFileLoader ldr(path);
-    ldr.read(boost::bind(&IndexLoader::read, this, _1, _2));
+    if (UopFile::isUopPath(path)) {
+        UopFile uopFile(path);
+        std::vector<IndexBlock> blocks;
+        uopFile.buildIndex(blocks);
+
+        size_ = blocks.size();
+        LOG_DEBUG << "Read index from uop file, size " << size_ << std::endl;
+        indexBlocks_ = new IndexBlock[size_];
+        std::copy(blocks.begin(), blocks.end(), indexBlocks_);
+    } else {
+        FullFileLoader ldr(path);
+        ldr.read(boost::bind(&IndexLoader::read, this, _1, _2));
+    }
 
     fileName_ = StringConverter::fromUtf8(path.leaf());
 }
@@ -60,12 +74,13 @@ void IndexLoader::read(int8_t* buf, unsigned int len) {
         ++ptr;
         indexBlocks_[i].extra_ = *ptr;
         ++ptr;
+        indexBlocks_[i].decompressedLength_ = 0;
     }
 }
 
 const IndexBlock& IndexLoader::get(unsigned int id) const {
     // if someone tries to load an unknown id, just return the first entry
-    if (id > size_) {
+    if (id >= size_) {
         LOG_WARN << "Trying to access out of bounds index=" << id << " size=" << size_ << " in file " << fileName_ << std::endl;
         id = 0;
     }
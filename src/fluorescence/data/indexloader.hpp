@@ -31,10 +31,14 @@ struct IndexBlock {
     uint32_t offset_;
     uint32_t length_;
     uint32_t extra_;
+
+    /// Only set for zlib compressed entries in uop files, 0 otherwise
+    uint32_t decompressedLength_;
 };
 
 class IndexLoader {
 public:
+    /// Accepts mul index files as well as uop files, which contain the index
     IndexLoader(const boost::filesystem::path& path);
     ~IndexLoader();
 
@@ -0,0 +1,91 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include "ioscheduler.hpp"
+
+#include <misc/exception.hpp>
+
+namespace fluo {
+namespace data {
+
+boost::shared_ptr<IoScheduler> IoScheduler::singleton_;
+
+void IoScheduler::create(unsigned int ioThreadCount, unsigned int decodeThreadCount) {
+    if (!singleton_) {
+        singleton_.reset(new IoScheduler(ioThreadCount, decodeThreadCount));
+    }
+}
+
+void IoScheduler::destroy() {
+    // loaders still holding a reference keep the scheduler alive until they are destroyed
+    singleton_.reset();
+}
+
+boost::shared_ptr<IoScheduler> IoScheduler::getSingleton() {
+    if (!singleton_) {
+        throw Exception("fluo::data::IoScheduler Singleton not created yet");
+    }
+
+    return singleton_;
+}
+
+IoScheduler::IoScheduler(unsigned int ioThreadCount, unsigned int decodeThreadCount) {
+    if (decodeThreadCount == 0) {
+        decodeThreadCount = boost::thread::hardware_concurrency();
+    }
+
+    ioPool_.reset(new WorkerPool("io", ioThreadCount));
+    decodePool_.reset(new WorkerPool("decode", decodeThreadCount));
+}
+
+void IoScheduler::enqueueRead(const void* owner, const Job& job, unsigned int priority, const void* item) {
+    ioPool_->enqueue(owner, job, priority, item);
+}
+
+void IoScheduler::enqueueDecode(const void* owner, const Job& job, unsigned int priority, const void* item) {
+    decodePool_->enqueue(owner, job, priority, item);
+}
+
+void IoScheduler::raisePriority(const void* owner, const void* item, unsigned int priority) {
+    // io pool first, a read job finishing in between enqueues its decode job with the raised priority
+    ioPool_->raisePriority(owner, item, priority);
+    decodePool_->raisePriority(owner, item, priority);
+}
+
+void IoScheduler::parallelDecode(unsigned int count, const WorkerPool::IndexJob& job) {
+    decodePool_->parallelFor(count, job);
+}
+
+void IoScheduler::cancel(const void* owner) {
+    // jobs enqueue into the other pool (cache lookups on the decode pool queue reads, reads queue decodes), so
+    // both pools drop new jobs of the owner until nothing of it is queued or running anywhere
+    ioPool_->block(owner);
+    decodePool_->block(owner);
+
+    ioPool_->cancel(owner);
+    decodePool_->cancel(owner);
+
+    ioPool_->unblock(owner);
+    decodePool_->unblock(owner);
+}
+
+}
+}
@@ -0,0 +1,76 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_DATA_IOSCHEDULER_HPP
+#define FLUO_DATA_IOSCHEDULER_HPP
+
+#include "workerpool.hpp"
+
+#include <boost/shared_ptr.hpp>
+
+namespace fluo {
+namespace data {
+
+/**
+ * \brief Schedules the file reads and the decoding of all OnDemandFileLoader instances
+ *
+ * Reading and decoding are split into two pools. A small number of io threads fetch the raw data and hand it
+ * to the decode pool, which is sized to the number of cores. This way, a burst of expensive decodes does not
+ * stall the reads queued behind it.
+ *
+ * Loaders keep a shared_ptr to the scheduler, so it stays alive until the last loader is gone.
+ */
+class IoScheduler {
+public:
+    typedef WorkerPool::Job Job;
+
+    /// A decodeThreadCount of 0 uses one decode thread per core
+    static void create(unsigned int ioThreadCount, unsigned int decodeThreadCount);
+    static void destroy();
+    static boost::shared_ptr<IoScheduler> getSingleton();
+
+    /// item identifies the object that is loaded, so that raisePriority can find the job again
+    void enqueueRead(const void* owner, const Job& job, unsigned int priority, const void* item = NULL);
+    void enqueueDecode(const void* owner, const Job& job, unsigned int priority, const void* item = NULL);
+
+    /// Moves the queued read and decode jobs of an item to a higher priority, e.g. when a prefetched object becomes visible
+    void raisePriority(const void* owner, const void* item, unsigned int priority);
+
+    /// Removes all queued read and decode jobs of the given owner and waits until its currently running jobs are finished
+    void cancel(const void* owner);
+
+    /// Splits a decode into independent parts, e.g. the frames of an animation. See WorkerPool::parallelFor
+    void parallelDecode(unsigned int count, const WorkerPool::IndexJob& job);
+
+private:
+    static boost::shared_ptr<IoScheduler> singleton_;
+
+    IoScheduler(unsigned int ioThreadCount, unsigned int decodeThreadCount);
+    IoScheduler(const IoScheduler& copy) { }
+    IoScheduler& operator=(const IoScheduler& copy) { return *this; }
+
+    boost::shared_ptr<WorkerPool> ioPool_;
+    boost::shared_ptr<WorkerPool> decodePool_;
+};
+
+}
+}
+
+#endif
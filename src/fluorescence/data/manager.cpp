@@ -20,6 +20,7 @@
 
 #include "manager.hpp"
 
+#include <boost/bind.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <unicode/regex.h>
 
@@ -43,6 +44,12 @@
 #include "spellbooks.hpp"
 #include "skillsloader.hpp"
 #include "radarcolloader.hpp"
+#include "ioscheduler.hpp"
+#include "decodecache.hpp"
+#include "sharedmemorycache.hpp"
+#include "texturepack.hpp"
+#include "animprefetcher.hpp"
+#include "startuptasks.hpp"
 
 #include <client.hpp>
 
@@ -85,7 +92,7 @@ Manager* Manager::getSingleton() {
     return singleton_;
 }
 
-Manager::Manager() {
+Manager::Manager() : decodeCacheMaxMegabytes_(0), decodeCacheMaxAgeDays_(0) {
     LOG_INFO << "Initializing http loader" << std::endl;
     httpLoader_.reset(new HttpLoader());
 
@@ -101,10 +108,9 @@ bool Manager::setShardConfig(Config& config) {
         fileFormat_ = FileFormat::MUL_HIGH_SEAS;
     } else if (fileFormatStr == "uop") {
         fileFormat_ = FileFormat::UOP;
-        LOG_ERROR << "UOP file format not qupported yet" << std::endl;
-        return false;
     } else {
-        LOG_ERROR << "Unsupported file format. Supported: \"mul\" for pre high seas files, \"mul-hs\" for high seas files" << std::endl;
+        LOG_ERROR << "Unsupported file format. Supported: \"mul\" for pre high seas files, \"mul-hs\" for high seas files, " <<
+                "\"uop\" for clients with uop files" << std::endl;
         return false;
     }
 
@@ -122,54 +128,71 @@ bool Manager::setShardConfig(Config& config) {
 
     boost::filesystem::path idxPath;
     boost::filesystem::path path;
-    boost::filesystem::path difOffsetsPath;
-    boost::filesystem::path difIdxPath;
-    boost::filesystem::path difPath;
+
+    IoScheduler::create(config["/fluo/files/io@threads"].asInt(), config["/fluo/files/io@decode-threads"].asInt());
+
+    boost::filesystem::path decodeCachePath;
+    if (config["/fluo/files/decode-cache@enabled"].asBool()) {
+        decodeCachePath = config["/fluo/files/decode-cache@path"].asPath();
+        decodeCacheMaxMegabytes_ = config["/fluo/files/decode-cache@max-mb"].asInt();
+        decodeCacheMaxAgeDays_ = config["/fluo/files/decode-cache@max-age-days"].asInt();
+    }
+
+    if (config["/fluo/files/shared-cache@enabled"].asBool()) {
+        sharedMemoryCache_ = createSharedMemoryCache(config["/fluo/files/shared-cache@size-mb"].asInt() * 1024 * 1024);
+    }
+
+    boost::filesystem::path httpCachePath;
+    if (config["/fluo/files/http-cache@enabled"].asBool()) {
+        httpCachePath = config["/fluo/files/http-cache@path"].asPath();
+    }
+    httpLoader_->configure(config["/fluo/files/http@max-connections"].asInt(), httpCachePath);
+
+    // file lookups and config reads happen here, only the loader construction runs in the startup tasks
+    StartupTasks tasks;
 
     checkFileExists("tiledata.mul");
     path = filePathMap_["tiledata.mul"];
     LOG_INFO << "Opening tiledata.mul from mul=" << path << std::endl;
-    tileDataLoader_.reset(new TileDataLoader(path, fileFormat_ == FileFormat::MUL_HIGH_SEAS));
+    tasks.add("tiledata", boost::bind(&Manager::loadTileData, this, path, fileFormat_ != FileFormat::MUL));
 
     checkFileExists("hues.mul");
     path = filePathMap_["hues.mul"];
     LOG_INFO << "Opening hues.mul from mul=" << path << std::endl;
-    huesLoader_.reset(new HuesLoader(path));
+    tasks.add("hues", boost::bind(&Manager::loadHues, this, path));
 
     checkFileExists("texidx.mul");
     checkFileExists("texmaps.mul");
     idxPath = filePathMap_["texidx.mul"];
     path = filePathMap_["texmaps.mul"];
     LOG_INFO << "Opening maptex from idx=" << idxPath << " mul=" << path << std::endl;
-    mapTexLoader_.reset(new MapTexLoader(idxPath, path));
+    tasks.add("maptex", boost::bind(&Manager::loadMapTex, this, idxPath, path, config["/fluo/files/cache@texmaps-mb"].asInt() * 1024 * 1024));
 
-    checkFileExists("artidx.mul");
-    checkFileExists("art.mul");
-    idxPath = filePathMap_["artidx.mul"];
-    path = filePathMap_["art.mul"];
+    getIndexedFilePaths("artlegacymul.uop", "artidx.mul", "art.mul", idxPath, path);
     LOG_INFO << "Opening art from idx=" << idxPath << " mul=" << path << std::endl;
-    artLoader_.reset(new ArtLoader(idxPath, path));
+    tasks.add("art", boost::bind(&Manager::loadArt, this, idxPath, path, decodeCachePath, config["/fluo/files/cache@art-mb"].asInt() * 1024 * 1024));
+
+    if (config["/fluo/files/texture-pack@enabled"].asBool()) {
+        std::vector<std::string> packDependencies;
+        packDependencies.push_back("art");
+        packDependencies.push_back("maptex");
+        tasks.add("texture-pack", boost::bind(&Manager::applyTexturePack, this, config["/fluo/files/texture-pack@path"].asPath()), packDependencies);
+    }
 
-    checkFileExists("gumpidx.mul");
-    checkFileExists("gumpart.mul");
-    idxPath = filePathMap_["gumpidx.mul"];
-    path = filePathMap_["gumpart.mul"];
+    getIndexedFilePaths("gumpartlegacymul.uop", "gumpidx.mul", "gumpart.mul", idxPath, path);
     LOG_INFO << "Opening gump art from idx=" << idxPath << " mul=" << path << std::endl;
-    gumpArtLoader_.reset(new GumpArtLoader(idxPath, path));
+    tasks.add("gumpart", boost::bind(&Manager::loadGumpArt, this, idxPath, path, decodeCachePath, config["/fluo/files/cache@gumpart-mb"].asInt() * 1024 * 1024));
 
     checkFileExists("animdata.mul");
     path = filePathMap_["animdata.mul"];
     LOG_INFO << "Opening animdata from mul=" << path << std::endl;
-    animDataLoader_.reset(new AnimDataLoader(path));
-
-
-    unsigned int blockCountX;
-    unsigned int blockCountY;
-    bool difsEnabled;
+    tasks.add("animdata", boost::bind(&Manager::loadAnimData, this, path));
 
 
-    // map0.mul is the only file that is absolutely required, all others are optional
-    checkFileExists("map0.mul");
+    // map0 is the only file that is absolutely required, all others are optional
+    if (!getUopPath("map0legacymul.uop", path)) {
+        checkFileExists("map0.mul");
+    }
 
     std::stringstream ss;
     for (unsigned int index = 0; index <= 5; ++index) {
@@ -180,56 +203,60 @@ bool Manager::setShardConfig(Config& config) {
             continue;
         }
 
+        MapFiles files;
+
         ss.str(""); ss.clear();
-        ss << "map" << index << ".mul";
-        if (!hasPathFor(ss.str())) {
-            // file does not exist
-            if (index == 1) {
-                // old clients use map0.mul also for map1
-                ss.str(""); ss.clear();
-                ss << "map0.mul";
-                LOG_INFO << "Using map0.mul instead of map1.mul" << std::endl;
-            } else {
-                LOG_WARN << "Could not find map file " << ss.str() << ", although this map is enabled" << std::endl;
-                continue;
+        ss << "map" << index << "legacymul.uop";
+        if (!getUopPath(ss.str(), files.mapPath_)) {
+            ss.str(""); ss.clear();
+            ss << "map" << index << ".mul";
+            if (!hasPathFor(ss.str())) {
+                // file does not exist
+                if (index == 1) {
+                    // old clients use map0.mul also for map1
+                    ss.str(""); ss.clear();
+                    ss << "map0.mul";
+                    LOG_INFO << "Using map0.mul instead of map1.mul" << std::endl;
+                } else {
+                    LOG_WARN << "Could not find map file " << ss.str() << ", although this map is enabled" << std::endl;
+                    continue;
+                }
             }
+            files.mapPath_ = filePathMap_[ss.str()];
         }
-        path = filePathMap_[ss.str()];
 
         ss.str(""); ss.clear();
         ss << "/fluo/files/map" << index << "@width";
-        blockCountX = config[ss.str().c_str()].asInt();
+        files.blockCountX_ = config[ss.str().c_str()].asInt();
 
         ss.str(""); ss.clear();
         ss << "/fluo/files/map" << index << "@height";
-        blockCountY = config[ss.str().c_str()].asInt();
+        files.blockCountY_ = config[ss.str().c_str()].asInt();
 
         ss.str(""); ss.clear();
         ss << "/fluo/files/map" << index << "@difs-enabled";
-        difsEnabled = config[ss.str().c_str()].asBool();
+        files.difsEnabled_ = config[ss.str().c_str()].asBool();
 
-        if (difsEnabled) {
+        if (files.difsEnabled_) {
             // difs are not really mandatory, so no hard checkFileExists here
             ss.str(""); ss.clear();
             ss << "mapdifl" << index << ".mul";
-            difOffsetsPath = filePathMap_[ss.str()];
+            files.mapDifOffsetsPath_ = filePathMap_[ss.str()];
 
             ss.str(""); ss.clear();
             ss << "mapdif" << index << ".mul";
-            difPath = filePathMap_[ss.str()];
+            files.mapDifPath_ = filePathMap_[ss.str()];
 
-            LOG_INFO << "Opening map" << index << " from mul=" << path << ", dif-offsets=" << difOffsetsPath <<
-                    ", dif=" << difPath << ", blockCountX=" << blockCountX << ", blockCountY=" << blockCountY << std::endl;
-            mapLoader_[index].reset(new MapLoader(path, difOffsetsPath, difPath, blockCountX, blockCountY));
+            LOG_INFO << "Opening map" << index << " from mul=" << files.mapPath_ << ", dif-offsets=" << files.mapDifOffsetsPath_ <<
+                    ", dif=" << files.mapDifPath_ << ", blockCountX=" << files.blockCountX_ << ", blockCountY=" << files.blockCountY_ << std::endl;
         } else {
-            LOG_INFO << "Opening map" << index << " from mul=" << path << ", difs disabled, blockCountX=" <<
-                    blockCountX << ", blockCountY=" << blockCountY << std::endl;
-            mapLoader_[index].reset(new MapLoader(path, blockCountX, blockCountY));
+            LOG_INFO << "Opening map" << index << " from mul=" << files.mapPath_ << ", difs disabled, blockCountX=" <<
+                    files.blockCountX_ << ", blockCountY=" << files.blockCountY_ << std::endl;
         }
 
-        if (!fallbackMapLoader_.get()) {
-            fallbackMapLoader_ = mapLoader_[index];
-        }
+        ss.str(""); ss.clear();
+        ss << "map" << index;
+        tasks.add(ss.str(), boost::bind(&Manager::loadMap, this, index, files));
 
 
         ss.str(""); ss.clear();
@@ -246,7 +273,7 @@ bool Manager::setShardConfig(Config& config) {
                 continue;
             }
         }
-        idxPath = filePathMap_[ss.str()];
+        files.staticsIdxPath_ = filePathMap_[ss.str()];
 
         ss.str(""); ss.clear();
         ss << "statics" << index << ".mul";
@@ -262,37 +289,35 @@ bool Manager::setShardConfig(Config& config) {
                 continue;
             }
         }
-        path = filePathMap_[ss.str()];
+        files.staticsPath_ = filePathMap_[ss.str()];
 
 
 
-        if (difsEnabled) {
+        if (files.difsEnabled_) {
             ss.str(""); ss.clear();
             ss << "stadifl" << index << ".mul";
             //checkFileExists(ss.str());
-            difOffsetsPath = filePathMap_[ss.str()];
+            files.staticsDifOffsetsPath_ = filePathMap_[ss.str()];
 
             ss.str(""); ss.clear();
             ss << "stadifi" << index << ".mul";
             //checkFileExists(ss.str());
-            difIdxPath = filePathMap_[ss.str()];
+            files.staticsDifIdxPath_ = filePathMap_[ss.str()];
 
             ss.str(""); ss.clear();
             ss << "stadif" << index << ".mul";
             //checkFileExists(ss.str());
-            difPath = filePathMap_[ss.str()];
+            files.staticsDifPath_ = filePathMap_[ss.str()];
 
-            LOG_INFO << "Opening statics" << index << " from idx=" << idxPath << ", mul=" << path << ", dif-offsets=" << difOffsetsPath <<
-                    ", dif-idx=" << difIdxPath << ", dif=" << difPath << std::endl;
-            staticsLoader_[index].reset(new StaticsLoader(idxPath, path, difOffsetsPath, difIdxPath, difPath, blockCountX, blockCountY));
+            LOG_INFO << "Opening statics" << index << " from idx=" << files.staticsIdxPath_ << ", mul=" << files.staticsPath_ <<
+                    ", dif-offsets=" << files.staticsDifOffsetsPath_ << ", dif-idx=" << files.staticsDifIdxPath_ << ", dif=" << files.staticsDifPath_ << std::endl;
         } else {
-            LOG_INFO << "Opening statics" << index << " from idx=" << idxPath << ", mul=" << path << ", difs disabled" << std::endl;
-            staticsLoader_[index].reset(new StaticsLoader(idxPath, path, blockCountX, blockCountY));
+            LOG_INFO << "Opening statics" << index << " from idx=" << files.staticsIdxPath_ << ", mul=" << files.staticsPath_ << ", difs disabled" << std::endl;
         }
 
-        if (!fallbackStaticsLoader_.get()) {
-            fallbackStaticsLoader_ = staticsLoader_[index];
-        }
+        ss.str(""); ss.clear();
+        ss << "statics" << index;
+        tasks.add(ss.str(), boost::bind(&Manager::loadStatics, this, index, files));
     }
 
 
@@ -327,24 +352,16 @@ bool Manager::setShardConfig(Config& config) {
 
         LOG_INFO << "Opening " << animNames[index] << " from idx=" << idxPath << ", mul=" << path << ", high-detail=" <<
                 highDetailCount << ", low-detail=" << lowDetailCount << std::endl;
-        animLoader_[index].reset(new AnimLoader(idxPath, path, highDetailCount, lowDetailCount));
-
-        if (!fallbackAnimLoader_.get()) {
-            fallbackAnimLoader_ = animLoader_[index];
-        }
-    }
-
-    // check if at least one anim mul file was found
-    if (!fallbackAnimLoader_) {
-        LOG_EMERGENCY << "No anim*.mul file found, exiting" << std::endl;
-        return false;
+        tasks.add(animNames[index], boost::bind(&Manager::loadAnim, this, index, idxPath, path, highDetailCount, lowDetailCount,
+                decodeCachePath, config["/fluo/files/cache@anim-mb"].asInt() * 1024 * 1024));
     }
 
 
     if (hasPathFor("mobtypes.txt")) {
         path = filePathMap_["mobtypes.txt"];
         LOG_INFO << "Opening mobtypes.txt from path=" << path << std::endl;
-        mobTypesLoader_.reset(new DefFileLoader<MobTypeDef>(path, "isi", &MobTypesLoader::parseType));
+        tasks.add("mobtypes", boost::bind(&Manager::loadStringDefFile<MobTypeDef>, this, &mobTypesLoader_, path, "isi", &MobTypesLoader::parseType,
+                getDefCachePath(config, "mobtypes")));
     } else {
         LOG_WARN << "mobtypes.txt not found" << std::endl;
         mobTypesLoader_.reset(new DefFileLoader<MobTypeDef>());
@@ -359,10 +376,7 @@ bool Manager::setShardConfig(Config& config) {
         if (hasPathFor(ss.str())) {
             path = filePathMap_[ss.str()];
             LOG_INFO << "Opening " << unifontNames[index] << ".mul from path=" << path << std::endl;
-            uniFontLoader_[index].reset(new UniFontLoader(path));
-            if (!fallbackUniFontLoader_) {
-                fallbackUniFontLoader_ = uniFontLoader_[index];
-            }
+            tasks.add(unifontNames[index], boost::bind(&Manager::loadUniFont, this, index, path));
         } else {
             LOG_WARN << "Unable to find " << unifontNames[index] << ".mul" << std::endl;
         }
@@ -373,45 +387,49 @@ bool Manager::setShardConfig(Config& config) {
     idxPath = filePathMap_["soundidx.mul"];
     path = filePathMap_["sound.mul"];
     LOG_INFO << "Opening sound from idx=" << idxPath << " mul=" << path << std::endl;
-    soundLoader_.reset(new SoundLoader(idxPath, path));
+    tasks.add("sound", boost::bind(&Manager::loadSound, this, idxPath, path));
 
     checkFileExists("skills.idx");
     checkFileExists("skills.mul");
     idxPath = filePathMap_["skills.idx"];
     path = filePathMap_["skills.mul"];
     LOG_INFO << "Opening skills from idx=" << idxPath << " mul=" << path << std::endl;
-    skillsLoader_.reset(new SkillsLoader(idxPath, path));
+    tasks.add("skills", boost::bind(&Manager::loadSkills, this, idxPath, path));
 
     checkFileExists("radarcol.mul");
     path = filePathMap_["radarcol.mul"];
     LOG_INFO << "Opening radarcol from mul=" << path << std::endl;
-    radarColLoader_.reset(new RadarColLoader(path));
+    tasks.add("radarcol", boost::bind(&Manager::loadRadarCol, this, path));
 
+    if (config["/fluo/files/anim-prefetch@enabled"].asBool()) {
+        animPrefetcher_.reset(new AnimPrefetcher(config["/fluo/files/anim-prefetch@max-animations"].asInt(),
+                config["/fluo/files/anim-prefetch@per-frame"].asInt(), &Manager::getAnim));
+    }
 
     checkFileExists("body.def");
     path = filePathMap_["body.def"];
     LOG_INFO << "Opening body.def from path=" << path << std::endl;
-    bodyDefLoader_.reset(new DefFileLoader<BodyDef>(path, "iri"));
+    tasks.add("body.def", boost::bind(&Manager::loadDefFile<BodyDef>, this, &bodyDefLoader_, path, "iri", getDefCachePath(config, "body")));
 
     checkFileExists("bodyconv.def");
     path = filePathMap_["bodyconv.def"];
     LOG_INFO << "Opening bodyconv.def from path=" << path << std::endl;
-    bodyConvDefLoader_.reset(new DefFileLoader<BodyConvDef>(path, "iiiii"));
+    tasks.add("bodyconv.def", boost::bind(&Manager::loadDefFile<BodyConvDef>, this, &bodyConvDefLoader_, path, "iiiii", getDefCachePath(config, "bodyconv")));
 
     checkFileExists("paperdoll.def");
     path = filePathMap_["paperdoll.def"];
     LOG_INFO << "Opening paperdoll.def from path=" << path << std::endl;
-    paperdollDefLoader_.reset(new DefFileLoader<PaperdollDef>(path, "iiii"));
+    tasks.add("paperdoll.def", boost::bind(&Manager::loadDefFile<PaperdollDef>, this, &paperdollDefLoader_, path, "iiii", getDefCachePath(config, "paperdoll")));
 
     checkFileExists("gump.def");
     path = filePathMap_["gump.def"];
     LOG_INFO << "Opening gump.def from path=" << path << std::endl;
-    gumpDefLoader_.reset(new DefFileLoader<GumpDef>(path, "iri"));
+    tasks.add("gump.def", boost::bind(&Manager::loadDefFile<GumpDef>, this, &gumpDefLoader_, path, "iri", getDefCachePath(config, "gump")));
 
     if (hasPathFor("equipconv.def")) {
         path = filePathMap_["equipconv.def"];
         LOG_INFO << "Opening equipconv.def from path=" << path << std::endl;
-        equipConvDefLoader_.reset(new EquipConvDefLoader(path));
+        tasks.add("equipconv.def", boost::bind(&Manager::loadEquipConvDef, this, path, getDefCachePath(config, "equipconv")));
     } else {
         LOG_WARN << "equipconv.def not found" << std::endl;
         equipConvDefLoader_.reset(new EquipConvDefLoader());
@@ -420,43 +438,74 @@ bool Manager::setShardConfig(Config& config) {
     checkFileExists("mount.def");
     path = filePathMap_["mount.def"];
     LOG_INFO << "Opening mount.def from path=" << path << std::endl;
-    mountDefLoader_.reset(new DefFileLoader<MountDef>(path, "ii"));
+    tasks.add("mount.def", boost::bind(&Manager::loadDefFile<MountDef>, this, &mountDefLoader_, path, "ii", getDefCachePath(config, "mount")));
 
     checkFileExists("effecttranslation.def");
     path = filePathMap_["effecttranslation.def"];
     LOG_INFO << "Opening effecttranslation.def from path=" << path << std::endl;
-    effectTranslationDefLoader_.reset(new DefFileLoader<EffectTranslationDef>(path, "is", &EffectTranslationDef::setEffectName));
+    tasks.add("effecttranslation.def", boost::bind(&Manager::loadStringDefFile<EffectTranslationDef>, this, &effectTranslationDefLoader_, path, "is",
+            &EffectTranslationDef::setEffectName, getDefCachePath(config, "effecttranslation")));
 
     checkFileExists("music/digital/config.txt");
     path = filePathMap_["music/digital/config.txt"];
     LOG_INFO << "Opening sound config.txt from path=" << path << std::endl;
-    musicConfigDefLoader_.reset(new DefFileLoader<MusicConfigDef>(path, "is", &MusicConfigDef::parse));
+    tasks.add("music config", boost::bind(&Manager::loadStringDefFile<MusicConfigDef>, this, &musicConfigDefLoader_, path, "is",
+            &MusicConfigDef::parse, getDefCachePath(config, "musicconfig")));
 
     checkFileExists("sound.def");
     path = filePathMap_["sound.def"];
     LOG_INFO << "Opening sound.def from path=" << path << std::endl;
-    soundDefLoader_.reset(new DefFileLoader<SoundDef>(path, "iri"));
+    tasks.add("sound.def", boost::bind(&Manager::loadDefFile<SoundDef>, this, &soundDefLoader_, path, "iri", getDefCachePath(config, "sound")));
 
     checkFileExists("spellbooks.xml");
     path = filePathMap_["spellbooks.xml"];
     LOG_INFO << "Opening spellbooks.xml from path=" << path << std::endl;
-    spellbooks_.reset(new Spellbooks(path));
+    tasks.add("spellbooks", boost::bind(&Manager::loadSpellbooks, this, path));
 
     checkFileExists("cliloc.enu");
     path = filePathMap_["cliloc.enu"];
     LOG_INFO << "Opening cliloc.enu from path=" << path << std::endl;
-    clilocLoader_.reset(new ClilocLoader());
-    clilocLoader_->indexFile(path, true);
 
+    boost::filesystem::path languagePath;
     ss.str(""); ss.clear();
     UnicodeString langString = config["/fluo/files/cliloc@language"].asString();
     langString.toLower();
     ss << "cliloc." << StringConverter::toUtf8String(langString);
     if (ss.str() != "cliloc.enu") {
         checkFileExists(ss.str());
-        path = filePathMap_[ss.str()];
-        LOG_INFO << "Opening " << ss.str() << " from path=" << path << std::endl;
-        clilocLoader_->indexFile(path, false);
+        languagePath = filePathMap_[ss.str()];
+        LOG_INFO << "Opening " << ss.str() << " from path=" << languagePath << std::endl;
+    }
+    tasks.add("cliloc", boost::bind(&Manager::loadCliloc, this, path, languagePath));
+
+    tasks.run(config["/fluo/files/startup@threads"].asInt());
+
+    // the fallbacks are the loaders with the lowest index, as with serial loading
+    for (unsigned int index = 0; index <= 5; ++index) {
+        if (!fallbackMapLoader_ && mapLoader_[index]) {
+            fallbackMapLoader_ = mapLoader_[index];
+        }
+        if (!fallbackStaticsLoader_ && staticsLoader_[index]) {
+            fallbackStaticsLoader_ = staticsLoader_[index];
+        }
+    }
+
+    for (unsigned int index = 0; index < 5; ++index) {
+        if (!fallbackAnimLoader_ && animLoader_[index]) {
+            fallbackAnimLoader_ = animLoader_[index];
+        }
+    }
+
+    // check if at least one anim mul file was found
+    if (!fallbackAnimLoader_) {
+        LOG_EMERGENCY << "No anim*.mul file found, exiting" << std::endl;
+        return false;
+    }
+
+    for (unsigned int index = 0; index <= 12; ++index) {
+        if (!fallbackUniFontLoader_ && uniFontLoader_[index]) {
+            fallbackUniFontLoader_ = uniFontLoader_[index];
+        }
     }
 
 
@@ -465,8 +514,120 @@ bool Manager::setShardConfig(Config& config) {
     return true;
 }
 
+void Manager::loadTileData(const boost::filesystem::path& path, bool highSeasFormat) {
+    tileDataLoader_.reset(new TileDataLoader(path, highSeasFormat, sharedMemoryCache_));
+}
+
+void Manager::loadHues(const boost::filesystem::path& path) {
+    huesLoader_.reset(new HuesLoader(path));
+}
+
+void Manager::loadMapTex(const boost::filesystem::path& idxPath, const boost::filesystem::path& path, unsigned int retentionBudget) {
+    mapTexLoader_.reset(new MapTexLoader(idxPath, path, sharedMemoryCache_));
+    mapTexLoader_->setRetentionBudget(retentionBudget);
+}
+
+void Manager::loadArt(const boost::filesystem::path& idxPath, const boost::filesystem::path& path,
+        const boost::filesystem::path& decodeCachePath, unsigned int retentionBudget) {
+    artLoader_.reset(new ArtLoader(idxPath, path, createDecodeCache(decodeCachePath, "art", idxPath, path), sharedMemoryCache_));
+    artLoader_->setRetentionBudget(retentionBudget);
+}
+
+void Manager::applyTexturePack(const boost::filesystem::path& path) {
+    boost::shared_ptr<TexturePack> pack = loadTexturePack(path);
+    artLoader_->setTexturePack(pack);
+    mapTexLoader_->setTexturePack(pack);
+}
+
+void Manager::loadGumpArt(const boost::filesystem::path& idxPath, const boost::filesystem::path& path,
+        const boost::filesystem::path& decodeCachePath, unsigned int retentionBudget) {
+    gumpArtLoader_.reset(new GumpArtLoader(idxPath, path, createDecodeCache(decodeCachePath, "gumpart", idxPath, path), sharedMemoryCache_));
+    gumpArtLoader_->setRetentionBudget(retentionBudget);
+}
+
+void Manager::loadAnimData(const boost::filesystem::path& path) {
+    animDataLoader_.reset(new AnimDataLoader(path));
+}
+
+void Manager::loadMap(unsigned int index, const MapFiles& files) {
+    if (files.difsEnabled_) {
+        mapLoader_[index].reset(new MapLoader(files.mapPath_, files.mapDifOffsetsPath_, files.mapDifPath_, files.blockCountX_, files.blockCountY_));
+    } else {
+        mapLoader_[index].reset(new MapLoader(files.mapPath_, files.blockCountX_, files.blockCountY_));
+    }
+}
+
+void Manager::loadStatics(unsigned int index, const MapFiles& files) {
+    if (files.difsEnabled_) {
+        staticsLoader_[index].reset(new StaticsLoader(files.staticsIdxPath_, files.staticsPath_, files.staticsDifOffsetsPath_,
+                files.staticsDifIdxPath_, files.staticsDifPath_, files.blockCountX_, files.blockCountY_));
+    } else {
+        staticsLoader_[index].reset(new StaticsLoader(files.staticsIdxPath_, files.staticsPath_, files.blockCountX_, files.blockCountY_));
+    }
+}
+
+void Manager::loadAnim(unsigned int index, const boost::filesystem::path& idxPath, const boost::filesystem::path& path,
+        unsigned int highDetailCount, unsigned int lowDetailCount, const boost::filesystem::path& decodeCachePath, unsigned int retentionBudget) {
+    const char* animNames[] = { "anim", "anim2", "anim3", "anim4", "anim5" };
+    animLoader_[index].reset(new AnimLoader(idxPath, path, highDetailCount, lowDetailCount,
+            createDecodeCache(decodeCachePath, animNames[index], idxPath, path)));
+    animLoader_[index]->setRetentionBudget(retentionBudget);
+}
+
+void Manager::loadUniFont(unsigned int index, const boost::filesystem::path& path) {
+    uniFontLoader_[index].reset(new UniFontLoader(path));
+}
+
+void Manager::loadSound(const boost::filesystem::path& idxPath, const boost::filesystem::path& path) {
+    soundLoader_.reset(new SoundLoader(idxPath, path));
+}
+
+void Manager::loadSkills(const boost::filesystem::path& idxPath, const boost::filesystem::path& path) {
+    skillsLoader_.reset(new SkillsLoader(idxPath, path));
+}
+
+void Manager::loadRadarCol(const boost::filesystem::path& path) {
+    radarColLoader_.reset(new RadarColLoader(path));
+}
+
+template<typename T>
+void Manager::loadDefFile(boost::shared_ptr<DefFileLoader<T> >* loader, const boost::filesystem::path& path, const char* pattern,
+        const boost::filesystem::path& cachePath) {
+    loader->reset(new DefFileLoader<T>(path, pattern, NULL, cachePath));
+}
+
+template<typename T>
+void Manager::loadStringDefFile(boost::shared_ptr<DefFileLoader<T> >* loader, const boost::filesystem::path& path, const char* pattern,
+        boost::function<void (T&, unsigned int, const char*, int*&)> stringParseFunction, const boost::filesystem::path& cachePath) {
+    loader->reset(new DefFileLoader<T>(path, pattern, stringParseFunction, cachePath));
+}
+
+void Manager::loadEquipConvDef(const boost::filesystem::path& path, const boost::filesystem::path& cachePath) {
+    equipConvDefLoader_.reset(new EquipConvDefLoader(path, cachePath));
+}
+
+void Manager::loadSpellbooks(const boost::filesystem::path& path) {
+    spellbooks_.reset(new Spellbooks(path));
+}
+
+void Manager::loadCliloc(const boost::filesystem::path& path, const boost::filesystem::path& languagePath) {
+    clilocLoader_.reset(new ClilocLoader());
+    clilocLoader_->indexFile(path, true);
+
+    if (!languagePath.empty()) {
+        clilocLoader_->indexFile(languagePath, false);
+    }
+}
+
 Manager::~Manager() {
     LOG_INFO << "data::Manager shutdown" << std::endl;
+
+    if (animPrefetcher_) {
+        animPrefetcher_->printStats();
+    }
+
+    // the loaders still hold a reference to the scheduler. it is stopped when the last one is destroyed
+    IoScheduler::destroy();
 }
 
 boost::shared_ptr<MapLoader> Manager::getMapLoader(unsigned int index) {
@@ -507,7 +668,7 @@ boost::shared_ptr<ui::TextureProvider> Manager::getItemTextureProvider(unsigned
     boost::shared_ptr<ui::TextureProvider> ret;
 
     // check for animate flag in tiledata
-    if (getTileDataLoader()->getStaticTileInfo(artId)->animation()) {
+    if (getTileDataLoader()->getStaticTileInfo(artId).animation()) {
         // if exists, load complex textureprovider
         ret.reset(new ui::AnimDataTextureProvider(artId));
     } else {
@@ -533,9 +694,13 @@ unsigned int Manager::getAnimType(unsigned int bodyId) {
     return ldr->getAnimType(bodyId);
 }
 
-std::vector<boost::shared_ptr<ui::Animation> > Manager::getAnim(unsigned int bodyId, unsigned int animId) {
+std::vector<boost::shared_ptr<ui::Animation> > Manager::getAnim(unsigned int bodyId, unsigned int animId, unsigned int priority) {
     Manager* sing = getSingleton();
 
+    if (sing->animPrefetcher_ && priority == LoadPriority::VISIBLE) {
+        sing->animPrefetcher_->onShow(bodyId, animId);
+    }
+
     BodyConvDef bodyConvEntry = sing->bodyConvDefLoader_->get(bodyId);
     boost::shared_ptr<AnimLoader> ldr;
     unsigned int animIdx;
@@ -550,11 +715,11 @@ std::vector<boost::shared_ptr<ui::Animation> > Manager::getAnim(unsigned int bod
 
     std::vector<boost::shared_ptr<ui::Animation> > ret;
 
-    boost::shared_ptr<ui::Animation> tmpDown = ldr->getAnimation(animIdx, animId, 0);
-    boost::shared_ptr<ui::Animation> tmpDownLeft = ldr->getAnimation(animIdx, animId, 1);
-    boost::shared_ptr<ui::Animation> tmpLeft = ldr->getAnimation(animIdx, animId, 2);
-    boost::shared_ptr<ui::Animation> tmpUpLeft = ldr->getAnimation(animIdx, animId, 3);
-    boost::shared_ptr<ui::Animation> tmpUp = ldr->getAnimation(animIdx, animId, 4);
+    boost::shared_ptr<ui::Animation> tmpDown = ldr->getAnimation(animIdx, animId, 0, priority);
+    boost::shared_ptr<ui::Animation> tmpDownLeft = ldr->getAnimation(animIdx, animId, 1, priority);
+    boost::shared_ptr<ui::Animation> tmpLeft = ldr->getAnimation(animIdx, animId, 2, priority);
+    boost::shared_ptr<ui::Animation> tmpUpLeft = ldr->getAnimation(animIdx, animId, 3, priority);
+    boost::shared_ptr<ui::Animation> tmpUp = ldr->getAnimation(animIdx, animId, 4, priority);
 
     // mirrored
     ret.push_back(tmpUpLeft);
@@ -707,10 +872,126 @@ void Manager::checkFileExists(const std::string& file) const {
     }
 }
 
+bool Manager::getUopPath(const std::string& file, boost::filesystem::path& path) {
+    if (fileFormat_ != FileFormat::UOP || !hasPathFor(file)) {
+        return false;
+    }
+
+    path = filePathMap_[file];
+    return true;
+}
+
+void Manager::getIndexedFilePaths(const std::string& uopFile, const std::string& idxFile, const std::string& mulFile,
+        boost::filesystem::path& idxPath, boost::filesystem::path& mulPath) {
+    // uop files contain the index, so they are used for both
+    if (getUopPath(uopFile, mulPath)) {
+        idxPath = mulPath;
+        return;
+    }
+
+    checkFileExists(idxFile);
+    checkFileExists(mulFile);
+    idxPath = filePathMap_[idxFile];
+    mulPath = filePathMap_[mulFile];
+}
+
+boost::shared_ptr<DecodeCache> Manager::createDecodeCache(const boost::filesystem::path& directory, const std::string& name,
+        const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath) {
+    boost::shared_ptr<DecodeCache> ret;
+    if (directory.empty()) {
+        return ret;
+    }
+
+    std::vector<boost::filesystem::path> indexFiles;
+    indexFiles.push_back(idxPath);
+    std::vector<boost::filesystem::path> dataFiles;
+    dataFiles.push_back(mulPath);
+
+    try {
+        ret.reset(new DecodeCache(directory, name, indexFiles, dataFiles, decodeCacheMaxMegabytes_, decodeCacheMaxAgeDays_));
+    } catch (const boost::filesystem::filesystem_error& ex) {
+        LOG_WARN << "Unable to initialize decode cache for " << name << ": " << ex.what() << std::endl;
+    }
+
+    return ret;
+}
+
+boost::shared_ptr<SharedMemoryCache> Manager::createSharedMemoryCache(unsigned int size) {
+    boost::shared_ptr<SharedMemoryCache> ret;
+
+#ifdef WIN32
+    LOG_WARN << "The shared memory cache is not supported on Windows" << std::endl;
+#else
+    // the files are large, only their size and modification time are hashed
+    std::vector<boost::filesystem::path> dataFiles;
+    boost::filesystem::path idxPath;
+    boost::filesystem::path path;
+
+    getIndexedFilePaths("artlegacymul.uop", "artidx.mul", "art.mul", idxPath, path);
+    dataFiles.push_back(idxPath);
+    dataFiles.push_back(path);
+
+    getIndexedFilePaths("gumpartlegacymul.uop", "gumpidx.mul", "gumpart.mul", idxPath, path);
+    dataFiles.push_back(idxPath);
+    dataFiles.push_back(path);
+
+    checkFileExists("texidx.mul");
+    checkFileExists("texmaps.mul");
+    checkFileExists("tiledata.mul");
+    dataFiles.push_back(filePathMap_["texidx.mul"]);
+    dataFiles.push_back(filePathMap_["texmaps.mul"]);
+    dataFiles.push_back(filePathMap_["tiledata.mul"]);
+
+    // the file format decides how tiledata is read
+    uint64_t hash = DecodeCache::hashFiles(std::vector<boost::filesystem::path>(), dataFiles) ^ fileFormat_;
+
+    try {
+        ret.reset(new SharedMemoryCache(hash, size));
+    } catch (const Exception& ex) {
+        LOG_WARN << "Unable to use shared memory cache: " << ex.what() << std::endl;
+    }
+#endif
+
+    return ret;
+}
+
+boost::filesystem::path Manager::getDefCachePath(Config& config, const std::string& name) const {
+    if (!config["/fluo/files/def-cache@enabled"].asBool()) {
+        return boost::filesystem::path();
+    }
+
+    return config["/fluo/files/def-cache@path"].asPath() / (name + ".bin");
+}
+
+boost::shared_ptr<TexturePack> Manager::loadTexturePack(const boost::filesystem::path& path) {
+    boost::shared_ptr<TexturePack> ret;
+
+    uint64_t sourceHash[TexturePack::Source::COUNT];
+    std::vector<boost::filesystem::path> indexFiles;
+    std::vector<boost::filesystem::path> dataFiles;
+
+    indexFiles.push_back(boost::filesystem::path());
+    dataFiles.push_back(boost::filesystem::path());
+    getIndexedFilePaths("artlegacymul.uop", "artidx.mul", "art.mul", indexFiles[0], dataFiles[0]);
+    sourceHash[TexturePack::Source::ART] = DecodeCache::hashFiles(indexFiles, dataFiles);
+
+    indexFiles[0] = filePathMap_["texidx.mul"];
+    dataFiles[0] = filePathMap_["texmaps.mul"];
+    sourceHash[TexturePack::Source::TEXMAP] = DecodeCache::hashFiles(indexFiles, dataFiles);
+
+    try {
+        ret.reset(new TexturePack(path, sourceHash));
+    } catch (const Exception& ex) {
+        LOG_WARN << "Unable to use texture pack " << path << ": " << ex.what() << std::endl;
+    }
+
+    return ret;
+}
+
 unsigned int Manager::getGumpIdForItem(unsigned int itemId, unsigned int parentBodyId) {
     Manager* sing = getSingleton();
 
-    unsigned int animId = sing->tileDataLoader_->getStaticTileInfo(itemId)->animId_;
+    unsigned int animId = sing->tileDataLoader_->getStaticTileInfo(itemId).animId();
 
     EquipConvDef equipConv = sing->equipConvDefLoader_->get(parentBodyId, itemId);
     if (equipConv.bodyId_ != 0) {
@@ -768,6 +1049,16 @@ boost::shared_ptr<RadarColLoader> Manager::getRadarColLoader() {
     return getSingleton()->radarColLoader_;
 }
 
+boost::shared_ptr<AnimPrefetcher> Manager::getAnimPrefetcher() {
+    return getSingleton()->animPrefetcher_;
+}
+
+void Manager::step() {
+    if (animPrefetcher_) {
+        animPrefetcher_->step();
+    }
+}
+
 
 boost::filesystem::path Manager::getShardFilePath(const boost::filesystem::path& innerPath) {
     boost::filesystem::path ret;
@@ -788,7 +1079,7 @@ boost::filesystem::path Manager::getShardFilePath(const boost::filesystem::path&
     return ret;
 }
 
-boost::shared_ptr<ui::Texture> Manager::getTexture(unsigned int source, unsigned int id) {
+boost::shared_ptr<ui::Texture> Manager::getTexture(unsigned int source, unsigned int id, bool needPixels) {
     Manager* sing = getSingleton();
     boost::shared_ptr<ui::Texture> ret;
     std::map<unsigned int, boost::filesystem::path>::const_iterator iter;
@@ -816,7 +1107,7 @@ boost::shared_ptr<ui::Texture> Manager::getTexture(unsigned int source, unsigned
             ret = sing->filePathLoader_->getTexture(iter->second);
             ret->setUsage(ui::Texture::USAGE_WORLD);
         } else {
-            ret = sing->artLoader_->getItemTexture(id);
+            ret = sing->artLoader_->getItemTexture(id, needPixels);
         }
         break;
 
@@ -1006,7 +1297,7 @@ UnicodeString Manager::getItemName(unsigned int artId) {
     if (sing->clilocLoader_->hasEntry(clilocId)) {
         return sing->clilocLoader_->get(clilocId);
     } else {
-        return sing->tileDataLoader_->getStaticTileInfo(artId)->name_;
+        return sing->tileDataLoader_->getStaticTileInfo(artId).name();
     }
 }
 
@@ -24,6 +24,7 @@
 
 #include <boost/filesystem/path.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
 
 #include <vector>
 
@@ -32,12 +33,16 @@
 
 #include <misc/config.hpp>
 #include "defstructs.hpp"
+#include "workerpool.hpp"
 
 namespace fluo {
 namespace data {
 
 class TileDataLoader;
 class ArtLoader;
+class DecodeCache;
+class SharedMemoryCache;
+class TexturePack;
 class HuesLoader;
 class GumpArtLoader;
 class MapLoader;
@@ -55,6 +60,7 @@ class Spellbooks;
 class SpellbookInfo;
 class SkillsLoader;
 class RadarColLoader;
+class AnimPrefetcher;
 
 template<typename ValueType>
 class DefFileLoader;
@@ -89,6 +95,9 @@ public:
 
     bool setShardConfig(Config& config);
 
+    /// Called once per frame while playing
+    void step();
+
     // return the path to the file inside the current shard directory, if the file exists there.
     // if not, return default path
     static boost::filesystem::path getShardFilePath(const boost::filesystem::path& innerPath);
@@ -105,7 +114,7 @@ public:
     static SoundDef getSoundDef(unsigned int soundId);
 
     static boost::shared_ptr<ui::TextureProvider> getItemTextureProvider(unsigned int artId);
-    static std::vector<boost::shared_ptr<ui::Animation> > getAnim(unsigned int bodyId, unsigned int animId);
+    static std::vector<boost::shared_ptr<ui::Animation> > getAnim(unsigned int bodyId, unsigned int animId, unsigned int priority = LoadPriority::VISIBLE);
     static unsigned int getAnimType(unsigned int bodyId);
 
     static boost::shared_ptr<TileDataLoader> getTileDataLoader();
@@ -119,8 +128,11 @@ public:
     static boost::shared_ptr<SoundLoader> getSoundLoader();
     static boost::shared_ptr<SkillsLoader> getSkillsLoader();
     static boost::shared_ptr<RadarColLoader> getRadarColLoader();
+    /// Returns an empty pointer if prefetching is disabled
+    static boost::shared_ptr<AnimPrefetcher> getAnimPrefetcher();
 
-    static boost::shared_ptr<ui::Texture> getTexture(unsigned int source, unsigned int id);
+    /// needPixels is required if the caller reads the pixel buffer, which textures from the texture pack do not have
+    static boost::shared_ptr<ui::Texture> getTexture(unsigned int source, unsigned int id, bool needPixels = false);
     static boost::shared_ptr<ui::Texture> getTexture(unsigned int source, const UnicodeString& id);
     static boost::shared_ptr<ui::Texture> getTexture(const UnicodeString& source, const UnicodeString& id);
 
@@ -146,6 +158,77 @@ private:
     void addToFilePathMap(const boost::filesystem::path& directory, bool addSubdirectories, const UnicodeString& prefix = "");
     void checkFileExists(const std::string& file) const;
 
+    /// True if the file format is uop and the file exists
+    bool getUopPath(const std::string& file, boost::filesystem::path& path);
+    /// Prefers the uop file if the file format is uop, otherwise looks for the idx and mul pair
+    void getIndexedFilePaths(const std::string& uopFile, const std::string& idxFile, const std::string& mulFile,
+            boost::filesystem::path& idxPath, boost::filesystem::path& mulPath);
+
+    /// Returns an empty pointer if directory is empty, i.e. the decode cache is disabled
+    boost::shared_ptr<DecodeCache> createDecodeCache(const boost::filesystem::path& directory, const std::string& name,
+            const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath);
+
+    /// Returns an empty pointer if the segment can not be used. Named after the art, gump art, texmaps and tiledata files
+    boost::shared_ptr<SharedMemoryCache> createSharedMemoryCache(unsigned int size);
+
+    /// Returns an empty path if the def cache is disabled
+    boost::filesystem::path getDefCachePath(Config& config, const std::string& name) const;
+
+    /// Returns an empty pointer if the pack is missing or was created for different art and texmaps files
+    boost::shared_ptr<TexturePack> loadTexturePack(const boost::filesystem::path& path);
+
+    struct MapFiles {
+        boost::filesystem::path mapPath_;
+        boost::filesystem::path mapDifOffsetsPath_;
+        boost::filesystem::path mapDifPath_;
+
+        boost::filesystem::path staticsIdxPath_;
+        boost::filesystem::path staticsPath_;
+        boost::filesystem::path staticsDifOffsetsPath_;
+        boost::filesystem::path staticsDifIdxPath_;
+        boost::filesystem::path staticsDifPath_;
+
+        bool difsEnabled_;
+        unsigned int blockCountX_;
+        unsigned int blockCountY_;
+    };
+
+    // loader construction, run as StartupTasks by setShardConfig. Each of them only writes its own members
+    void loadTileData(const boost::filesystem::path& path, bool highSeasFormat);
+    void loadHues(const boost::filesystem::path& path);
+    void loadMapTex(const boost::filesystem::path& idxPath, const boost::filesystem::path& path, unsigned int retentionBudget);
+    void loadArt(const boost::filesystem::path& idxPath, const boost::filesystem::path& path,
+            const boost::filesystem::path& decodeCachePath, unsigned int retentionBudget);
+    /// Requires the art and maptex loaders
+    void applyTexturePack(const boost::filesystem::path& path);
+    void loadGumpArt(const boost::filesystem::path& idxPath, const boost::filesystem::path& path,
+            const boost::filesystem::path& decodeCachePath, unsigned int retentionBudget);
+    void loadAnimData(const boost::filesystem::path& path);
+    void loadMap(unsigned int index, const MapFiles& files);
+    void loadStatics(unsigned int index, const MapFiles& files);
+    void loadAnim(unsigned int index, const boost::filesystem::path& idxPath, const boost::filesystem::path& path,
+            unsigned int highDetailCount, unsigned int lowDetailCount, const boost::filesystem::path& decodeCachePath, unsigned int retentionBudget);
+    void loadUniFont(unsigned int index, const boost::filesystem::path& path);
+    void loadSound(const boost::filesystem::path& idxPath, const boost::filesystem::path& path);
+    void loadSkills(const boost::filesystem::path& idxPath, const boost::filesystem::path& path);
+    void loadRadarCol(const boost::filesystem::path& path);
+    template<typename T>
+    void loadDefFile(boost::shared_ptr<DefFileLoader<T> >* loader, const boost::filesystem::path& path, const char* pattern,
+            const boost::filesystem::path& cachePath);
+    template<typename T>
+    void loadStringDefFile(boost::shared_ptr<DefFileLoader<T> >* loader, const boost::filesystem::path& path, const char* pattern,
+            boost::function<void (T&, unsigned int, const char*, int*&)> stringParseFunction, const boost::filesystem::path& cachePath);
+    void loadEquipConvDef(const boost::filesystem::path& path, const boost::filesystem::path& cachePath);
+    void loadSpellbooks(const boost::filesystem::path& path);
+    void loadCliloc(const boost::filesystem::path& path, const boost::filesystem::path& languagePath);
+
+    // created before the loaders, which take it from here
+    boost::shared_ptr<SharedMemoryCache> sharedMemoryCache_;
+
+    // limits for all versions of one file's decode cache, see DecodeCache
+    unsigned int decodeCacheMaxMegabytes_;
+    unsigned int decodeCacheMaxAgeDays_;
+
     boost::shared_ptr<ArtLoader> artLoader_;
     boost::shared_ptr<TileDataLoader> tileDataLoader_;
     boost::shared_ptr<HuesLoader> huesLoader_;
@@ -189,6 +272,9 @@ private:
 
     boost::shared_ptr<Spellbooks> spellbooks_;
 
+    // declared last, so the prefetched animations are released before the loaders
+    boost::shared_ptr<AnimPrefetcher> animPrefetcher_;
+
     void initOverrides();
     void addOverrideDirectory(std::map<unsigned int, boost::filesystem::path>& map, boost::filesystem::path directory);
     std::map<unsigned int, boost::filesystem::path> staticArtOverrides_;
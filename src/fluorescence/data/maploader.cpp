@@ -236,17 +236,10 @@ CL_Vec3f MapLoader::calculateNormal(int8_t tile, int8_t top, int8_t right, int8_
 }
 
 void MapLoader::readCallbackDifOffsets(int8_t* buf, unsigned int len) {
-    unsigned int entryCount = len / 4;
-    uint32_t* ptr = reinterpret_cast<uint32_t*>(buf);
-
-    for (unsigned int i = 0; i < entryCount; ++i) {
-        unsigned int curEntry = *ptr;
-        ptr++;
-        difEntries_[curEntry] = i;
-    }
+    difIndex_.init(reinterpret_cast<uint32_t*>(buf), len / 4, blockCountX_ * blockCountY_);
 }
 
-boost::shared_ptr<world::MapBlock> MapLoader::get(unsigned int x, unsigned int y) {
+boost::shared_ptr<world::MapBlock> MapLoader::get(unsigned int x, unsigned int y, unsigned int priority) {
     if (x >= blockCountX_) {
         x = 0;
     }
@@ -259,14 +252,14 @@ boost::shared_ptr<world::MapBlock> MapLoader::get(unsigned int x, unsigned int y
 
     if (difEnabled_) {
         // check if there is a dif entry for this block
-        std::map<unsigned int, unsigned int>::const_iterator iter = difEntries_.find(idx);
-        if (iter != difEntries_.end()) {
-            return difCache_.get(iter->second, idx);
+        unsigned int difIdx;
+        if (difIndex_.find(idx, difIdx)) {
+            return difCache_.get(difIdx, idx, priority);
         } else {
-            return mulCache_.get(idx, idx);
+            return mulCache_.get(idx, idx, priority);
         }
     } else {
-        return mulCache_.get(idx, idx);
+        return mulCache_.get(idx, idx, priority);
     }
 }
 
@@ -283,9 +276,9 @@ boost::shared_ptr<world::MapBlock> MapLoader::getNoCreate(unsigned int x, unsign
 
     if (difEnabled_) {
         // check if there is a dif entry for this block
-        std::map<unsigned int, unsigned int>::const_iterator iter = difEntries_.find(idx);
-        if (iter != difEntries_.end()) {
-            return difCache_.getNoCreate(iter->second);
+        unsigned int difIdx;
+        if (difIndex_.find(idx, difIdx)) {
+            return difCache_.getNoCreate(difIdx);
         } else {
             return mulCache_.getNoCreate(idx);
         }
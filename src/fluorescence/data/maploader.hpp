@@ -21,6 +21,7 @@
 #define FLUO_MAP_LOADER_HPP
 
 #include "weakptrcache.hpp"
+#include "difindex.hpp"
 #include "fixedsizeondemandfileloader.hpp"
 
 #include <boost/filesystem.hpp>
@@ -46,7 +47,7 @@ public:
 
     void readCallbackDifOffsets(int8_t* buf, unsigned int len);
 
-    boost::shared_ptr<world::MapBlock> get(unsigned int x, unsigned int y);
+    boost::shared_ptr<world::MapBlock> get(unsigned int x, unsigned int y, unsigned int priority = LoadPriority::VISIBLE);
     boost::shared_ptr<world::MapBlock> getNoCreate(unsigned int x, unsigned int y);
 
     unsigned int getBlockCountX();
@@ -58,8 +59,8 @@ private:
     WeakPtrCache<unsigned int, world::MapBlock, FixedSizeOnDemandFileLoader> mulCache_;
     WeakPtrCache<unsigned int, world::MapBlock, FixedSizeOnDemandFileLoader> difCache_;
 
-    // stores block idx - file offset in dif file pairs
-    std::map<unsigned int, unsigned int> difEntries_;
+    // maps block idx to entry in the dif file
+    DifIndex difIndex_;
 
     unsigned int blockCountX_;
     unsigned int blockCountY_;
@@ -28,17 +28,36 @@
 namespace fluo {
 namespace data {
 
-MapTexLoader::MapTexLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath) {
+MapTexLoader::MapTexLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath,
+        boost::shared_ptr<SharedMemoryCache> sharedCache) :
+        sharedCache_(sharedCache) {
 
     boost::shared_ptr<IndexedOnDemandFileLoader<unsigned int, ui::Texture> > loader(new IndexedOnDemandFileLoader<unsigned int, ui::Texture>(idxPath, mulPath,
             boost::bind(&MapTexLoader::readCallback, this, _1, _2, _3, _4, _5, _6)));
+    if (sharedCache_) {
+        loader->setCacheCallback(boost::bind(&MapTexLoader::loadCached, this, _1, _2));
+    }
     cache_.init(loader);
 }
 
 boost::shared_ptr<ui::Texture> MapTexLoader::get(unsigned int id) {
+    if (texturePack_) {
+        boost::shared_ptr<ui::Texture> ret = texturePack_->getTexture(TexturePack::Source::TEXMAP, id);
+        if (ret) {
+            return ret;
+        }
+    }
+
     return cache_.get(id);
 }
 
+bool MapTexLoader::loadCached(unsigned int index, boost::shared_ptr<ui::Texture> tex) {
+    tex->setUsage(ui::Texture::USAGE_WORLD);
+    tex->setBorderWidth(1);
+
+    return sharedCache_->loadTexture(SharedMemoryCache::Source::TEXMAP, index, tex);
+}
+
 void MapTexLoader::readCallback(unsigned int index, int8_t* buf, unsigned int len, boost::shared_ptr<ui::Texture> tex, unsigned int extra, unsigned int userData) {
     tex->setUsage(ui::Texture::USAGE_WORLD);
     tex->setBorderWidth(1);
@@ -46,19 +65,39 @@ void MapTexLoader::readCallback(unsigned int index, int8_t* buf, unsigned int le
     // map textures are always quadratic
     unsigned short width = (extra == 1) ? 128 : 64;
 
+    if (len < width * width * 2u) {
+        LOG_WARN << "Map texture " << index << " too short: len=" << len << " width=" << width << std::endl;
+        tex->setReadFailed();
+        return;
+    }
+
     tex->initPixelBuffer(width, width);
     uint32_t* pixBufPtr = tex->getPixelBufferData();
 
     uint16_t* inputPtr = reinterpret_cast<uint16_t*>(buf);
 
-    for (unsigned int x = 0; x < width; ++x) {
-        for (unsigned int y = 0; y < width; ++y) {
-            uint32_t pixel = Util::getColorRGBA(*inputPtr);
-            ++inputPtr;
-            pixBufPtr[(y * width) + x] = pixel;
+    // the file stores one column after the other. Gather the pixels of one row into a small buffer first, so that
+    // the conversion and the writes to the pixel buffer go row by row instead of jumping to a new line for every pixel
+    uint16_t row[128];
+    for (unsigned int y = 0; y < width; ++y) {
+        for (unsigned int x = 0; x < width; ++x) {
+            row[x] = inputPtr[(x * width) + y];
         }
+        Util::convertRow1555(row, pixBufPtr + (y * width), width);
+    }
+
+    if (sharedCache_) {
+        sharedCache_->storeTexture(SharedMemoryCache::Source::TEXMAP, index, tex);
     }
 }
 
+void MapTexLoader::setRetentionBudget(unsigned int bytes) {
+    cache_.setRetentionBudget(bytes);
+}
+
+void MapTexLoader::setTexturePack(boost::shared_ptr<TexturePack> pack) {
+    texturePack_ = pack;
+}
+
 }
 }
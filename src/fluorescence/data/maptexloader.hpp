@@ -20,8 +20,10 @@
 #ifndef FLUO_DATA_MAPTEXLOADER_HPP
 #define FLUO_DATA_MAPTEXLOADER_HPP
 
-#include "weakptrcache.hpp"
+#include "denseweakptrcache.hpp"
 #include "indexedondemandfileloader.hpp"
+#include "texturepack.hpp"
+#include "sharedmemorycache.hpp"
 
 #include <boost/filesystem.hpp>
 
@@ -35,15 +37,28 @@ namespace data {
 
 class MapTexLoader {
 public:
-    MapTexLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath);
+    MapTexLoader(const boost::filesystem::path& idxPath, const boost::filesystem::path& mulPath,
+            boost::shared_ptr<SharedMemoryCache> sharedCache = boost::shared_ptr<SharedMemoryCache>());
 
 
     boost::shared_ptr<ui::Texture> get(unsigned int id);
 
     void readCallback(unsigned int index, int8_t* buf, unsigned int len, boost::shared_ptr<ui::Texture>, unsigned int extra, unsigned int userData);
+    bool loadCached(unsigned int index, boost::shared_ptr<ui::Texture> tex);
+
+    /// Keeps recently used items in memory up to the given size, see DenseWeakPtrCache::setRetentionBudget
+    void setRetentionBudget(unsigned int bytes);
+
+    /// Textures found in the pack are taken from its atlas pages instead of texmaps.mul
+    void setTexturePack(boost::shared_ptr<TexturePack> pack);
 
 private:
-    WeakPtrCache<unsigned int, ui::Texture, IndexedOnDemandFileLoader> cache_;
+    boost::shared_ptr<TexturePack> texturePack_;
+
+    // declared before the cache, so that it outlives the decode jobs cancelled by the loader destructor
+    boost::shared_ptr<SharedMemoryCache> sharedCache_;
+
+    DenseWeakPtrCache<ui::Texture, IndexedOnDemandFileLoader> cache_;
 };
 
 }
@@ -17,31 +17,57 @@
  */
 
 
+
 #ifndef FLUO_DATA_ONDEMANDFILELOADER_HPP
 #define FLUO_DATA_ONDEMANDFILELOADER_HPP
 
 #include "indexloader.hpp"
+#include "ioscheduler.hpp"
 
 #include <misc/log.hpp>
 #include <misc/exception.hpp>
 
-#include <queue>
-
 #include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/shared_array.hpp>
 #include <boost/function.hpp>
+#include <boost/bind.hpp>
 
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 
-#include <boost/thread.hpp>
-#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <zlib.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace fluo {
 namespace data {
 
 /**
  * \brief Used to load parts of files on demand (e.g. animations, arts, ...)
+ *
+ * If possible, the file is mapped into memory and the read callback receives a pointer directly into the mapping.
+ * If the mapping fails, the loader falls back to reading the requested parts with pread (or a locked stream on windows).
+ * The reads are executed by the io threads of the shared IoScheduler, which then hand the raw data to its decode pool.
+ * The read callback and setReadComplete are called from a decode thread. A read callback that finds the data to be
+ * invalid marks the item with setReadFailed, the item is then not set to read complete.
+ *
+ * Loaders with a cache of decoded items can set a cache callback. It is called on a decode thread before anything
+ * is read, the file is only read if it returns false.
+ *
+ * Entries with a decompressedLength_ (zlib compressed uop entries) are inflated on the decode thread before the
+ * read callback is called.
+ *
+ * The jobs only hold a weak reference to the returned object. If all shared_ptrs to it are released before the job
+ * runs (e.g. because the player moved on), the read and decode steps are skipped.
  */
 template <
 typename KeyType,
@@ -51,145 +77,308 @@ class OnDemandFileLoader {
 public:
 
     typedef boost::function<void (KeyType, int8_t*, unsigned int, boost::shared_ptr<ValueType>, unsigned int, unsigned int)> ReadCallback;
-
-    OnDemandFileLoader(const boost::filesystem::path& path, ReadCallback readCallback) : path_(path), readCallback_(readCallback) {
+    /// Returns true if it filled the item
+    typedef boost::function<bool (KeyType, boost::shared_ptr<ValueType>)> CacheCallback;
+
+    /// allowMapping false always reads with pread/the stream, e.g. to compare both paths
+    OnDemandFileLoader(const boost::filesystem::path& path, ReadCallback readCallback, bool allowMapping = true) :
+            path_(path), fileMapping_(NULL), mappedRegion_(NULL), mappedData_(NULL),
+#ifndef WIN32
+            fileDescriptor_(-1),
+#endif
+            scheduler_(IoScheduler::getSingleton()), readCallback_(readCallback) {
         if (!boost::filesystem::exists(path) || !boost::filesystem::is_regular_file(path)) {
             throw Exception("File not found");
         }
 
-        stream_.open(path, std::ios_base::binary);
-        if (!stream_.is_open()) {
-            throw Exception("Error opening stream");
-        }
-
         fileSize_ = boost::filesystem::file_size(path);
 
-        running_ = true;
-        ioThread_ = new boost::thread(boost::bind(&OnDemandFileLoader::run, this));
+        if (!allowMapping || !mapFile()) {
+#ifdef WIN32
+            stream_.open(path, std::ios_base::binary);
+            if (!stream_.is_open()) {
+                throw Exception("Error opening stream");
+            }
+#else
+            fileDescriptor_ = ::open(path.string().c_str(), O_RDONLY);
+            if (fileDescriptor_ < 0) {
+                throw Exception("Error opening file");
+            }
+#endif
+        }
     }
 
     ~OnDemandFileLoader() {
-        if (ioThread_) {
-            kill();
-            ioThread_->join();
-            delete ioThread_;
-            ioThread_ = NULL;
+        // make sure no job is accessing this loader anymore
+        scheduler_->cancel(this);
+
+        if (mappedRegion_) {
+            delete mappedRegion_;
+            mappedRegion_ = NULL;
+        }
+
+        if (fileMapping_) {
+            delete fileMapping_;
+            fileMapping_ = NULL;
         }
 
+#ifdef WIN32
         if (stream_.is_open()) {
             stream_.close();
         }
+#else
+        if (fileDescriptor_ >= 0) {
+            ::close(fileDescriptor_);
+            fileDescriptor_ = -1;
+        }
+#endif
+    }
+
+    bool isMemoryMapped() const {
+        return mappedData_ != NULL;
     }
 
-    boost::shared_ptr<ValueType> get(KeyType index, const IndexBlock& indexBlock, unsigned int userData) {
+    boost::shared_ptr<ValueType> get(KeyType index, const IndexBlock& indexBlock, unsigned int userData,
+            unsigned int priority = LoadPriority::VISIBLE) {
         // return dummy object, enqueue for decoding
         boost::shared_ptr<ValueType> obj(new ValueType);
+        obj->setLoadPriority(priority);
 
         ReadInformation inf(index, indexBlock, obj, userData);
-        boost::mutex::scoped_lock lock(mutex_);
-        queue_.push(inf);
-        signal_.notify_all();
+        enqueue(inf, obj, priority);
 
         return obj;
     }
 
-    boost::shared_ptr<ValueType> get(KeyType index, unsigned int offset, unsigned int len, unsigned int userData) {
+    boost::shared_ptr<ValueType> get(KeyType index, unsigned int offset, unsigned int len, unsigned int userData,
+            unsigned int priority = LoadPriority::VISIBLE) {
         // return dummy object, enqueue for decoding
         boost::shared_ptr<ValueType> obj(new ValueType);
+        obj->setLoadPriority(priority);
 
         ReadInformation inf(index, offset, len, obj, userData);
-        boost::mutex::scoped_lock lock(mutex_);
-        queue_.push(inf);
-        signal_.notify_all();
+        enqueue(inf, obj, priority);
 
         return obj;
     }
 
-    void kill() {
-        running_ = false;
-        signal_.notify_all();
+    /// Has to be set before the first get
+    void setCacheCallback(const CacheCallback& callback) {
+        cacheCallback_ = callback;
+    }
+
+    /// Moves the queued jobs of an item that is still being loaded up, if the given priority is higher than its current one
+    void raisePriority(const boost::shared_ptr<ValueType>& item, unsigned int priority) {
+        if (item->isReadComplete() || item->isReadFailed() || priority >= item->getLoadPriority()) {
+            return;
+        }
+
+        item->setLoadPriority(priority);
+        scheduler_->raisePriority(this, item.get(), priority);
     }
 
 private:
+    static const unsigned int PAGE_SIZE_ESTIMATE = 4096;
+
     struct ReadInformation {
         KeyType index_;
         unsigned int offset_;
         unsigned int readLen_;
         unsigned int extra_;
-        boost::shared_ptr<ValueType> item_;
+        unsigned int decompressedLength_;
+        boost::weak_ptr<ValueType> item_;
         unsigned int userData_;
 
         ReadInformation() {
         }
 
         ReadInformation(KeyType index, const IndexBlock& indexBlock, boost::shared_ptr<ValueType> item, unsigned int userData) :
-                index_(index), offset_(indexBlock.offset_), readLen_(indexBlock.length_), extra_(indexBlock.extra_), item_(item), userData_(userData) {
+                index_(index), offset_(indexBlock.offset_), readLen_(indexBlock.length_), extra_(indexBlock.extra_),
+                decompressedLength_(indexBlock.decompressedLength_), item_(item),
+                userData_(userData) {
         }
 
         ReadInformation(KeyType index, unsigned int offset, unsigned int readLen, boost::shared_ptr<ValueType> item, unsigned int userData) :
-            index_(index), offset_(offset), readLen_(readLen), extra_(0), item_(item), userData_(userData) {
+            index_(index), offset_(offset), readLen_(readLen), extra_(0), decompressedLength_(0), item_(item), userData_(userData) {
         }
     };
 
-    void run() {
-        unsigned int curBufferSize = 2048;
-        int8_t* buf = reinterpret_cast<int8_t*>(malloc(curBufferSize));
-        while (running_) {
-            ReadInformation next;
-            {
-                boost::mutex::scoped_lock lock(mutex_);
-                if (!queue_.empty()) {
-                    next = queue_.front();
-                    queue_.pop();
-                } else {
-                    signal_.wait(lock);
-                    continue;
-                }
+    bool mapFile() {
+        if (fileSize_ == 0) {
+            // empty files can not be mapped
+            return false;
+        }
+
+        try {
+            fileMapping_ = new boost::interprocess::file_mapping(path_.string().c_str(), boost::interprocess::read_only);
+            mappedRegion_ = new boost::interprocess::mapped_region(*fileMapping_, boost::interprocess::read_only, 0, fileSize_);
+            mappedData_ = reinterpret_cast<int8_t*>(mappedRegion_->get_address());
+        } catch (const boost::interprocess::interprocess_exception& ex) {
+            LOG_WARN << "Unable to map file " << path_ << " into memory, falling back to stream reading: " << ex.what() << std::endl;
+
+            if (mappedRegion_) {
+                delete mappedRegion_;
+                mappedRegion_ = NULL;
             }
 
-            if (next.offset_ == 0xFFFFFFFFu) {
-                // skip this. could be e.g. a static block with no data
-                next.item_->setReadComplete();
-                continue;
+            if (fileMapping_) {
+                delete fileMapping_;
+                fileMapping_ = NULL;
             }
 
-            // trying to read out of file bounds
-            if (next.offset_ > fileSize_ || (next.offset_ + next.readLen_) > fileSize_) {
-                LOG_WARN << "Trying to read out of file bounds in file " << path_ << ", size=" << fileSize_ << " start=" << next.offset_
-                        << " len=" << next.readLen_ << std::endl;
-                continue;
+            mappedData_ = NULL;
+        }
+
+        return mappedData_ != NULL;
+    }
+
+    /// Reads len bytes starting at offset into buf, if the file is not memory mapped
+    bool readFromFile(unsigned int offset, unsigned int len, int8_t* buf) {
+#ifdef WIN32
+        boost::mutex::scoped_lock lock(streamMutex_);
+        stream_.seekg(offset, std::ios_base::beg);
+        stream_.read(reinterpret_cast<char*>(buf), len);
+        return stream_.good();
+#else
+        unsigned int readTotal = 0;
+        while (readTotal < len) {
+            ssize_t readNow = ::pread(fileDescriptor_, buf + readTotal, len - readTotal, offset + readTotal);
+            if (readNow <= 0) {
+                return false;
             }
+            readTotal += readNow;
+        }
+        return true;
+#endif
+    }
+
+    void enqueue(const ReadInformation& inf, const boost::shared_ptr<ValueType>& obj, unsigned int priority) {
+        if (cacheCallback_) {
+            scheduler_->enqueueDecode(this, boost::bind(&OnDemandFileLoader::loadCached, this, inf), priority, obj.get());
+        } else {
+            scheduler_->enqueueRead(this, boost::bind(&OnDemandFileLoader::read, this, inf), priority, obj.get());
+        }
+    }
+
+    void loadCached(const ReadInformation& next) {
+        boost::shared_ptr<ValueType> item = next.item_.lock();
+        if (!item) {
+            return;
+        }
+
+        if (cacheCallback_(next.index_, item)) {
+            item->setReadComplete();
+        } else {
+            scheduler_->enqueueRead(this, boost::bind(&OnDemandFileLoader::read, this, next), item->getLoadPriority(), item.get());
+        }
+    }
 
-            if (next.offset_ != stream_.tellg()) {
-                stream_.seekg(next.offset_, std::ios_base::beg);
+    void read(const ReadInformation& next) {
+        if (next.item_.expired()) {
+            // nobody is interested in this object anymore
+            return;
+        }
+
+        if (next.offset_ == 0xFFFFFFFFu) {
+            // skip this. could be e.g. a static block with no data
+            boost::shared_ptr<ValueType> item = next.item_.lock();
+            if (item) {
+                item->setReadComplete();
+            }
+            return;
+        }
+
+        // trying to read out of file bounds
+        if (next.offset_ > fileSize_ || (next.offset_ + next.readLen_) > fileSize_) {
+            LOG_WARN << "Trying to read out of file bounds in file " << path_ << ", size=" << fileSize_ << " start=" << next.offset_
+                    << " len=" << next.readLen_ << std::endl;
+            setReadFailed(next);
+            return;
+        }
+
+        if (mappedData_) {
+            // touch every page, so that the decode thread does not have to wait for the disk
+            volatile int8_t touch = 0;
+            for (unsigned int pageOffset = 0; pageOffset < next.readLen_; pageOffset += PAGE_SIZE_ESTIMATE) {
+                touch += mappedData_[next.offset_ + pageOffset];
             }
 
-            if (next.readLen_ > curBufferSize) {
-                //printf("Resizing buffer to %u\n", next.readLen_ * 2);
-                buf = reinterpret_cast<int8_t*>(realloc(buf, next.readLen_ * 2));
-                curBufferSize = next.readLen_;
+            // the mapping is read only, but the callbacks only copy data out of the buffer anyway
+            enqueueDecode(next, mappedData_ + next.offset_, boost::shared_array<int8_t>());
+            return;
+        }
+
+        boost::shared_array<int8_t> buf(new int8_t[next.readLen_]);
+        if (readFromFile(next.offset_, next.readLen_, buf.get())) {
+            enqueueDecode(next, buf.get(), buf);
+        } else {
+            LOG_WARN << "Error reading from file " << path_ << ", start=" << next.offset_ << " len=" << next.readLen_ << std::endl;
+            setReadFailed(next);
+        }
+    }
+
+    /// Uses the current priority of the item, it might have been raised while the item was read
+    void enqueueDecode(const ReadInformation& next, int8_t* buf, boost::shared_array<int8_t> ownedBuffer) {
+        boost::shared_ptr<ValueType> item = next.item_.lock();
+        if (item) {
+            scheduler_->enqueueDecode(this, boost::bind(&OnDemandFileLoader::decode, this, next, buf, ownedBuffer), item->getLoadPriority(), item.get());
+        }
+    }
+
+    /// Lets anybody waiting for the item know that it will never be read complete
+    void setReadFailed(const ReadInformation& next) {
+        boost::shared_ptr<ValueType> item = next.item_.lock();
+        if (item) {
+            item->setReadFailed();
+        }
+    }
+
+    /// ownedBuffer keeps the data alive if it was not taken directly from the memory mapping
+    void decode(const ReadInformation& next, int8_t* buf, boost::shared_array<int8_t> ownedBuffer) {
+        boost::shared_ptr<ValueType> item = next.item_.lock();
+        if (!item) {
+            return;
+        }
+
+        if (next.decompressedLength_ != 0) {
+            boost::shared_array<int8_t> decompressed(new int8_t[next.decompressedLength_]);
+            uLongf decompressedLength = next.decompressedLength_;
+            int err = uncompress(reinterpret_cast<Bytef*>(decompressed.get()), &decompressedLength, reinterpret_cast<const Bytef*>(buf), next.readLen_);
+            if (err != Z_OK) {
+                LOG_WARN << "Error decompressing data from file " << path_ << ", start=" << next.offset_ << " len=" << next.readLen_ << std::endl;
+                item->setReadFailed();
+                return;
             }
 
-            //printf("decode thread read %u bytes from %u\n", next.readLen_, next.offset_);
-            stream_.read(reinterpret_cast<char*>(buf), next.readLen_);
-            readCallback_(next.index_, buf, next.readLen_, next.item_, next.extra_, next.userData_);
-            next.item_->setReadComplete();
+            readCallback_(next.index_, decompressed.get(), decompressedLength, item, next.extra_, next.userData_);
+        } else {
+            readCallback_(next.index_, buf, next.readLen_, item, next.extra_, next.userData_);
+        }
+
+        // the callback calls setReadFailed itself if the data is invalid
+        if (!item->isReadFailed()) {
+            item->setReadComplete();
         }
     }
 
     boost::filesystem::path path_;
+    unsigned int fileSize_;
 
-    boost::thread* ioThread_;
-    bool running_;
-    boost::condition_variable signal_;
-    boost::mutex mutex_;
+    boost::interprocess::file_mapping* fileMapping_;
+    boost::interprocess::mapped_region* mappedRegion_;
+    int8_t* mappedData_;
 
+#ifdef WIN32
     boost::filesystem::ifstream stream_;
-    unsigned int fileSize_;
+    boost::mutex streamMutex_;
+#else
+    int fileDescriptor_;
+#endif
 
-    std::queue<ReadInformation> queue_;
+    boost::shared_ptr<IoScheduler> scheduler_;
 
     ReadCallback readCallback_;
+    CacheCallback cacheCallback_;
 };
 
 }
@@ -0,0 +1,130 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FLUO_DATA_ONDEMANDHTTPLOADER_HPP
+#define FLUO_DATA_ONDEMANDHTTPLOADER_HPP
+
+#include "workerpool.hpp"
+#include "ioscheduler.hpp"
+#include "httpdownloader.hpp"
+
+#include <misc/log.hpp>
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+
+namespace fluo {
+namespace data {
+
+/**
+ * \brief Used to load objects from http/ftp/file urls on demand (e.g. gumps provided by the shard)
+ *
+ * Downloads are handed to a HttpDownloader. The read callback is called with the downloaded bytes on the decode pool of
+ * the shared IoScheduler, so that decoding a large image does not hold back the other transfers. Like with
+ * OnDemandFileLoader, a read callback that finds the data to be invalid marks the item with setReadFailed.
+ * Failed downloads are marked the same way. Items that are no longer referenced when their turn comes are not downloaded
+ * at all.
+ */
+template <
+typename UrlType,
+typename ValueType
+>
+class OnDemandHttpLoader {
+public:
+    typedef boost::function<void (const UrlType&, boost::shared_ptr<ValueType>, const std::vector<int8_t>&)> ReadCallback;
+
+    OnDemandHttpLoader(ReadCallback callback, unsigned int maxConnections = 4) :
+            scheduler_(IoScheduler::getSingleton()), callback_(callback), downloader_(maxConnections) {
+    }
+
+    ~OnDemandHttpLoader() {
+        // no new decode jobs after this, then wait for the queued ones
+        downloader_.stop();
+        scheduler_->cancel(this);
+    }
+
+    boost::shared_ptr<ValueType> get(const UrlType& url, unsigned int userData, unsigned int priority = LoadPriority::VISIBLE) {
+        // return dummy object, enqueue for download
+        boost::shared_ptr<ValueType> obj(new ValueType());
+        boost::weak_ptr<ValueType> weakObj(obj);
+
+        downloader_.enqueue(url,
+                boost::bind(&OnDemandHttpLoader::onDownloaded, this, url, weakObj, _1, _2),
+                boost::bind(&OnDemandHttpLoader::isWanted, weakObj),
+                priority);
+        obj->setLoadPriority(priority);
+
+        return obj;
+    }
+
+    /// Downloads are queued by url, a download that is already queued keeps its priority
+    void raisePriority(const boost::shared_ptr<ValueType>& item, unsigned int priority) {
+    }
+
+    HttpDownloader& getDownloader() {
+        return downloader_;
+    }
+
+private:
+    boost::shared_ptr<IoScheduler> scheduler_;
+    ReadCallback callback_;
+
+    // declared last, so that the download thread is stopped before anything it uses is destroyed
+    HttpDownloader downloader_;
+
+    static bool isWanted(boost::weak_ptr<ValueType> item) {
+        return !item.expired();
+    }
+
+    void onDownloaded(const UrlType& url, boost::weak_ptr<ValueType> weakItem, const std::vector<int8_t>& data, bool success) {
+        boost::shared_ptr<ValueType> item = weakItem.lock();
+        if (!item) {
+            return;
+        }
+
+        if (!success) {
+            LOG_ERROR << "Unable to load url " << url << std::endl;
+            item->setReadFailed();
+            return;
+        }
+
+        // the download buffer belongs to the transfer, the decode job needs its own copy
+        boost::shared_ptr<std::vector<int8_t> > buffer(new std::vector<int8_t>(data));
+        scheduler_->enqueueDecode(this, boost::bind(&OnDemandHttpLoader::decode, this, url, weakItem, buffer),
+                item->getLoadPriority(), item.get());
+    }
+
+    void decode(const UrlType& url, boost::weak_ptr<ValueType> weakItem, boost::shared_ptr<std::vector<int8_t> > data) {
+        boost::shared_ptr<ValueType> item = weakItem.lock();
+        if (!item) {
+            return;
+        }
+
+        callback_(url, item, *data);
+    }
+};
+
+}
+}
+
+#endif
@@ -20,37 +20,147 @@
 #ifndef FLUO_DATA_ONDEMANDREADABLE_HPP
 #define FLUO_DATA_ONDEMANDREADABLE_HPP
 
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
 #include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+
+#include "completionqueue.hpp"
 
 namespace fluo {
 namespace data {
 
+/**
+ * \brief Base class for objects filled by a loader thread
+ *
+ * setReadComplete or setReadFailed is called from the loader thread, isReadComplete and isReadFailed can be called from
+ * any thread.
+ * Objects waiting for the read register a listener on the main thread, the listeners are called from
+ * CompletionQueue::drain in the main loop.
+ */
 template<class T>
 class OnDemandReadable {
 public:
     typedef boost::function<void ()> Callback;
-    
-    OnDemandReadable() : readComplete_(false) { }
-    
-    void setReadComplete() { 
-        readComplete_ = true; 
-        
-        if (completeCallback_) {
-            completeCallback_();
+
+    OnDemandReadable() : readComplete_(false), readFailed_(false), hasListeners_(false), notifyPosted_(false), memoryUsage_(0),
+            loadPriority_(0) { }
+
+    void setReadComplete() {
+        readComplete_.store(true);
+
+        if (hasListeners_.load()) {
+            postNotify();
         }
     }
-    
-    bool isReadComplete() { 
-        return readComplete_; 
+
+    bool isReadComplete() {
+        return readComplete_.load(std::memory_order_acquire);
+    }
+
+    /// Set instead of setReadComplete if the data could not be read or decoded. Listeners are called as well
+    void setReadFailed() {
+        readFailed_.store(true);
+
+        if (hasListeners_.load()) {
+            postNotify();
+        }
+    }
+
+    bool isReadFailed() {
+        return readFailed_.load(std::memory_order_acquire);
+    }
+
+    /// The LoadPriority the loader works on this object with. Set by the loader, see OnDemandFileLoader::raisePriority
+    unsigned int getLoadPriority() const {
+        return loadPriority_.load();
+    }
+
+    void setLoadPriority(unsigned int priority) {
+        loadPriority_.store(priority);
+    }
+
+    /**
+     * Main thread only. The callback is called from CompletionQueue::drain once the read is complete or failed, or
+     * right away if it already is. Callbacks have to check isReadFailed. Owners that are destroyed earlier have to
+     * call removeCompleteListeners
+     */
+    void addCompleteListener(const void* owner, const Callback& callback) {
+        if (isReadComplete() || isReadFailed()) {
+            callback();
+            return;
+        }
+
+        // the list is created before hasListeners_ is set, loader threads only read the pointer after seeing the flag
+        if (!listeners_) {
+            listeners_.reset(new ListenerList());
+        }
+        listeners_->push_back(Listener(owner, callback));
+        hasListeners_.store(true);
+
+        // the loader thread might have missed hasListeners_. Both sides use sequentially consistent accesses, so at
+        // least one of them sees the other's store
+        if (readComplete_.load() || readFailed_.load()) {
+            postNotify();
+        }
+    }
+
+    /// Main thread only
+    void removeCompleteListeners(const void* owner) {
+        if (listeners_) {
+            listeners_->erase(std::remove_if(listeners_->begin(), listeners_->end(),
+                    boost::bind(&Listener::owner_, _1) == owner), listeners_->end());
+        }
+    }
+
+    /// Rough estimate of the memory held by this object in bytes, used to enforce cache budgets
+    unsigned int getMemoryUsage() const {
+        return memoryUsage_;
+    }
+
+    void setMemoryUsage(unsigned int bytes) {
+        memoryUsage_ = bytes;
     }
-    
-    void setCompleteCallback(Callback cb) { completeCallback_ = cb; }
 
 private:
-    bool readComplete_;
-    
-    Callback completeCallback_;
+    struct Listener {
+        const void* owner_;
+        Callback callback_;
+
+        Listener(const void* owner, const Callback& callback) : owner_(owner), callback_(callback) {
+        }
+    };
+    typedef std::vector<Listener> ListenerList;
+
+    std::atomic<bool> readComplete_;
+    std::atomic<bool> readFailed_;
+    std::atomic<bool> hasListeners_;
+    // set by whoever posts the notification first, setReadComplete, setReadFailed or addCompleteListener
+    std::atomic<bool> notifyPosted_;
+    unsigned int memoryUsage_;
+    std::atomic<unsigned int> loadPriority_;
+
+    // only touched by the main thread, except for copying the pointer in postNotify. Outlives this object if a
+    // notification is still queued
+    boost::shared_ptr<ListenerList> listeners_;
+
+    void postNotify() {
+        if (!notifyPosted_.exchange(true)) {
+            CompletionQueue::getSingleton()->post(boost::bind(&OnDemandReadable::notifyListeners, listeners_));
+        }
+    }
+
+    static void notifyListeners(boost::shared_ptr<ListenerList> listeners) {
+        // one at a time, a callback might remove the listeners of another owner
+        while (!listeners->empty()) {
+            Callback callback = listeners->front().callback_;
+            listeners->erase(listeners->begin());
+            callback();
+        }
+    }
 };
 
 }
@@ -21,6 +21,7 @@
 #define FLUO_DATA_ONDEMANDURLLOADER_HPP
 
 #include "indexloader.hpp"
+#include "workerpool.hpp"
 
 #include <misc/log.hpp>
 #include <misc/exception.hpp>
@@ -65,7 +66,8 @@ public:
         }
     }
 
-    boost::shared_ptr<ValueType> get(const UrlType& url, unsigned int userData) {
+    /// All urls are loaded in request order by a single thread, the priority is ignored
+    boost::shared_ptr<ValueType> get(const UrlType& url, unsigned int userData, unsigned int priority = LoadPriority::VISIBLE) {
         // return dummy object, enqueue for decoding
         boost::shared_ptr<ValueType> obj(new ValueType());
 
@@ -77,6 +79,9 @@ public:
         return obj;
     }
 
+    void raisePriority(const boost::shared_ptr<ValueType>& item, unsigned int priority) {
+    }
+
     void kill() {
         running_ = false;
         signal_.notify_all();
@@ -48,10 +48,8 @@ void RadarColLoader::readCallback(int8_t* buf, unsigned int len) {
 
     uint16_t* ptr = reinterpret_cast<uint16_t*>(buf);
 
-    for (unsigned int i = 0; i < colorCount_; ++i) {
-        colors_[i] = Util::getColorRGBA(*ptr);
-        ++ptr;
-    }
+    Util::convertRow1555(ptr, colors_, colorCount_);
+    ptr += colorCount_;
 
     LOG_DEBUG << "Total read bytes: " << (reinterpret_cast<int8_t*>(ptr) - buf) << " len: " << len << std::endl;
 }
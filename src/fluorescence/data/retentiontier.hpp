@@ -0,0 +1,269 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FLUO_DATA_RETENTIONTIER_HPP
+#define FLUO_DATA_RETENTIONTIER_HPP
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/bind.hpp>
+
+#include <list>
+#include <map>
+#include <algorithm>
+
+namespace fluo {
+namespace data {
+
+/**
+ * \brief Keeps strong references to the most recently used items of a cache, up to a byte budget
+ *
+ * The size of an item is taken from OnDemandReadable::getMemoryUsage once the item is read completely.
+ * Items that are still loading are only referenced weakly, so that the tier does not keep a load alive that nobody
+ * waits for anymore. They are pinned and count against the budget once their complete listener is called. Loading
+ * items that fail or are dropped by everyone else are moved to the back, to be evicted first.
+ * A budget of 0 disables the tier. Main thread only.
+ *
+ * The owning cache stores the Handle returned by insert next to its own entry, so that touching an item does not
+ * require a lookup. After inserting, the cache has to call evictOldest as long as isOverBudget returns true and
+ * forget the handles of the returned keys.
+ */
+template <
+typename KeyType,
+typename ValueType
+>
+class RetentionTier {
+private:
+    struct Entry;
+    typedef std::list<Entry> ListType;
+
+public:
+    typedef typename ListType::iterator Handle;
+
+    RetentionTier() : budget_(0), usedBytes_(0), evictionCount_(0), nextPendingId_(0), deadCount_(0), sweepThreshold_(MIN_SWEEP_THRESHOLD), self_(new RetentionTier*(this)) {
+    }
+
+    void setBudget(unsigned int bytes) {
+        budget_ = bytes;
+    }
+
+    bool isEnabled() const {
+        return budget_ > 0;
+    }
+
+    /// Adds an item as the most recently used one
+    Handle insert(const KeyType& id, const boost::shared_ptr<ValueType>& item) {
+        dropExpired();
+
+        lru_.push_front(Entry(id));
+        Handle handle = lru_.begin();
+
+        if (item->isReadComplete()) {
+            settle(handle, item);
+        } else if (item->isReadFailed()) {
+            kill(handle);
+        } else {
+            handle->pendingItem_ = item;
+            unsigned int pendingId = nextPendingId_++;
+            handle->pendingIter_ = pending_.insert(std::make_pair(pendingId, handle)).first;
+            item->addCompleteListener(this, boost::bind(&RetentionTier::onItemComplete, boost::weak_ptr<RetentionTier*>(self_), pendingId));
+        }
+
+        return handle;
+    }
+
+    /// Marks an item as the most recently used one
+    void touch(Handle handle) {
+        if (!handle->dead_) {
+            lru_.splice(lru_.begin(), lru_, handle);
+        }
+    }
+
+    /// True if the tier holds a strong reference to the item, false while it is loading
+    bool isPinned(Handle handle) const {
+        return handle->item_.get() != NULL;
+    }
+
+    void remove(Handle handle) {
+        if (handle->dead_) {
+            --deadCount_;
+        } else if (handle->sized_) {
+            usedBytes_ -= handle->size_;
+        } else {
+            pending_.erase(handle->pendingIter_);
+
+            boost::shared_ptr<ValueType> item = handle->pendingItem_.lock();
+            if (item) {
+                item->removeCompleteListeners(this);
+            }
+        }
+        lru_.erase(handle);
+    }
+
+    /// True if the items exceed the budget or dropped entries wait to be evicted. The most recently used item is only
+    /// evicted if the tier is disabled
+    bool isOverBudget() const {
+        if (budget_ == 0 || deadCount_ > 0) {
+            return !lru_.empty();
+        }
+
+        return lru_.size() > 1 && usedBytes_ > budget_;
+    }
+
+    /// Removes the least recently used item and returns its key
+    KeyType evictOldest() {
+        Handle oldest = lru_.end();
+        --oldest;
+        KeyType ret = oldest->key_;
+        if (!oldest->dead_) {
+            ++evictionCount_;
+        }
+        remove(oldest);
+        return ret;
+    }
+
+    void clear() {
+        lru_.clear();
+        pending_.clear();
+        usedBytes_ = 0;
+        deadCount_ = 0;
+    }
+
+    /// Loading items that are still waiting for their complete listener
+    unsigned int getPendingCount() const {
+        return pending_.size();
+    }
+
+    unsigned int getBudget() const {
+        return budget_;
+    }
+
+    unsigned int getUsedBytes() const {
+        return usedBytes_;
+    }
+
+    unsigned int getItemCount() const {
+        return lru_.size();
+    }
+
+    unsigned int getEvictionCount() const {
+        return evictionCount_;
+    }
+
+private:
+    RetentionTier(const RetentionTier& copy) { }
+    RetentionTier& operator=(const RetentionTier& copy) { return *this; }
+
+    typedef std::map<unsigned int, Handle> PendingMapType;
+
+    struct Entry {
+        Entry(const KeyType& key) : key_(key), size_(0), sized_(false), dead_(false) {
+        }
+
+        KeyType key_;
+        boost::shared_ptr<ValueType> item_; ///< Empty while the item is loading
+        boost::weak_ptr<ValueType> pendingItem_; ///< Only set while the item is loading
+        unsigned int size_;
+        bool sized_;
+        bool dead_; ///< Failed or expired while loading, waits at the back to be evicted
+        typename PendingMapType::iterator pendingIter_; ///< Only valid while the item is loading
+    };
+
+    unsigned int budget_;
+    unsigned int usedBytes_;
+    unsigned int evictionCount_;
+
+    ListType lru_; ///< Most recently used item at the front
+    PendingMapType pending_; ///< Items that were not completely read when they were added, by the id given to their listener
+    unsigned int nextPendingId_;
+    unsigned int deadCount_;
+
+    enum { MIN_SWEEP_THRESHOLD = 64 };
+    unsigned int sweepThreshold_; ///< pending_ is only scanned for expired items when it grew to this size
+
+    // the complete listeners only hold a weak reference, they might be called after the tier is destroyed
+    boost::shared_ptr<RetentionTier*> self_;
+
+    /// Pins the item and adds its size
+    void settle(Handle handle, const boost::shared_ptr<ValueType>& item) {
+        handle->item_ = item;
+        handle->size_ = (std::max)(item->getMemoryUsage(), (unsigned int)sizeof(ValueType));
+        handle->sized_ = true;
+        usedBytes_ += handle->size_;
+    }
+
+    /// The entry holds nothing anymore, evictOldest returns it before any other
+    void kill(Handle handle) {
+        handle->dead_ = true;
+        ++deadCount_;
+        lru_.splice(lru_.end(), lru_, handle);
+    }
+
+    void dropPending(Handle handle) {
+        pending_.erase(handle->pendingIter_);
+        handle->pendingItem_.reset();
+        kill(handle);
+    }
+
+    /// Items destroyed while loading never call their listener. They are looked for whenever the pending items doubled
+    void dropExpired() {
+        if (pending_.size() < sweepThreshold_) {
+            return;
+        }
+
+        typename PendingMapType::iterator iter = pending_.begin();
+        while (iter != pending_.end()) {
+            Handle handle = iter->second;
+            ++iter;
+            if (handle->pendingItem_.expired()) {
+                dropPending(handle);
+            }
+        }
+
+        sweepThreshold_ = (std::max)((unsigned int)MIN_SWEEP_THRESHOLD, (unsigned int)pending_.size() * 2);
+    }
+
+    static void onItemComplete(boost::weak_ptr<RetentionTier*> weakTier, unsigned int pendingId) {
+        boost::shared_ptr<RetentionTier*> tier = weakTier.lock();
+        if (!tier) {
+            return;
+        }
+
+        // the entry might have been evicted or removed in the meantime
+        typename PendingMapType::iterator iter = (*tier)->pending_.find(pendingId);
+        if (iter == (*tier)->pending_.end()) {
+            return;
+        }
+
+        Handle handle = iter->second;
+        boost::shared_ptr<ValueType> item = handle->pendingItem_.lock();
+        if (item && !item->isReadFailed()) {
+            (*tier)->pending_.erase(iter);
+            handle->pendingItem_.reset();
+            (*tier)->settle(handle, item);
+        } else {
+            (*tier)->dropPending(handle);
+        }
+    }
+};
+
+}
+}
+
+#endif
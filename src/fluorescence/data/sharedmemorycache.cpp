@@ -0,0 +1,482 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "sharedmemorycache.hpp"
+
+#include <boost/thread/thread.hpp>
+
+#include <atomic>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <dirent.h>
+#endif
+
+#include <ui/texture.hpp>
+#include <misc/log.hpp>
+#include <misc/exception.hpp>
+
+namespace fluo {
+namespace data {
+
+#ifndef WIN32
+
+namespace {
+// increase whenever the layout of the segment or of an entry changes
+const unsigned int FORMAT_VERSION = 2;
+
+const uint32_t MAGIC = 0x464C5348; // FLSH
+const uint32_t STATE_READY = 1;
+
+// enough for all art, gump and texmap ids at a load of about 70%
+const unsigned int SLOT_COUNT = 1 << 18;
+const unsigned int MAX_ENTRY_COUNT = SLOT_COUNT / 4 * 3;
+
+const unsigned int SEGMENT_PAGE_SIZE = 4096;
+const unsigned int ENTRY_ALIGNMENT = 16;
+
+// time for the creator to set up the header, before the segment is considered broken
+const unsigned int WAIT_TIMEOUT_MS = 2000;
+const unsigned int WAIT_STEP_MS = 10;
+
+// clients beyond this number still use the segment, but do not keep it from being removed
+const unsigned int MAX_OWNER_COUNT = 64;
+
+const char* SEGMENT_DIRECTORY = "/dev/shm";
+
+uint64_t makeKey(unsigned int source, unsigned int id) {
+    return (static_cast<uint64_t>(source) << 32) | id;
+}
+
+bool isProcessAlive(uint32_t pid) {
+    // EPERM: the process exists, but belongs to another user
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+}
+
+// a fresh segment is filled with zeros, which is a valid initial value for all fields
+struct SharedMemoryCache::Header {
+    uint32_t magic_;
+    uint32_t version_;
+    uint32_t dataSize_;
+    std::atomic<uint32_t> state_;
+    std::atomic<uint32_t> entryCount_;
+    std::atomic<uint32_t> full_;
+    std::atomic<uint64_t> used_;
+    // pids of the attached clients, 0 if unused
+    std::atomic<uint32_t> owners_[MAX_OWNER_COUNT];
+};
+
+struct SharedMemoryCache::Slot {
+    std::atomic<uint64_t> key_;
+    // offset / ENTRY_ALIGNMENT + 1 in the upper, size in the lower half. 0 while the entry is being written
+    std::atomic<uint64_t> value_;
+};
+
+namespace {
+const unsigned int SLOTS_OFFSET = SEGMENT_PAGE_SIZE;
+const unsigned int DATA_OFFSET = SLOTS_OFFSET + SLOT_COUNT * 16;
+}
+
+SharedMemoryCache::SharedMemoryCache(uint64_t dataHash, unsigned int size) :
+        fd_(-1), mapping_(NULL), mappingSize_(0), header_(NULL), slots_(NULL), data_(NULL), ownerIndex_(MAX_OWNER_COUNT) {
+    static_assert(sizeof(Header) <= SEGMENT_PAGE_SIZE, "SharedMemoryCache header does not fit in the first page");
+    static_assert(sizeof(Slot) == 16, "Unexpected SharedMemoryCache slot size");
+
+    unsigned int dataSize = (size + SEGMENT_PAGE_SIZE - 1) / SEGMENT_PAGE_SIZE * SEGMENT_PAGE_SIZE;
+
+    std::stringstream ss;
+    ss << "/fluo-" << std::hex << std::setw(16) << std::setfill('0') << dataHash << "-" << dataSize << "-" << FORMAT_VERSION;
+    name_ = ss.str();
+
+    removeStaleSegments();
+
+    // another client might create or remove the segment in between
+    for (unsigned int attempt = 0; attempt < 3 && !header_; ++attempt) {
+        if (open(false, DATA_OFFSET + dataSize)) {
+            break;
+        }
+
+        if (open(true, DATA_OFFSET + dataSize)) {
+            initSegment(dataSize);
+        }
+    }
+
+    if (!header_) {
+        throw Exception("Unable to open shared memory cache");
+    }
+
+    uint32_t pid = getpid();
+    for (unsigned int i = 0; i < MAX_OWNER_COUNT && ownerIndex_ == MAX_OWNER_COUNT; ++i) {
+        uint32_t expected = 0;
+        if (header_->owners_[i].compare_exchange_strong(expected, pid)) {
+            ownerIndex_ = i;
+        }
+    }
+
+    if (ownerIndex_ == MAX_OWNER_COUNT) {
+        LOG_WARN << "Shared memory cache " << name_ << " has too many clients, the segment might be removed while in use" << std::endl;
+    }
+
+    unsigned int clientCount = releaseDeadOwners(header_);
+    LOG_INFO << "Shared memory cache " << name_ << ": clients=" << clientCount << " entries=" << header_->entryCount_.load()
+            << " used=" << header_->used_.load() << std::endl;
+}
+
+SharedMemoryCache::~SharedMemoryCache() {
+    if (header_) {
+        LOG_DEBUG << "Shared memory cache " << name_ << ": entries=" << header_->entryCount_.load() << " used=" << header_->used_.load() << std::endl;
+
+        if (ownerIndex_ < MAX_OWNER_COUNT) {
+            header_->owners_[ownerIndex_].store(0);
+        }
+
+        if (releaseDeadOwners(header_) == 0) {
+            // clients attaching right now keep their mapping, later ones create a new segment
+            shm_unlink(name_.c_str());
+        }
+    }
+
+    if (mapping_) {
+        munmap(mapping_, mappingSize_);
+    }
+
+    if (fd_ != -1) {
+        close(fd_);
+    }
+}
+
+bool SharedMemoryCache::open(bool create, unsigned int mappingSize) {
+    int fd = shm_open(name_.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0600);
+    if (fd == -1) {
+        if (errno == ENOENT || errno == EEXIST) {
+            return false;
+        }
+
+        LOG_ERROR << "Unable to open shared memory segment " << name_ << ": " << strerror(errno) << std::endl;
+        throw Exception("Unable to open shared memory cache");
+    }
+
+    fd_ = fd;
+    bool success = create ? ftruncate(fd_, mappingSize) == 0 : waitForSegment(mappingSize);
+
+    if (success) {
+        void* mapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (mapping == MAP_FAILED) {
+            LOG_ERROR << "Unable to map shared memory segment " << name_ << ": " << strerror(errno) << std::endl;
+            success = false;
+        } else {
+            mapping_ = reinterpret_cast<int8_t*>(mapping);
+            mappingSize_ = mappingSize;
+
+            // entries are written through the file descriptor only, so nobody can modify published data by accident
+            mprotect(mapping_ + DATA_OFFSET, mappingSize - DATA_OFFSET, PROT_READ);
+        }
+    }
+
+    if (!success) {
+        if (create) {
+            shm_unlink(name_.c_str());
+        }
+        close(fd_);
+        fd_ = -1;
+        throw Exception("Unable to open shared memory cache");
+    }
+
+    if (create) {
+        header_ = reinterpret_cast<Header*>(mapping_);
+    } else {
+        Header* header = reinterpret_cast<Header*>(mapping_);
+        unsigned int waited = 0;
+        while (header->state_.load() != STATE_READY && waited < WAIT_TIMEOUT_MS) {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(WAIT_STEP_MS));
+            waited += WAIT_STEP_MS;
+        }
+
+        if (header->state_.load() != STATE_READY || header->magic_ != MAGIC || header->version_ != FORMAT_VERSION) {
+            // the creator probably crashed while setting it up
+            LOG_WARN << "Removing broken shared memory segment " << name_ << std::endl;
+            shm_unlink(name_.c_str());
+            munmap(mapping_, mappingSize_);
+            mapping_ = NULL;
+            close(fd_);
+            fd_ = -1;
+            throw Exception("Broken shared memory cache");
+        }
+
+        header_ = header;
+    }
+
+    slots_ = reinterpret_cast<Slot*>(mapping_ + SLOTS_OFFSET);
+    data_ = mapping_ + DATA_OFFSET;
+    return true;
+}
+
+bool SharedMemoryCache::waitForSegment(unsigned int mappingSize) {
+    // the creator sets the size right after creating the segment
+    struct stat fileStat;
+    for (unsigned int waited = 0; waited < WAIT_TIMEOUT_MS; waited += WAIT_STEP_MS) {
+        if (fstat(fd_, &fileStat) != 0) {
+            return false;
+        }
+
+        if (fileStat.st_size == static_cast<off_t>(mappingSize)) {
+            return true;
+        } else if (fileStat.st_size != 0) {
+            LOG_ERROR << "Shared memory segment " << name_ << " has an unexpected size" << std::endl;
+            return false;
+        }
+
+        boost::this_thread::sleep(boost::posix_time::milliseconds(WAIT_STEP_MS));
+    }
+
+    return false;
+}
+
+void SharedMemoryCache::initSegment(unsigned int dataSize) {
+    header_->magic_ = MAGIC;
+    header_->version_ = FORMAT_VERSION;
+    header_->dataSize_ = dataSize;
+    // registered before the segment is ready, so that removeStaleSegments of other clients does not remove it
+    header_->owners_[0].store(getpid());
+    ownerIndex_ = 0;
+    header_->state_.store(STATE_READY);
+
+    LOG_INFO << "Created shared memory segment " << name_ << std::endl;
+}
+
+unsigned int SharedMemoryCache::releaseDeadOwners(Header* header) {
+    unsigned int aliveCount = 0;
+    for (unsigned int i = 0; i < MAX_OWNER_COUNT; ++i) {
+        uint32_t pid = header->owners_[i].load();
+        if (pid == 0) {
+            continue;
+        }
+
+        if (isProcessAlive(pid)) {
+            ++aliveCount;
+        } else {
+            // a client that crashed, or was killed before detaching
+            header->owners_[i].compare_exchange_strong(pid, 0);
+        }
+    }
+
+    return aliveCount;
+}
+
+void SharedMemoryCache::removeStaleSegments() {
+    // segments of other data files are never opened again, so nobody would notice that their clients are gone
+    DIR* dir = opendir(SEGMENT_DIRECTORY);
+    if (!dir) {
+        return;
+    }
+
+    std::stringstream ss;
+    ss << "-" << FORMAT_VERSION;
+    std::string versionSuffix = ss.str();
+
+    std::vector<std::string> names;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        std::string name(entry->d_name);
+        if (name.compare(0, 5, "fluo-") == 0 && name.size() > versionSuffix.size() &&
+                name.compare(name.size() - versionSuffix.size(), versionSuffix.size(), versionSuffix) == 0 && "/" + name != name_) {
+            names.push_back("/" + name);
+        }
+    }
+    closedir(dir);
+
+    for (unsigned int i = 0; i < names.size(); ++i) {
+        int fd = shm_open(names[i].c_str(), O_RDWR, 0600);
+        if (fd == -1) {
+            continue;
+        }
+
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) == 0 && fileStat.st_size >= static_cast<off_t>(DATA_OFFSET)) {
+            void* mapping = mmap(NULL, SEGMENT_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (mapping != MAP_FAILED) {
+                Header* header = reinterpret_cast<Header*>(mapping);
+                // segments still being set up are left alone
+                if (header->magic_ == MAGIC && header->version_ == FORMAT_VERSION && header->state_.load() == STATE_READY &&
+                        releaseDeadOwners(header) == 0) {
+                    LOG_INFO << "Removing stale shared memory segment " << names[i] << std::endl;
+                    shm_unlink(names[i].c_str());
+                }
+                munmap(mapping, SEGMENT_PAGE_SIZE);
+            }
+        }
+
+        close(fd);
+    }
+}
+
+SharedMemoryCache::Slot* SharedMemoryCache::findSlot(uint64_t key) const {
+    unsigned int index = (key * 0x9E3779B97F4A7C15ULL) >> 46;
+    for (unsigned int i = 0; i < SLOT_COUNT; ++i) {
+        Slot* slot = &slots_[(index + i) % SLOT_COUNT];
+        uint64_t slotKey = slot->key_.load();
+        if (slotKey == key || slotKey == 0) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+const int8_t* SharedMemoryCache::find(unsigned int source, unsigned int id, unsigned int& size) const {
+    uint64_t key = makeKey(source, id);
+    Slot* slot = findSlot(key);
+    if (!slot || slot->key_.load() != key) {
+        return NULL;
+    }
+
+    uint64_t value = slot->value_.load(std::memory_order_acquire);
+    if (value == 0) {
+        return NULL;
+    }
+
+    size = value & 0xFFFFFFFFu;
+    return data_ + ((value >> 32) - 1) * ENTRY_ALIGNMENT;
+}
+
+const int8_t* SharedMemoryCache::store(unsigned int source, unsigned int id, const void* data, unsigned int size) {
+    unsigned int existingSize;
+    const int8_t* existing = find(source, id, existingSize);
+    if (existing) {
+        return existing;
+    }
+
+    if (header_->entryCount_.load() >= MAX_ENTRY_COUNT) {
+        return NULL;
+    }
+
+    uint64_t alignedSize = (static_cast<uint64_t>(size) + ENTRY_ALIGNMENT - 1) / ENTRY_ALIGNMENT * ENTRY_ALIGNMENT;
+    uint64_t offset = header_->used_.fetch_add(alignedSize);
+    if (offset + alignedSize > header_->dataSize_) {
+        if (header_->full_.exchange(1) == 0) {
+            LOG_INFO << "Shared memory cache " << name_ << " is full" << std::endl;
+        }
+        return NULL;
+    }
+
+    const char* ptr = reinterpret_cast<const char*>(data);
+    unsigned int written = 0;
+    while (written < size) {
+        ssize_t ret = pwrite(fd_, ptr + written, size - written, DATA_OFFSET + offset + written);
+        if (ret <= 0) {
+            if (ret == -1 && errno == EINTR) {
+                continue;
+            }
+            LOG_WARN << "Unable to write to shared memory cache " << name_ << ": " << strerror(errno) << std::endl;
+            return NULL;
+        }
+        written += ret;
+    }
+
+    uint64_t key = makeKey(source, id);
+    Slot* slot = findSlot(key);
+    if (!slot) {
+        return NULL;
+    }
+
+    uint64_t expected = 0;
+    if (!slot->key_.compare_exchange_strong(expected, key)) {
+        // someone published the same id at the same time, the space of this copy is lost
+        return find(source, id, existingSize);
+    }
+
+    header_->entryCount_.fetch_add(1);
+    slot->value_.store(((offset / ENTRY_ALIGNMENT + 1) << 32) | size, std::memory_order_release);
+    return data_ + offset;
+}
+
+bool SharedMemoryCache::loadTexture(unsigned int source, unsigned int id, boost::shared_ptr<ui::Texture> tex) {
+    unsigned int size;
+    const uint32_t* data = reinterpret_cast<const uint32_t*>(find(source, id, size));
+    if (!data || size < 2 * sizeof(uint32_t)) {
+        return false;
+    }
+
+    unsigned int width = data[0];
+    unsigned int height = data[1];
+    if (size != (2 + width * height) * sizeof(uint32_t)) {
+        return false;
+    }
+
+    tex->initSharedPixelBuffer(width, height, data + 2);
+    return true;
+}
+
+void SharedMemoryCache::storeTexture(unsigned int source, unsigned int id, boost::shared_ptr<ui::Texture> tex) {
+    unsigned int width = tex->getPixelBuffer().get_width();
+    unsigned int height = tex->getPixelBuffer().get_height();
+
+    std::vector<uint32_t> data(2 + width * height);
+    data[0] = width;
+    data[1] = height;
+    if (width * height > 0) {
+        memcpy(&data[2], tex->getPixelBufferData(), width * height * sizeof(uint32_t));
+    }
+
+    const uint32_t* shared = reinterpret_cast<const uint32_t*>(store(source, id, &data[0], data.size() * sizeof(uint32_t)));
+    if (shared) {
+        tex->initSharedPixelBuffer(width, height, shared + 2);
+    }
+}
+
+#else
+
+SharedMemoryCache::SharedMemoryCache(uint64_t dataHash, unsigned int size) :
+        fd_(-1), mapping_(NULL), mappingSize_(0), header_(NULL), slots_(NULL), data_(NULL), ownerIndex_(0) {
+    throw Exception("Shared memory cache is not supported on this platform");
+}
+
+SharedMemoryCache::~SharedMemoryCache() {
+}
+
+const int8_t* SharedMemoryCache::find(unsigned int source, unsigned int id, unsigned int& size) const {
+    return NULL;
+}
+
+const int8_t* SharedMemoryCache::store(unsigned int source, unsigned int id, const void* data, unsigned int size) {
+    return NULL;
+}
+
+bool SharedMemoryCache::loadTexture(unsigned int source, unsigned int id, boost::shared_ptr<ui::Texture> tex) {
+    return false;
+}
+
+void SharedMemoryCache::storeTexture(unsigned int source, unsigned int id, boost::shared_ptr<ui::Texture> tex) {
+}
+
+#endif
+
+}
+}
@@ -0,0 +1,117 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FLUO_DATA_SHAREDMEMORYCACHE_HPP
+#define FLUO_DATA_SHAREDMEMORYCACHE_HPP
+
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+
+#include <stdint.h>
+
+namespace fluo {
+
+namespace ui {
+    class Texture;
+}
+
+namespace data {
+
+/**
+ * \brief Decoded assets shared between all clients running on the same machine with the same data files
+ *
+ * The first client creates a POSIX shared memory segment named after a hash of the data files, all later clients map
+ * the same segment. Every client publishes what it decodes, so that the others can use it without decoding it again.
+ * Published entries are never changed or removed. The data part of the segment is mapped read only, entries are
+ * written through the file descriptor.
+ *
+ * The segment is removed when the last client using it detaches. Clients register their pid in the segment, so that
+ * segments left behind by crashed clients are removed by the next client that starts, also if they belong to other
+ * data files. Segments of older client versions have to be removed by hand, they are found in /dev/shm as fluo-*.
+ *
+ * Not available on Windows, the constructor throws.
+ *
+ * All methods can be called from multiple decode threads at once.
+ */
+class SharedMemoryCache {
+public:
+    struct Source {
+    enum {
+        ART = 1,
+        GUMPART = 2,
+        TEXMAP = 3,
+        TILEDATA = 4,
+    };
+    };
+
+    /**
+     * \param dataHash Identifies the data files, clients with a different hash use a different segment
+     * \param size Size of the data part of the segment
+     * \throw Exception if the segment can not be created or mapped
+     */
+    SharedMemoryCache(uint64_t dataHash, unsigned int size);
+    ~SharedMemoryCache();
+
+    /// Returns NULL if the entry was not published (yet)
+    const int8_t* find(unsigned int source, unsigned int id, unsigned int& size) const;
+
+    /**
+     * Copies the data into the segment. Returns the published entry, which might be the one of another client that
+     * published the same id first. Returns NULL if the segment is full or another client is still writing the same id
+     */
+    const int8_t* store(unsigned int source, unsigned int id, const void* data, unsigned int size);
+
+    /// Returns true and points the texture to the shared pixels if the id is published
+    bool loadTexture(unsigned int source, unsigned int id, boost::shared_ptr<ui::Texture> tex);
+
+    /// Publishes the pixels and points the texture to the shared copy
+    void storeTexture(unsigned int source, unsigned int id, boost::shared_ptr<ui::Texture> tex);
+
+private:
+    struct Header;
+    struct Slot;
+
+    std::string name_;
+    int fd_;
+
+    int8_t* mapping_;
+    unsigned int mappingSize_;
+
+    Header* header_;
+    Slot* slots_;
+    const int8_t* data_;
+
+    unsigned int ownerIndex_;
+
+    bool open(bool create, unsigned int mappingSize);
+    void initSegment(unsigned int dataSize);
+    bool waitForSegment(unsigned int mappingSize);
+
+    Slot* findSlot(uint64_t key) const;
+
+    /// Clears the pids of clients that are not running any more, returns the number of clients that still are
+    static unsigned int releaseDeadOwners(Header* header);
+    void removeStaleSegments();
+};
+
+}
+}
+
+#endif
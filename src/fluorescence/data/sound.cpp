@@ -51,6 +51,7 @@ void Sound::setData(const int8_t* buf, unsigned int len) {
     WaveHeader header(len);
     memcpy(rawData_, &header, sizeof(WaveHeader));
     memcpy(rawData_ + sizeof(WaveHeader), buf, len);
+    setMemoryUsage(dataLength_);
 }
 
 unsigned int Sound::getDataLength() const {
@@ -24,7 +24,7 @@
 #include <boost/filesystem/path.hpp>
 
 #include "indexedondemandfileloader.hpp"
-#include "weakptrcache.hpp"
+#include "denseweakptrcache.hpp"
 #include "sound.hpp"
 
 namespace fluo {
@@ -39,7 +39,7 @@ public:
     void readCallback(unsigned int index, int8_t* buf, unsigned int len, boost::shared_ptr<Sound>, unsigned int extra, unsigned int userData);
     
 private:
-    WeakPtrCache<unsigned int, Sound, IndexedOnDemandFileLoader> cache_;
+    DenseWeakPtrCache<Sound, IndexedOnDemandFileLoader> cache_;
 
 };
 
@@ -0,0 +1,171 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include "startuptasks.hpp"
+
+#include "workerpool.hpp"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <misc/exception.hpp>
+#include <misc/log.hpp>
+
+#include <algorithm>
+
+namespace fluo {
+namespace data {
+
+StartupTasks::StartupTasks() : runningCount_(0), failed_(false) {
+}
+
+void StartupTasks::add(const std::string& name, const Task& task) {
+    add(name, task, std::vector<std::string>());
+}
+
+void StartupTasks::add(const std::string& name, const Task& task, const std::string& dependency) {
+    add(name, task, std::vector<std::string>(1, dependency));
+}
+
+void StartupTasks::add(const std::string& name, const Task& task, const std::vector<std::string>& dependencies) {
+    if (nameIndex_.count(name) > 0) {
+        throw Exception("Duplicate startup task ", name.c_str());
+    }
+
+    unsigned int index = nodes_.size();
+    nodes_.push_back(Node());
+    Node& node = nodes_.back();
+    node.name_ = name;
+    node.task_ = task;
+    node.dependencyCount_ = dependencies.size();
+    node.pendingDependencies_ = 0;
+
+    for (unsigned int i = 0; i < dependencies.size(); ++i) {
+        std::map<std::string, unsigned int>::const_iterator iter = nameIndex_.find(dependencies[i]);
+        if (iter == nameIndex_.end()) {
+            nodes_.pop_back();
+            throw Exception("Startup task depends on a task that was not added before: ", dependencies[i].c_str());
+        }
+        nodes_[iter->second].dependents_.push_back(index);
+    }
+
+    nameIndex_[name] = index;
+}
+
+void StartupTasks::run(unsigned int threadCount) {
+    if (threadCount == 0) {
+        threadCount = boost::thread::hardware_concurrency();
+    }
+
+    if (threadCount <= 1 || nodes_.size() <= 1) {
+        runSerial();
+        return;
+    }
+
+    runningCount_ = 0;
+    failed_ = false;
+    error_.clear();
+
+    for (unsigned int i = 0; i < nodes_.size(); ++i) {
+        nodes_[i].pendingDependencies_ = nodes_[i].dependencyCount_;
+    }
+
+    {
+        WorkerPool pool("startup", (std::min)(threadCount, (unsigned int)nodes_.size()));
+
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            for (unsigned int i = 0; i < nodes_.size(); ++i) {
+                if (nodes_[i].dependencyCount_ == 0) {
+                    ++runningCount_;
+                    pool.enqueue(this, boost::bind(&StartupTasks::runTask, this, &pool, i));
+                }
+            }
+
+            // every task enqueues its ready dependents before it counts as finished, so 0 means all are done (or failed)
+            while (runningCount_ > 0) {
+                finishedSignal_.wait(lock);
+            }
+        }
+    }
+
+    if (failed_) {
+        throw Exception(error_.c_str());
+    }
+}
+
+void StartupTasks::runSerial() {
+    for (unsigned int i = 0; i < nodes_.size(); ++i) {
+        try {
+            nodes_[i].task_();
+        } catch (const std::exception& ex) {
+            LOG_ERROR << "Startup task " << nodes_[i].name_ << " failed: " << ex.what() << std::endl;
+            std::string error = "Startup task failed: " + nodes_[i].name_ + ": " + ex.what();
+            throw Exception(error.c_str());
+        }
+    }
+}
+
+void StartupTasks::runTask(WorkerPool* pool, unsigned int index) {
+    Node& node = nodes_[index];
+
+    bool skip;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        skip = failed_;
+    }
+
+    bool success = true;
+    std::string reason;
+    try {
+        if (!skip) {
+            node.task_();
+        }
+    } catch (const std::exception& ex) {
+        LOG_ERROR << "Startup task " << node.name_ << " failed: " << ex.what() << std::endl;
+        success = false;
+        reason = ex.what();
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    if (!success && !failed_) {
+        failed_ = true;
+        error_ = "Startup task failed: " + node.name_ + ": " + reason;
+    }
+
+    if (!failed_) {
+        for (unsigned int i = 0; i < node.dependents_.size(); ++i) {
+            Node& dependent = nodes_[node.dependents_[i]];
+            if (--dependent.pendingDependencies_ == 0) {
+                ++runningCount_;
+                pool->enqueue(this, boost::bind(&StartupTasks::runTask, this, pool, node.dependents_[i]));
+            }
+        }
+    }
+
+    --runningCount_;
+    if (runningCount_ == 0) {
+        finishedSignal_.notify_all();
+    }
+}
+
+}
+}
@@ -0,0 +1,89 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_DATA_STARTUPTASKS_HPP
+#define FLUO_DATA_STARTUPTASKS_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace fluo {
+namespace data {
+
+class WorkerPool;
+
+/**
+ * \brief A set of named tasks with dependencies, used to construct the data loaders in parallel
+ *
+ * A task can only depend on tasks added before it. Thus there are no cycles, and the order of adding is a
+ * valid serial order. A task is started as soon as all of its dependencies are finished.
+ *
+ * If a task throws, no further tasks are started. run() waits for the running ones and then throws an
+ * Exception naming the first task that failed and its error message.
+ */
+class StartupTasks {
+public:
+    typedef boost::function<void ()> Task;
+
+    StartupTasks();
+
+    void add(const std::string& name, const Task& task);
+    void add(const std::string& name, const Task& task, const std::string& dependency);
+    void add(const std::string& name, const Task& task, const std::vector<std::string>& dependencies);
+
+    /// A threadCount of 0 uses one thread per core. With 1, all tasks are run in the calling thread, in the order they were added
+    void run(unsigned int threadCount);
+
+private:
+    StartupTasks(const StartupTasks& copy) { }
+    StartupTasks& operator=(const StartupTasks& copy) { return *this; }
+
+    struct Node {
+        std::string name_;
+        Task task_;
+        unsigned int dependencyCount_;
+        std::vector<unsigned int> dependents_;
+
+        // only used during run
+        unsigned int pendingDependencies_;
+    };
+
+    std::vector<Node> nodes_;
+    std::map<std::string, unsigned int> nameIndex_;
+
+    void runSerial();
+    void runTask(WorkerPool* pool, unsigned int index);
+
+    boost::mutex mutex_;
+    boost::condition_variable finishedSignal_;
+    unsigned int runningCount_;
+    bool failed_;
+    std::string error_;
+};
+
+}
+}
+
+#endif
@@ -71,17 +71,10 @@ void StaticsLoader::readCallbackMul(unsigned int index, int8_t* buf, unsigned in
 }
 
 void StaticsLoader::readCallbackDifOffsets(int8_t* buf, unsigned int len) {
-    unsigned int entryCount = len / 4;
-    uint32_t* ptr = reinterpret_cast<uint32_t*>(buf);
-
-    for (unsigned int i = 0; i < entryCount; ++i) {
-        unsigned int curEntry = *ptr;
-        ptr++;
-        difEntries_[curEntry] = i;
-    }
+    difIndex_.init(reinterpret_cast<uint32_t*>(buf), len / 4, blockCountX_ * blockCountY_);
 }
 
-boost::shared_ptr<world::StaticBlock> StaticsLoader::get(unsigned int x, unsigned int y) {
+boost::shared_ptr<world::StaticBlock> StaticsLoader::get(unsigned int x, unsigned int y, unsigned int priority) {
     if (x >= blockCountX_) {
         x = 0;
     }
@@ -94,14 +87,14 @@ boost::shared_ptr<world::StaticBlock> StaticsLoader::get(unsigned int x, unsigne
 
     if (difEnabled_) {
         // check if there is a dif entry for this block
-        std::map<unsigned int, unsigned int>::const_iterator iter = difEntries_.find(idx);
-        if (iter != difEntries_.end()) {
-            return difCache_.get(iter->second, idx);
+        unsigned int difIdx;
+        if (difIndex_.find(idx, difIdx)) {
+            return difCache_.get(difIdx, idx, priority);
         } else {
-            return mulCache_.get(idx, idx);
+            return mulCache_.get(idx, idx, priority);
         }
     } else {
-        return mulCache_.get(idx, idx);
+        return mulCache_.get(idx, idx, priority);
     }
 }
 
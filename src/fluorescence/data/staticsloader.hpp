@@ -21,6 +21,7 @@
 #define FLUO_STATICS_LOADER_HPP
 
 #include "weakptrcache.hpp"
+#include "difindex.hpp"
 #include "indexedondemandfileloader.hpp"
 
 #include <world/statics.hpp>
@@ -43,15 +44,15 @@ public:
 
     void readCallbackDifOffsets(int8_t* buf, unsigned int len);
 
-    boost::shared_ptr<world::StaticBlock> get(unsigned int x, unsigned int y);
+    boost::shared_ptr<world::StaticBlock> get(unsigned int x, unsigned int y, unsigned int priority = LoadPriority::VISIBLE);
 
 
 private:
     WeakPtrCache<unsigned int, world::StaticBlock, IndexedOnDemandFileLoader> mulCache_;
     WeakPtrCache<unsigned int, world::StaticBlock, IndexedOnDemandFileLoader> difCache_;
 
-    // stores block idx - file offset in dif file pairs
-    std::map<unsigned int, unsigned int> difEntries_;
+    // maps block idx to entry in the dif file
+    DifIndex difIndex_;
 
     unsigned int blockCountX_;
     unsigned int blockCountY_;
@@ -0,0 +1,216 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "texturepack.hpp"
+#include "completionqueue.hpp"
+
+#include <ui/texture.hpp>
+#include <ui/manager.hpp>
+
+#include <misc/exception.hpp>
+#include <misc/log.hpp>
+
+#include <string.h>
+
+namespace fluo {
+namespace data {
+
+TexturePack::TexturePack(const boost::filesystem::path& path, const uint64_t sourceHash[Source::COUNT]) :
+        path_(path), ioScheduler_(IoScheduler::getSingleton()) {
+    stream_.open(path, std::ios_base::binary);
+    if (!stream_.is_open()) {
+        throw Exception("Unable to open texture pack");
+    }
+
+    stream_.read(reinterpret_cast<char*>(&header_), sizeof(Header));
+    if (!stream_.good() || memcmp(header_.magic_, "FLPK", 4) != 0 || header_.version_ != VERSION) {
+        throw Exception("Invalid texture pack file or version");
+    }
+
+    for (unsigned int i = 0; i < Source::COUNT; ++i) {
+        if (header_.sourceHash_[i] != sourceHash[i]) {
+            throw Exception("Texture pack was created for different data files");
+        }
+    }
+
+    // texture coordinates are normalized to the size of the texture groups
+    if (header_.pageWidth_ != ui::Manager::TEXTURE_GROUP_WIDTH || header_.pageHeight_ != ui::Manager::TEXTURE_GROUP_HEIGHT) {
+        throw Exception("Texture pack page size does not match texture group size");
+    }
+
+    entries_.resize(header_.entryCount_);
+    if (header_.entryCount_ > 0) {
+        stream_.seekg(header_.entryOffset_, std::ios_base::beg);
+        stream_.read(reinterpret_cast<char*>(&entries_[0]), header_.entryCount_ * sizeof(Entry));
+    }
+
+    uint64_t fileSize = boost::filesystem::file_size(path);
+    if (header_.maskOffset_ < fileSize) {
+        masks_.resize(fileSize - header_.maskOffset_);
+        stream_.seekg(header_.maskOffset_, std::ios_base::beg);
+        stream_.read(reinterpret_cast<char*>(&masks_[0]), masks_.size());
+    }
+
+    if (!stream_.good()) {
+        throw Exception("Error reading texture pack");
+    }
+
+    for (unsigned int i = 0; i < entries_.size(); ++i) {
+        const Entry& cur = entries_[i];
+        if (cur.source_ >= Source::COUNT || cur.page_ >= header_.pageCount_ ||
+                cur.maskOffset_ + ui::BitMask::getBitStoreSize(cur.width_, cur.height_) > masks_.size()) {
+            throw Exception("Invalid entry in texture pack");
+        }
+
+        std::vector<int>& index = entryIndex_[cur.source_];
+        if (index.size() <= cur.id_) {
+            index.resize(cur.id_ + 1, -1);
+        }
+        index[cur.id_] = i;
+    }
+
+    textures_.resize(entries_.size());
+    pages_.resize(header_.pageCount_);
+
+    LOG_INFO << "Texture pack " << path_ << " with " << header_.entryCount_ << " textures on " << header_.pageCount_ << " pages" << std::endl;
+}
+
+TexturePack::~TexturePack() {
+    ioScheduler_->cancel(this);
+}
+
+bool TexturePack::hasTexture(unsigned int source, unsigned int id) const {
+    return source < Source::COUNT && id < entryIndex_[source].size() && entryIndex_[source][id] >= 0;
+}
+
+const TexturePack::Entry* TexturePack::getEntry(unsigned int source, unsigned int id) const {
+    if (!hasTexture(source, id)) {
+        return NULL;
+    }
+
+    return &entries_[entryIndex_[source][id]];
+}
+
+const TexturePack::Header& TexturePack::getHeader() const {
+    return header_;
+}
+
+boost::shared_ptr<ui::Texture> TexturePack::getTexture(unsigned int source, unsigned int id) {
+    boost::shared_ptr<ui::Texture> ret;
+    if (!hasTexture(source, id)) {
+        return ret;
+    }
+
+    unsigned int idx = entryIndex_[source][id];
+    ret = textures_[idx].lock();
+    if (ret) {
+        return ret;
+    }
+
+    Page& page = pages_[entries_[idx].page_];
+    if (page.state_ == PageState::FAILED) {
+        return ret;
+    }
+
+    ret.reset(new ui::Texture(ui::Texture::USAGE_WORLD));
+    textures_[idx] = ret;
+
+    if (page.state_ == PageState::LOADED) {
+        initTexture(idx, ret);
+    } else {
+        page.waitingEntries_.push_back(idx);
+        if (page.state_ == PageState::NOT_LOADED) {
+            page.state_ = PageState::LOADING;
+            ioScheduler_->enqueueRead(this, boost::bind(&TexturePack::loadPage, this, boost::weak_ptr<TexturePack>(shared_from_this()), entries_[idx].page_),
+                    LoadPriority::VISIBLE);
+        }
+    }
+
+    return ret;
+}
+
+void TexturePack::initTexture(unsigned int index, boost::shared_ptr<ui::Texture> tex) {
+    const Entry& entry = entries_[index];
+    tex->initFromAtlas(pages_[entry.page_].texture_, CL_Rect(entry.x_, entry.y_, CL_Size(entry.width_, entry.height_)), entry.borderWidth_,
+            &masks_[entry.maskOffset_]);
+}
+
+bool TexturePack::readPage(unsigned int page, uint32_t* pixels) {
+    uint64_t pageSize = (uint64_t)header_.pageWidth_ * header_.pageHeight_ * sizeof(uint32_t);
+
+    boost::mutex::scoped_lock lock(streamMutex_);
+    stream_.seekg(sizeof(Header) + page * pageSize, std::ios_base::beg);
+    stream_.read(reinterpret_cast<char*>(pixels), pageSize);
+    if (!stream_.good()) {
+        stream_.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void TexturePack::loadPage(boost::weak_ptr<TexturePack> self, unsigned int page) {
+    boost::shared_array<uint32_t> pixels(new uint32_t[header_.pageWidth_ * header_.pageHeight_]);
+    if (!readPage(page, pixels.get())) {
+        pixels.reset();
+    }
+
+    // the upload needs the gl context of the main thread
+    CompletionQueue::getSingleton()->post(boost::bind(&TexturePack::onPageRead, self, page, pixels));
+}
+
+void TexturePack::onPageRead(boost::weak_ptr<TexturePack> self, unsigned int page, boost::shared_array<uint32_t> pixels) {
+    boost::shared_ptr<TexturePack> pack = self.lock();
+    if (pack) {
+        pack->uploadPage(page, pixels);
+    }
+}
+
+void TexturePack::uploadPage(unsigned int page, boost::shared_array<uint32_t> pixels) {
+    Page& cur = pages_[page];
+
+    if (pixels) {
+        // only references the pixels, they are copied by the upload
+        CL_PixelBuffer pixelBuffer(header_.pageWidth_, header_.pageHeight_, cl_rgba8, pixels.get(), true);
+        cur.texture_ = ui::Manager::getSingleton()->providerRenderBufferTexture(CL_Size(header_.pageWidth_, header_.pageHeight_), cl_rgba8);
+        cur.texture_.set_image(pixelBuffer);
+        cur.state_ = PageState::LOADED;
+    } else {
+        LOG_ERROR << "Error reading page " << page << " from texture pack " << path_ << std::endl;
+        cur.state_ = PageState::FAILED;
+    }
+
+    for (unsigned int i = 0; i < cur.waitingEntries_.size(); ++i) {
+        boost::shared_ptr<ui::Texture> tex = textures_[cur.waitingEntries_[i]].lock();
+        if (!tex) {
+            continue;
+        }
+
+        if (cur.state_ == PageState::LOADED) {
+            initTexture(cur.waitingEntries_[i], tex);
+        } else {
+            tex->setReadFailed();
+        }
+    }
+    cur.waitingEntries_.clear();
+}
+
+}
+}
@@ -0,0 +1,171 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FLUO_DATA_TEXTUREPACK_HPP
+#define FLUO_DATA_TEXTUREPACK_HPP
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/shared_array.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <ClanLib/Display/Render/texture.h>
+
+#include <vector>
+
+#include <stdint.h>
+
+#include "ioscheduler.hpp"
+
+namespace fluo {
+
+namespace ui {
+    class Texture;
+}
+
+namespace data {
+
+/**
+ * \brief Atlas pages of art and texmaps, packed offline by fluo-packer
+ *
+ * File layout: Header, pageCount pages of raw RGBA pixels, entryCount Entry structs, then the bit masks of all entries.
+ * A page is read by an io thread when the first texture on it is requested, and uploaded when the main loop drains
+ * the CompletionQueue. Until then, the textures on it are not read complete. If a page can not be read, its textures
+ * are set to read failed, and later requests are left to the regular loaders.
+ * All methods except readPage have to be called from the main thread.
+ */
+class TexturePack : public boost::enable_shared_from_this<TexturePack> {
+public:
+    struct Source {
+    enum {
+        ART = 0,
+        TEXMAP = 1,
+
+        COUNT = 2,
+    };
+    };
+
+    static const uint32_t VERSION = 1;
+
+#ifdef WIN32
+#pragma pack(push,1)
+    struct Header {
+#else
+    struct __attribute__((packed)) Header {
+#endif
+        char magic_[4]; ///< FLPK
+        uint32_t version_;
+        uint64_t sourceHash_[Source::COUNT]; ///< See DecodeCache::hashFiles
+        uint32_t pageWidth_;
+        uint32_t pageHeight_;
+        uint32_t pageCount_;
+        uint32_t entryCount_;
+        uint64_t entryOffset_;
+        uint64_t maskOffset_;
+    };
+
+#ifdef WIN32
+    struct Entry {
+#else
+    struct __attribute__((packed)) Entry {
+#endif
+        uint32_t source_;
+        uint32_t id_;
+        uint32_t page_;
+        uint16_t x_; ///< Position on the page, without border
+        uint16_t y_;
+        uint16_t width_;
+        uint16_t height_;
+        uint32_t borderWidth_;
+        uint32_t maskOffset_; ///< Relative to Header::maskOffset_
+    };
+#ifdef WIN32
+#pragma pack(pop)
+#endif
+
+    /**
+     * \throw Exception if the file can not be read or was created for different data files
+     */
+    TexturePack(const boost::filesystem::path& path, const uint64_t sourceHash[Source::COUNT]);
+    ~TexturePack();
+
+    /// Returns an empty pointer if the id is not part of the pack, or its page could not be read
+    boost::shared_ptr<ui::Texture> getTexture(unsigned int source, unsigned int id);
+
+    bool hasTexture(unsigned int source, unsigned int id) const;
+
+    /// Returns NULL if the id is not part of the pack
+    const Entry* getEntry(unsigned int source, unsigned int id) const;
+
+    const Header& getHeader() const;
+
+    /// Reads the raw pixels of a page, pageWidth * pageHeight values. Can be called from any thread
+    bool readPage(unsigned int page, uint32_t* pixels);
+
+private:
+    struct PageState {
+    enum {
+        NOT_LOADED,
+        LOADING,
+        LOADED,
+        FAILED,
+    };
+    };
+
+    struct Page {
+        Page() : state_(PageState::NOT_LOADED) {
+        }
+
+        unsigned int state_;
+        CL_Texture texture_;
+        std::vector<unsigned int> waitingEntries_; ///< Indexes in entries_ of the textures waiting for the upload
+    };
+
+    boost::filesystem::path path_;
+    boost::mutex streamMutex_;
+    boost::filesystem::ifstream stream_;
+    Header header_;
+
+    std::vector<Entry> entries_;
+    std::vector<uint8_t> masks_;
+
+    /// Maps source and id to an index in entries_, or -1
+    std::vector<int> entryIndex_[Source::COUNT];
+
+    std::vector<boost::weak_ptr<ui::Texture> > textures_;
+    std::vector<Page> pages_;
+
+    boost::shared_ptr<IoScheduler> ioScheduler_;
+
+    void initTexture(unsigned int index, boost::shared_ptr<ui::Texture> tex);
+
+    /// Io thread
+    void loadPage(boost::weak_ptr<TexturePack> self, unsigned int page);
+    /// Main thread, the pack might be gone already
+    static void onPageRead(boost::weak_ptr<TexturePack> self, unsigned int page, boost::shared_array<uint32_t> pixels);
+    void uploadPage(unsigned int page, boost::shared_array<uint32_t> pixels);
+};
+
+}
+}
+
+#endif
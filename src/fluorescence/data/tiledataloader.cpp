@@ -21,53 +21,136 @@
 #include "tiledataloader.hpp"
 
 #include "fullfileloader.hpp"
+#include "sharedmemorycache.hpp"
 
 #include <misc/log.hpp>
 
 #include <boost/bind.hpp>
+#include <cstring>
 
 namespace fluo {
 namespace data {
 
-TileDataLoader::TileDataLoader(const boost::filesystem::path& path, bool highSeasFormat) : highSeasFormat_(highSeasFormat) {
-    FullFileLoader ldr(path);
-    ldr.read(boost::bind(&TileDataLoader::read, this, _1, _2));
+namespace {
+const unsigned int BLOCK_HEADER_SIZE = 16;
 }
 
-TileDataLoader::~TileDataLoader() {
-    if (landTileInfos_) {
-        delete [] landTileInfos_;
-        landTileInfos_ = 0;
+TileDataLoader::TileDataLoader(const boost::filesystem::path& path, bool highSeasFormat, boost::shared_ptr<SharedMemoryCache> sharedCache) :
+        sharedCache_(sharedCache), landTileCount_(0), staticTileCount_(0), highSeasFormat_(highSeasFormat) {
+    if (sharedCache_) {
+        unsigned int size;
+        const int8_t* block = sharedCache_->find(SharedMemoryCache::Source::TILEDATA, 0, size);
+        if (block && useSharedBlock(block, size)) {
+            LOG_INFO << "Using tiledata from shared memory" << std::endl;
+            return;
+        }
     }
 
-    if (staticTileInfos_) {
-        delete [] staticTileInfos_;
-        staticTileCount_ = 0;
-    }
+    FullFileLoader ldr(path);
+    ldr.read(boost::bind(&TileDataLoader::read, this, _1, _2));
 }
 
-const LandTileInfo* TileDataLoader::getLandTileInfo(unsigned int id) {
-    if (id > landTileCount_) {
+LandTileInfo TileDataLoader::getLandTileInfo(unsigned int id) const {
+    if (id >= landTileCount_) {
         LOG_WARN << "Trying to access out of range land tile data index " << id << std::endl;
         id = 0;
     }
 
-    return &landTileInfos_[id];
+    return LandTileInfo(this, id);
 }
 
-const StaticTileInfo* TileDataLoader::getStaticTileInfo(unsigned int id) {
-    if (id > staticTileCount_) {
+StaticTileInfo TileDataLoader::getStaticTileInfo(unsigned int id) const {
+    if (id >= staticTileCount_) {
         LOG_WARN << "Trying to access out of range static tile data index " << id << std::endl;
         id = 0;
     }
 
-    return &staticTileInfos_[id];
+    return StaticTileInfo(this, id);
+}
+
+unsigned int TileDataLoader::getLandTileCount() const {
+    return landTileCount_;
+}
+
+unsigned int TileDataLoader::getStaticTileCount() const {
+    return staticTileCount_;
+}
+
+UnicodeString TileDataLoader::getName(const char* names, std::map<unsigned int, UnicodeString>& cache, unsigned int id) const {
+    // returned by value, the cache must only be accessed while holding the lock
+    boost::mutex::scoped_lock myLock(nameMutex_);
+
+    std::map<unsigned int, UnicodeString>::const_iterator iter = cache.find(id);
+    if (iter != cache.end()) {
+        return iter->second;
+    }
+
+    UnicodeString ret = StringConverter::fromUtf8(&names[id * NAME_LENGTH], NAME_LENGTH);
+    cache[id] = ret;
+    return ret;
+}
+
+unsigned int TileDataLoader::getBlockSize(unsigned int landTileCount, unsigned int staticTileCount) {
+    return BLOCK_HEADER_SIZE +
+            landTileCount * (sizeof(uint32_t) + sizeof(uint16_t) + NAME_LENGTH) +
+            staticTileCount * (sizeof(uint32_t) + sizeof(uint16_t) + sizeof(StaticTileDetails) + sizeof(uint8_t) + NAME_LENGTH);
+}
+
+void TileDataLoader::setArrays(int8_t* block) {
+    // ordered by alignment
+    int8_t* ptr = block + BLOCK_HEADER_SIZE;
+
+    landFlags_ = reinterpret_cast<uint32_t*>(ptr);
+    ptr += landTileCount_ * sizeof(uint32_t);
+    staticFlags_ = reinterpret_cast<uint32_t*>(ptr);
+    ptr += staticTileCount_ * sizeof(uint32_t);
+
+    landTextureIds_ = reinterpret_cast<uint16_t*>(ptr);
+    ptr += landTileCount_ * sizeof(uint16_t);
+    staticAnimIds_ = reinterpret_cast<uint16_t*>(ptr);
+    ptr += staticTileCount_ * sizeof(uint16_t);
+    staticDetails_ = reinterpret_cast<StaticTileDetails*>(ptr);
+    ptr += staticTileCount_ * sizeof(StaticTileDetails);
+
+    staticHeights_ = reinterpret_cast<uint8_t*>(ptr);
+    ptr += staticTileCount_;
+    landNames_ = reinterpret_cast<char*>(ptr);
+    ptr += landTileCount_ * NAME_LENGTH;
+    staticNames_ = reinterpret_cast<char*>(ptr);
+}
+
+bool TileDataLoader::useSharedBlock(const int8_t* block, unsigned int size) {
+    const uint32_t* counts = reinterpret_cast<const uint32_t*>(block);
+    if (size < BLOCK_HEADER_SIZE || size != getBlockSize(counts[0], counts[1])) {
+        LOG_WARN << "Invalid tiledata in shared memory" << std::endl;
+        return false;
+    }
+
+    landTileCount_ = counts[0];
+    staticTileCount_ = counts[1];
+    // the shared block is read only. This is fine, the arrays are only written while reading the file
+    setArrays(const_cast<int8_t*>(block));
+    return true;
 }
 
 void TileDataLoader::read(int8_t* buf, unsigned int len) {
     landTileCount_ = LAND_TILE_COUNT;
 
-    landTileInfos_ = new LandTileInfo[landTileCount_];
+    // calculate number of static tile blocks
+    unsigned int landBytes = (landTileCount_ / 32) * 4 + landTileCount_ * ((highSeasFormat_ ? 8 : 4) + 2 + NAME_LENGTH);
+    if (highSeasFormat_) {
+        staticTileCount_ = ((len - landBytes) / 1316) * 32;
+    } else {
+        staticTileCount_ = ((len - landBytes) / 1188) * 32;
+    }
+
+    LOG_DEBUG << "Static tile count: " << staticTileCount_ << std::endl;
+
+    storage_.resize(getBlockSize(landTileCount_, staticTileCount_));
+    uint32_t* counts = reinterpret_cast<uint32_t*>(&storage_[0]);
+    counts[0] = landTileCount_;
+    counts[1] = staticTileCount_;
+    setArrays(&storage_[0]);
 
     int8_t* ptr = buf;
 
@@ -77,25 +160,13 @@ void TileDataLoader::read(int8_t* buf, unsigned int len) {
             ptr += 4;
         }
 
-        landTileInfos_[i].flags_ = *(reinterpret_cast<uint32_t*>(ptr));
+        landFlags_[i] = *(reinterpret_cast<uint32_t*>(ptr));
         ptr += highSeasFormat_ ? 8 : 4;
-        landTileInfos_[i].textureId_ = *(reinterpret_cast<uint16_t*>(ptr));
+        landTextureIds_[i] = *(reinterpret_cast<uint16_t*>(ptr));
         ptr += 2;
-        landTileInfos_[i].name_ = StringConverter::fromUtf8(reinterpret_cast<char*>(ptr), 20);
-        ptr += 20;
-    }
-
-    // calculate number of static tile blocks
-
-    if (highSeasFormat_) {
-        staticTileCount_ = ((len - (ptr - buf)) / 1316) * 32;
-    } else {
-        staticTileCount_ = ((len - (ptr - buf)) / 1188) * 32;
+        memcpy(&landNames_[i * NAME_LENGTH], ptr, NAME_LENGTH);
+        ptr += NAME_LENGTH;
     }
-    
-    LOG_DEBUG << "Static tile count: " << staticTileCount_ << std::endl;
-
-    staticTileInfos_ = new StaticTileInfo[staticTileCount_];
 
     for (unsigned int i = 0; i < staticTileCount_; ++i) {
         // jump header
@@ -103,48 +174,56 @@ void TileDataLoader::read(int8_t* buf, unsigned int len) {
             ptr += 4;
         }
 
-        staticTileInfos_[i].flags_ = *(reinterpret_cast<uint32_t*>(ptr));
+        staticFlags_[i] = *(reinterpret_cast<uint32_t*>(ptr));
         ptr += highSeasFormat_ ? 8 : 4;
 
-        staticTileInfos_[i].weight_ = *(reinterpret_cast<uint8_t*>(ptr));
+        StaticTileDetails& details = staticDetails_[i];
+
+        details.weight_ = *(reinterpret_cast<uint8_t*>(ptr));
         ++ptr;
 
-        staticTileInfos_[i].quality_ = *(reinterpret_cast<uint8_t*>(ptr));
+        details.quality_ = *(reinterpret_cast<uint8_t*>(ptr));
         ++ptr;
 
-        staticTileInfos_[i].unknown1_ = *(reinterpret_cast<uint16_t*>(ptr));
+        details.unknown1_ = *(reinterpret_cast<uint16_t*>(ptr));
         ptr += 2;
 
-        staticTileInfos_[i].unknown2_ = *(reinterpret_cast<uint8_t*>(ptr));
+        details.unknown2_ = *(reinterpret_cast<uint8_t*>(ptr));
         ++ptr;
 
-        staticTileInfos_[i].quantity_ = *(reinterpret_cast<uint8_t*>(ptr));
+        details.quantity_ = *(reinterpret_cast<uint8_t*>(ptr));
         ++ptr;
 
-        staticTileInfos_[i].animId_ = *(reinterpret_cast<uint16_t*>(ptr));
+        staticAnimIds_[i] = *(reinterpret_cast<uint16_t*>(ptr));
         ptr += 2;
 
-        staticTileInfos_[i].unknown3_ = *(reinterpret_cast<uint8_t*>(ptr));
+        details.unknown3_ = *(reinterpret_cast<uint8_t*>(ptr));
         ++ptr;
 
-        staticTileInfos_[i].hue_ = *(reinterpret_cast<uint8_t*>(ptr));
+        details.hue_ = *(reinterpret_cast<uint8_t*>(ptr));
         ++ptr;
 
-        staticTileInfos_[i].unknown4_ = *(reinterpret_cast<uint8_t*>(ptr));
+        details.unknown4_ = *(reinterpret_cast<uint8_t*>(ptr));
         ++ptr;
 
-        staticTileInfos_[i].unknown5_ = *(reinterpret_cast<uint8_t*>(ptr));
+        details.unknown5_ = *(reinterpret_cast<uint8_t*>(ptr));
         ++ptr;
 
-        staticTileInfos_[i].height_ = *(reinterpret_cast<uint8_t*>(ptr));
+        staticHeights_[i] = *(reinterpret_cast<uint8_t*>(ptr));
         ++ptr;
 
-        staticTileInfos_[i].name_ = StringConverter::fromUtf8(reinterpret_cast<char*>(ptr), 20);
-        ptr += 20;
+        memcpy(&staticNames_[i * NAME_LENGTH], ptr, NAME_LENGTH);
+        ptr += NAME_LENGTH;
     }
 
     LOG_DEBUG << "Total read bytes: " << (ptr-buf) << " len: " << len << std::endl;
 
+    if (sharedCache_) {
+        const int8_t* shared = sharedCache_->store(SharedMemoryCache::Source::TILEDATA, 0, &storage_[0], storage_.size());
+        if (shared && useSharedBlock(shared, storage_.size())) {
+            std::vector<int8_t>().swap(storage_);
+        }
+    }
 }
 
 
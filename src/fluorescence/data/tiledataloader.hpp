@@ -23,132 +23,204 @@
 #include <misc/string.hpp>
 #include <misc/exception.hpp>
 
+#include <map>
+#include <vector>
 #include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace fluo {
 namespace data {
 
-#define FLUO_FLAG_GETTER(_flagName, _flagValue)     bool _flagName() const { return (flags_ & _flagValue) != 0; }
-
-struct LandTileInfo {
-    uint32_t flags_;
-    uint16_t textureId_;
-    UnicodeString name_;
-
-    FLUO_FLAG_GETTER(background,    0x00000001)
-    FLUO_FLAG_GETTER(weapon,        0x00000002)
-    FLUO_FLAG_GETTER(transparent,   0x00000004)
-    FLUO_FLAG_GETTER(translucent,   0x00000008)
-    FLUO_FLAG_GETTER(wall,          0x00000010)
-    FLUO_FLAG_GETTER(damaging,      0x00000020)
-    FLUO_FLAG_GETTER(impassable,    0x00000040)
-    FLUO_FLAG_GETTER(liquid,        0x00000080)
-
-    FLUO_FLAG_GETTER(unknown1,      0x00000100)
-    FLUO_FLAG_GETTER(surface,       0x00000200)
-    FLUO_FLAG_GETTER(bridge,        0x00000400)
-    FLUO_FLAG_GETTER(generic,       0x00000800)
-    FLUO_FLAG_GETTER(window,        0x00001000)
-    FLUO_FLAG_GETTER(noShoot,       0x00002000)
-    FLUO_FLAG_GETTER(articleA,      0x00004000)
-    FLUO_FLAG_GETTER(articleAn,     0x00008000)
-
-    FLUO_FLAG_GETTER(mongen,        0x00010000)
-    FLUO_FLAG_GETTER(foliage,       0x00020000)
-    FLUO_FLAG_GETTER(partialHue,    0x00040000)
-    FLUO_FLAG_GETTER(unknown2,      0x00080000)
-    FLUO_FLAG_GETTER(map,           0x00100000)
-    FLUO_FLAG_GETTER(container,     0x00200000)
-    FLUO_FLAG_GETTER(wearable,      0x00400000)
-    FLUO_FLAG_GETTER(lightSource,   0x00800000)
-
-    FLUO_FLAG_GETTER(animation,     0x01000000)
-    FLUO_FLAG_GETTER(noDiagonal,    0x02000000)
-    FLUO_FLAG_GETTER(unknown3,      0x04000000)
-    FLUO_FLAG_GETTER(armor,         0x08000000)
-    FLUO_FLAG_GETTER(roof,          0x10000000)
-    FLUO_FLAG_GETTER(door,          0x20000000)
-    FLUO_FLAG_GETTER(stairBack,     0x40000000)
+class TileDataLoader;
+class SharedMemoryCache;
+
+#define FLUO_FLAG_GETTER(_flagName, _flagValue)     bool _flagName() const { return (flags() & _flagValue) != 0; }
+
+#define FLUO_FLAG_GETTERS \
+    FLUO_FLAG_GETTER(background,    0x00000001) \
+    FLUO_FLAG_GETTER(weapon,        0x00000002) \
+    FLUO_FLAG_GETTER(transparent,   0x00000004) \
+    FLUO_FLAG_GETTER(translucent,   0x00000008) \
+    FLUO_FLAG_GETTER(wall,          0x00000010) \
+    FLUO_FLAG_GETTER(damaging,      0x00000020) \
+    FLUO_FLAG_GETTER(impassable,    0x00000040) \
+    FLUO_FLAG_GETTER(liquid,        0x00000080) \
+\
+    FLUO_FLAG_GETTER(unknown1,      0x00000100) \
+    FLUO_FLAG_GETTER(surface,       0x00000200) \
+    FLUO_FLAG_GETTER(bridge,        0x00000400) \
+    FLUO_FLAG_GETTER(generic,       0x00000800) \
+    FLUO_FLAG_GETTER(window,        0x00001000) \
+    FLUO_FLAG_GETTER(noShoot,       0x00002000) \
+    FLUO_FLAG_GETTER(articleA,      0x00004000) \
+    FLUO_FLAG_GETTER(articleAn,     0x00008000) \
+\
+    FLUO_FLAG_GETTER(mongen,        0x00010000) \
+    FLUO_FLAG_GETTER(foliage,       0x00020000) \
+    FLUO_FLAG_GETTER(partialHue,    0x00040000) \
+    FLUO_FLAG_GETTER(unknown2,      0x00080000) \
+    FLUO_FLAG_GETTER(map,           0x00100000) \
+    FLUO_FLAG_GETTER(container,     0x00200000) \
+    FLUO_FLAG_GETTER(wearable,      0x00400000) \
+    FLUO_FLAG_GETTER(lightSource,   0x00800000) \
+\
+    FLUO_FLAG_GETTER(animation,     0x01000000) \
+    FLUO_FLAG_GETTER(noDiagonal,    0x02000000) \
+    FLUO_FLAG_GETTER(unknown3,      0x04000000) \
+    FLUO_FLAG_GETTER(armor,         0x08000000) \
+    FLUO_FLAG_GETTER(roof,          0x10000000) \
+    FLUO_FLAG_GETTER(door,          0x20000000) \
+    FLUO_FLAG_GETTER(stairBack,     0x40000000) \
     FLUO_FLAG_GETTER(stairRight,    0x80000000)
+
+// Handle to one land tile entry. The data itself lives in the loader's arrays, so this is cheap to copy
+// and stays valid as long as the loader does.
+class LandTileInfo {
+public:
+    LandTileInfo() : loader_(nullptr), id_(0) { }
+    LandTileInfo(const TileDataLoader* loader, unsigned int id) : loader_(loader), id_(id) { }
+
+    bool isValid() const { return loader_ != nullptr; }
+    unsigned int getId() const { return id_; }
+
+    inline uint32_t flags() const;
+    inline uint16_t textureId() const;
+    // converted on first access
+    inline UnicodeString name() const;
+
+    FLUO_FLAG_GETTERS
+
+private:
+    const TileDataLoader* loader_;
+    unsigned int id_;
 };
 
-struct StaticTileInfo {
-    uint32_t flags_;
+// fields of a static tile that are not needed for movement checks or rendering
+struct StaticTileDetails {
     uint8_t weight_;
     uint8_t quality_;
     uint16_t unknown1_;
     uint8_t unknown2_;
     uint8_t quantity_;
-    uint16_t animId_;
     uint8_t unknown3_;
     uint8_t hue_;
     uint8_t unknown4_;
     uint8_t unknown5_;
-    uint8_t height_;
-    UnicodeString name_;
-
-    FLUO_FLAG_GETTER(background,    0x00000001)
-    FLUO_FLAG_GETTER(weapon,        0x00000002)
-    FLUO_FLAG_GETTER(transparent,   0x00000004)
-    FLUO_FLAG_GETTER(translucent,   0x00000008)
-    FLUO_FLAG_GETTER(wall,          0x00000010)
-    FLUO_FLAG_GETTER(damaging,      0x00000020)
-    FLUO_FLAG_GETTER(impassable,    0x00000040)
-    FLUO_FLAG_GETTER(liquid,        0x00000080)
-
-    FLUO_FLAG_GETTER(unknown1,      0x00000100)
-    FLUO_FLAG_GETTER(surface,       0x00000200)
-    FLUO_FLAG_GETTER(bridge,        0x00000400)
-    FLUO_FLAG_GETTER(generic,       0x00000800)
-    FLUO_FLAG_GETTER(window,        0x00001000)
-    FLUO_FLAG_GETTER(noShoot,       0x00002000)
-    FLUO_FLAG_GETTER(articleA,      0x00004000)
-    FLUO_FLAG_GETTER(articleAn,     0x00008000)
-
-    FLUO_FLAG_GETTER(mongen,        0x00010000)
-    FLUO_FLAG_GETTER(foliage,       0x00020000)
-    FLUO_FLAG_GETTER(partialHue,    0x00040000)
-    FLUO_FLAG_GETTER(unknown2,      0x00080000)
-    FLUO_FLAG_GETTER(map,           0x00100000)
-    FLUO_FLAG_GETTER(container,     0x00200000)
-    FLUO_FLAG_GETTER(wearable,      0x00400000)
-    FLUO_FLAG_GETTER(lightSource,   0x00800000)
-
-    FLUO_FLAG_GETTER(animation,     0x01000000)
-    FLUO_FLAG_GETTER(noDiagonal,    0x02000000)
-    FLUO_FLAG_GETTER(unknown3,      0x04000000)
-    FLUO_FLAG_GETTER(armor,         0x08000000)
-    FLUO_FLAG_GETTER(roof,          0x10000000)
-    FLUO_FLAG_GETTER(door,          0x20000000)
-    FLUO_FLAG_GETTER(stairBack,     0x40000000)
-    FLUO_FLAG_GETTER(stairRight,    0x80000000)
 };
 
+// Handle to one static tile entry, see LandTileInfo
+class StaticTileInfo {
+public:
+    StaticTileInfo() : loader_(nullptr), id_(0) { }
+    StaticTileInfo(const TileDataLoader* loader, unsigned int id) : loader_(loader), id_(id) { }
+
+    bool isValid() const { return loader_ != nullptr; }
+    unsigned int getId() const { return id_; }
+
+    inline uint32_t flags() const;
+    inline uint8_t height() const;
+    inline uint16_t animId() const;
+    inline const StaticTileDetails& details() const;
+    // converted on first access
+    inline UnicodeString name() const;
+
+    FLUO_FLAG_GETTERS
+
+private:
+    const TileDataLoader* loader_;
+    unsigned int id_;
+};
+
+#undef FLUO_FLAG_GETTERS
 #undef FLUO_FLAG_GETTER
 
 class TileDataLoader {
+friend class LandTileInfo;
+friend class StaticTileInfo;
+
 public:
     enum { LAND_TILE_COUNT = 0x4000 };
+    enum { NAME_LENGTH = 20 };
+
+    /// If a shared memory cache is given, the tables are taken from it or published to it
+    TileDataLoader(const boost::filesystem::path& path, bool highSeasFormat,
+            boost::shared_ptr<SharedMemoryCache> sharedCache = boost::shared_ptr<SharedMemoryCache>());
 
-    TileDataLoader(const boost::filesystem::path& path, bool highSeasFormat);
-    ~TileDataLoader();
+    LandTileInfo getLandTileInfo(unsigned int id) const;
 
-    const LandTileInfo* getLandTileInfo(unsigned int id);
+    StaticTileInfo getStaticTileInfo(unsigned int id) const;
 
-    const StaticTileInfo* getStaticTileInfo(unsigned int id);
+    unsigned int getLandTileCount() const;
+    unsigned int getStaticTileCount() const;
 
     void read(int8_t* buf, unsigned int len);
 
 private:
+    // all arrays live in one block, either storage_ or an entry of the shared memory cache
+    std::vector<int8_t> storage_;
+    boost::shared_ptr<SharedMemoryCache> sharedCache_;
+
     unsigned int landTileCount_;
-    LandTileInfo* landTileInfos_;
+    uint32_t* landFlags_;
+    uint16_t* landTextureIds_;
+    // raw utf-8 names, NAME_LENGTH bytes per tile
+    char* landNames_;
 
     unsigned int staticTileCount_;
-    StaticTileInfo* staticTileInfos_;
-    
+    uint32_t* staticFlags_;
+    uint8_t* staticHeights_;
+    uint16_t* staticAnimIds_;
+    StaticTileDetails* staticDetails_;
+    char* staticNames_;
+
     bool highSeasFormat_;
+
+    mutable boost::mutex nameMutex_;
+    mutable std::map<unsigned int, UnicodeString> landNameCache_;
+    mutable std::map<unsigned int, UnicodeString> staticNameCache_;
+
+    UnicodeString getName(const char* names, std::map<unsigned int, UnicodeString>& cache, unsigned int id) const;
+
+    /// The block starts with the tile counts, followed by the arrays
+    static unsigned int getBlockSize(unsigned int landTileCount, unsigned int staticTileCount);
+    void setArrays(int8_t* block);
+    /// Returns false if the block does not fit its tile counts
+    bool useSharedBlock(const int8_t* block, unsigned int size);
 };
 
+uint32_t LandTileInfo::flags() const {
+    return loader_->landFlags_[id_];
+}
+
+uint16_t LandTileInfo::textureId() const {
+    return loader_->landTextureIds_[id_];
+}
+
+UnicodeString LandTileInfo::name() const {
+    return loader_->getName(loader_->landNames_, loader_->landNameCache_, id_);
+}
+
+uint32_t StaticTileInfo::flags() const {
+    return loader_->staticFlags_[id_];
+}
+
+uint8_t StaticTileInfo::height() const {
+    return loader_->staticHeights_[id_];
+}
+
+uint16_t StaticTileInfo::animId() const {
+    return loader_->staticAnimIds_[id_];
+}
+
+const StaticTileDetails& StaticTileInfo::details() const {
+    return loader_->staticDetails_[id_];
+}
+
+UnicodeString StaticTileInfo::name() const {
+    return loader_->getName(loader_->staticNames_, loader_->staticNameCache_, id_);
+}
+
 }
 }
 
@@ -18,46 +18,29 @@
 
 
 
+
 #include "unifontloader.hpp"
 
-#include <list>
-#include <string.h>
+#include <stdio.h>
 #include <boost/filesystem/operations.hpp>
-#include <unicode/schriter.h>
+#include <boost/filesystem/fstream.hpp>
 
 #include <misc/exception.hpp>
 #include <misc/log.hpp>
 
-#include <ui/texture.hpp>
-
-
-#define BORDER_WIDTH 1
-
 namespace fluo {
 namespace data {
 
 UnicodeCharacter::UnicodeCharacter() :
-        charCode_(0), xOffset_(0), yOffset_(0), width_(0), height_(0), data_(NULL) {
+        charCode_(0), xOffset_(0), yOffset_(0), width_(0), height_(0), atlasPage_(0), atlasX_(0), atlasY_(0) {
 }
 
 UnicodeCharacter::UnicodeCharacter(unsigned int charCode, int xOffset, int yOffset, int width, int height) :
-        charCode_(charCode), xOffset_(xOffset), yOffset_(yOffset), width_(width), height_(height) {
+        charCode_(charCode), xOffset_(xOffset), yOffset_(yOffset), width_(width), height_(height), atlasPage_(0), atlasX_(0), atlasY_(0) {
 
     if (width <= 0 || height <= 0) {
-        height = 0;
-        width = 0;
-        data_ = nullptr;
-    } else {
-        data_ = reinterpret_cast<uint8_t*>(malloc(width_ * height_));
-
-        memset(data_, 0, width_ * height_);
-    }
-}
-
-UnicodeCharacter::~UnicodeCharacter() {
-    if (data_) {
-        free(data_);
-        data_ = NULL;
+        width_ = 0;
+        height_ = 0;
     }
 }
 
@@ -69,108 +52,229 @@ unsigned int UnicodeCharacter::getTotalHeight() const {
     return yOffset_ + height_;
 }
 
-void UnicodeCharacter::debugPrintToConsole() const {
-    LOG_DEBUG << "UnicodeCharacter code=" << charCode_ << " xOff=" << xOffset_ << " yOff=" << yOffset_ << " width=" << width_ << " height=" << height_ << std::endl;
-    for (unsigned int y = 0; y < height_; ++y) {
-        for (unsigned int x = 0; x < width_; ++x) {
-            if (data_[y * width_ + x] == 1) {
-                printf("o");
-            } else {
-                printf(" ");
-            }
-        }
-        printf("\n");
-    }
-    LOG_DEBUG << "end UnicodeCharacter" << std::endl;
-}
 
+// passed by reference to the vector constructor
+const uint32_t UniFontLoader::NOT_LOADED;
 
-UniFontLoader::UniFontLoader(const boost::filesystem::path& path) : maxHeight_(0) {
+UniFontLoader::UniFontLoader(const boost::filesystem::path& path) :
+        fileMapping_(NULL), mappedRegion_(NULL), data_(NULL), dataSize_(0),
+        characterIndex_(0x10000, NOT_LOADED), shelfX_(0), shelfY_(0), shelfHeight_(0), maxHeight_(0) {
     if (!boost::filesystem::exists(path) || !boost::filesystem::is_regular_file(path)) {
         throw Exception("File not found");
     }
 
-    stream_.open(path, std::ios_base::binary);
-    if (!stream_.is_open()) {
-        throw Exception("Error opening stream");
+    dataSize_ = boost::filesystem::file_size(path);
+    if (dataSize_ < 0x40000) {
+        // characters outside of the offset table are not available
+        LOG_WARN << "Unifont file " << path << " is too small for the full offset table" << std::endl;
     }
 
-    // read offsets
-    stream_.read(reinterpret_cast<char*>(offsets_), 0x40000);
+    // an empty file can not be mapped
+    if (dataSize_ > 0) {
+        try {
+            fileMapping_ = new boost::interprocess::file_mapping(path.string().c_str(), boost::interprocess::read_only);
+            mappedRegion_ = new boost::interprocess::mapped_region(*fileMapping_, boost::interprocess::read_only, 0, dataSize_);
+            data_ = reinterpret_cast<const uint8_t*>(mappedRegion_->get_address());
+        } catch (const boost::interprocess::interprocess_exception& ex) {
+            LOG_WARN << "Unable to map file " << path << " into memory, reading it completely: " << ex.what() << std::endl;
+
+            if (mappedRegion_) {
+                delete mappedRegion_;
+                mappedRegion_ = NULL;
+            }
 
+            if (fileMapping_) {
+                delete fileMapping_;
+                fileMapping_ = NULL;
+            }
+
+            fileData_.resize(dataSize_);
+            boost::filesystem::ifstream stream(path, std::ios_base::binary);
+            stream.read(reinterpret_cast<char*>(&fileData_[0]), dataSize_);
+            if (!stream.good()) {
+                throw Exception("Error reading unifont file");
+            }
+            data_ = &fileData_[0];
+        }
+    }
 
     // store dummy blank character
-    boost::shared_ptr<UnicodeCharacter> space(new UnicodeCharacter(' ', 0, 0, 5, 1));
-    cache_[' '] = space;
+    characterIndex_[' '] = characters_.size();
+    characters_.push_back(UnicodeCharacter(' ', 0, 0, 5, 1));
+    addToAtlas(characters_.back());
 
     // load a few characters to get an estimated font height
     getCharacter('M');
     getCharacter('W');
+}
+
+UniFontLoader::~UniFontLoader() {
+    if (mappedRegion_) {
+        delete mappedRegion_;
+        mappedRegion_ = NULL;
+    }
 
-    getCharacter(' ');
+    if (fileMapping_) {
+        delete fileMapping_;
+        fileMapping_ = NULL;
+    }
 }
 
-boost::shared_ptr<UnicodeCharacter> UniFontLoader::getCharacter(unsigned int character) {
-    UniFontLoader::MapType::iterator iter = cache_.find(character);
-    if (iter != cache_.end()) {
-        boost::shared_ptr<UnicodeCharacter> ret = iter->second;
-        return ret;
+const UnicodeCharacter* UniFontLoader::getCharacter(unsigned int character) {
+    if (character >= 0x10000) {
+        return NULL;
+    }
+
+    uint32_t idx = characterIndex_[character];
+    if (idx < NOT_AVAILABLE) {
+        return &characters_[idx];
+    } else if (idx == NOT_AVAILABLE) {
+        return NULL;
     }
 
-    if (character >= 0x40000 || offsets_[character] == 0) {
-        boost::shared_ptr<UnicodeCharacter> ret;
-        return ret;
+    // offset table with one uint32 per character at the start of the file
+    if (character >= dataSize_ / 4) {
+        characterIndex_[character] = NOT_AVAILABLE;
+        return NULL;
     }
 
-    stream_.seekg(offsets_[character], std::ios_base::beg);
-    int8_t charHeader[4];
-    stream_.read(reinterpret_cast<char*>(charHeader), 4);
+    const uint8_t* offsetPtr = data_ + character * 4;
+    unsigned int offset = offsetPtr[0] | (offsetPtr[1] << 8) | (offsetPtr[2] << 16) | (offsetPtr[3] << 24);
+    if (offset == 0 || offset > dataSize_ - 4) {
+        characterIndex_[character] = NOT_AVAILABLE;
+        return NULL;
+    }
 
-    boost::shared_ptr<UnicodeCharacter> ret(new UnicodeCharacter(character, charHeader[0], charHeader[1], charHeader[2], charHeader[3]));
+    const int8_t* charHeader = reinterpret_cast<const int8_t*>(data_ + offset);
+    UnicodeCharacter ret(character, charHeader[0], charHeader[1], charHeader[2], charHeader[3]);
 
-    if (ret->getTotalHeight() > maxHeight_) {
-        maxHeight_ = ret->getTotalHeight();
+    unsigned int lineWidth = ret.width_ > 0 ? (ret.width_ - 1) / 8 + 1 : 0;
+    if (lineWidth * ret.height_ > dataSize_ - 4 - offset) {
+        LOG_WARN << "Unifont character " << character << " exceeds the file size" << std::endl;
+        characterIndex_[character] = NOT_AVAILABLE;
+        return NULL;
     }
 
-    static uint8_t scanline[1024];
-    static uint8_t pow2[] = { 1, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5, 1 << 6, 1 << 7 };
+    if (ret.getTotalHeight() > maxHeight_) {
+        maxHeight_ = ret.getTotalHeight();
+    }
 
-    unsigned int lineWidth = (ret->width_ - 1) / 8 + 1;
-    stream_.read(reinterpret_cast<char*>(scanline), lineWidth * ret->height_);
-    uint8_t* scanlinePtr = scanline - 1; // because it is immediately increased again
+    characterIndex_[character] = characters_.size();
+    characters_.push_back(ret);
+    UnicodeCharacter& stored = characters_.back();
+    addToAtlas(stored);
 
-    for (unsigned int y = 0; y < ret->height_; ++y) {
-        unsigned int bitIndex = 7;
-        ++scanlinePtr;
+    if (stored.width_ == 0 || stored.height_ == 0) {
+        return &stored;
+    }
 
-        for (unsigned int x = 0; x < ret->width_; ++x) {
-            if ((*scanlinePtr & pow2[bitIndex]) != 0) {
-                ret->data_[y * ret->width_ + x] = 1;
+    // one bit per pixel, each line starts at a new byte
+    std::vector<uint8_t>& page = atlasPages_[stored.atlasPage_];
+    const uint8_t* scanline = data_ + offset + 4;
+    for (unsigned int y = 0; y < stored.height_; ++y) {
+        uint8_t* atlasLine = &page[(stored.atlasY_ + y) * ATLAS_WIDTH + stored.atlasX_];
+        for (unsigned int x = 0; x < stored.width_; ++x) {
+            if ((scanline[x >> 3] >> (7 - (x & 7))) & 1) {
+                atlasLine[x] = ATLAS_GLYPH;
             }
+        }
+        scanline += lineWidth;
+    }
 
-            if (bitIndex == 0) {
-                bitIndex = 7;
+    addBorder(stored);
 
-                if (x < ret->width_-1) { // only advance pointer if this is not already the last byte for this char
-                    ++scanlinePtr;
+    return &stored;
+}
+
+void UniFontLoader::addToAtlas(UnicodeCharacter& character) {
+    if (character.width_ == 0 || character.height_ == 0) {
+        return;
+    }
+
+    // the glyph is stored with its border. One pixel space between characters, to avoid bleeding when the atlas is filtered
+    unsigned int slotWidth = character.width_ + ATLAS_BORDER_WIDTH * 2;
+    unsigned int slotHeight = character.height_ + ATLAS_BORDER_WIDTH * 2;
+
+    if (shelfX_ + slotWidth > ATLAS_WIDTH) {
+        shelfY_ += shelfHeight_ + 1;
+        shelfX_ = 0;
+        shelfHeight_ = 0;
+    }
+
+    if (atlasPages_.empty() || shelfY_ + slotHeight > ATLAS_PAGE_HEIGHT) {
+        atlasPages_.push_back(std::vector<uint8_t>(ATLAS_WIDTH * ATLAS_PAGE_HEIGHT, 0));
+        shelfX_ = 0;
+        shelfY_ = 0;
+        shelfHeight_ = 0;
+    }
+
+    character.atlasPage_ = atlasPages_.size() - 1;
+    character.atlasX_ = shelfX_ + ATLAS_BORDER_WIDTH;
+    character.atlasY_ = shelfY_ + ATLAS_BORDER_WIDTH;
+    shelfX_ += slotWidth + 1;
+    if (slotHeight > shelfHeight_) {
+        shelfHeight_ = slotHeight;
+    }
+}
+
+void UniFontLoader::addBorder(const UnicodeCharacter& character) {
+    std::vector<uint8_t>& page = atlasPages_[character.atlasPage_];
+    int border = ATLAS_BORDER_WIDTH;
+
+    // same as drawing the glyph shifted into all directions below it
+    for (unsigned int y = 0; y < character.height_; ++y) {
+        for (unsigned int x = 0; x < character.width_; ++x) {
+            if (page[(character.atlasY_ + y) * ATLAS_WIDTH + character.atlasX_ + x] != ATLAS_GLYPH) {
+                continue;
+            }
+
+            for (int offY = -border; offY <= border; ++offY) {
+                uint8_t* borderLine = &page[(character.atlasY_ + y + offY) * ATLAS_WIDTH + character.atlasX_ + x];
+                for (int offX = -border; offX <= border; ++offX) {
+                    if (borderLine[offX] == 0) {
+                        borderLine[offX] = ATLAS_BORDER;
+                    }
                 }
-            } else {
-                bitIndex--;
             }
         }
     }
-
-    cache_[character] = ret;
-
-    return ret;
 }
 
 unsigned int UniFontLoader::getMaxHeight() {
     return maxHeight_;
 }
 
-#undef BORDER_WIDTH
+unsigned int UniFontLoader::getCharacterCount() const {
+    return characters_.size();
+}
 
+const UnicodeCharacter* UniFontLoader::getCharacterByIndex(unsigned int index) const {
+    return &characters_[index];
+}
+
+unsigned int UniFontLoader::getAtlasPageCount() const {
+    return atlasPages_.size();
+}
+
+const uint8_t* UniFontLoader::getAtlasPageData(unsigned int page) const {
+    return &atlasPages_[page][0];
+}
+
+void UniFontLoader::debugPrintToConsole(const UnicodeCharacter* character) const {
+    LOG_DEBUG << "UnicodeCharacter code=" << character->charCode_ << " xOff=" << character->xOffset_ << " yOff=" << character->yOffset_ <<
+            " width=" << character->width_ << " height=" << character->height_ << std::endl;
+    for (unsigned int y = 0; y < character->height_; ++y) {
+        for (unsigned int x = 0; x < character->width_; ++x) {
+            if (atlasPages_[character->atlasPage_][(character->atlasY_ + y) * ATLAS_WIDTH + character->atlasX_ + x] == ATLAS_GLYPH) {
+                printf("o");
+            } else {
+                printf(" ");
+            }
+        }
+        printf("\n");
+    }
+    LOG_DEBUG << "end UnicodeCharacter" << std::endl;
+}
 
 }
 }
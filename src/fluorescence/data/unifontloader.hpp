@@ -17,14 +17,17 @@
  */
 
 
+
 #ifndef FLUO_DATA_UNIFONTLOADER_HPP
 #define FLUO_DATA_UNIFONTLOADER_HPP
 
-#include <map>
+#include <deque>
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
 #include <boost/filesystem.hpp>
-#include <boost/filesystem/fstream.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 #include <misc/string.hpp>
 
@@ -41,38 +44,78 @@ public:
     UnicodeCharacter();
     UnicodeCharacter(unsigned int charCode, int xOffset, int yOffset, int width, int height);
 
-    ~UnicodeCharacter();
-
     unsigned int charCode_;
     int xOffset_;
     int yOffset_;
     unsigned int width_;
     unsigned int height_;
-    uint8_t* data_;
+
+    // position of the pixels in the glyph atlas of the font. The border is stored in the ATLAS_BORDER_WIDTH pixels around it
+    unsigned int atlasPage_;
+    unsigned int atlasX_;
+    unsigned int atlasY_;
 
     unsigned int getTotalWidth() const;
     unsigned int getTotalHeight() const;
-
-    void debugPrintToConsole() const;
 };
 
+/**
+ * \brief Loads the characters of a unifontX.mul file
+ *
+ * The file is mapped into memory. Characters are decoded on first use into a glyph atlas shared by all users of the font,
+ * one byte per pixel (ATLAS_GLYPH, ATLAS_BORDER or 0 for transparent). The atlas consists of pages with a fixed size,
+ * a new page is started when the current one is full. Characters are never moved.
+ */
 class UniFontLoader {
-private:
-    typedef std::map<unsigned int, boost::shared_ptr<UnicodeCharacter> > MapType;
-
 public:
     UniFontLoader(const boost::filesystem::path& mulPath);
+    ~UniFontLoader();
 
-    boost::shared_ptr<UnicodeCharacter> getCharacter(unsigned int character);
+    /// Returns NULL if the font does not contain this character. The pointer stays valid for the lifetime of the loader
+    const UnicodeCharacter* getCharacter(unsigned int character);
 
     unsigned int getMaxHeight();
 
+    /// Characters in the order they were added to the atlas
+    unsigned int getCharacterCount() const;
+    const UnicodeCharacter* getCharacterByIndex(unsigned int index) const;
+
+    static const unsigned int ATLAS_WIDTH = 512;
+    static const unsigned int ATLAS_PAGE_HEIGHT = 512;
+    static const unsigned int ATLAS_BORDER_WIDTH = 1;
+
+    static const uint8_t ATLAS_GLYPH = 1;
+    /// Pixels next to a glyph pixel, including the diagonals
+    static const uint8_t ATLAS_BORDER = 2;
+
+    unsigned int getAtlasPageCount() const;
+    const uint8_t* getAtlasPageData(unsigned int page) const;
+
+    void debugPrintToConsole(const UnicodeCharacter* character) const;
+
 private:
-    boost::filesystem::ifstream stream_;
+    boost::interprocess::file_mapping* fileMapping_;
+    boost::interprocess::mapped_region* mappedRegion_;
+    // used if the file can not be mapped
+    std::vector<uint8_t> fileData_;
+
+    const uint8_t* data_;
+    unsigned int dataSize_;
+
+    static const uint32_t NOT_LOADED = 0xFFFFFFFFu;
+    static const uint32_t NOT_AVAILABLE = 0xFFFFFFFEu;
+
+    // index into characters_ for each char code
+    std::vector<uint32_t> characterIndex_;
+    std::deque<UnicodeCharacter> characters_;
 
-    MapType cache_;
+    std::vector<std::vector<uint8_t> > atlasPages_;
+    unsigned int shelfX_;
+    unsigned int shelfY_;
+    unsigned int shelfHeight_;
 
-    unsigned int offsets_[0x10000];
+    void addToAtlas(UnicodeCharacter& character);
+    void addBorder(const UnicodeCharacter& character);
 
     unsigned int maxHeight_;
 };
@@ -0,0 +1,312 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "uopfile.hpp"
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <algorithm>
+#include <cstdio>
+
+#include <misc/log.hpp>
+#include <misc/exception.hpp>
+
+namespace fluo {
+namespace data {
+
+namespace {
+template<typename T>
+T readValue(boost::filesystem::ifstream& stream) {
+    T ret = 0;
+    stream.read(reinterpret_cast<char*>(&ret), sizeof(T));
+    return ret;
+}
+
+bool compareChunks(const UopFile::Chunk& a, const UopFile::Chunk& b) {
+    return a.logicalOffset_ < b.logicalOffset_;
+}
+}
+
+bool UopFile::isUopPath(const boost::filesystem::path& path) {
+    std::string extension = path.extension();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".uop";
+}
+
+uint64_t UopFile::hashName(const std::string& name) {
+    // Bob Jenkins' lookup3 hashlittle2, as used by the client
+    uint32_t length = name.size();
+    uint32_t a, b, c;
+    a = b = c = 0xDEADBEEF + length;
+
+    const uint8_t* k = reinterpret_cast<const uint8_t*>(name.c_str());
+
+    while (length > 12) {
+        a += k[0] | ((uint32_t)k[1] << 8) | ((uint32_t)k[2] << 16) | ((uint32_t)k[3] << 24);
+        b += k[4] | ((uint32_t)k[5] << 8) | ((uint32_t)k[6] << 16) | ((uint32_t)k[7] << 24);
+        c += k[8] | ((uint32_t)k[9] << 8) | ((uint32_t)k[10] << 16) | ((uint32_t)k[11] << 24);
+
+        a -= c; a ^= (c << 4) | (c >> 28); c += b;
+        b -= a; b ^= (a << 6) | (a >> 26); a += c;
+        c -= b; c ^= (b << 8) | (b >> 24); b += a;
+        a -= c; a ^= (c << 16) | (c >> 16); c += b;
+        b -= a; b ^= (a << 19) | (a >> 13); a += c;
+        c -= b; c ^= (b << 4) | (b >> 28); b += a;
+
+        length -= 12;
+        k += 12;
+    }
+
+    if (length == 0) {
+        return (static_cast<uint64_t>(b) << 32) | c;
+    }
+
+    switch (length) {
+        case 12: c += (uint32_t)k[11] << 24;
+        case 11: c += (uint32_t)k[10] << 16;
+        case 10: c += (uint32_t)k[9] << 8;
+        case 9: c += k[8];
+        case 8: b += (uint32_t)k[7] << 24;
+        case 7: b += (uint32_t)k[6] << 16;
+        case 6: b += (uint32_t)k[5] << 8;
+        case 5: b += k[4];
+        case 4: a += (uint32_t)k[3] << 24;
+        case 3: a += (uint32_t)k[2] << 16;
+        case 2: a += (uint32_t)k[1] << 8;
+        case 1: a += k[0];
+    }
+
+    c ^= b; c -= (b << 14) | (b >> 18);
+    a ^= c; a -= (c << 11) | (c >> 21);
+    b ^= a; b -= (a << 25) | (a >> 7);
+    c ^= b; c -= (b << 16) | (b >> 16);
+    a ^= c; a -= (c << 4) | (c >> 28);
+    b ^= a; b -= (a << 14) | (a >> 18);
+    c ^= b; c -= (b << 24) | (b >> 8);
+
+    return (static_cast<uint64_t>(b) << 32) | c;
+}
+
+UopFile::UopFile(const boost::filesystem::path& path) : path_(path), extraInData_(false) {
+    boost::filesystem::ifstream stream(path, std::ios_base::binary);
+    if (!stream.is_open()) {
+        throw Exception("Error opening uop file");
+    }
+
+    if (readValue<uint32_t>(stream) != MAGIC) {
+        LOG_ERROR << "Invalid uop header in " << path << std::endl;
+        throw Exception("Invalid uop file");
+    }
+
+    readValue<uint32_t>(stream); // version
+    readValue<uint32_t>(stream); // signature
+    uint64_t nextTable = readValue<uint64_t>(stream);
+    readValue<uint32_t>(stream); // table capacity
+    uint32_t fileCount = readValue<uint32_t>(stream);
+
+    uint64_t fileSize = boost::filesystem::file_size(path);
+
+    while (nextTable != 0) {
+        if (nextTable >= fileSize) {
+            LOG_ERROR << "Invalid uop table offset in " << path << std::endl;
+            throw Exception("Invalid uop file");
+        }
+
+        stream.seekg(nextTable, std::ios_base::beg);
+        uint32_t tableCount = readValue<uint32_t>(stream);
+        nextTable = readValue<uint64_t>(stream);
+
+        for (unsigned int i = 0; i < tableCount; ++i) {
+            uint64_t headerOffset = readValue<uint64_t>(stream);
+            uint32_t headerLength = readValue<uint32_t>(stream);
+
+            Entry entry;
+            entry.compressedLength_ = readValue<uint32_t>(stream);
+            entry.decompressedLength_ = readValue<uint32_t>(stream);
+            uint64_t hash = readValue<uint64_t>(stream);
+            readValue<uint32_t>(stream); // adler32 of the data
+            entry.compression_ = readValue<uint16_t>(stream);
+
+            if (headerOffset == 0) {
+                // unused slot
+                continue;
+            }
+
+            entry.dataOffset_ = headerOffset + headerLength;
+            entries_[hash] = entry;
+        }
+
+        if (!stream.good()) {
+            LOG_ERROR << "Unexpected end of uop file " << path << std::endl;
+            throw Exception("Invalid uop file");
+        }
+    }
+
+    if (entries_.size() != fileCount) {
+        LOG_WARN << "Uop file " << path << " announces " << fileCount << " entries, found " << entries_.size() << std::endl;
+    }
+
+    // e.g. artLegacyMUL.uop => build/artlegacymul/00000000.tga
+    std::string stem = path.stem();
+    std::transform(stem.begin(), stem.end(), stem.begin(), ::tolower);
+    entryPrefix_ = "build/" + stem + "/";
+    if (stem == "artlegacymul" || stem == "gumpartlegacymul") {
+        entryExtension_ = ".tga";
+    } else {
+        entryExtension_ = ".dat";
+    }
+    extraInData_ = stem == "gumpartlegacymul";
+}
+
+std::string UopFile::getEntryName(unsigned int id) const {
+    char idStr[16];
+    snprintf(idStr, 16, "%08u", id);
+    return entryPrefix_ + idStr + entryExtension_;
+}
+
+const UopFile::Entry* UopFile::find(unsigned int id) const {
+    std::map<uint64_t, Entry>::const_iterator iter = entries_.find(hashName(getEntryName(id)));
+    if (iter == entries_.end()) {
+        return NULL;
+    } else {
+        return &iter->second;
+    }
+}
+
+unsigned int UopFile::getEntryCount() const {
+    return entries_.size();
+}
+
+void UopFile::buildIndex(std::vector<IndexBlock>& blocks) const {
+    IndexBlock missing;
+    missing.offset_ = 0xFFFFFFFFu;
+    missing.length_ = 0;
+    missing.extra_ = 0;
+    missing.decompressedLength_ = 0;
+
+    boost::filesystem::ifstream stream;
+    if (extraInData_) {
+        stream.open(path_, std::ios_base::binary);
+    }
+
+    blocks.clear();
+    unsigned int found = 0;
+    for (unsigned int id = 0; id < MAX_ID && found < entries_.size(); ++id) {
+        const Entry* entry = find(id);
+        if (!entry) {
+            continue;
+        }
+        ++found;
+
+        if (entry->dataOffset_ + entry->compressedLength_ > 0xFFFFFFFFu) {
+            LOG_WARN << "Uop entry " << getEntryName(id) << " is out of the supported file size" << std::endl;
+            continue;
+        }
+
+        IndexBlock block;
+        block.offset_ = entry->dataOffset_;
+        block.length_ = entry->compressedLength_;
+        block.extra_ = 0;
+
+        if (entry->compression_ == Compression::NONE) {
+            block.decompressedLength_ = 0;
+        } else if (entry->compression_ == Compression::ZLIB) {
+            block.decompressedLength_ = entry->decompressedLength_;
+        } else {
+            LOG_WARN << "Unsupported compression " << entry->compression_ << " for uop entry " << getEntryName(id) << std::endl;
+            continue;
+        }
+
+        if (extraInData_) {
+            if (block.decompressedLength_ != 0 || block.length_ < 8) {
+                LOG_WARN << "Unable to read size of uop entry " << getEntryName(id) << std::endl;
+                continue;
+            }
+
+            stream.seekg(block.offset_, std::ios_base::beg);
+            uint32_t width = readValue<uint32_t>(stream);
+            uint32_t height = readValue<uint32_t>(stream);
+            block.extra_ = (width << 16) | (height & 0xFFFF);
+            block.offset_ += 8;
+            block.length_ -= 8;
+        }
+
+        if (blocks.size() <= id) {
+            blocks.resize(id + 1, missing);
+        }
+        blocks[id] = block;
+    }
+
+    if (found < entries_.size()) {
+        LOG_WARN << "Uop file " << path_ << " contains " << (entries_.size() - found) << " entries not following the naming scheme" << std::endl;
+    }
+}
+
+void UopFile::buildChunkTable(std::vector<Chunk>& chunks) const {
+    chunks.clear();
+
+    uint32_t logicalOffset = 0;
+    unsigned int found = 0;
+    for (unsigned int id = 0; id < MAX_ID && found < entries_.size(); ++id) {
+        const Entry* entry = find(id);
+        if (!entry) {
+            // chunks are numbered without gaps
+            break;
+        }
+        ++found;
+
+        if (entry->compression_ != Compression::NONE) {
+            LOG_WARN << "Compressed uop entry " << getEntryName(id) << " can not be read partially, skipping it" << std::endl;
+        } else {
+            Chunk chunk;
+            chunk.logicalOffset_ = logicalOffset;
+            chunk.dataOffset_ = entry->dataOffset_;
+            chunk.length_ = entry->compressedLength_;
+            chunks.push_back(chunk);
+        }
+
+        logicalOffset += entry->decompressedLength_;
+    }
+
+    std::sort(chunks.begin(), chunks.end(), compareChunks);
+}
+
+bool UopFile::translateChunkOffset(const std::vector<Chunk>& chunks, unsigned int logicalOffset, unsigned int length,
+        unsigned int& dataOffset) {
+    // find the last chunk starting at or before logicalOffset
+    Chunk key;
+    key.logicalOffset_ = logicalOffset;
+    std::vector<Chunk>::const_iterator iter = std::upper_bound(chunks.begin(), chunks.end(), key, compareChunks);
+    if (iter == chunks.begin()) {
+        return false;
+    }
+    --iter;
+
+    unsigned int offsetInChunk = logicalOffset - iter->logicalOffset_;
+    if (offsetInChunk + length > iter->length_) {
+        return false;
+    }
+
+    dataOffset = iter->dataOffset_ + offsetInChunk;
+    return true;
+}
+
+}
+}
@@ -0,0 +1,108 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FLUO_DATA_UOPFILE_HPP
+#define FLUO_DATA_UOPFILE_HPP
+
+#include <boost/filesystem/path.hpp>
+
+#include <map>
+#include <vector>
+#include <string>
+
+#include <stdint.h>
+
+#include "indexloader.hpp"
+
+namespace fluo {
+namespace data {
+
+/**
+ * \brief Reads the entry tables of an uop container (e.g. artLegacyMUL.uop)
+ *
+ * Entries are identified by a hash of their name. The name of the entry for a mul id is derived from the file name,
+ * e.g. "build/artlegacymul/00001234.tga" for id 1234 in artLegacyMUL.uop.
+ */
+class UopFile {
+public:
+    struct Compression {
+    enum {
+        NONE = 0,
+        ZLIB = 1,
+    };
+    };
+
+    struct Entry {
+        uint64_t dataOffset_;
+        uint32_t compressedLength_;
+        uint32_t decompressedLength_;
+        uint16_t compression_;
+    };
+
+    /// Part of a file that is split into several entries of concatenated mul data (the maps)
+    struct Chunk {
+        uint32_t logicalOffset_; ///< offset in the equivalent mul file
+        uint32_t dataOffset_;
+        uint32_t length_;
+    };
+
+    static const uint32_t MAGIC = 0x0050594D;
+
+    static bool isUopPath(const boost::filesystem::path& path);
+
+    static uint64_t hashName(const std::string& name);
+
+    UopFile(const boost::filesystem::path& path);
+
+    std::string getEntryName(unsigned int id) const;
+
+    const Entry* find(unsigned int id) const;
+
+    unsigned int getEntryCount() const;
+
+    /**
+     * Builds the same table an idx file would contain, with offset 0xFFFFFFFF for missing ids.
+     * Gump art stores width and height in front of the data, these are moved to extra
+     */
+    void buildIndex(std::vector<IndexBlock>& blocks) const;
+
+    /// Chunks are sorted by their logical offset. Compressed chunks are skipped
+    void buildChunkTable(std::vector<Chunk>& chunks) const;
+
+    /// Returns false if the logical offset is not part of any chunk
+    static bool translateChunkOffset(const std::vector<Chunk>& chunks, unsigned int logicalOffset, unsigned int length,
+            unsigned int& dataOffset);
+
+private:
+    boost::filesystem::path path_;
+
+    std::string entryPrefix_;
+    std::string entryExtension_;
+    bool extraInData_;
+
+    std::map<uint64_t, Entry> entries_;
+
+    // nobody stores more entries than this in one file. Ids are probed up to this limit
+    static const unsigned int MAX_ID = 0x100000;
+};
+
+}
+}
+
+#endif
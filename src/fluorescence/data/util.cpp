@@ -20,6 +20,24 @@
 
 #include "util.hpp"
 
+#include <stddef.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLUO_UTIL_SSE2
+#include <emmintrin.h>
+
+// the avx2 kernel is compiled with a target attribute and only used if the cpu supports it
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define FLUO_UTIL_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define FLUO_UTIL_NEON
+#include <arm_neon.h>
+#endif
+
 namespace fluo {
 namespace data {
 
@@ -42,5 +60,148 @@ uint32_t Util::getColorRGBA(uint16_t color) {
            ((color) ? 0xFF : 0x00);
 }
 
+/*
+ * All kernels work on 16 bit lanes. For a color c, the two halves of the result are
+ *   high = (r << 8) | g   with r = (c >> 7) & 0xF8, g = (c >> 2) & 0xF8
+ *   low  = (b << 8) | a   with b = (c << 3) & 0xF8, a = c ? 0xFF : 0
+ * and are interleaved to form the 32 bit pixels.
+ */
+
+static void convertRow1555Scalar(const uint16_t* src, uint32_t* dst, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        dst[i] = Util::getColorRGBA(src[i]);
+    }
+}
+
+#ifdef FLUO_UTIL_SSE2
+static void convertRow1555Sse2(const uint16_t* src, uint32_t* dst, unsigned int count) {
+    const __m128i mask = _mm_set1_epi16(0xF8);
+    const __m128i alpha = _mm_set1_epi16(0xFF);
+    const __m128i zero = _mm_setzero_si128();
+
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+
+        __m128i r = _mm_and_si128(_mm_srli_epi16(c, 7), mask);
+        __m128i g = _mm_and_si128(_mm_srli_epi16(c, 2), mask);
+        __m128i b = _mm_and_si128(_mm_slli_epi16(c, 3), mask);
+        __m128i a = _mm_andnot_si128(_mm_cmpeq_epi16(c, zero), alpha);
+
+        __m128i high = _mm_or_si128(_mm_slli_epi16(r, 8), g);
+        __m128i low = _mm_or_si128(_mm_slli_epi16(b, 8), a);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(low, high));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(low, high));
+    }
+
+    convertRow1555Scalar(src + i, dst + i, count - i);
+}
+#endif
+
+#ifdef FLUO_UTIL_AVX2
+__attribute__((target("avx2")))
+static void convertRow1555Avx2(const uint16_t* src, uint32_t* dst, unsigned int count) {
+    const __m256i mask = _mm256_set1_epi16(0xF8);
+    const __m256i alpha = _mm256_set1_epi16(0xFF);
+    const __m256i zero = _mm256_setzero_si256();
+
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+
+        __m256i r = _mm256_and_si256(_mm256_srli_epi16(c, 7), mask);
+        __m256i g = _mm256_and_si256(_mm256_srli_epi16(c, 2), mask);
+        __m256i b = _mm256_and_si256(_mm256_slli_epi16(c, 3), mask);
+        __m256i a = _mm256_andnot_si256(_mm256_cmpeq_epi16(c, zero), alpha);
+
+        __m256i high = _mm256_or_si256(_mm256_slli_epi16(r, 8), g);
+        __m256i low = _mm256_or_si256(_mm256_slli_epi16(b, 8), a);
+
+        // unpack works on each 128 bit lane separately, pixels 0-3 and 8-11 end up in the first register
+        __m256i first = _mm256_unpacklo_epi16(low, high);
+        __m256i second = _mm256_unpackhi_epi16(low, high);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+
+    convertRow1555Sse2(src + i, dst + i, count - i);
+}
+#endif
+
+#ifdef FLUO_UTIL_NEON
+static void convertRow1555Neon(const uint16_t* src, uint32_t* dst, unsigned int count) {
+    const uint16x8_t mask = vdupq_n_u16(0xF8);
+    const uint16x8_t alpha = vdupq_n_u16(0xFF);
+    const uint16x8_t zero = vdupq_n_u16(0);
+
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint16x8_t c = vld1q_u16(src + i);
+
+        uint16x8_t r = vandq_u16(vshrq_n_u16(c, 7), mask);
+        uint16x8_t g = vandq_u16(vshrq_n_u16(c, 2), mask);
+        uint16x8_t b = vandq_u16(vshlq_n_u16(c, 3), mask);
+        uint16x8_t a = vbicq_u16(alpha, vceqq_u16(c, zero));
+
+        // the interleaving store writes low, high pairs, which are the 32 bit pixels on little endian
+        uint16x8x2_t pixels;
+        pixels.val[0] = vorrq_u16(vshlq_n_u16(b, 8), a);
+        pixels.val[1] = vorrq_u16(vshlq_n_u16(r, 8), g);
+        vst2q_u16(reinterpret_cast<uint16_t*>(dst + i), pixels);
+    }
+
+    convertRow1555Scalar(src + i, dst + i, count - i);
+}
+#endif
+
+Util::ConvertRowFunc Util::getConvertRow1555Kernel(unsigned int kernel) {
+    switch (kernel) {
+    case KERNEL_SCALAR:
+        return &convertRow1555Scalar;
+#ifdef FLUO_UTIL_SSE2
+    case KERNEL_SSE2:
+        return &convertRow1555Sse2;
+#endif
+#ifdef FLUO_UTIL_AVX2
+    case KERNEL_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? &convertRow1555Avx2 : NULL;
+#endif
+#ifdef FLUO_UTIL_NEON
+    case KERNEL_NEON:
+        return &convertRow1555Neon;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+Util::ConvertRowFunc Util::selectConvertRow1555() {
+    // fastest first
+    const unsigned int kernels[] = { KERNEL_AVX2, KERNEL_SSE2, KERNEL_NEON };
+    for (unsigned int i = 0; i < sizeof(kernels) / sizeof(kernels[0]); ++i) {
+        ConvertRowFunc ret = getConvertRow1555Kernel(kernels[i]);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    return &convertRow1555Scalar;
+}
+
+bool Util::convertRow1555With(unsigned int kernel, const uint16_t* src, uint32_t* dst, unsigned int count) {
+    ConvertRowFunc func = getConvertRow1555Kernel(kernel);
+    if (!func) {
+        return false;
+    }
+
+    func(src, dst, count);
+    return true;
+}
+
+Util::ConvertRowFunc Util::convertRow1555Impl_ = selectConvertRow1555();
+
 }
 }
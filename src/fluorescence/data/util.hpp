@@ -31,6 +31,31 @@ public:
     static uint8_t getColorG(uint16_t color);
     static uint8_t getColorB(uint16_t color);
     static uint32_t getColorRGBA(uint16_t color);
+
+    /**
+     * Converts count ARGB1555 colors to the RGBA8 format of getColorRGBA.
+     * Uses the fastest kernel (AVX2, SSE2, NEON or plain C++) supported by the cpu, selected at startup
+     */
+    static void convertRow1555(const uint16_t* src, uint32_t* dst, unsigned int count) {
+        convertRow1555Impl_(src, dst, count);
+    }
+
+    enum {
+        KERNEL_SCALAR,
+        KERNEL_SSE2,
+        KERNEL_AVX2,
+        KERNEL_NEON,
+        KERNEL_COUNT,
+    };
+
+    /// Runs one specific kernel of convertRow1555. Returns false if it is not compiled in or not supported by the cpu
+    static bool convertRow1555With(unsigned int kernel, const uint16_t* src, uint32_t* dst, unsigned int count);
+
+private:
+    typedef void (*ConvertRowFunc)(const uint16_t*, uint32_t*, unsigned int);
+    static ConvertRowFunc convertRow1555Impl_;
+    static ConvertRowFunc selectConvertRow1555();
+    static ConvertRowFunc getConvertRow1555Kernel(unsigned int kernel);
 };
 
 }
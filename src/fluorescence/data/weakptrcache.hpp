@@ -28,11 +28,18 @@
 
 #include <misc/log.hpp>
 
+#include "workerpool.hpp"
+#include "retentiontier.hpp"
+
 namespace fluo {
 namespace data {
 
 /**
  * \brief This class provides caching based on weak pointers. Additionally, it provides support for fixing items in the memory
+ *
+ * Optionally, the most recently used items are kept alive up to a byte budget (see RetentionTier), so that items which
+ * are released and requested again shortly afterwards (e.g. when walking back and forth over a sector border) are not
+ * loaded again.
  */
 template <
 typename KeyType,
@@ -41,17 +48,34 @@ template <typename, typename> class FileLoader
 >
 class WeakPtrCache {
 private:
-    typedef std::map<KeyType, boost::weak_ptr<ValueType> > MapType;
+    typedef RetentionTier<KeyType, ValueType> RetentionType;
+
+    struct Entry {
+        Entry() : retained_(false) {
+        }
+
+        boost::weak_ptr<ValueType> item_;
+        bool retained_;
+        typename RetentionType::Handle retentionHandle_; ///< Only valid if retained_ is true
+    };
+
+    typedef std::map<KeyType, Entry> MapType;
     typedef std::list<boost::shared_ptr<ValueType> > FixedListType;
 
 public:
-    WeakPtrCache() {
+    WeakPtrCache() : hitCount_(0), retainedHitCount_(0), missCount_(0) {
     }
 
     void init(boost::shared_ptr<FileLoader<KeyType, ValueType> > loader) {
         loader_ = loader;
     }
 
+    /// Sets the byte budget for keeping recently used items alive. 0 disables retention
+    void setRetentionBudget(unsigned int bytes) {
+        retention_.setBudget(bytes);
+        evictRetained();
+    }
+
     /// Fixes an item in the memory
     void fixItem(const KeyType& id) {
         boost::shared_ptr<ValueType> toFix = get(id);
@@ -78,27 +102,45 @@ public:
         typename MapType::iterator iter = this->cache_.find(id);
         if (iter != this->cache_.end()) {
             // was loaded at some point
-            return iter->second.lock();
+            return iter->second.item_.lock();
         } else {
             return boost::shared_ptr<ValueType>();
         }
     }
 
 
-    boost::shared_ptr<ValueType> get(const KeyType& id, unsigned int userData = 0) {
+    /**
+     * Returns the cached object, or starts loading it with the given LoadPriority.
+     * An object that is still being loaded with a lower priority is moved up to the given one.
+     */
+    boost::shared_ptr<ValueType> get(const KeyType& id, unsigned int userData = 0, unsigned int priority = LoadPriority::VISIBLE) {
         typename MapType::iterator iter = this->cache_.find(id);
         if (iter != this->cache_.end()) {
             // was loaded at some point - is it still valid?
-            boost::shared_ptr<ValueType> smPtr = iter->second.lock();
+            boost::shared_ptr<ValueType> smPtr = iter->second.item_.lock();
             if (smPtr.get() != NULL) {
+                ++hitCount_;
+                if (iter->second.retained_) {
+                    if (smPtr.use_count() == 2 && retention_.isPinned(iter->second.retentionHandle_)) {
+                        // only smPtr and the retention tier hold the item
+                        ++retainedHitCount_;
+                    }
+                    retention_.touch(iter->second.retentionHandle_);
+                } else {
+                    retain(iter->first, iter->second, smPtr);
+                }
+
+                if (!smPtr->isReadComplete()) {
+                    loader_->raisePriority(smPtr, priority);
+                }
                 return smPtr;
             } else {
                 // we need to reload it
-                return this->load(id, userData);
+                return this->load(id, userData, priority);
             }
         } else {
             // we need to load it for the first time
-            return this->load(id, userData);
+            return this->load(id, userData, priority);
         }
     }
 
@@ -119,7 +161,7 @@ public:
 
         for (; iter != end; ++iter) {
             // was loaded at some point - is it still valid?
-            boost::shared_ptr<ValueType> smPtr = iter->second.lock();
+            boost::shared_ptr<ValueType> smPtr = iter->second.item_.lock();
             if (smPtr) {
                 realCount += 1;
                 unsigned int width = smPtr->getWidth();
@@ -134,25 +176,84 @@ public:
         }
 
         LOG_DEBUG << "WeakPtrCache stats: weak=" << weakCount << " real=" << realCount << std::endl;
+        LOG_DEBUG << "Requests hits=" << hitCount_ << " (retained=" << retainedHitCount_ << ") misses=" << missCount_ <<
+                "  retention items=" << retention_.getItemCount() << " bytes=" << retention_.getUsedBytes() << "/" << retention_.getBudget() <<
+                " evictions=" << retention_.getEvictionCount() << std::endl;
         LOG_DEBUG << "Sizes avg=" << (avgWidth / realCount) << "/" << (avgHeight / realCount) << "  max=" << maxWidth << "/" << maxHeight << std::endl;
     }
 
+    unsigned int getHitCount() const {
+        return hitCount_;
+    }
+
+    /// Hits on items that were only kept alive by the retention tier
+    unsigned int getRetainedHitCount() const {
+        return retainedHitCount_;
+    }
+
+    unsigned int getMissCount() const {
+        return missCount_;
+    }
+
+    unsigned int getRetainedItemCount() const {
+        return retention_.getItemCount();
+    }
+
+    unsigned int getRetainedBytes() const {
+        return retention_.getUsedBytes();
+    }
+
     void clear() {
         fixedList_.clear();
+        retention_.clear();
         cache_.clear();
     }
 
 private:
     MapType cache_;
     FixedListType fixedList_; ///< Keeps a shared_ptr to fixed items. May contain duplicates
+    RetentionType retention_;
+
+    unsigned int hitCount_;
+    unsigned int retainedHitCount_;
+    unsigned int missCount_;
 
     boost::shared_ptr<FileLoader<KeyType, ValueType> > loader_;
 
-    boost::shared_ptr<ValueType> load(const KeyType& id, unsigned int userData) {
-        boost::shared_ptr<ValueType> smPtr = loader_->get(id, userData);
-        cache_[id] = boost::weak_ptr<ValueType>(smPtr);
+    boost::shared_ptr<ValueType> load(const KeyType& id, unsigned int userData, unsigned int priority) {
+        ++missCount_;
+        boost::shared_ptr<ValueType> smPtr = loader_->get(id, userData, priority);
+
+        Entry& entry = cache_[id];
+        entry.item_ = smPtr;
+        if (entry.retained_) {
+            // the retained item was replaced
+            retention_.remove(entry.retentionHandle_);
+            entry.retained_ = false;
+        }
+        retain(id, entry, smPtr);
+
         return smPtr;
     }
+
+    void retain(const KeyType& id, Entry& entry, const boost::shared_ptr<ValueType>& smPtr) {
+        if (!retention_.isEnabled() || !smPtr) {
+            return;
+        }
+
+        entry.retentionHandle_ = retention_.insert(id, smPtr);
+        entry.retained_ = true;
+        evictRetained();
+    }
+
+    void evictRetained() {
+        while (retention_.isOverBudget()) {
+            typename MapType::iterator iter = cache_.find(retention_.evictOldest());
+            if (iter != cache_.end()) {
+                iter->second.retained_ = false;
+            }
+        }
+    }
 };
 
 }
@@ -0,0 +1,226 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include "workerpool.hpp"
+
+#include <misc/log.hpp>
+
+#include <algorithm>
+
+namespace fluo {
+namespace data {
+
+WorkerPool::WorkerPool(const UnicodeString& name, unsigned int threadCount) : name_(name), threadCount_(threadCount), running_(true) {
+    if (threadCount_ == 0) {
+        threadCount_ = 1;
+    }
+
+    LOG_INFO << "Starting " << name_ << " worker pool with " << threadCount_ << " threads" << std::endl;
+
+    for (unsigned int i = 0; i < threadCount_; ++i) {
+        threads_.create_thread(boost::bind(&WorkerPool::run, this));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        running_ = false;
+        for (unsigned int i = 0; i < LoadPriority::COUNT; ++i) {
+            queues_[i].clear();
+        }
+        signal_.notify_all();
+    }
+
+    threads_.join_all();
+}
+
+void WorkerPool::enqueue(const void* owner, const Job& job, unsigned int priority, const void* item) {
+    if (priority >= LoadPriority::COUNT) {
+        priority = LoadPriority::BACKGROUND;
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    if (blockedOwners_.count(owner)) {
+        return;
+    }
+
+    queues_[priority].push_back(QueuedJob(owner, item, job));
+    signal_.notify_one();
+}
+
+void WorkerPool::raisePriority(const void* owner, const void* item, unsigned int priority) {
+    if (!item || priority >= LoadPriority::COUNT) {
+        return;
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    for (unsigned int i = priority + 1; i < LoadPriority::COUNT; ++i) {
+        std::deque<QueuedJob>::iterator iter = queues_[i].begin();
+        while (iter != queues_[i].end()) {
+            if (iter->owner_ == owner && iter->item_ == item) {
+                queues_[priority].push_back(*iter);
+                iter = queues_[i].erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+}
+
+void WorkerPool::cancel(const void* owner) {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    for (unsigned int i = 0; i < LoadPriority::COUNT; ++i) {
+        std::deque<QueuedJob>::iterator iter = queues_[i].begin();
+        while (iter != queues_[i].end()) {
+            if (iter->owner_ == owner) {
+                iter = queues_[i].erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+
+    std::map<const void*, unsigned int>::iterator runIter = runningJobs_.find(owner);
+    while (runIter != runningJobs_.end()) {
+        jobFinishedSignal_.wait(lock);
+        runIter = runningJobs_.find(owner);
+    }
+}
+
+void WorkerPool::block(const void* owner) {
+    boost::mutex::scoped_lock lock(mutex_);
+    blockedOwners_.insert(owner);
+}
+
+void WorkerPool::unblock(const void* owner) {
+    boost::mutex::scoped_lock lock(mutex_);
+    blockedOwners_.erase(owner);
+}
+
+unsigned int WorkerPool::getThreadCount() const {
+    return threadCount_;
+}
+
+void WorkerPool::parallelFor(unsigned int count, const IndexJob& job) {
+    if (count <= 1 || threadCount_ <= 1) {
+        for (unsigned int i = 0; i < count; ++i) {
+            job(i);
+        }
+        return;
+    }
+
+    boost::shared_ptr<ParallelForState> state(new ParallelForState());
+    state->job_ = job;
+    state->count_ = count;
+    state->nextIndex_ = 0;
+    state->doneCount_ = 0;
+
+    // the calling thread is one of the workers, so at most count - 1 helpers are useful
+    unsigned int helperCount = (std::min)(count, threadCount_) - 1;
+    for (unsigned int i = 0; i < helperCount; ++i) {
+        enqueue(state.get(), boost::bind(&WorkerPool::runParallelFor, this, state), LoadPriority::VISIBLE);
+    }
+
+    runParallelFor(state);
+
+    // only waits for indexes other threads are currently working on, never for helpers that did not start yet
+    boost::mutex::scoped_lock lock(state->mutex_);
+    while (state->doneCount_ < state->count_) {
+        state->doneSignal_.wait(lock);
+    }
+}
+
+void WorkerPool::runParallelFor(boost::shared_ptr<ParallelForState> state) {
+    while (true) {
+        unsigned int index;
+        {
+            boost::mutex::scoped_lock lock(state->mutex_);
+            if (state->nextIndex_ >= state->count_) {
+                return;
+            }
+            index = state->nextIndex_++;
+        }
+
+        try {
+            state->job_(index);
+        } catch (const std::exception& ex) {
+            LOG_ERROR << "Exception in " << name_ << " worker pool parallelFor: " << ex.what() << std::endl;
+        }
+
+        {
+            boost::mutex::scoped_lock lock(state->mutex_);
+            if (++state->doneCount_ == state->count_) {
+                state->doneSignal_.notify_all();
+            }
+        }
+    }
+}
+
+bool WorkerPool::popNext(QueuedJob& job) {
+    for (unsigned int i = 0; i < LoadPriority::COUNT; ++i) {
+        if (!queues_[i].empty()) {
+            job = queues_[i].front();
+            queues_[i].pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkerPool::run() {
+    while (true) {
+        QueuedJob next;
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            while (running_ && !popNext(next)) {
+                signal_.wait(lock);
+            }
+
+            if (!running_) {
+                break;
+            }
+
+            ++runningJobs_[next.owner_];
+        }
+
+        try {
+            next.job_();
+        } catch (const std::exception& ex) {
+            LOG_ERROR << "Exception in " << name_ << " worker pool job: " << ex.what() << std::endl;
+        }
+
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            std::map<const void*, unsigned int>::iterator runIter = runningJobs_.find(next.owner_);
+            if (--runIter->second == 0) {
+                runningJobs_.erase(runIter);
+            }
+            jobFinishedSignal_.notify_all();
+        }
+    }
+}
+
+}
+}
@@ -0,0 +1,136 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_DATA_WORKERPOOL_HPP
+#define FLUO_DATA_WORKERPOOL_HPP
+
+#include <deque>
+#include <map>
+#include <set>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <boost/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <misc/string.hpp>
+
+namespace fluo {
+namespace data {
+
+struct LoadPriority {
+enum {
+    VISIBLE = 0, ///< Required for what is on screen right now
+    PREFETCH = 1, ///< Probably required soon, e.g. sectors just outside the view
+    BACKGROUND = 2, ///< Everything else, e.g. minimap sectors
+
+    COUNT = 3,
+};
+};
+
+/**
+ * \brief A fixed number of threads working on a shared job queue
+ *
+ * Jobs are tagged with an owner, so that all jobs of an owner can be removed before the owner is destroyed.
+ * Queued jobs are served in LoadPriority order (VISIBLE first), jobs of the same priority in FIFO order.
+ */
+class WorkerPool {
+public:
+    typedef boost::function<void ()> Job;
+
+    WorkerPool(const UnicodeString& name, unsigned int threadCount);
+    ~WorkerPool();
+
+    /// item optionally identifies the object the job works on, see raisePriority
+    void enqueue(const void* owner, const Job& job, unsigned int priority = LoadPriority::VISIBLE, const void* item = NULL);
+
+    /// Moves the queued jobs of the given owner and item with a lower priority to the end of the given priority's queue
+    void raisePriority(const void* owner, const void* item, unsigned int priority);
+
+    /// Removes all queued jobs of the given owner and waits until its currently running jobs are finished
+    void cancel(const void* owner);
+
+    /// Drops all jobs the given owner enqueues from now on, until unblock is called. Used to cancel owners enqueueing across pools
+    void block(const void* owner);
+    void unblock(const void* owner);
+
+    unsigned int getThreadCount() const;
+
+    typedef boost::function<void (unsigned int)> IndexJob;
+
+    /**
+     * Calls job for every index in [0, count) and returns when all of them are done.
+     * The calling thread works on the indexes itself, idle threads of the pool help out.
+     * Can be called from within a job of this pool
+     */
+    void parallelFor(unsigned int count, const IndexJob& job);
+
+private:
+    WorkerPool(const WorkerPool& copy) { }
+    WorkerPool& operator=(const WorkerPool& copy) { return *this; }
+
+    struct QueuedJob {
+        const void* owner_;
+        const void* item_;
+        Job job_;
+
+        QueuedJob() : owner_(NULL), item_(NULL) {
+        }
+
+        QueuedJob(const void* owner, const void* item, const Job& job) : owner_(owner), item_(item), job_(job) {
+        }
+    };
+
+    void run();
+
+    UnicodeString name_;
+    unsigned int threadCount_;
+    boost::thread_group threads_;
+    bool running_;
+
+    boost::mutex mutex_;
+    boost::condition_variable signal_;
+    boost::condition_variable jobFinishedSignal_;
+
+    std::deque<QueuedJob> queues_[LoadPriority::COUNT];
+    bool popNext(QueuedJob& job);
+    std::map<const void*, unsigned int> runningJobs_;
+    std::set<const void*> blockedOwners_;
+
+    /// Shared by all threads taking part in one parallelFor call. Helpers starting after all indexes are done only touch this
+    struct ParallelForState {
+        IndexJob job_;
+        unsigned int count_;
+        unsigned int nextIndex_;
+        unsigned int doneCount_;
+
+        boost::mutex mutex_;
+        boost::condition_variable doneSignal_;
+    };
+
+    void runParallelFor(boost::shared_ptr<ParallelForState> state);
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_DATAGEN_CHECKSUM_HPP
+#define FLUO_DATAGEN_CHECKSUM_HPP
+
+#include <string>
+
+#include <stdint.h>
+
+namespace fluo {
+namespace datagen {
+
+/**
+ * \brief 64 bit FNV-1a hash over decoded values
+ *
+ * Numbers are always added as 4 little endian bytes, strings with their length first, so that the generator and
+ * the conformance check get the same result no matter which integer types they hold the values in.
+ */
+class Checksum {
+public:
+    Checksum() : hash_(0xCBF29CE484222325ULL), count_(0) {
+    }
+
+    void add(const void* data, unsigned int len) {
+        const uint8_t* ptr = reinterpret_cast<const uint8_t*>(data);
+        for (unsigned int i = 0; i < len; ++i) {
+            hash_ = (hash_ ^ ptr[i]) * 0x100000001B3ULL;
+        }
+    }
+
+    void add(uint32_t value) {
+        uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+        add(bytes, 4);
+    }
+
+    void add(const std::string& str) {
+        add(str.size());
+        add(str.data(), str.size());
+    }
+
+    void addPixels(const uint32_t* pixels, unsigned int count) {
+        for (unsigned int i = 0; i < count; ++i) {
+            add(pixels[i]);
+        }
+    }
+
+    /// Counts the entries of a section, done once per id or record
+    void addEntry(uint32_t id) {
+        ++count_;
+        add(id);
+    }
+
+    uint64_t get() const {
+        return hash_;
+    }
+
+    unsigned int getCount() const {
+        return count_;
+    }
+
+private:
+    uint64_t hash_;
+    unsigned int count_;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,731 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "conformancecheck.hpp"
+
+#include <data/animdataloader.hpp>
+#include <data/animloader.hpp>
+#include <data/artloader.hpp>
+#include <data/clilocloader.hpp>
+#include <data/deffileloader.hpp>
+#include <data/defstructs.hpp>
+#include <data/difindex.hpp>
+#include <data/equipconvdefloader.hpp>
+#include <data/fullfileloader.hpp>
+#include <data/gumpartloader.hpp>
+#include <data/huesloader.hpp>
+#include <data/indexloader.hpp>
+#include <data/maptexloader.hpp>
+#include <data/mobtypesloader.hpp>
+#include <data/radarcolloader.hpp>
+#include <data/skillsloader.hpp>
+#include <data/sound.hpp>
+#include <data/soundloader.hpp>
+#include <data/spellbooks.hpp>
+#include <data/tiledataloader.hpp>
+#include <data/unifontloader.hpp>
+
+#include <ui/animation.hpp>
+#include <ui/texture.hpp>
+
+#include <misc/exception.hpp>
+#include <misc/log.hpp>
+#include <misc/profiler.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <map>
+#include <random>
+
+#include <string.h>
+
+namespace fluo {
+namespace datagen {
+
+namespace {
+
+const unsigned int LAND_TILE_COUNT = 0x4000;
+const unsigned int MAP_BLOCK_SIZE = 196;
+
+// reading a broken file might never complete
+const unsigned int ITEM_TIMEOUT_MILLIS = 10000;
+
+template<typename T>
+bool waitForItem(const boost::shared_ptr<T>& item) {
+    for (unsigned int i = 0; i < ITEM_TIMEOUT_MILLIS && !item->isReadComplete() && !item->isReadFailed(); ++i) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+
+    return item->isReadComplete();
+}
+
+/// Same rule as IndexedOnDemandFileLoader
+bool hasIndexEntry(const data::IndexLoader& index, unsigned int id) {
+    if (id >= index.size()) {
+        return false;
+    }
+
+    const data::IndexBlock& block = index.get(id);
+    return block.offset_ != 0xFFFFFFFFu && block.length_ != 0xFFFFFFFFu && block.length_ != 0;
+}
+
+void copyFile(std::vector<int8_t>* target, int8_t* buf, unsigned int len) {
+    target->assign(buf, buf + len);
+}
+
+void readFile(const boost::filesystem::path& path, std::vector<int8_t>& target) {
+    data::FullFileLoader loader(path);
+    loader.read(boost::bind(&copyFile, &target, _1, _2));
+}
+
+void addString(Checksum& checksum, const UnicodeString& str) {
+    checksum.add(StringConverter::toUtf8String(str));
+}
+
+/// Compares DifIndex with the lookup MapLoader and StaticsLoader did before: a map from block id to the last dif entry
+unsigned int countDifMismatches(const uint32_t* blockIds, unsigned int entryCount, unsigned int blockCount) {
+    std::map<unsigned int, unsigned int> difEntries;
+    for (unsigned int i = 0; i < entryCount; ++i) {
+        difEntries[blockIds[i]] = i;
+    }
+
+    data::DifIndex difIndex;
+    difIndex.init(blockIds, entryCount, blockCount);
+
+    unsigned int mismatches = 0;
+    for (unsigned int block = 0; block < blockCount; ++block) {
+        unsigned int difIdx = 0;
+        bool isDif = difIndex.find(block, difIdx);
+        std::map<unsigned int, unsigned int>::const_iterator iter = difEntries.find(block);
+        if (isDif != (iter != difEntries.end()) || (isDif && difIdx != iter->second)) {
+            ++mismatches;
+        }
+    }
+
+    // the loaders clamp coordinates outside of the facet, so these ids never reached the map
+    unsigned int difIdx = 0;
+    if (difIndex.find(blockCount, difIdx)) {
+        ++mismatches;
+    }
+
+    return mismatches;
+}
+
+}
+
+ConformanceCheck::ConformanceCheck(const boost::filesystem::path& directory) : directory_(directory), failedCount_(0) {
+    manifest_.load(directory_ / Manifest::FILE_NAME);
+}
+
+bool ConformanceCheck::run() {
+    failedCount_ = 0;
+    checkedSections_.clear();
+
+    std::vector<std::pair<const char*, boost::function<void ()> > > checks;
+    checks.push_back(std::make_pair("tiledata", boost::bind(&ConformanceCheck::checkTileData, this)));
+    checks.push_back(std::make_pair("hues", boost::bind(&ConformanceCheck::checkHues, this)));
+    checks.push_back(std::make_pair("radarcol", boost::bind(&ConformanceCheck::checkRadarCol, this)));
+    checks.push_back(std::make_pair("art", boost::bind(&ConformanceCheck::checkArt, this)));
+    checks.push_back(std::make_pair("gumpart", boost::bind(&ConformanceCheck::checkGumpArt, this)));
+    checks.push_back(std::make_pair("texmaps", boost::bind(&ConformanceCheck::checkTexMaps, this)));
+    checks.push_back(std::make_pair("anim", boost::bind(&ConformanceCheck::checkAnim, this)));
+    checks.push_back(std::make_pair("animdata", boost::bind(&ConformanceCheck::checkAnimData, this)));
+    checks.push_back(std::make_pair("map0", boost::bind(&ConformanceCheck::checkMap, this)));
+    checks.push_back(std::make_pair("statics0", boost::bind(&ConformanceCheck::checkStatics, this)));
+    checks.push_back(std::make_pair("difs", boost::bind(&ConformanceCheck::checkDifIndex, this)));
+    checks.push_back(std::make_pair("unifont", boost::bind(&ConformanceCheck::checkUniFont, this, "unifont")));
+    checks.push_back(std::make_pair("unifont1", boost::bind(&ConformanceCheck::checkUniFont, this, "unifont1")));
+    checks.push_back(std::make_pair("cliloc", boost::bind(&ConformanceCheck::checkCliloc, this)));
+    checks.push_back(std::make_pair("skills", boost::bind(&ConformanceCheck::checkSkills, this)));
+    checks.push_back(std::make_pair("sound", boost::bind(&ConformanceCheck::checkSound, this)));
+    checks.push_back(std::make_pair("def files", boost::bind(&ConformanceCheck::checkDefFiles, this)));
+    checks.push_back(std::make_pair("spellbooks", boost::bind(&ConformanceCheck::checkSpellbooks, this)));
+
+    for (unsigned int i = 0; i < checks.size(); ++i) {
+        ProfilePhase phase(checks[i].first);
+        try {
+            checks[i].second();
+        } catch (const std::exception& ex) {
+            LOG_ERROR << "Unable to check " << checks[i].first << ": " << ex.what() << std::endl;
+            ++failedCount_;
+        }
+    }
+
+    std::map<std::string, Manifest::Section>::const_iterator iter = manifest_.getSections().begin();
+    std::map<std::string, Manifest::Section>::const_iterator end = manifest_.getSections().end();
+    for (; iter != end; ++iter) {
+        if (checkedSections_.find(iter->first) == checkedSections_.end()) {
+            LOG_ERROR << "Section " << iter->first << " of the manifest was not checked" << std::endl;
+            ++failedCount_;
+        }
+    }
+
+    if (failedCount_ > 0) {
+        LOG_ERROR << failedCount_ << " conformance checks failed" << std::endl;
+    } else {
+        LOG_INFO << "All " << checkedSections_.size() << " sections match the manifest" << std::endl;
+    }
+
+    return failedCount_ == 0;
+}
+
+void ConformanceCheck::compare(const std::string& section, const Checksum& checksum) {
+    checkedSections_.insert(section);
+
+    const Manifest::Section& expected = manifest_.getSection(section);
+    if (expected.count_ == checksum.getCount() && expected.checksum_ == checksum.get()) {
+        LOG_INFO << section << ": " << checksum.getCount() << " entries ok" << std::endl;
+    } else {
+        LOG_ERROR << section << ": expected " << expected.count_ << " entries, decoded " << checksum.getCount() <<
+                ". Checksum expected " << std::hex << expected.checksum_ << ", decoded " << checksum.get() << std::dec << std::endl;
+        ++failedCount_;
+    }
+}
+
+void ConformanceCheck::addTextures(Checksum& checksum, const TextureList& textures) {
+    for (unsigned int i = 0; i < textures.size(); ++i) {
+        unsigned int id = textures[i].first;
+        boost::shared_ptr<ui::Texture> tex = textures[i].second;
+        if (!tex || !waitForItem(tex) || tex->getPixelBuffer().is_null()) {
+            LOG_ERROR << "Unable to load texture " << id << std::endl;
+            continue;
+        }
+
+        unsigned int width = tex->getPixelBuffer().get_width();
+        unsigned int height = tex->getPixelBuffer().get_height();
+        checksum.addEntry(id);
+        checksum.add(width);
+        checksum.add(height);
+        checksum.addPixels(tex->getPixelBufferData(), width * height);
+    }
+}
+
+void ConformanceCheck::checkTileData() {
+    data::TileDataLoader loader(directory_ / "tiledata.mul", manifest_.getOption("high-seas") != 0);
+    Checksum checksum;
+
+    for (unsigned int id = 0; id < loader.getLandTileCount(); ++id) {
+        data::LandTileInfo info = loader.getLandTileInfo(id);
+        checksum.addEntry(id);
+        checksum.add(info.flags());
+        checksum.add(info.textureId());
+        addString(checksum, info.name());
+    }
+
+    for (unsigned int id = 0; id < loader.getStaticTileCount(); ++id) {
+        data::StaticTileInfo info = loader.getStaticTileInfo(id);
+        const data::StaticTileDetails& details = info.details();
+        checksum.addEntry(LAND_TILE_COUNT + id);
+        checksum.add(info.flags());
+        checksum.add(details.weight_);
+        checksum.add(details.quality_);
+        checksum.add(details.unknown1_);
+        checksum.add(details.unknown2_);
+        checksum.add(details.quantity_);
+        checksum.add(info.animId());
+        checksum.add(details.unknown3_);
+        checksum.add(details.hue_);
+        checksum.add(details.unknown4_);
+        checksum.add(details.unknown5_);
+        checksum.add(info.height());
+        addString(checksum, info.name());
+    }
+
+    compare("tiledata", checksum);
+}
+
+void ConformanceCheck::checkHues() {
+    data::HuesLoader loader(directory_ / "hues.mul");
+    Checksum checksum;
+
+    for (unsigned int hue = 1; hue <= loader.getHueCount(); ++hue) {
+        checksum.addEntry(hue);
+        checksum.add(loader.getFontRgbColor(hue));
+    }
+
+    compare("hues", checksum);
+}
+
+void ConformanceCheck::checkRadarCol() {
+    const Manifest::Section& section = manifest_.getSection("radarcol");
+    data::RadarColLoader loader(directory_ / "radarcol.mul");
+    Checksum checksum;
+
+    for (unsigned int id = section.first_; id < section.end_; ++id) {
+        checksum.addEntry(id);
+        checksum.add(id < LAND_TILE_COUNT ? loader.getMapColor(id) : loader.getStaticColor(id - LAND_TILE_COUNT));
+    }
+
+    compare("radarcol", checksum);
+}
+
+void ConformanceCheck::checkArt() {
+    const Manifest::Section& section = manifest_.getSection("art");
+    data::IndexLoader index(directory_ / "artidx.mul");
+    data::ArtLoader loader(directory_ / "artidx.mul", directory_ / "art.mul");
+
+    // all textures are requested first, so that the io threads can work on them in parallel
+    TextureList textures;
+    for (unsigned int id = section.first_; id < section.end_; ++id) {
+        if (hasIndexEntry(index, id)) {
+            textures.push_back(std::make_pair(id, id < LAND_TILE_COUNT ? loader.getMapTexture(id) : loader.getItemTexture(id - LAND_TILE_COUNT)));
+        }
+    }
+
+    Checksum checksum;
+    addTextures(checksum, textures);
+    compare("art", checksum);
+}
+
+void ConformanceCheck::checkGumpArt() {
+    const Manifest::Section& section = manifest_.getSection("gumpart");
+    data::IndexLoader index(directory_ / "gumpidx.mul");
+    data::GumpArtLoader loader(directory_ / "gumpidx.mul", directory_ / "gumpart.mul");
+
+    TextureList textures;
+    for (unsigned int id = section.first_; id < section.end_; ++id) {
+        if (hasIndexEntry(index, id)) {
+            textures.push_back(std::make_pair(id, loader.getTexture(id)));
+        }
+    }
+
+    Checksum checksum;
+    addTextures(checksum, textures);
+    compare("gumpart", checksum);
+}
+
+void ConformanceCheck::checkTexMaps() {
+    const Manifest::Section& section = manifest_.getSection("texmaps");
+    data::IndexLoader index(directory_ / "texidx.mul");
+    data::MapTexLoader loader(directory_ / "texidx.mul", directory_ / "texmaps.mul");
+
+    TextureList textures;
+    for (unsigned int id = section.first_; id < section.end_; ++id) {
+        if (hasIndexEntry(index, id)) {
+            textures.push_back(std::make_pair(id, loader.get(id)));
+        }
+    }
+
+    Checksum checksum;
+    addTextures(checksum, textures);
+    compare("texmaps", checksum);
+}
+
+void ConformanceCheck::checkAnim() {
+    const Manifest::Section& section = manifest_.getSection("anim");
+    data::IndexLoader index(directory_ / "anim.idx");
+    data::AnimLoader loader(directory_ / "anim.idx", directory_ / "anim.mul", manifest_.getOption("anim-high-detail"), 0);
+
+    // high detail bodies have 22 actions with 5 directions
+    std::vector<std::pair<unsigned int, boost::shared_ptr<ui::Animation> > > animations;
+    for (unsigned int id = section.first_; id < section.end_; ++id) {
+        if (hasIndexEntry(index, id)) {
+            animations.push_back(std::make_pair(id, loader.getAnimation(id / 110, (id % 110) / 5, id % 5)));
+        }
+    }
+
+    Checksum checksum;
+    for (unsigned int i = 0; i < animations.size(); ++i) {
+        unsigned int id = animations[i].first;
+        boost::shared_ptr<ui::Animation> anim = animations[i].second;
+        if (!anim || !waitForItem(anim)) {
+            LOG_ERROR << "Unable to load animation " << id << std::endl;
+            continue;
+        }
+
+        checksum.addEntry(id);
+        checksum.add(anim->getFrameCount());
+
+        for (unsigned int frameIdx = 0; frameIdx < anim->getFrameCount(); ++frameIdx) {
+            ui::AnimationFrame frame = anim->getFrame(frameIdx);
+            CL_PixelBuffer pixelBuffer = frame.texture_->getPixelBuffer();
+            unsigned int width = pixelBuffer.get_width();
+            unsigned int height = pixelBuffer.get_height();
+
+            checksum.add(frame.centerX_);
+            checksum.add(frame.centerY_);
+            checksum.add(width);
+            checksum.add(height);
+            checksum.addPixels(frame.texture_->getPixelBufferData(), width * height);
+        }
+    }
+
+    compare("anim", checksum);
+}
+
+void ConformanceCheck::checkAnimData() {
+    const Manifest::Section& section = manifest_.getSection("animdata");
+    data::AnimDataLoader loader(directory_ / "animdata.mul");
+    Checksum checksum;
+
+    for (unsigned int id = section.first_; id < section.end_; ++id) {
+        data::AnimDataInfo info = loader.getInfo(id);
+        if (info.frameCount_ == 0) {
+            continue;
+        }
+
+        checksum.addEntry(id);
+        checksum.add(info.frameCount_);
+        for (unsigned int frame = 0; frame < info.frameCount_ && frame < 64; ++frame) {
+            checksum.add(info.artIds_[frame]);
+        }
+        checksum.add(info.frameIntervalMillis_);
+        checksum.add(info.frameStart_);
+    }
+
+    compare("animdata", checksum);
+}
+
+void ConformanceCheck::checkMap() {
+    unsigned int blockCount = manifest_.getOption("map-width") * manifest_.getOption("map-height");
+
+    std::vector<int8_t> mapData;
+    std::vector<int8_t> difOffsets;
+    std::vector<int8_t> difData;
+    readFile(directory_ / "map0.mul", mapData);
+    readFile(directory_ / "mapdifl0.mul", difOffsets);
+    readFile(directory_ / "mapdif0.mul", difData);
+
+    data::DifIndex difIndex;
+    difIndex.init(reinterpret_cast<const uint32_t*>(&difOffsets[0]), difOffsets.size() / 4, blockCount);
+
+    Checksum checksum;
+    for (unsigned int block = 0; block < blockCount; ++block) {
+        unsigned int difIdx;
+        const std::vector<int8_t>& source = difIndex.find(block, difIdx) ? difData : mapData;
+        unsigned int offset = (&source == &difData ? difIdx : block) * MAP_BLOCK_SIZE;
+        if (offset + MAP_BLOCK_SIZE > source.size()) {
+            LOG_ERROR << "Map block " << block << " is outside of the file" << std::endl;
+            continue;
+        }
+
+        // without the 4 byte header
+        checksum.addEntry(block);
+        checksum.add(&source[offset + 4], MAP_BLOCK_SIZE - 4);
+    }
+
+    compare("map0", checksum);
+}
+
+void ConformanceCheck::checkStatics() {
+    unsigned int blockCount = manifest_.getOption("map-width") * manifest_.getOption("map-height");
+
+    data::IndexLoader index(directory_ / "staidx0.mul");
+    data::IndexLoader difIndexFile(directory_ / "stadifi0.mul");
+
+    std::vector<int8_t> staticsData;
+    std::vector<int8_t> difOffsets;
+    std::vector<int8_t> difData;
+    readFile(directory_ / "statics0.mul", staticsData);
+    readFile(directory_ / "stadifl0.mul", difOffsets);
+    readFile(directory_ / "stadif0.mul", difData);
+
+    data::DifIndex difIndex;
+    difIndex.init(reinterpret_cast<const uint32_t*>(&difOffsets[0]), difOffsets.size() / 4, blockCount);
+
+    Checksum checksum;
+    for (unsigned int block = 0; block < blockCount; ++block) {
+        unsigned int difIdx;
+        bool isDif = difIndex.find(block, difIdx);
+        const data::IndexLoader& sourceIndex = isDif ? difIndexFile : index;
+        const std::vector<int8_t>& source = isDif ? difData : staticsData;
+        unsigned int sourceIdx = isDif ? difIdx : block;
+
+        // blocks without an index entry have no statics
+        unsigned int offset = 0;
+        unsigned int length = 0;
+        if (hasIndexEntry(sourceIndex, sourceIdx)) {
+            offset = sourceIndex.get(sourceIdx).offset_;
+            length = sourceIndex.get(sourceIdx).length_;
+        }
+
+        if (offset + length > source.size()) {
+            LOG_ERROR << "Statics block " << block << " is outside of the file" << std::endl;
+            continue;
+        }
+
+        checksum.addEntry(block);
+        checksum.add(length / 7);
+
+        const uint8_t* ptr = reinterpret_cast<const uint8_t*>(length > 0 ? &source[offset] : NULL);
+        for (unsigned int pos = 0; pos + 7 <= length; pos += 7) {
+            checksum.add(ptr[pos] | (ptr[pos + 1] << 8));
+            checksum.add(ptr[pos + 2]);
+            checksum.add(ptr[pos + 3]);
+            checksum.add((int8_t)ptr[pos + 4]);
+            checksum.add(ptr[pos + 5] | (ptr[pos + 6] << 8));
+        }
+    }
+
+    compare("statics0", checksum);
+}
+
+void ConformanceCheck::checkDifIndex() {
+    unsigned int blockCount = manifest_.getOption("map-width") * manifest_.getOption("map-height");
+    unsigned int mismatches = 0;
+
+    const char* fileNames[] = { "mapdifl0.mul", "stadifl0.mul" };
+    for (unsigned int i = 0; i < 2; ++i) {
+        std::vector<int8_t> difOffsets;
+        readFile(directory_ / fileNames[i], difOffsets);
+        const uint32_t* blockIds = reinterpret_cast<const uint32_t*>(difOffsets.empty() ? NULL : &difOffsets[0]);
+        mismatches += countDifMismatches(blockIds, difOffsets.size() / 4, blockCount);
+    }
+
+    // many duplicates and ids past the end, and block counts that are not a multiple of 64
+    std::mt19937 random(1);
+    for (unsigned int round = 0; round < 50; ++round) {
+        unsigned int randomBlockCount = 1 + random() % 5000;
+        std::vector<uint32_t> blockIds(random() % (randomBlockCount * 2));
+        for (unsigned int i = 0; i < blockIds.size(); ++i) {
+            blockIds[i] = random() % (randomBlockCount + randomBlockCount / 8 + 1);
+        }
+        mismatches += countDifMismatches(blockIds.empty() ? NULL : &blockIds[0], blockIds.size(), randomBlockCount);
+    }
+
+    if (mismatches > 0) {
+        LOG_ERROR << "difs: " << mismatches << " blocks resolve to a different dif entry than with the old lookup" << std::endl;
+        ++failedCount_;
+    } else {
+        LOG_INFO << "difs: DifIndex matches the old lookup" << std::endl;
+    }
+}
+
+void ConformanceCheck::checkUniFont(const std::string& name) {
+    const Manifest::Section& section = manifest_.getSection(name);
+    data::UniFontLoader loader(directory_ / (name + ".mul"));
+    Checksum checksum;
+
+    for (unsigned int character = section.first_; character < section.end_; ++character) {
+        const data::UnicodeCharacter* info = loader.getCharacter(character);
+        if (!info) {
+            continue;
+        }
+
+        checksum.addEntry(character);
+        checksum.add(info->xOffset_);
+        checksum.add(info->yOffset_);
+        checksum.add(info->width_);
+        checksum.add(info->height_);
+
+        // only the glyph pixels, one byte each. The border is generated by the loader
+        const uint8_t* atlas = loader.getAtlasPageData(info->atlasPage_);
+        std::vector<uint8_t> line(info->width_);
+        for (unsigned int y = 0; y < info->height_; ++y) {
+            const uint8_t* atlasLine = atlas + (info->atlasY_ + y) * data::UniFontLoader::ATLAS_WIDTH + info->atlasX_;
+            for (unsigned int x = 0; x < info->width_; ++x) {
+                line[x] = atlasLine[x] == data::UniFontLoader::ATLAS_GLYPH ? 1 : 0;
+            }
+            checksum.add(&line[0], info->width_);
+        }
+    }
+
+    compare(name, checksum);
+}
+
+void ConformanceCheck::checkCliloc() {
+    const Manifest::Section& section = manifest_.getSection("cliloc");
+    data::ClilocLoader loader;
+    loader.indexFile(directory_ / "cliloc.enu", true);
+    Checksum checksum;
+
+    for (unsigned int id = section.first_; id < section.end_; ++id) {
+        if (loader.hasEntry(id)) {
+            checksum.addEntry(id);
+            addString(checksum, loader.get(id));
+        }
+    }
+
+    compare("cliloc", checksum);
+}
+
+void ConformanceCheck::checkSkills() {
+    const Manifest::Section& section = manifest_.getSection("skills");
+    data::IndexLoader index(directory_ / "skills.idx");
+    data::SkillsLoader loader(directory_ / "skills.idx", directory_ / "skills.mul");
+    Checksum checksum;
+
+    for (unsigned int id = section.first_; id < section.end_ && id < loader.getSkillCount(); ++id) {
+        if (hasIndexEntry(index, id)) {
+            const data::SkillInfo* info = loader.getSkillInfo(id);
+            checksum.addEntry(id);
+            checksum.add(info->isUsable_ ? 1 : 0);
+            addString(checksum, info->name_);
+        }
+    }
+
+    compare("skills", checksum);
+}
+
+void ConformanceCheck::checkSound() {
+    const Manifest::Section& section = manifest_.getSection("sound");
+    data::IndexLoader index(directory_ / "soundidx.mul");
+    data::SoundLoader loader(directory_ / "soundidx.mul", directory_ / "sound.mul");
+
+    std::vector<std::pair<unsigned int, boost::shared_ptr<data::Sound> > > sounds;
+    for (unsigned int id = section.first_; id < section.end_; ++id) {
+        if (hasIndexEntry(index, id)) {
+            sounds.push_back(std::make_pair(id, loader.get(id)));
+        }
+    }
+
+    Checksum checksum;
+    for (unsigned int i = 0; i < sounds.size(); ++i) {
+        unsigned int id = sounds[i].first;
+        boost::shared_ptr<data::Sound> sound = sounds[i].second;
+        if (!sound || !waitForItem(sound)) {
+            LOG_ERROR << "Unable to load sound " << id << std::endl;
+            continue;
+        }
+
+        // the pcm data follows the wave header added by the loader
+        unsigned int pcmLength = sound->getDataLength() - 44;
+        checksum.addEntry(id);
+        addString(checksum, sound->getName());
+        checksum.add(pcmLength);
+        checksum.add(sound->getData() + 44, pcmLength);
+    }
+
+    compare("sound", checksum);
+}
+
+template<typename T>
+void ConformanceCheck::checkNumericDefFile(const std::string& name, const char* pattern) {
+    data::DefFileLoader<T> loader(directory_ / name, pattern);
+    Checksum checksum;
+
+    // the records consist of ints only, filled in pattern order like DefFileLoader does
+    unsigned int fieldCount = strlen(pattern);
+    typename std::map<int, T>::const_iterator iter = loader.begin();
+    typename std::map<int, T>::const_iterator end = loader.end();
+    for (; iter != end; ++iter) {
+        const int* fields = reinterpret_cast<const int*>(&iter->second);
+        checksum.addEntry(fields[0]);
+        for (unsigned int field = 1; field < fieldCount; ++field) {
+            checksum.add(fields[field]);
+        }
+    }
+
+    compare(name, checksum);
+}
+
+void ConformanceCheck::checkDefFiles() {
+    checkNumericDefFile<data::BodyDef>("body.def", "iri");
+    checkNumericDefFile<data::BodyConvDef>("bodyconv.def", "iiiii");
+    checkNumericDefFile<data::PaperdollDef>("paperdoll.def", "iiii");
+    checkNumericDefFile<data::GumpDef>("gump.def", "iri");
+    checkNumericDefFile<data::MountDef>("mount.def", "ii");
+    checkNumericDefFile<data::SoundDef>("sound.def", "iri");
+
+    // EquipConvDefLoader can not be iterated, its records are looked up by the keys found in the file
+    data::DefFileLoader<data::EquipConvDef> equipConvRecords(directory_ / "equipconv.def", "iiiii");
+    data::EquipConvDefLoader equipConvLoader(directory_ / "equipconv.def", boost::filesystem::path());
+    Checksum equipConvChecksum;
+    std::map<int, data::EquipConvDef>::const_iterator equipConvIter = equipConvRecords.begin();
+    std::map<int, data::EquipConvDef>::const_iterator equipConvEnd = equipConvRecords.end();
+    for (; equipConvIter != equipConvEnd; ++equipConvIter) {
+        if (!equipConvLoader.hasValue(equipConvIter->second.bodyId_, equipConvIter->second.gumpId_)) {
+            LOG_ERROR << "equipconv.def: no entry for body " << equipConvIter->second.bodyId_ << std::endl;
+            continue;
+        }
+
+        data::EquipConvDef def = equipConvLoader.get(equipConvIter->second.bodyId_, equipConvIter->second.gumpId_);
+        equipConvChecksum.addEntry(def.bodyId_);
+        equipConvChecksum.add(def.itemId_);
+        equipConvChecksum.add(def.itemIdTranslate_);
+        equipConvChecksum.add(def.gumpId_);
+        equipConvChecksum.add(def.hue_);
+    }
+    compare("equipconv.def", equipConvChecksum);
+
+    data::DefFileLoader<data::EffectTranslationDef> effects(directory_ / "effecttranslation.def", "is", &data::EffectTranslationDef::setEffectName);
+    Checksum effectsChecksum;
+    std::map<int, data::EffectTranslationDef>::const_iterator effectsIter = effects.begin();
+    std::map<int, data::EffectTranslationDef>::const_iterator effectsEnd = effects.end();
+    for (; effectsIter != effectsEnd; ++effectsIter) {
+        effectsChecksum.addEntry(effectsIter->second.effectId_);
+        addString(effectsChecksum, effectsIter->second.particleEffectName_);
+    }
+    compare("effecttranslation.def", effectsChecksum);
+
+    data::DefFileLoader<data::MusicConfigDef> music(directory_ / "music" / "digital" / "config.txt", "is", &data::MusicConfigDef::parse);
+    Checksum musicChecksum;
+    std::map<int, data::MusicConfigDef>::const_iterator musicIter = music.begin();
+    std::map<int, data::MusicConfigDef>::const_iterator musicEnd = music.end();
+    for (; musicIter != musicEnd; ++musicIter) {
+        musicChecksum.addEntry(musicIter->second.musicId_);
+        addString(musicChecksum, musicIter->second.fileName_);
+        musicChecksum.add(musicIter->second.loop_ ? 1 : 0);
+    }
+    compare("music-config", musicChecksum);
+
+    data::DefFileLoader<data::MobTypeDef> mobTypes(directory_ / "mobtypes.txt", "isi", &data::MobTypesLoader::parseType);
+    Checksum mobTypesChecksum;
+    std::map<int, data::MobTypeDef>::const_iterator mobTypesIter = mobTypes.begin();
+    std::map<int, data::MobTypeDef>::const_iterator mobTypesEnd = mobTypes.end();
+    for (; mobTypesIter != mobTypesEnd; ++mobTypesIter) {
+        mobTypesChecksum.addEntry(mobTypesIter->second.bodyId_);
+        mobTypesChecksum.add(mobTypesIter->second.mobType_);
+        mobTypesChecksum.add(mobTypesIter->second.flags_);
+    }
+    compare("mobtypes.txt", mobTypesChecksum);
+}
+
+void ConformanceCheck::checkSpellbooks() {
+    const Manifest::Section& section = manifest_.getSection("spellbooks.xml");
+    data::Spellbooks spellbooks(directory_ / "spellbooks.xml");
+    Checksum checksum;
+
+    for (unsigned int offset = section.first_; offset < section.end_; ++offset) {
+        const data::SpellbookInfo* book = spellbooks.get(offset);
+        if (!book) {
+            continue;
+        }
+
+        checksum.addEntry(offset);
+        addString(checksum, book->name_);
+        addString(checksum, book->gumpName_);
+
+        for (unsigned int byte = 0; byte < 8; ++byte) {
+            const data::SpellbookSectionInfo& bookSection = book->sections_[byte];
+            addString(checksum, bookSection.name_);
+            checksum.add(bookSection.byteIndex_);
+
+            for (unsigned int bit = 0; bit < 8; ++bit) {
+                const data::SpellInfo& spell = bookSection.spells_[bit];
+                addString(checksum, spell.name_);
+                checksum.add(spell.bitIndex_);
+                addString(checksum, spell.wops_);
+                addString(checksum, spell.descriptionHeader_);
+                addString(checksum, spell.description_);
+                addString(checksum, spell.sectionHeader_);
+                checksum.add(spell.gumpId_);
+                checksum.add(spell.spellId_);
+            }
+        }
+    }
+
+    compare("spellbooks.xml", checksum);
+}
+
+}
+}
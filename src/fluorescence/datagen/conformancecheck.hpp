@@ -0,0 +1,94 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_DATAGEN_CONFORMANCECHECK_HPP
+#define FLUO_DATAGEN_CONFORMANCECHECK_HPP
+
+#include "manifest.hpp"
+
+#include <boost/filesystem/path.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace fluo {
+
+namespace ui {
+    class Texture;
+}
+
+namespace datagen {
+
+/**
+ * \brief Loads a data set written by DataSetWriter through the client loaders and compares the decoded data with the manifest
+ *
+ * Every manifest section is loaded by the loader the data::Manager uses for it. Map and statics blocks are resolved
+ * with IndexLoader and DifIndex like MapLoader and StaticsLoader do, their world objects need the running client.
+ * DifIndex is also compared with the std::map lookup the loaders used before it.
+ * The data::IoScheduler has to be created before.
+ */
+class ConformanceCheck {
+public:
+    /// \throw Exception if the manifest can not be read
+    ConformanceCheck(const boost::filesystem::path& directory);
+
+    /// Returns false if any section differs from the manifest or could not be loaded
+    bool run();
+
+private:
+    boost::filesystem::path directory_;
+    Manifest manifest_;
+
+    unsigned int failedCount_;
+    std::set<std::string> checkedSections_;
+
+    void compare(const std::string& section, const Checksum& checksum);
+
+    typedef std::vector<std::pair<unsigned int, boost::shared_ptr<ui::Texture> > > TextureList;
+    void addTextures(Checksum& checksum, const TextureList& textures);
+
+    void checkTileData();
+    void checkHues();
+    void checkRadarCol();
+    void checkArt();
+    void checkGumpArt();
+    void checkTexMaps();
+    void checkAnim();
+    void checkAnimData();
+    void checkMap();
+    void checkStatics();
+    void checkDifIndex();
+    void checkUniFont(const std::string& name);
+    void checkCliloc();
+    void checkSkills();
+    void checkSound();
+    void checkDefFiles();
+    void checkSpellbooks();
+
+    template<typename T>
+    void checkNumericDefFile(const std::string& name, const char* pattern);
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,1132 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "datasetwriter.hpp"
+
+#include <misc/exception.hpp>
+#include <misc/log.hpp>
+#include <misc/profiler.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <map>
+#include <sstream>
+#include <algorithm>
+
+#include <string.h>
+
+namespace fluo {
+namespace datagen {
+
+namespace {
+
+const unsigned int LAND_TILE_COUNT = 0x4000;
+const unsigned int MAP_BLOCK_SIZE = 196;
+
+void put8(std::vector<uint8_t>& buf, uint8_t value) {
+    buf.push_back(value);
+}
+
+void put16(std::vector<uint8_t>& buf, uint16_t value) {
+    buf.push_back(value & 0xFF);
+    buf.push_back(value >> 8);
+}
+
+void put32(std::vector<uint8_t>& buf, uint32_t value) {
+    put16(buf, value & 0xFFFF);
+    put16(buf, value >> 16);
+}
+
+void set16(std::vector<uint8_t>& buf, unsigned int pos, uint16_t value) {
+    buf[pos] = value & 0xFF;
+    buf[pos + 1] = value >> 8;
+}
+
+void set32(std::vector<uint8_t>& buf, unsigned int pos, uint32_t value) {
+    set16(buf, pos, value & 0xFFFF);
+    set16(buf, pos + 2, value >> 16);
+}
+
+/// Fixed length field, padded with zeros
+void putString(std::vector<uint8_t>& buf, const std::string& str, unsigned int fieldLength) {
+    for (unsigned int i = 0; i < fieldLength; ++i) {
+        buf.push_back(i < str.size() ? str[i] : 0);
+    }
+}
+
+void putIndexEntry(std::vector<uint8_t>& idx, uint32_t offset, uint32_t length, uint32_t extra) {
+    put32(idx, offset);
+    put32(idx, length);
+    put32(idx, extra);
+}
+
+void putEmptyIndexEntry(std::vector<uint8_t>& idx, unsigned int id) {
+    // the original files use both variants
+    putIndexEntry(idx, 0xFFFFFFFFu, (id % 2) ? 0xFFFFFFFFu : 0, 0);
+}
+
+/// ARGB1555 to the RGBA8 pixels of a decoded texture. 0 is the only transparent color
+uint32_t toRgba(uint16_t color) {
+    uint32_t red = (color >> 10) & 0x1F;
+    uint32_t green = (color >> 5) & 0x1F;
+    uint32_t blue = color & 0x1F;
+    uint32_t alpha = (color != 0) ? 0xFF : 0;
+    return (red << 27) | (green << 19) | (blue << 11) | alpha;
+}
+
+// words for cliloc texts, with some multi byte utf8 characters
+const char* const CLILOC_WORDS[] = {
+    "the", "sword", "of", "a", "Gr\xC3\xBC\xC3\x9F" "e", "\xC3\x96l", "na\xC3\xAFve", "\xE6\x97\xA5\xE6\x9C\xAC", "~1_NAME~", "gold", "coins", "you",
+};
+
+const char* const MOB_TYPES[] = { "HUMAN", "MONSTER", "ANIMAL", "EQUIPMENT", "SEA_MONSTER" };
+
+}
+
+DataSetWriter::DataSetWriter(const boost::filesystem::path& directory, unsigned int seed, unsigned int mapWidth, unsigned int mapHeight, bool highSeas) :
+        directory_(directory), mapWidth_(mapWidth), mapHeight_(mapHeight), highSeas_(highSeas), random_(seed) {
+    manifest_.setOption("seed", seed);
+    manifest_.setOption("map-width", mapWidth_);
+    manifest_.setOption("map-height", mapHeight_);
+    manifest_.setOption("high-seas", highSeas_ ? 1 : 0);
+    manifest_.setOption("anim-high-detail", ANIM_BODY_COUNT);
+}
+
+void DataSetWriter::write() {
+    boost::filesystem::create_directories(directory_ / "music" / "digital");
+
+    {
+        ProfilePhase phase("tiledata");
+        writeTileData();
+    }
+    {
+        ProfilePhase phase("hues");
+        writeHues();
+    }
+    {
+        ProfilePhase phase("radarcol");
+        writeRadarCol();
+    }
+    {
+        ProfilePhase phase("art");
+        writeArt();
+    }
+    {
+        ProfilePhase phase("gumpart");
+        writeGumpArt();
+    }
+    {
+        ProfilePhase phase("texmaps");
+        writeTexMaps();
+    }
+    {
+        ProfilePhase phase("anim");
+        writeAnim();
+    }
+    {
+        ProfilePhase phase("animdata");
+        writeAnimData();
+    }
+    {
+        // both need the art ids
+        ProfilePhase phase("map and statics");
+        writeMap();
+        writeStatics();
+    }
+    {
+        ProfilePhase phase("unifont");
+        writeUniFont("unifont");
+        writeUniFont("unifont1");
+    }
+    {
+        ProfilePhase phase("cliloc");
+        writeCliloc();
+    }
+    {
+        ProfilePhase phase("skills and sound");
+        writeSkills();
+        writeSound();
+    }
+    {
+        ProfilePhase phase("def files");
+        writeDefFiles();
+        writeSpellbooks();
+    }
+
+    manifest_.save(directory_ / Manifest::FILE_NAME);
+}
+
+unsigned int DataSetWriter::randomBelow(unsigned int range) {
+    return random_() % range;
+}
+
+int DataSetWriter::randomBetween(int min, int max) {
+    return min + (int)randomBelow(max - min + 1);
+}
+
+uint16_t DataSetWriter::randomColor() {
+    return randomBelow(0x8000);
+}
+
+std::string DataSetWriter::randomName(const char* prefix, unsigned int id, unsigned int maxLength) {
+    std::ostringstream sstr;
+    sstr << prefix << id;
+    std::string ret = sstr.str();
+    if (ret.size() >= maxLength) {
+        return ret.substr(0, maxLength);
+    }
+
+    unsigned int length = randomBetween(ret.size(), maxLength);
+    while (ret.size() < length) {
+        ret += (char)('a' + randomBelow(26));
+    }
+
+    return ret;
+}
+
+void DataSetWriter::writeFile(const std::string& name, const std::vector<uint8_t>& data) {
+    boost::filesystem::path path = directory_ / name;
+    boost::filesystem::ofstream stream(path, std::ios_base::binary | std::ios_base::trunc);
+    if (!stream.is_open()) {
+        LOG_ERROR << "Unable to open " << path << " for writing" << std::endl;
+        throw Exception("Unable to write data set");
+    }
+
+    if (!data.empty()) {
+        stream.write(reinterpret_cast<const char*>(&data[0]), data.size());
+    }
+
+    if (!stream.good()) {
+        LOG_ERROR << "Unable to write " << path << std::endl;
+        throw Exception("Unable to write data set");
+    }
+}
+
+void DataSetWriter::writeTileData() {
+    std::vector<uint8_t> data;
+    Checksum checksum;
+
+    for (unsigned int id = 0; id < LAND_TILE_COUNT; ++id) {
+        if ((id % 32) == 0) {
+            put32(data, random_());
+        }
+
+        uint32_t flags = random_();
+        uint16_t textureId = randomBelow(TEXMAP_COUNT);
+        std::string name = randomName("land", id, 20);
+
+        put32(data, flags);
+        if (highSeas_) {
+            put32(data, random_());
+        }
+        put16(data, textureId);
+        putString(data, name, 20);
+
+        checksum.addEntry(id);
+        checksum.add(flags);
+        checksum.add(textureId);
+        checksum.add(name);
+    }
+
+    for (unsigned int id = 0; id < STATIC_COUNT; ++id) {
+        if ((id % 32) == 0) {
+            put32(data, random_());
+        }
+
+        uint32_t flags = random_();
+        put32(data, flags);
+        if (highSeas_) {
+            put32(data, random_());
+        }
+
+        checksum.addEntry(LAND_TILE_COUNT + id);
+        checksum.add(flags);
+
+        // weight, quality, unknown1 (2 bytes), unknown2, quantity, anim id (2 bytes), unknown3, hue, unknown4, unknown5, height
+        const unsigned int fieldSizes[] = { 1, 1, 2, 1, 1, 2, 1, 1, 1, 1, 1 };
+        for (unsigned int field = 0; field < 11; ++field) {
+            if (fieldSizes[field] == 1) {
+                uint8_t value = randomBelow(0x100);
+                put8(data, value);
+                checksum.add(value);
+            } else {
+                uint16_t value = randomBelow(0x10000);
+                put16(data, value);
+                checksum.add(value);
+            }
+        }
+
+        std::string name = randomName("static", id, 20);
+        putString(data, name, 20);
+        checksum.add(name);
+    }
+
+    writeFile("tiledata.mul", data);
+    manifest_.setSection("tiledata", 0, LAND_TILE_COUNT + STATIC_COUNT, checksum);
+}
+
+void DataSetWriter::writeHues() {
+    std::vector<uint8_t> data;
+    Checksum checksum;
+
+    for (unsigned int hue = 0; hue < HUE_COUNT; ++hue) {
+        if ((hue % 8) == 0) {
+            put32(data, random_());
+        }
+
+        uint16_t color = 0;
+        for (unsigned int i = 0; i < 32; ++i) {
+            color = randomColor();
+            put16(data, color);
+        }
+
+        put16(data, randomBelow(0x8000));
+        put16(data, randomBelow(0x8000));
+        putString(data, randomName("hue", hue, 20), 20);
+
+        // font colors use the last color of the table, hue ids start at 1
+        checksum.addEntry(hue + 1);
+        checksum.add(toRgba(color));
+    }
+
+    writeFile("hues.mul", data);
+    manifest_.setSection("hues", 1, HUE_COUNT + 1, checksum);
+}
+
+void DataSetWriter::writeRadarCol() {
+    std::vector<uint8_t> data;
+    Checksum checksum;
+
+    for (unsigned int id = 0; id < RADARCOL_COUNT; ++id) {
+        uint16_t color = randomColor();
+        put16(data, color);
+
+        checksum.addEntry(id);
+        checksum.add(toRgba(color));
+    }
+
+    writeFile("radarcol.mul", data);
+    manifest_.setSection("radarcol", 0, RADARCOL_COUNT, checksum);
+}
+
+void DataSetWriter::writeArt() {
+    std::vector<uint8_t> idx;
+    std::vector<uint8_t> data;
+    std::vector<uint32_t> pixels;
+    Checksum checksum;
+
+    for (unsigned int id = 0; id < LAND_TILE_COUNT + STATIC_COUNT; ++id) {
+        bool isLand = id < LAND_TILE_COUNT;
+        if ((isLand && (id >= LAND_ART_COUNT || (id % 61) == 60)) || (!isLand && ((id - LAND_TILE_COUNT) % 53) == 52)) {
+            putEmptyIndexEntry(idx, id);
+            continue;
+        }
+
+        uint32_t offset = data.size();
+        unsigned int width;
+        unsigned int height;
+
+        if (isLand) {
+            // 44x44 diamond, the rows grow by 2 pixels up to the middle and shrink again
+            width = 44;
+            height = 44;
+            pixels.assign(width * height, 0);
+
+            unsigned int x = 22;
+            unsigned int lineWidth = 0;
+            for (unsigned int y = 0; y < height; ++y) {
+                if (y < 22) {
+                    --x;
+                    lineWidth += 2;
+                }
+
+                for (unsigned int px = x; px < x + lineWidth; ++px) {
+                    uint16_t color = randomColor();
+                    put16(data, color);
+                    pixels[y * width + px] = toRgba(color);
+                }
+
+                if (y >= 22) {
+                    ++x;
+                    lineWidth -= 2;
+                }
+            }
+
+            landArtIds_.push_back(id);
+        } else {
+            width = randomBetween(1, 64);
+            height = randomBetween(1, 96);
+            pixels.assign(width * height, 0);
+
+            put32(data, random_());
+            put16(data, width);
+            put16(data, height);
+
+            // row offsets in 16 bit words, relative to the end of the table
+            unsigned int lookupPos = data.size();
+            data.resize(data.size() + height * 2);
+            unsigned int rowDataStart = data.size();
+
+            for (unsigned int y = 0; y < height; ++y) {
+                set16(data, lookupPos + y * 2, (data.size() - rowDataStart) / 2);
+
+                // runs of (gap before the run, run length, pixels), ended by 0 0
+                unsigned int x = 0;
+                while (true) {
+                    unsigned int gap = randomBelow(6);
+                    if (x + gap >= width) {
+                        break;
+                    }
+                    x += gap;
+
+                    unsigned int runLength = randomBetween(1, (std::min)(16u, width - x));
+                    put16(data, gap);
+                    put16(data, runLength);
+                    for (unsigned int i = 0; i < runLength; ++i) {
+                        uint16_t color = randomColor();
+                        put16(data, color);
+                        pixels[y * width + x] = toRgba(color);
+                        ++x;
+                    }
+                }
+
+                put16(data, 0);
+                put16(data, 0);
+            }
+
+            staticArtIds_.push_back(id - LAND_TILE_COUNT);
+        }
+
+        putIndexEntry(idx, offset, data.size() - offset, 0);
+
+        checksum.addEntry(id);
+        checksum.add(width);
+        checksum.add(height);
+        checksum.addPixels(&pixels[0], pixels.size());
+    }
+
+    writeFile("artidx.mul", idx);
+    writeFile("art.mul", data);
+    manifest_.setSection("art", 0, LAND_TILE_COUNT + STATIC_COUNT, checksum);
+}
+
+void DataSetWriter::writeGumpArt() {
+    std::vector<uint8_t> idx;
+    std::vector<uint8_t> data;
+    std::vector<uint32_t> pixels;
+    std::vector<uint16_t> runs;
+    Checksum checksum;
+
+    for (unsigned int id = 0; id < GUMP_COUNT; ++id) {
+        if ((id % 37) == 36) {
+            putEmptyIndexEntry(idx, id);
+            continue;
+        }
+
+        unsigned int width = randomBetween(1, 160);
+        unsigned int height = randomBetween(1, 160);
+        pixels.assign(width * height, 0);
+        runs.clear();
+
+        // one offset per row in 32 bit words, then (color, run length) pairs covering the whole row. Color 0 is transparent
+        uint32_t offset = data.size();
+        for (unsigned int y = 0; y < height; ++y) {
+            put32(data, height + runs.size() / 2);
+
+            unsigned int x = 0;
+            while (x < width) {
+                unsigned int runLength = randomBetween(1, (std::min)(24u, width - x));
+                uint16_t color = (randomBelow(4) == 0) ? 0 : randomColor();
+                runs.push_back(color);
+                runs.push_back(runLength);
+
+                for (unsigned int i = 0; i < runLength; ++i) {
+                    pixels[y * width + x] = toRgba(color);
+                    ++x;
+                }
+            }
+        }
+
+        for (unsigned int i = 0; i < runs.size(); ++i) {
+            put16(data, runs[i]);
+        }
+
+        putIndexEntry(idx, offset, data.size() - offset, (width << 16) | height);
+
+        checksum.addEntry(id);
+        checksum.add(width);
+        checksum.add(height);
+        checksum.addPixels(&pixels[0], pixels.size());
+    }
+
+    writeFile("gumpidx.mul", idx);
+    writeFile("gumpart.mul", data);
+    manifest_.setSection("gumpart", 0, GUMP_COUNT, checksum);
+}
+
+void DataSetWriter::writeTexMaps() {
+    std::vector<uint8_t> idx;
+    std::vector<uint8_t> data;
+    std::vector<uint32_t> pixels;
+    Checksum checksum;
+
+    for (unsigned int id = 0; id < TEXMAP_COUNT; ++id) {
+        if ((id % 11) == 10) {
+            putEmptyIndexEntry(idx, id);
+            continue;
+        }
+
+        // extra 1 marks the large textures
+        bool large = randomBelow(2) == 0;
+        unsigned int width = large ? 128 : 64;
+        pixels.assign(width * width, 0);
+
+        // stored column by column
+        uint32_t offset = data.size();
+        for (unsigned int x = 0; x < width; ++x) {
+            for (unsigned int y = 0; y < width; ++y) {
+                uint16_t color = randomColor();
+                put16(data, color);
+                pixels[y * width + x] = toRgba(color);
+            }
+        }
+
+        putIndexEntry(idx, offset, data.size() - offset, large ? 1 : 0);
+
+        checksum.addEntry(id);
+        checksum.add(width);
+        checksum.add(width);
+        checksum.addPixels(&pixels[0], pixels.size());
+    }
+
+    writeFile("texidx.mul", idx);
+    writeFile("texmaps.mul", data);
+    manifest_.setSection("texmaps", 0, TEXMAP_COUNT, checksum);
+}
+
+void DataSetWriter::writeAnim() {
+    std::vector<uint8_t> idx;
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> entry;
+    std::vector<uint32_t> pixels;
+    Checksum checksum;
+
+    // high detail bodies only, 22 actions with 5 directions each
+    unsigned int animCount = ANIM_BODY_COUNT * 110;
+    for (unsigned int id = 0; id < animCount; ++id) {
+        unsigned int action = (id % 110) / 5;
+        if ((action % 7) == 6) {
+            putEmptyIndexEntry(idx, id);
+            continue;
+        }
+
+        entry.clear();
+
+        uint32_t palette[256];
+        for (unsigned int i = 0; i < 256; ++i) {
+            uint16_t color = randomColor();
+            put16(entry, color);
+            palette[i] = toRgba(color);
+        }
+
+        unsigned int frameCount = randomBetween(1, 6);
+        put32(entry, frameCount);
+        unsigned int frameOffsetsPos = entry.size();
+        entry.resize(entry.size() + frameCount * 4);
+
+        checksum.addEntry(id);
+        checksum.add(frameCount);
+
+        for (unsigned int frame = 0; frame < frameCount; ++frame) {
+            // frame offsets are relative to the end of the palette
+            set32(entry, frameOffsetsPos + frame * 4, entry.size() - 0x200);
+
+            int width = randomBetween(1, 48);
+            int height = randomBetween(1, 64);
+            int centerX = randomBetween(-8, width + 8);
+            int centerY = randomBetween(-10, 10);
+            put16(entry, centerX);
+            put16(entry, centerY);
+            put16(entry, width);
+            put16(entry, height);
+            pixels.assign(width * height, 0);
+
+            // runs of palette indices. The header holds the position relative to the center as two 10 bit signed values
+            for (int y = 0; y < height; ++y) {
+                int x = 0;
+                while (true) {
+                    int gap = randomBelow(6);
+                    if (x + gap >= width) {
+                        break;
+                    }
+                    x += gap;
+
+                    int runLength = randomBetween(1, (std::min)(32, width - x));
+                    int xOffset = x - centerX;
+                    int yOffset = y - centerY - height;
+                    put32(entry, ((uint32_t)(xOffset & 0x3FF) << 22) | ((uint32_t)(yOffset & 0x3FF) << 12) | runLength);
+
+                    for (int i = 0; i < runLength; ++i) {
+                        uint8_t colorIdx = randomBelow(256);
+                        put8(entry, colorIdx);
+                        pixels[y * width + x] = palette[colorIdx];
+                        ++x;
+                    }
+                }
+            }
+            put32(entry, 0x7FFF7FFFu);
+
+            checksum.add(centerX);
+            checksum.add(centerY);
+            checksum.add(width);
+            checksum.add(height);
+            checksum.addPixels(&pixels[0], pixels.size());
+        }
+
+        putIndexEntry(idx, data.size(), entry.size(), 0);
+        data.insert(data.end(), entry.begin(), entry.end());
+    }
+
+    writeFile("anim.idx", idx);
+    writeFile("anim.mul", data);
+    manifest_.setSection("anim", 0, animCount, checksum);
+}
+
+void DataSetWriter::writeAnimData() {
+    std::vector<uint8_t> data;
+    Checksum checksum;
+
+    for (unsigned int id = 0; id < STATIC_COUNT; ++id) {
+        if ((id % 8) == 0) {
+            put32(data, random_());
+        }
+
+        // 64 frame offsets relative to the art id, unknown, frame count, interval and start delay in ticks of 50ms
+        unsigned int frameCount = ((id % 9) == 0) ? randomBetween(1, 64) : 0;
+        if (frameCount > 0) {
+            checksum.addEntry(id);
+            checksum.add(frameCount);
+        }
+
+        for (unsigned int frame = 0; frame < 64; ++frame) {
+            int8_t offset = randomBetween(-8, 8);
+            put8(data, offset);
+            if (frame < frameCount) {
+                checksum.add(id + offset);
+            }
+        }
+
+        unsigned int interval = randomBetween(1, 10);
+        unsigned int start = randomBelow(5);
+        put8(data, random_());
+        put8(data, frameCount);
+        put8(data, interval);
+        put8(data, start);
+
+        if (frameCount > 0) {
+            checksum.add(interval * 50);
+            checksum.add(start * 50);
+        }
+    }
+
+    writeFile("animdata.mul", data);
+    manifest_.setSection("animdata", 0, STATIC_COUNT, checksum);
+}
+
+void DataSetWriter::writeMap() {
+    unsigned int blockCount = mapWidth_ * mapHeight_;
+
+    // the cells of each block after applying the difs, as stored in the file (art id, z)
+    std::vector<uint8_t> cells;
+    cells.reserve(blockCount * (MAP_BLOCK_SIZE - 4));
+
+    std::vector<uint8_t> data;
+    for (unsigned int block = 0; block < blockCount; ++block) {
+        put32(data, random_());
+        for (unsigned int cell = 0; cell < 64; ++cell) {
+            put16(cells, landArtIds_[randomBelow(landArtIds_.size())]);
+            put8(cells, randomBetween(-15, 15));
+        }
+        data.insert(data.end(), cells.end() - (MAP_BLOCK_SIZE - 4), cells.end());
+    }
+
+    // the second to last dif repeats a block, the last one is outside of the map and must be ignored
+    std::vector<uint8_t> difOffsets;
+    std::vector<uint8_t> difData;
+    unsigned int difCount = blockCount / 16 + 3;
+    for (unsigned int dif = 0; dif < difCount; ++dif) {
+        unsigned int block;
+        if (dif == difCount - 2) {
+            block = difOffsets[0] | (difOffsets[1] << 8) | (difOffsets[2] << 16) | (difOffsets[3] << 24);
+        } else if (dif == difCount - 1) {
+            block = blockCount + 7;
+        } else {
+            block = randomBelow(blockCount);
+        }
+        put32(difOffsets, block);
+
+        put32(difData, random_());
+        for (unsigned int cell = 0; cell < 64; ++cell) {
+            put16(difData, landArtIds_[randomBelow(landArtIds_.size())]);
+            put8(difData, randomBetween(-15, 15));
+        }
+
+        if (block < blockCount) {
+            std::copy(difData.end() - (MAP_BLOCK_SIZE - 4), difData.end(), cells.begin() + block * (MAP_BLOCK_SIZE - 4));
+        }
+    }
+
+    Checksum checksum;
+    for (unsigned int block = 0; block < blockCount; ++block) {
+        checksum.addEntry(block);
+        checksum.add(&cells[block * (MAP_BLOCK_SIZE - 4)], MAP_BLOCK_SIZE - 4);
+    }
+
+    writeFile("map0.mul", data);
+    writeFile("mapdifl0.mul", difOffsets);
+    writeFile("mapdif0.mul", difData);
+    manifest_.setSection("map0", 0, blockCount, checksum);
+}
+
+void DataSetWriter::writeStatics() {
+    unsigned int blockCount = mapWidth_ * mapHeight_;
+
+    // 7 byte records (art id, x, y, z, hue) of each block after applying the difs
+    std::vector<std::vector<uint8_t> > blocks(blockCount);
+
+    std::vector<uint8_t> idx;
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> difOffsets;
+    std::vector<uint8_t> difIdx;
+    std::vector<uint8_t> difData;
+
+    unsigned int difCount = blockCount / 16 + 3;
+    for (unsigned int i = 0; i < blockCount + difCount; ++i) {
+        bool isDif = i >= blockCount;
+        unsigned int block = i;
+        if (isDif) {
+            unsigned int dif = i - blockCount;
+            if (dif == difCount - 2) {
+                block = difOffsets[0] | (difOffsets[1] << 8) | (difOffsets[2] << 16) | (difOffsets[3] << 24);
+            } else if (dif == difCount - 1) {
+                block = blockCount + 7;
+            } else {
+                block = randomBelow(blockCount);
+            }
+            put32(difOffsets, block);
+        }
+
+        std::vector<uint8_t> records;
+        unsigned int staticCount = randomBelow(5);
+        for (unsigned int s = 0; s < staticCount; ++s) {
+            put16(records, staticArtIds_[randomBelow(staticArtIds_.size())]);
+            put8(records, randomBelow(8));
+            put8(records, randomBelow(8));
+            put8(records, randomBetween(-20, 20));
+            put16(records, (randomBelow(4) == 0) ? randomBetween(1, HUE_COUNT) : 0);
+        }
+
+        // a dif without statics removes the statics of the block
+        std::vector<uint8_t>& targetIdx = isDif ? difIdx : idx;
+        std::vector<uint8_t>& targetData = isDif ? difData : data;
+        if (records.empty()) {
+            putEmptyIndexEntry(targetIdx, i);
+        } else {
+            putIndexEntry(targetIdx, targetData.size(), records.size(), 0);
+            targetData.insert(targetData.end(), records.begin(), records.end());
+        }
+
+        if (block < blockCount) {
+            blocks[block].swap(records);
+        }
+    }
+
+    Checksum checksum;
+    for (unsigned int block = 0; block < blockCount; ++block) {
+        const std::vector<uint8_t>& records = blocks[block];
+        checksum.addEntry(block);
+        checksum.add(records.size() / 7);
+
+        for (unsigned int pos = 0; pos < records.size(); pos += 7) {
+            checksum.add(records[pos] | (records[pos + 1] << 8));
+            checksum.add(records[pos + 2]);
+            checksum.add(records[pos + 3]);
+            checksum.add((int8_t)records[pos + 4]);
+            checksum.add(records[pos + 5] | (records[pos + 6] << 8));
+        }
+    }
+
+    writeFile("staidx0.mul", idx);
+    writeFile("statics0.mul", data);
+    writeFile("stadifl0.mul", difOffsets);
+    writeFile("stadifi0.mul", difIdx);
+    writeFile("stadif0.mul", difData);
+    manifest_.setSection("statics0", 0, blockCount, checksum);
+}
+
+void DataSetWriter::writeUniFont(const std::string& name) {
+    // one offset per character, 0 if the character is not in the font
+    std::vector<uint8_t> data(0x10000 * 4, 0);
+    std::vector<uint8_t> glyph;
+    Checksum checksum;
+
+    std::vector<unsigned int> characters;
+    for (unsigned int character = 0x20; character < 0x7F; ++character) {
+        characters.push_back(character);
+    }
+    for (unsigned int character = 0xC0; character < 0x100; ++character) {
+        characters.push_back(character);
+    }
+    characters.push_back(0x20AC);
+    for (unsigned int character = 0x4E00; character < 0x4E10; ++character) {
+        characters.push_back(character);
+    }
+
+    for (unsigned int i = 0; i < characters.size(); ++i) {
+        unsigned int character = characters[i];
+        set32(data, character * 4, data.size());
+
+        // x offset, y offset, width, height, then one bit per pixel with each line starting at a new byte
+        int xOffset = 0;
+        int yOffset = 0;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        if (character != ' ') {
+            xOffset = randomBelow(3);
+            yOffset = randomBetween(0, 6);
+            width = randomBetween(1, 16);
+            height = randomBetween(1, 18);
+        }
+
+        put8(data, xOffset);
+        put8(data, yOffset);
+        put8(data, width);
+        put8(data, height);
+
+        glyph.assign(width * height, 0);
+        unsigned int lineBytes = (width + 7) / 8;
+        for (unsigned int y = 0; y < height; ++y) {
+            for (unsigned int byte = 0; byte < lineBytes; ++byte) {
+                uint8_t bits = randomBelow(0x100);
+                put8(data, bits);
+
+                for (unsigned int bit = 0; bit < 8 && byte * 8 + bit < width; ++bit) {
+                    glyph[y * width + byte * 8 + bit] = (bits >> (7 - bit)) & 1;
+                }
+            }
+        }
+
+        // UniFontLoader replaces the space with a blank character of its own
+        if (character == ' ') {
+            width = 5;
+            height = 1;
+            glyph.assign(width * height, 0);
+        }
+
+        checksum.addEntry(character);
+        checksum.add(xOffset);
+        checksum.add(yOffset);
+        checksum.add(width);
+        checksum.add(height);
+        if (!glyph.empty()) {
+            checksum.add(&glyph[0], glyph.size());
+        }
+    }
+
+    writeFile(name + ".mul", data);
+    manifest_.setSection(name, 0, 0x10000, checksum);
+}
+
+void DataSetWriter::writeCliloc() {
+    std::vector<uint8_t> data;
+    std::map<uint32_t, std::string> entries;
+
+    put32(data, 2);
+    put16(data, 1);
+
+    unsigned int wordCount = sizeof(CLILOC_WORDS) / sizeof(CLILOC_WORDS[0]);
+    uint32_t lastId = 0;
+
+    // every 97th entry is empty and not indexed. The last entry repeats the first id and replaces its text
+    for (unsigned int i = 0; i <= CLILOC_COUNT; ++i) {
+        uint32_t id = (i < CLILOC_COUNT) ? CLILOC_FIRST_ID + i * 3 + randomBelow(3) : entries.begin()->first;
+        lastId = (std::max)(lastId, id);
+
+        std::string text;
+        if ((i % 97) != 96) {
+            unsigned int words = randomBetween(1, 12);
+            for (unsigned int word = 0; word < words; ++word) {
+                if (word > 0) {
+                    text += ' ';
+                }
+                text += CLILOC_WORDS[randomBelow(wordCount)];
+            }
+            entries[id] = text;
+        }
+
+        put32(data, id);
+        put8(data, 0);
+        put16(data, text.size());
+        data.insert(data.end(), text.begin(), text.end());
+    }
+
+    Checksum checksum;
+    std::map<uint32_t, std::string>::const_iterator iter = entries.begin();
+    std::map<uint32_t, std::string>::const_iterator end = entries.end();
+    for (; iter != end; ++iter) {
+        checksum.addEntry(iter->first);
+        checksum.add(iter->second);
+    }
+
+    writeFile("cliloc.enu", data);
+    manifest_.setSection("cliloc", CLILOC_FIRST_ID, lastId + 1, checksum);
+}
+
+void DataSetWriter::writeSkills() {
+    std::vector<uint8_t> idx;
+    std::vector<uint8_t> data;
+    Checksum checksum;
+
+    // without gaps, SkillsLoader expects the ids to be dense like in the original file
+    for (unsigned int id = 0; id < SKILL_COUNT; ++id) {
+        // usable flag, then the zero terminated name
+        uint8_t usable = randomBelow(2);
+        std::string name = randomName("skill", id, 24);
+
+        putIndexEntry(idx, data.size(), name.size() + 2, 0);
+        put8(data, usable);
+        putString(data, name, name.size() + 1);
+
+        checksum.addEntry(id);
+        checksum.add(usable);
+        checksum.add(name);
+    }
+
+    writeFile("skills.idx", idx);
+    writeFile("skills.mul", data);
+    manifest_.setSection("skills", 0, SKILL_COUNT, checksum);
+}
+
+void DataSetWriter::writeSound() {
+    std::vector<uint8_t> idx;
+    std::vector<uint8_t> data;
+    Checksum checksum;
+
+    for (unsigned int id = 0; id < SOUND_COUNT; ++id) {
+        if ((id % 13) == 12) {
+            putEmptyIndexEntry(idx, id);
+            continue;
+        }
+
+        // 40 byte header starting with the name, then 16 bit pcm samples
+        std::string name = randomName("snd", id, 20);
+        unsigned int pcmLength = randomBetween(32, 2048) * 2;
+
+        uint32_t offset = data.size();
+        putString(data, name, 20);
+        for (unsigned int i = 0; i < 20; ++i) {
+            put8(data, random_());
+        }
+        for (unsigned int i = 0; i < pcmLength; ++i) {
+            put8(data, random_());
+        }
+        putIndexEntry(idx, offset, data.size() - offset, 0);
+
+        checksum.addEntry(id);
+        checksum.add(name);
+        checksum.add(pcmLength);
+        checksum.add(&data[offset + 40], pcmLength);
+    }
+
+    writeFile("soundidx.mul", idx);
+    writeFile("sound.mul", data);
+    manifest_.setSection("sound", 0, SOUND_COUNT, checksum);
+}
+
+void DataSetWriter::writeNumericDefFile(const std::string& name, const char* pattern, unsigned int recordCount, bool duplicateId) {
+    std::ostringstream text;
+    std::map<int, std::vector<int> > records;
+    unsigned int fieldCount = strlen(pattern);
+
+    text << "# " << name << ", written by fluo-datagen" << std::endl;
+    text << "# fields: " << pattern << std::endl << std::endl;
+
+    // if duplicateId is set, the last record repeats the first id and replaces it
+    for (unsigned int i = 0; i <= recordCount; ++i) {
+        if (i == recordCount && !duplicateId) {
+            break;
+        }
+
+        std::vector<int> fields(fieldCount);
+        fields[0] = (i < recordCount) ? (int)(i * 2 + 1) : records.begin()->first;
+        for (unsigned int field = 1; field < fieldCount; ++field) {
+            fields[field] = randomBetween(-1, 3000);
+        }
+        records[fields[0]] = fields;
+
+        for (unsigned int field = 0; field < fieldCount; ++field) {
+            text << ((randomBelow(2) == 0) ? " " : "\t");
+
+            // only the first number of a random group is used
+            if (pattern[field] == 'r') {
+                text << "{" << fields[field];
+                unsigned int extraCount = randomBelow(3);
+                for (unsigned int extra = 0; extra < extraCount; ++extra) {
+                    text << ", " << randomBetween(0, 3000);
+                }
+                text << "}";
+            } else {
+                text << fields[field];
+            }
+        }
+
+        if ((i % 5) == 0) {
+            text << " // trailing comment";
+        }
+        text << std::endl;
+
+        if ((i % 7) == 0) {
+            text << "# comment" << std::endl << std::endl;
+        }
+    }
+
+    Checksum checksum;
+    std::map<int, std::vector<int> >::const_iterator iter = records.begin();
+    std::map<int, std::vector<int> >::const_iterator end = records.end();
+    for (; iter != end; ++iter) {
+        checksum.addEntry(iter->first);
+        for (unsigned int field = 1; field < fieldCount; ++field) {
+            checksum.add(iter->second[field]);
+        }
+    }
+
+    std::string str = text.str();
+    writeFile(name, std::vector<uint8_t>(str.begin(), str.end()));
+    manifest_.setSection(name, 0, 0, checksum);
+}
+
+void DataSetWriter::writeDefFiles() {
+    writeNumericDefFile("body.def", "iri", 40, true);
+    writeNumericDefFile("bodyconv.def", "iiiii", 40, true);
+    writeNumericDefFile("paperdoll.def", "iiii", 40, true);
+    writeNumericDefFile("gump.def", "iri", 40, true);
+    writeNumericDefFile("mount.def", "ii", 40, true);
+    writeNumericDefFile("sound.def", "iri", 40, true);
+    // the equipconv table is keyed by body and gump, one record per body keeps it unambiguous
+    writeNumericDefFile("equipconv.def", "iiiii", 40, false);
+
+    std::ostringstream effects;
+    std::ostringstream music;
+    std::ostringstream mobTypes;
+    Checksum effectsChecksum;
+    Checksum musicChecksum;
+    Checksum mobTypesChecksum;
+
+    for (unsigned int i = 0; i < 30; ++i) {
+        int id = i * 3 + 2;
+
+        std::string effectName = randomName("effect", id, 16);
+        effects << id << " " << effectName << std::endl;
+        effectsChecksum.addEntry(id);
+        effectsChecksum.add(effectName);
+
+        // ".mp3" is added if missing, all tracks are played in a loop
+        std::string trackName = randomName("track", id, 12);
+        bool withExtension = randomBelow(2) == 0;
+        music << id << " " << trackName << (withExtension ? ".mp3" : "") << ",loop" << std::endl;
+        musicChecksum.addEntry(id);
+        musicChecksum.add(trackName + ".mp3");
+        musicChecksum.add(1);
+
+        unsigned int mobType = randomBelow(5);
+        unsigned int flags = randomBelow(0x100);
+        mobTypes << id << "\t" << MOB_TYPES[mobType] << "\t" << flags << std::endl;
+        mobTypesChecksum.addEntry(id);
+        mobTypesChecksum.add(mobType);
+        mobTypesChecksum.add(flags);
+    }
+
+    std::string str = effects.str();
+    writeFile("effecttranslation.def", std::vector<uint8_t>(str.begin(), str.end()));
+    manifest_.setSection("effecttranslation.def", 0, 0, effectsChecksum);
+
+    str = music.str();
+    writeFile("music/digital/config.txt", std::vector<uint8_t>(str.begin(), str.end()));
+    manifest_.setSection("music-config", 0, 0, musicChecksum);
+
+    str = mobTypes.str();
+    writeFile("mobtypes.txt", std::vector<uint8_t>(str.begin(), str.end()));
+    manifest_.setSection("mobtypes.txt", 0, 0, mobTypesChecksum);
+}
+
+void DataSetWriter::writeSpellbooks() {
+    std::ostringstream xml;
+    Checksum checksum;
+
+    // all sections and spells are present, the spellbook parser does not initialize missing ones
+    xml << "<spellbooks>" << std::endl;
+    for (unsigned int offset = 1; offset <= SPELLBOOK_COUNT; ++offset) {
+        std::string bookName = randomName("book", offset, 16);
+        std::string gumpName = randomName("gump", offset, 16);
+        xml << "    <spellbook name=\"" << bookName << "\" offset=\"" << offset << "\" gump=\"" << gumpName << "\">" << std::endl;
+        checksum.addEntry(offset);
+        checksum.add(bookName);
+        checksum.add(gumpName);
+
+        for (unsigned int byte = 0; byte < 8; ++byte) {
+            std::string sectionName = randomName("section", byte, 16);
+            xml << "        <section name=\"" << sectionName << "\" byte=\"" << byte << "\">" << std::endl;
+            checksum.add(sectionName);
+            checksum.add(byte);
+
+            for (unsigned int bit = 0; bit < 8; ++bit) {
+                std::string spellName = randomName("spell", bit, 16);
+                std::string words = randomName("words", bit, 16);
+                std::string header = randomName("header", bit, 16);
+                std::string description = randomName("description", bit, 24);
+                unsigned int gumpId = randomBetween(0x8C0, 0x8FF);
+                xml << "            <spell name=\"" << spellName << "\" bit=\"" << bit << "\" wops=\"" << words << "\" description-header=\"" <<
+                        header << "\" description=\"" << description << "\" gumpid=\"" << gumpId << "\" />" << std::endl;
+
+                checksum.add(spellName);
+                checksum.add(bit);
+                checksum.add(words);
+                checksum.add(header);
+                checksum.add(description);
+                checksum.add(sectionName);
+                checksum.add(gumpId);
+                checksum.add(offset + byte * 8 + bit);
+            }
+
+            xml << "        </section>" << std::endl;
+        }
+
+        xml << "    </spellbook>" << std::endl;
+    }
+    xml << "</spellbooks>" << std::endl;
+
+    std::string str = xml.str();
+    writeFile("spellbooks.xml", std::vector<uint8_t>(str.begin(), str.end()));
+    manifest_.setSection("spellbooks.xml", 1, SPELLBOOK_COUNT + 1, checksum);
+}
+
+}
+}
@@ -0,0 +1,109 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_DATAGEN_DATASETWRITER_HPP
+#define FLUO_DATAGEN_DATASETWRITER_HPP
+
+#include "manifest.hpp"
+
+#include <boost/filesystem/path.hpp>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace fluo {
+namespace datagen {
+
+/**
+ * \brief Writes a small, procedurally generated data set in the formats of the original client files
+ *
+ * Every file the data::Manager needs is written, plus map and statics difs and two unicode fonts. The content is random,
+ * but the same for the same seed. Each file is generated as decoded data first (pixels, records, strings), which is
+ * then encoded. The checksums of the decoded data go into the manifest, so that they do not depend on the loaders
+ * under test.
+ */
+class DataSetWriter {
+public:
+    /// Map sizes are in blocks of 8x8 tiles
+    DataSetWriter(const boost::filesystem::path& directory, unsigned int seed, unsigned int mapWidth, unsigned int mapHeight, bool highSeas);
+
+    /// Writes all files and the manifest. \throw Exception if a file can not be written
+    void write();
+
+    // sizes of the data set, in entries
+    static const unsigned int LAND_ART_COUNT = 0x200;
+    static const unsigned int STATIC_COUNT = 0x400;
+    static const unsigned int GUMP_COUNT = 0x100;
+    static const unsigned int TEXMAP_COUNT = 0x80;
+    static const unsigned int ANIM_BODY_COUNT = 4;
+    static const unsigned int HUE_COUNT = 0x200;
+    static const unsigned int RADARCOL_COUNT = 0x8000;
+    static const unsigned int SOUND_COUNT = 0x40;
+    static const unsigned int SKILL_COUNT = 58;
+    static const unsigned int CLILOC_FIRST_ID = 500000;
+    static const unsigned int CLILOC_COUNT = 2000;
+    static const unsigned int SPELLBOOK_COUNT = 2;
+
+private:
+    boost::filesystem::path directory_;
+    unsigned int mapWidth_;
+    unsigned int mapHeight_;
+    bool highSeas_;
+
+    std::mt19937 random_;
+    Manifest manifest_;
+
+    // ids that exist in art.mul, used by the map and statics
+    std::vector<unsigned int> landArtIds_;
+    std::vector<unsigned int> staticArtIds_;
+
+    unsigned int randomBelow(unsigned int range);
+    int randomBetween(int min, int max);
+    uint16_t randomColor();
+    std::string randomName(const char* prefix, unsigned int id, unsigned int maxLength);
+
+    void writeFile(const std::string& name, const std::vector<uint8_t>& data);
+
+    void writeTileData();
+    void writeHues();
+    void writeRadarCol();
+    void writeArt();
+    void writeGumpArt();
+    void writeTexMaps();
+    void writeAnim();
+    void writeAnimData();
+    void writeMap();
+    void writeStatics();
+    void writeUniFont(const std::string& name);
+    void writeCliloc();
+    void writeSkills();
+    void writeSound();
+    void writeDefFiles();
+    void writeNumericDefFile(const std::string& name, const char* pattern, unsigned int recordCount, bool duplicateId);
+    void writeSpellbooks();
+};
+
+}
+}
+
+#endif
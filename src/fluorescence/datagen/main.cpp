@@ -0,0 +1,122 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "datasetwriter.hpp"
+#include "conformancecheck.hpp"
+
+#include <data/ioscheduler.hpp>
+
+#include <misc/exception.hpp>
+#include <misc/log.hpp>
+#include <misc/profiler.hpp>
+
+#include <ClanLib/core.h>
+
+#include <boost/program_options.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <iostream>
+
+namespace po = boost::program_options;
+namespace bfs = boost::filesystem;
+
+using namespace fluo;
+
+int main(int argc, char** argv) {
+    LOG_INIT(LOG_LEVEL_INFO);
+
+    po::options_description desc("fluo-datagen: writes a synthetic data set and checks that the client loaders decode it as expected");
+    desc.add_options()
+    ("help,h", "Receive this message")
+    ("directory", po::value<std::string>()->default_value("datagen"), "Directory of the data set")
+    ("generate", "Write the data set. If neither generate nor verify is given, both are done")
+    ("verify", "Load the data set through the client loaders and compare with the manifest")
+    ("seed", po::value<unsigned int>()->default_value(1), "Seed of the random content")
+    ("map-width", po::value<unsigned int>()->default_value(64), "Width of the facet in blocks")
+    ("map-height", po::value<unsigned int>()->default_value(64), "Height of the facet in blocks")
+    ("high-seas", "Write tiledata.mul in the high seas format")
+    ("io-threads", po::value<unsigned int>()->default_value(2), "Number of io threads used by the loaders")
+    ("decode-threads", po::value<unsigned int>()->default_value(0), "Number of decode threads used by the loaders")
+    ("profile", "Print the time spent on each file")
+    ("profile-report", po::value<std::string>(), "Write the time spent on each file as json to this path")
+    ;
+
+    po::variables_map options;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), options);
+        po::notify(options);
+    } catch (const std::exception& ex) {
+        std::cout << ex.what() << std::endl << desc << std::endl;
+        return 1;
+    }
+
+    if (options.count("help")) {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    CL_SetupCore setupCore;
+
+    bfs::path directory(options["directory"].as<std::string>());
+    bool generate = options.count("generate") > 0;
+    bool verify = options.count("verify") > 0;
+    if (!generate && !verify) {
+        generate = true;
+        verify = true;
+    }
+
+    StartupProfiler::getSingleton()->setPrintTree(options.count("profile") > 0);
+    if (options.count("profile-report")) {
+        StartupProfiler::getSingleton()->setReportPath(bfs::path(options["profile-report"].as<std::string>()));
+    }
+
+    bool success = true;
+    try {
+        if (generate) {
+            ProfilePhase phase("generate");
+            bfs::create_directories(directory);
+
+            datagen::DataSetWriter writer(directory, options["seed"].as<unsigned int>(),
+                    options["map-width"].as<unsigned int>(), options["map-height"].as<unsigned int>(), options.count("high-seas") > 0);
+            writer.write();
+
+            LOG_INFO << "Data set written to " << directory << ". To start the client with it, set /fluo/files/mul-directory@path to it, /fluo/files/map0@width and @height to " <<
+                    options["map-width"].as<unsigned int>() << "x" << options["map-height"].as<unsigned int>() <<
+                    " blocks and /fluo/files/anim@highdetail to " << datagen::DataSetWriter::ANIM_BODY_COUNT << std::endl;
+        }
+
+        if (verify) {
+            ProfilePhase phase("verify");
+            data::IoScheduler::create(options["io-threads"].as<unsigned int>(), options["decode-threads"].as<unsigned int>());
+
+            datagen::ConformanceCheck check(directory);
+            success = check.run();
+
+            data::IoScheduler::destroy();
+        }
+    } catch (const std::exception& ex) {
+        LOG_EMERGENCY << "Unable to process data set: " << ex.what() << std::endl;
+        data::IoScheduler::destroy();
+        success = false;
+    }
+
+    StartupProfiler::getSingleton()->finish();
+    return success ? 0 : 1;
+}
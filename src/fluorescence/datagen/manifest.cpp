@@ -0,0 +1,139 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "manifest.hpp"
+
+#include <misc/exception.hpp>
+#include <misc/log.hpp>
+
+#include <boost/filesystem/fstream.hpp>
+
+#include <sstream>
+
+namespace fluo {
+namespace datagen {
+
+const char* const Manifest::FILE_NAME = "fluo-datagen.manifest";
+
+void Manifest::setOption(const std::string& name, unsigned int value) {
+    options_[name] = value;
+}
+
+unsigned int Manifest::getOption(const std::string& name) const {
+    std::map<std::string, unsigned int>::const_iterator iter = options_.find(name);
+    if (iter == options_.end()) {
+        LOG_ERROR << "Option " << name << " missing in manifest" << std::endl;
+        throw Exception("Incomplete manifest");
+    }
+
+    return iter->second;
+}
+
+void Manifest::setSection(const std::string& name, unsigned int first, unsigned int end, const Checksum& checksum) {
+    Section& section = sections_[name];
+    section.first_ = first;
+    section.end_ = end;
+    section.count_ = checksum.getCount();
+    section.checksum_ = checksum.get();
+}
+
+const Manifest::Section& Manifest::getSection(const std::string& name) const {
+    std::map<std::string, Section>::const_iterator iter = sections_.find(name);
+    if (iter == sections_.end()) {
+        LOG_ERROR << "Section " << name << " missing in manifest" << std::endl;
+        throw Exception("Incomplete manifest");
+    }
+
+    return iter->second;
+}
+
+const std::map<std::string, Manifest::Section>& Manifest::getSections() const {
+    return sections_;
+}
+
+void Manifest::save(const boost::filesystem::path& path) const {
+    boost::filesystem::ofstream stream(path);
+    if (!stream.is_open()) {
+        LOG_ERROR << "Unable to open manifest " << path << " for writing" << std::endl;
+        throw Exception("Unable to write manifest");
+    }
+
+    stream << "# expected decode results of the data set, written by fluo-datagen" << std::endl;
+
+    std::map<std::string, unsigned int>::const_iterator optionIter = options_.begin();
+    std::map<std::string, unsigned int>::const_iterator optionEnd = options_.end();
+    for (; optionIter != optionEnd; ++optionIter) {
+        stream << "option " << optionIter->first << " " << optionIter->second << std::endl;
+    }
+
+    std::map<std::string, Section>::const_iterator sectionIter = sections_.begin();
+    std::map<std::string, Section>::const_iterator sectionEnd = sections_.end();
+    for (; sectionIter != sectionEnd; ++sectionIter) {
+        const Section& section = sectionIter->second;
+        stream << "section " << sectionIter->first << " " << section.first_ << " " << section.end_ << " " << section.count_ << " " <<
+                std::hex << section.checksum_ << std::dec << std::endl;
+    }
+
+    if (!stream.good()) {
+        throw Exception("Unable to write manifest");
+    }
+}
+
+void Manifest::load(const boost::filesystem::path& path) {
+    boost::filesystem::ifstream stream(path);
+    if (!stream.is_open()) {
+        LOG_ERROR << "Unable to open manifest " << path << std::endl;
+        throw Exception("Unable to read manifest");
+    }
+
+    options_.clear();
+    sections_.clear();
+
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (std::getline(stream, line)) {
+        ++lineNumber;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::istringstream lineStream(line);
+        std::string type;
+        std::string name;
+        lineStream >> type >> name;
+
+        if (type == "option") {
+            lineStream >> options_[name];
+        } else if (type == "section") {
+            Section& section = sections_[name];
+            lineStream >> section.first_ >> section.end_ >> section.count_ >> std::hex >> section.checksum_;
+        } else {
+            lineStream.setstate(std::ios_base::failbit);
+        }
+
+        if (lineStream.fail()) {
+            LOG_ERROR << "Malformed line " << lineNumber << " in manifest " << path << std::endl;
+            throw Exception("Unable to read manifest");
+        }
+    }
+}
+
+}
+}
@@ -0,0 +1,81 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_DATAGEN_MANIFEST_HPP
+#define FLUO_DATAGEN_MANIFEST_HPP
+
+#include "checksum.hpp"
+
+#include <boost/filesystem/path.hpp>
+
+#include <map>
+#include <string>
+
+namespace fluo {
+namespace datagen {
+
+/**
+ * \brief Expected decode results of a generated data set
+ *
+ * Text file with one line per generator option ("option <name> <value>") and per section
+ * ("section <name> <first id> <end id> <entry count> <checksum>"). A section usually covers one file. The id range
+ * tells the conformance check which ids to probe, entries missing in the file are not part of count and checksum.
+ */
+class Manifest {
+public:
+    static const char* const FILE_NAME;
+
+    struct Section {
+        Section() : first_(0), end_(0), count_(0), checksum_(0) {
+        }
+
+        unsigned int first_;
+        unsigned int end_;
+        unsigned int count_;
+        uint64_t checksum_;
+    };
+
+    void setOption(const std::string& name, unsigned int value);
+
+    /// \throw Exception if the option is missing
+    unsigned int getOption(const std::string& name) const;
+
+    void setSection(const std::string& name, unsigned int first, unsigned int end, const Checksum& checksum);
+
+    /// \throw Exception if the section is missing
+    const Section& getSection(const std::string& name) const;
+
+    const std::map<std::string, Section>& getSections() const;
+
+    /// \throw Exception if the file can not be written
+    void save(const boost::filesystem::path& path) const;
+
+    /// \throw Exception if the file can not be read or is malformed
+    void load(const boost::filesystem::path& path);
+
+private:
+    std::map<std::string, unsigned int> options_;
+    std::map<std::string, Section> sections_;
+};
+
+}
+}
+
+#endif
@@ -28,6 +28,7 @@
 #include <boost/program_options.hpp>
 
 #include "log.hpp"
+#include "profiler.hpp"
 
 
 namespace fluo {
@@ -40,6 +41,43 @@ void Config::initDefaults() {
     variablesMap_["/fluo/files/mul-directory@path"].setPath("./", true);
     variablesMap_["/fluo/files/cliloc@language"].setString("enu", true);
     variablesMap_["/fluo/files@format"].setString("mul", true);
+    variablesMap_["/fluo/files/io@threads"].setInt(2, true);
+    variablesMap_["/fluo/files/io@decode-threads"].setInt(0, true); // 0 = one per core
+    variablesMap_["/fluo/files/startup@threads"].setInt(0, true); // loader construction. 0 = one per core, 1 = serial
+
+    // size of the recently used items kept in memory per file, in megabytes. 0 = disabled
+    variablesMap_["/fluo/files/cache@art-mb"].setInt(32, true);
+    variablesMap_["/fluo/files/cache@gumpart-mb"].setInt(16, true);
+    variablesMap_["/fluo/files/cache@texmaps-mb"].setInt(16, true);
+    variablesMap_["/fluo/files/cache@anim-mb"].setInt(48, true);
+
+    // decoded art, gumps and animations stored on disk
+    variablesMap_["/fluo/files/decode-cache@enabled"].setBool(false, true);
+    variablesMap_["/fluo/files/decode-cache@path"].setPath("./decodecache/", true);
+    variablesMap_["/fluo/files/decode-cache@max-mb"].setInt(1024, true); // all versions of one file, the current one is always kept
+    variablesMap_["/fluo/files/decode-cache@max-age-days"].setInt(30, true); // versions not used for this long are removed
+
+    // decoded art, gumps, texmaps and tiledata shared with other clients using the same files
+    variablesMap_["/fluo/files/shared-cache@enabled"].setBool(false, true);
+    variablesMap_["/fluo/files/shared-cache@size-mb"].setInt(256, true);
+
+    // parsed def files, reused while their size and modification time do not change
+    variablesMap_["/fluo/files/def-cache@enabled"].setBool(false, true);
+    variablesMap_["/fluo/files/def-cache@path"].setPath("./defcache/", true);
+
+    // gumps and art loaded from urls
+    variablesMap_["/fluo/files/http@max-connections"].setInt(4, true); // parallel downloads
+    variablesMap_["/fluo/files/http-cache@enabled"].setBool(false, true); // revalidated with ETag/Last-Modified
+    variablesMap_["/fluo/files/http-cache@path"].setPath("./httpcache/", true);
+
+    // art and texmaps packed into atlas pages by fluo-packer
+    variablesMap_["/fluo/files/texture-pack@enabled"].setBool(false, true);
+    variablesMap_["/fluo/files/texture-pack@path"].setPath("./textures.fpk", true);
+
+    // animations of mobiles in range, loaded before they are first shown
+    variablesMap_["/fluo/files/anim-prefetch@enabled"].setBool(false, true);
+    variablesMap_["/fluo/files/anim-prefetch@max-animations"].setInt(256, true);
+    variablesMap_["/fluo/files/anim-prefetch@per-frame"].setInt(4, true);
 
     // maps
     variablesMap_["/fluo/files/map0@enabled"].setBool(true, true);
@@ -159,6 +197,8 @@ bool Config::parseCommandLine(const std::vector<CL_String8>& args) {
     ("patcherupdate", "Indicates that the patcher itself has just received an update")
     ("defaultconfig", "Write defaultConfig.xml file")
     ("shard", po::value<std::string>(), "The shard you want to connect to. If empty, shard selection dialog is shown. Shard name can also be given without --shard prefix")
+    ("profile-startup", "Log the time and resources used by the startup phases, up to the first gump")
+    ("profile-report", po::value<std::string>(), "Write the startup phases to this json file")
     ;
 
     // transform vector to default argc, argv
@@ -197,6 +237,14 @@ bool Config::parseCommandLine(const std::vector<CL_String8>& args) {
             UnicodeString shard = StringConverter::fromUtf8(consoleOptions["shard"].as<std::string>());
             setShardName(shard);
         }
+
+        if (consoleOptions.count("profile-startup")) {
+            StartupProfiler::getSingleton()->setPrintTree(true);
+        }
+
+        if (consoleOptions.count("profile-report") > 0) {
+            StartupProfiler::getSingleton()->setReportPath(consoleOptions["profile-report"].as<std::string>());
+        }
     } catch (const std::exception& ex) {
         LOG_EMERGENCY << "Error parsing command line: " << ex.what() << std::endl;
         return false;
@@ -0,0 +1,181 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "log.hpp"
+
+
+#include "profiler.hpp"
+
+#include <iomanip>
+#include <sstream>
+#include <boost/filesystem/fstream.hpp>
+
+#include "log.hpp"
+
+namespace fluo {
+
+StartupProfiler* StartupProfiler::singleton_ = NULL;
+
+StartupProfiler* StartupProfiler::getSingleton() {
+    if (!singleton_) {
+        singleton_ = new StartupProfiler();
+    }
+    return singleton_;
+}
+
+StartupProfiler::StartupProfiler() : finished_(false), printTree_(false) {
+}
+
+void StartupProfiler::setPrintTree(bool value) {
+    printTree_ = value;
+}
+
+void StartupProfiler::setReportPath(const boost::filesystem::path& path) {
+    reportPath_ = path;
+}
+
+void StartupProfiler::takeSample(Sample& sample) {
+    timeval now;
+    gettimeofday(&now, NULL);
+    sample.wallMicros_ = (uint64_t)now.tv_sec * 1000000 + now.tv_usec;
+    getProcessUsage(sample.usage_);
+}
+
+void StartupProfiler::begin(const char* name) {
+    if (finished_) {
+        return;
+    }
+
+    unsigned int index = phases_.size();
+    phases_.push_back(Phase());
+    phases_.back().name_ = name;
+
+    if (openPhases_.empty()) {
+        rootPhases_.push_back(index);
+    } else {
+        phases_[openPhases_.back()].children_.push_back(index);
+    }
+    openPhases_.push_back(index);
+
+    // sample last, so the bookkeeping is not part of the phase
+    takeSample(phases_.back().start_);
+}
+
+void StartupProfiler::end() {
+    if (finished_ || openPhases_.empty()) {
+        return;
+    }
+
+    takeSample(phases_[openPhases_.back()].end_);
+    openPhases_.pop_back();
+}
+
+void StartupProfiler::finish() {
+    if (finished_) {
+        return;
+    }
+
+    while (!openPhases_.empty()) {
+        end();
+    }
+    finished_ = true;
+
+    if (printTree_) {
+        LOG_INFO << "Startup phases (wall ms / cpu ms / MB read / peak MB):" << std::endl;
+        for (unsigned int i = 0; i < rootPhases_.size(); ++i) {
+            printPhase(rootPhases_[i], 0);
+        }
+    }
+
+    if (!reportPath_.empty()) {
+        boost::filesystem::ofstream stream(reportPath_);
+        if (!stream) {
+            LOG_ERROR << "Unable to write startup report to " << reportPath_ << std::endl;
+            return;
+        }
+
+        stream << "{\n    \"phases\": [";
+        for (unsigned int i = 0; i < rootPhases_.size(); ++i) {
+            stream << (i > 0 ? "," : "") << "\n";
+            writeJsonPhase(stream, rootPhases_[i], 2);
+        }
+        stream << "\n    ]\n}\n";
+
+        LOG_INFO << "Startup report written to " << reportPath_ << std::endl;
+    }
+}
+
+void StartupProfiler::printPhase(unsigned int index, unsigned int depth) const {
+    const Phase& phase = phases_[index];
+
+    // formatted separately, so the log stream keeps its number format
+    std::ostringstream line;
+    line << std::string(depth * 2, ' ') << phase.name_ << ": " << std::fixed << std::setprecision(1) <<
+            (phase.end_.wallMicros_ - phase.start_.wallMicros_) / 1000.0 << " / " <<
+            (phase.end_.usage_.cpuMicros_ - phase.start_.usage_.cpuMicros_) / 1000.0 << " / " <<
+            (phase.end_.usage_.bytesRead_ - phase.start_.usage_.bytesRead_) / (1024.0 * 1024.0) << " / " <<
+            phase.end_.usage_.peakRssBytes_ / (1024.0 * 1024.0);
+    LOG_INFO << line.str() << std::endl;
+
+    for (unsigned int i = 0; i < phase.children_.size(); ++i) {
+        printPhase(phase.children_[i], depth + 1);
+    }
+}
+
+void StartupProfiler::writeJsonPhase(std::ostream& stream, unsigned int index, unsigned int depth) const {
+    const Phase& phase = phases_[index];
+    std::string indent(depth * 4, ' ');
+
+    // phase names are plain identifiers, only quotes and backslashes need escaping
+    std::string name;
+    for (unsigned int i = 0; i < phase.name_.size(); ++i) {
+        if (phase.name_[i] == '"' || phase.name_[i] == '\\') {
+            name += '\\';
+        }
+        name += phase.name_[i];
+    }
+
+    stream << indent << "{\n" <<
+            indent << "    \"name\": \"" << name << "\",\n" <<
+            indent << "    \"wall_us\": " << (phase.end_.wallMicros_ - phase.start_.wallMicros_) << ",\n" <<
+            indent << "    \"cpu_us\": " << (phase.end_.usage_.cpuMicros_ - phase.start_.usage_.cpuMicros_) << ",\n" <<
+            indent << "    \"bytes_read\": " << (phase.end_.usage_.bytesRead_ - phase.start_.usage_.bytesRead_) << ",\n" <<
+            indent << "    \"peak_rss_bytes\": " << phase.end_.usage_.peakRssBytes_ << ",\n" <<
+            indent << "    \"children\": [";
+
+    for (unsigned int i = 0; i < phase.children_.size(); ++i) {
+        stream << (i > 0 ? "," : "") << "\n";
+        writeJsonPhase(stream, phase.children_[i], depth + 2);
+    }
+
+    if (!phase.children_.empty()) {
+        stream << "\n" << indent << "    ";
+    }
+    stream << "]\n" << indent << "}";
+}
+
+
+ProfilePhase::ProfilePhase(const char* name) {
+    StartupProfiler::getSingleton()->begin(name);
+}
+
+ProfilePhase::~ProfilePhase() {
+    StartupProfiler::getSingleton()->end();
+}
+
+}
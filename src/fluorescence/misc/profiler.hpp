@@ -0,0 +1,96 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_MISC_PROFILER_HPP
+#define FLUO_MISC_PROFILER_HPP
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include <boost/filesystem/path.hpp>
+
+#include <platform.hpp>
+
+namespace fluo {
+
+/**
+ * \brief Records wall time, cpu time, bytes read and peak memory of the startup phases
+ *
+ * Phases are usually opened with a ProfilePhase object, a phase started while another one is open becomes its child.
+ * Phases are always recorded, they are cheap. Whether the tree is printed and the json report is written is set
+ * from the command line. Only to be used from the main thread.
+ */
+class StartupProfiler {
+public:
+    static StartupProfiler* getSingleton();
+
+    void setPrintTree(bool value);
+    void setReportPath(const boost::filesystem::path& path);
+
+    void begin(const char* name);
+    void end();
+
+    /// Closes all open phases, then prints the tree and writes the report if requested. Later calls do nothing
+    void finish();
+
+private:
+    static StartupProfiler* singleton_;
+
+    StartupProfiler();
+    StartupProfiler(const StartupProfiler& copy) { }
+    StartupProfiler& operator=(const StartupProfiler& copy) { return *this; }
+
+    struct Sample {
+        uint64_t wallMicros_;
+        ProcessUsage usage_;
+    };
+
+    static void takeSample(Sample& sample);
+
+    struct Phase {
+        std::string name_;
+        Sample start_;
+        Sample end_;
+        std::vector<unsigned int> children_;
+    };
+
+    std::vector<Phase> phases_;
+    std::vector<unsigned int> rootPhases_;
+    std::vector<unsigned int> openPhases_;
+
+    bool finished_;
+    bool printTree_;
+    boost::filesystem::path reportPath_;
+
+    void printPhase(unsigned int index, unsigned int depth) const;
+    void writeJsonPhase(std::ostream& stream, unsigned int index, unsigned int depth) const;
+};
+
+/// Scoped StartupProfiler phase
+class ProfilePhase {
+public:
+    ProfilePhase(const char* name);
+    ~ProfilePhase();
+};
+
+}
+
+#endif
@@ -57,6 +57,7 @@ void NakedMobile::onReceive() {
     mob->setHue(hue_);
     mob->setStatusFlags(status_);
     mob->moveTo(locX_, locY_, locZ_, direction_);
+    mob->prefetchAnimations();
 }
 
 }
@@ -86,6 +86,9 @@ void EquippedMobile::onReceive() {
 
         mob->addChildObject(itm);
     }
+
+    // after the equipment, which decides between the armed and unarmed animations
+    mob->prefetchAnimations();
 }
 
 }
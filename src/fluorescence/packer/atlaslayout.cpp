@@ -0,0 +1,88 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include "atlaslayout.hpp"
+
+namespace fluo {
+namespace packer {
+
+AtlasLayout::AtlasLayout(unsigned int pageWidth, unsigned int pageHeight) :
+        pageWidth_(pageWidth), pageHeight_(pageHeight), page_(0), usedHeight_(0) {
+}
+
+bool AtlasLayout::add(unsigned int width, unsigned int height, unsigned int& x, unsigned int& y) {
+    if (width > pageWidth_ || height > pageHeight_) {
+        return false;
+    }
+
+    Shelf* best = NULL;
+    std::vector<Shelf>::iterator iter = shelves_.begin();
+    std::vector<Shelf>::iterator end = shelves_.end();
+    for (; iter != end; ++iter) {
+        if (iter->height_ >= height && iter->usedWidth_ + width <= pageWidth_ &&
+                (!best || iter->height_ < best->height_)) {
+            best = &(*iter);
+        }
+    }
+
+    // do not waste more than half of a shelf, if there is still room for a new one
+    if (best && best->height_ > height * 2 && usedHeight_ + height <= pageHeight_) {
+        best = NULL;
+    }
+
+    if (!best) {
+        if (usedHeight_ + height > pageHeight_) {
+            return false;
+        }
+
+        Shelf shelf;
+        shelf.y_ = usedHeight_;
+        shelf.height_ = height;
+        shelf.usedWidth_ = 0;
+        shelves_.push_back(shelf);
+        usedHeight_ += height;
+
+        best = &shelves_.back();
+    }
+
+    x = best->usedWidth_;
+    y = best->y_;
+    best->usedWidth_ += width;
+
+    return true;
+}
+
+void AtlasLayout::nextPage() {
+    ++page_;
+    shelves_.clear();
+    usedHeight_ = 0;
+}
+
+unsigned int AtlasLayout::getPage() const {
+    return page_;
+}
+
+bool AtlasLayout::isPageEmpty() const {
+    return shelves_.empty();
+}
+
+}
+}
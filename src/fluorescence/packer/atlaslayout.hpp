@@ -0,0 +1,65 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_PACKER_ATLASLAYOUT_HPP
+#define FLUO_PACKER_ATLASLAYOUT_HPP
+
+#include <vector>
+#include <cstddef>
+
+namespace fluo {
+namespace packer {
+
+/**
+ * \brief Places rectangles on fixed size pages, row by row (shelf packing)
+ *
+ * A rectangle is put on the existing shelf that wastes the least height. If none fits, a new shelf is opened below the last one.
+ */
+class AtlasLayout {
+public:
+    AtlasLayout(unsigned int pageWidth, unsigned int pageHeight);
+
+    /// Returns false if the rectangle does not fit on the current page anymore
+    bool add(unsigned int width, unsigned int height, unsigned int& x, unsigned int& y);
+
+    void nextPage();
+
+    unsigned int getPage() const;
+    bool isPageEmpty() const;
+
+private:
+    struct Shelf {
+        unsigned int y_;
+        unsigned int height_;
+        unsigned int usedWidth_;
+    };
+
+    unsigned int pageWidth_;
+    unsigned int pageHeight_;
+
+    unsigned int page_;
+    std::vector<Shelf> shelves_;
+    unsigned int usedHeight_;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,221 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include "texturepacker.hpp"
+
+#include <data/artloader.hpp>
+#include <data/maptexloader.hpp>
+#include <data/indexloader.hpp>
+#include <data/ioscheduler.hpp>
+#include <data/decodecache.hpp>
+
+#include <misc/exception.hpp>
+#include <misc/log.hpp>
+
+#include <ClanLib/core.h>
+
+#include <boost/program_options.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <map>
+#include <set>
+#include <sstream>
+#include <iostream>
+
+namespace po = boost::program_options;
+namespace bfs = boost::filesystem;
+
+using namespace fluo;
+
+namespace {
+
+void collectIndexIds(const bfs::path& idxPath, unsigned int first, unsigned int last, std::vector<unsigned int>& ids) {
+    data::IndexLoader index(idxPath);
+    last = (std::min)(last, index.size());
+    for (unsigned int i = first; i < last; ++i) {
+        const data::IndexBlock& block = index.get(i);
+        if (block.offset_ != 0xFFFFFFFFu && block.length_ != 0xFFFFFFFFu && block.length_ != 0) {
+            ids.push_back(i);
+        }
+    }
+}
+
+/**
+ * Reads the art ids of all statics on the map, grouped by regions of regionSize*regionSize blocks.
+ * Regions are stored row by row, so neighbouring regions end up on the same or adjacent atlas pages
+ */
+void collectStatics(const bfs::path& idxPath, const bfs::path& mulPath, unsigned int blockCountX, unsigned int blockCountY,
+        unsigned int regionSize, std::vector<std::set<unsigned int> >& regions) {
+    unsigned int regionCountX = (blockCountX + regionSize - 1) / regionSize;
+    unsigned int regionCountY = (blockCountY + regionSize - 1) / regionSize;
+    regions.resize(regionCountX * regionCountY);
+
+    data::IndexLoader index(idxPath);
+    bfs::ifstream stream(mulPath, std::ios_base::binary);
+    if (!stream.is_open()) {
+        throw Exception("Unable to open statics file");
+    }
+
+    std::vector<uint8_t> buf;
+    for (unsigned int blockX = 0; blockX < blockCountX; ++blockX) {
+        for (unsigned int blockY = 0; blockY < blockCountY; ++blockY) {
+            unsigned int idx = blockX * blockCountY + blockY;
+            if (idx >= index.size()) {
+                continue;
+            }
+
+            const data::IndexBlock& block = index.get(idx);
+            if (block.offset_ == 0xFFFFFFFFu || block.length_ == 0xFFFFFFFFu || block.length_ == 0) {
+                continue;
+            }
+
+            buf.resize(block.length_);
+            stream.seekg(block.offset_, std::ios_base::beg);
+            stream.read(reinterpret_cast<char*>(&buf[0]), block.length_);
+            if (!stream.good()) {
+                stream.clear();
+                continue;
+            }
+
+            std::set<unsigned int>& region = regions[(blockY / regionSize) * regionCountX + blockX / regionSize];
+
+            // 7 bytes per static: art id, x, y, z, hue
+            for (unsigned int i = 0; i + 7 <= buf.size(); i += 7) {
+                region.insert(0x4000 + (buf[i] | (buf[i + 1] << 8)));
+            }
+        }
+    }
+}
+
+uint64_t hashSource(const bfs::path& idxPath, const bfs::path& mulPath) {
+    std::vector<bfs::path> indexFiles(1, idxPath);
+    std::vector<bfs::path> dataFiles(1, mulPath);
+    return data::DecodeCache::hashFiles(indexFiles, dataFiles);
+}
+
+}
+
+int main(int argc, char** argv) {
+    LOG_INIT(LOG_LEVEL_INFO);
+
+    po::options_description desc("fluo-packer: packs art and texmaps into texture atlas pages for the fluorescence client");
+    desc.add_options()
+    ("help,h", "Receive this message")
+    ("mul-directory", po::value<std::string>()->default_value("."), "Directory containing the mul files")
+    ("output", po::value<std::string>()->default_value("textures.fpk"), "The texture pack file to write")
+    ("map", po::value<unsigned int>()->default_value(0), "Index of the facet whose statics are packed in regions")
+    ("map-width", po::value<unsigned int>()->default_value(896), "Width of the facet in blocks")
+    ("map-height", po::value<unsigned int>()->default_value(512), "Height of the facet in blocks")
+    ("region-size", po::value<unsigned int>()->default_value(32), "Width and height of a region in blocks")
+    ("common-regions", po::value<unsigned int>()->default_value(0), "Statics used in at least this many regions are packed together. 0 = a tenth of all regions")
+    ;
+
+    po::variables_map options;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), options);
+        po::notify(options);
+    } catch (const std::exception& ex) {
+        std::cout << ex.what() << std::endl << desc << std::endl;
+        return 1;
+    }
+
+    if (options.count("help")) {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    CL_SetupCore setupCore;
+
+    bfs::path mulDirectory(options["mul-directory"].as<std::string>());
+    unsigned int mapIndex = options["map"].as<unsigned int>();
+    unsigned int regionSize = (std::max)(1u, options["region-size"].as<unsigned int>());
+
+    std::ostringstream staticsName;
+    staticsName << "statics" << mapIndex << ".mul";
+    std::ostringstream staticsIdxName;
+    staticsIdxName << "staidx" << mapIndex << ".mul";
+
+    try {
+        data::IoScheduler::create(2, 0);
+
+        uint64_t sourceHash[data::TexturePack::Source::COUNT];
+        sourceHash[data::TexturePack::Source::ART] = hashSource(mulDirectory / "artidx.mul", mulDirectory / "art.mul");
+        sourceHash[data::TexturePack::Source::TEXMAP] = hashSource(mulDirectory / "texidx.mul", mulDirectory / "texmaps.mul");
+
+        boost::shared_ptr<data::ArtLoader> artLoader(new data::ArtLoader(mulDirectory / "artidx.mul", mulDirectory / "art.mul"));
+        boost::shared_ptr<data::MapTexLoader> mapTexLoader(new data::MapTexLoader(mulDirectory / "texidx.mul", mulDirectory / "texmaps.mul"));
+
+        packer::TexturePacker texturePacker(bfs::path(options["output"].as<std::string>()), sourceHash, artLoader, mapTexLoader);
+
+        std::vector<unsigned int> ids;
+        collectIndexIds(mulDirectory / "artidx.mul", 0, 0x4000, ids);
+        texturePacker.addGroup("land", data::TexturePack::Source::ART, ids, true);
+
+        ids.clear();
+        collectIndexIds(mulDirectory / "texidx.mul", 0, 0xFFFFFFFFu, ids);
+        texturePacker.addGroup("texmaps", data::TexturePack::Source::TEXMAP, ids, true);
+
+        std::vector<std::set<unsigned int> > regions;
+        collectStatics(mulDirectory / staticsIdxName.str(), mulDirectory / staticsName.str(),
+                options["map-width"].as<unsigned int>(), options["map-height"].as<unsigned int>(), regionSize, regions);
+
+        std::map<unsigned int, unsigned int> regionCount;
+        for (unsigned int i = 0; i < regions.size(); ++i) {
+            std::set<unsigned int>::const_iterator iter = regions[i].begin();
+            std::set<unsigned int>::const_iterator end = regions[i].end();
+            for (; iter != end; ++iter) {
+                ++regionCount[*iter];
+            }
+        }
+
+        unsigned int commonThreshold = options["common-regions"].as<unsigned int>();
+        if (commonThreshold == 0) {
+            commonThreshold = (std::max)(2u, (unsigned int)regions.size() / 10);
+        }
+
+        ids.clear();
+        std::map<unsigned int, unsigned int>::const_iterator countIter = regionCount.begin();
+        std::map<unsigned int, unsigned int>::const_iterator countEnd = regionCount.end();
+        for (; countIter != countEnd; ++countIter) {
+            if (countIter->second >= commonThreshold) {
+                ids.push_back(countIter->first);
+            }
+        }
+        texturePacker.addGroup("common statics", data::TexturePack::Source::ART, ids, true);
+
+        // statics that are already part of the common group are skipped by the packer
+        for (unsigned int i = 0; i < regions.size(); ++i) {
+            ids.assign(regions[i].begin(), regions[i].end());
+            std::ostringstream name;
+            name << "region " << i;
+            texturePacker.addGroup(name.str(), data::TexturePack::Source::ART, ids, i == 0);
+        }
+
+        texturePacker.finish();
+    } catch (const std::exception& ex) {
+        LOG_EMERGENCY << "Unable to create texture pack: " << ex.what() << std::endl;
+        data::IoScheduler::destroy();
+        return 1;
+    }
+
+    data::IoScheduler::destroy();
+    return 0;
+}
@@ -0,0 +1,243 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include "texturepacker.hpp"
+
+#include <data/artloader.hpp>
+#include <data/maptexloader.hpp>
+#include <data/completionqueue.hpp>
+
+#include <ui/texture.hpp>
+#include <ui/bitmask.hpp>
+#include <ui/manager.hpp>
+
+#include <misc/exception.hpp>
+#include <misc/log.hpp>
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace fluo {
+namespace packer {
+
+TexturePacker::TexturePacker(const boost::filesystem::path& outputPath, const uint64_t sourceHash[data::TexturePack::Source::COUNT],
+            boost::shared_ptr<data::ArtLoader> artLoader, boost::shared_ptr<data::MapTexLoader> mapTexLoader) :
+        outputPath_(outputPath), artLoader_(artLoader), mapTexLoader_(mapTexLoader),
+        layout_(ui::Manager::TEXTURE_GROUP_WIDTH, ui::Manager::TEXTURE_GROUP_HEIGHT), finishedCount_(0) {
+
+    memset(&header_, 0, sizeof(header_));
+    memcpy(header_.magic_, "FLPK", 4);
+    header_.version_ = data::TexturePack::VERSION;
+    for (unsigned int i = 0; i < data::TexturePack::Source::COUNT; ++i) {
+        header_.sourceHash_[i] = sourceHash[i];
+    }
+    header_.pageWidth_ = ui::Manager::TEXTURE_GROUP_WIDTH;
+    header_.pageHeight_ = ui::Manager::TEXTURE_GROUP_HEIGHT;
+
+    pagePixels_.resize(header_.pageWidth_ * header_.pageHeight_, 0);
+
+    // the pack is written to a temporary file first, the client must never see a half written pack
+    tempPath_ = outputPath_;
+    tempPath_.replace_extension(".tmp");
+    stream_.open(tempPath_, std::ios_base::binary | std::ios_base::trunc);
+    if (!stream_.is_open()) {
+        throw Exception("Unable to open output file");
+    }
+
+    // placeholder, rewritten in finish
+    stream_.write(reinterpret_cast<char*>(&header_), sizeof(header_));
+}
+
+void TexturePacker::addGroup(const std::string& name, unsigned int source, const std::vector<unsigned int>& ids, bool startNewPage) {
+    if (startNewPage && !layout_.isPageEmpty()) {
+        flushPage();
+        layout_.nextPage();
+    }
+
+    unsigned int firstPage = layout_.getPage();
+    unsigned int packedCount = 0;
+
+    std::vector<unsigned int>::const_iterator iter = ids.begin();
+    std::vector<unsigned int>::const_iterator end = ids.end();
+    while (iter != end) {
+        // request a whole batch first, so that the io and decode threads can work in parallel
+        std::vector<std::pair<unsigned int, boost::shared_ptr<ui::Texture> > > batch;
+        for (; iter != end && batch.size() < BATCH_SIZE; ++iter) {
+            if (packedIds_.count(std::make_pair(source, *iter))) {
+                continue;
+            }
+
+            boost::shared_ptr<ui::Texture> tex = load(source, *iter);
+            if (tex) {
+                batch.push_back(std::make_pair(*iter, tex));
+            }
+        }
+
+        // the listeners count the finished textures, they are called when the completion queue is drained
+        finishedCount_ = 0;
+        for (unsigned int i = 0; i < batch.size(); ++i) {
+            batch[i].second->addCompleteListener(this, boost::bind(&TexturePacker::onTextureFinished, this));
+        }
+
+        data::CompletionQueue* completionQueue = data::CompletionQueue::getSingleton();
+        while (finishedCount_ < batch.size()) {
+            if (!completionQueue->waitForPost(WAIT_TIMEOUT_MILLIS)) {
+                LOG_WARN << "Timeout waiting for " << (batch.size() - finishedCount_) << " textures of group " << name << std::endl;
+                break;
+            }
+            completionQueue->drain();
+        }
+
+        for (unsigned int i = 0; i < batch.size(); ++i) {
+            batch[i].second->removeCompleteListeners(this);
+
+            if (!batch[i].second->isReadComplete()) {
+                LOG_WARN << "Unable to read " << name << " id " << batch[i].first << ", not packed" << std::endl;
+                continue;
+            }
+
+            add(source, batch[i].first, batch[i].second);
+            ++packedCount;
+        }
+    }
+
+    LOG_INFO << "Group " << name << ": " << packedCount << " textures on pages " << firstPage << "-" << layout_.getPage() << std::endl;
+}
+
+void TexturePacker::onTextureFinished() {
+    ++finishedCount_;
+}
+
+boost::shared_ptr<ui::Texture> TexturePacker::load(unsigned int source, unsigned int id) {
+    if (source == data::TexturePack::Source::TEXMAP) {
+        return mapTexLoader_->get(id);
+    } else if (id < 0x4000) {
+        return artLoader_->getMapTexture(id);
+    } else {
+        return artLoader_->getItemTexture(id - 0x4000);
+    }
+}
+
+void TexturePacker::add(unsigned int source, unsigned int id, boost::shared_ptr<ui::Texture> tex) {
+    CL_PixelBuffer pixels = tex->getPixelBuffer();
+    if (pixels.is_null()) {
+        return;
+    }
+
+    unsigned int width = pixels.get_width();
+    unsigned int height = pixels.get_height();
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    unsigned int border = tex->getBorderWidth();
+    unsigned int widthWithBorder = width + border * 2;
+    unsigned int heightWithBorder = height + border * 2;
+
+    unsigned int x;
+    unsigned int y;
+    if (!layout_.add(widthWithBorder, heightWithBorder, x, y)) {
+        if (!layout_.isPageEmpty()) {
+            flushPage();
+            layout_.nextPage();
+        }
+
+        if (!layout_.add(widthWithBorder, heightWithBorder, x, y)) {
+            LOG_WARN << "Texture " << id << " is too big for a page, skipping" << std::endl;
+            return;
+        }
+    }
+
+    // the border repeats the edge pixels, like CL_PixelBufferHelp::add_border does for the texture groups
+    const uint32_t* src = reinterpret_cast<const uint32_t*>(pixels.get_data());
+    for (unsigned int py = 0; py < heightWithBorder; ++py) {
+        unsigned int srcY = (std::min)((std::max)(py, border) - border, height - 1);
+        uint32_t* dst = &pagePixels_[(y + py) * header_.pageWidth_ + x];
+        for (unsigned int px = 0; px < widthWithBorder; ++px) {
+            unsigned int srcX = (std::min)((std::max)(px, border) - border, width - 1);
+            dst[px] = src[srcY * width + srcX];
+        }
+    }
+
+    ui::BitMask bitMask;
+    bitMask.init(pixels);
+
+    data::TexturePack::Entry entry;
+    entry.source_ = source;
+    entry.id_ = id;
+    entry.page_ = layout_.getPage();
+    entry.x_ = x + border;
+    entry.y_ = y + border;
+    entry.width_ = width;
+    entry.height_ = height;
+    entry.borderWidth_ = border;
+    entry.maskOffset_ = masks_.size();
+    entries_.push_back(entry);
+
+    masks_.insert(masks_.end(), bitMask.getBitStore(), bitMask.getBitStore() + bitMask.getBitStoreSize());
+
+    packedIds_.insert(std::make_pair(source, id));
+}
+
+void TexturePacker::flushPage() {
+    if (layout_.isPageEmpty()) {
+        return;
+    }
+
+    // pages are written in order, directly behind the header
+    stream_.write(reinterpret_cast<char*>(&pagePixels_[0]), pagePixels_.size() * sizeof(uint32_t));
+    std::fill(pagePixels_.begin(), pagePixels_.end(), 0);
+    ++header_.pageCount_;
+}
+
+void TexturePacker::finish() {
+    flushPage();
+
+    header_.entryCount_ = entries_.size();
+    header_.entryOffset_ = stream_.tellp();
+    if (!entries_.empty()) {
+        stream_.write(reinterpret_cast<char*>(&entries_[0]), entries_.size() * sizeof(data::TexturePack::Entry));
+    }
+
+    header_.maskOffset_ = stream_.tellp();
+    if (!masks_.empty()) {
+        stream_.write(reinterpret_cast<char*>(&masks_[0]), masks_.size());
+    }
+
+    stream_.seekp(0, std::ios_base::beg);
+    stream_.write(reinterpret_cast<char*>(&header_), sizeof(header_));
+
+    bool success = stream_.good();
+    stream_.close();
+    if (!success) {
+        boost::filesystem::remove(tempPath_);
+        throw Exception("Error writing texture pack");
+    }
+
+    boost::filesystem::remove(outputPath_);
+    boost::filesystem::rename(tempPath_, outputPath_);
+
+    LOG_INFO << "Wrote " << outputPath_ << " with " << entries_.size() << " textures on " << header_.pageCount_ << " pages" << std::endl;
+}
+
+}
+}
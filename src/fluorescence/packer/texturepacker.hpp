@@ -0,0 +1,100 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef FLUO_PACKER_TEXTUREPACKER_HPP
+#define FLUO_PACKER_TEXTUREPACKER_HPP
+
+#include "atlaslayout.hpp"
+
+#include <data/texturepack.hpp>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <set>
+#include <vector>
+#include <string>
+
+namespace fluo {
+
+namespace ui {
+    class Texture;
+}
+
+namespace data {
+    class ArtLoader;
+    class MapTexLoader;
+}
+
+namespace packer {
+
+/**
+ * \brief Loads art and texmaps through the client loaders and writes them to a data::TexturePack file
+ *
+ * Textures are packed in the order of the groups. Each id is only packed once, by the first group containing it.
+ * The loaders are waited for by draining the data::CompletionQueue, like the client's main loop does.
+ */
+class TexturePacker {
+public:
+    TexturePacker(const boost::filesystem::path& outputPath, const uint64_t sourceHash[data::TexturePack::Source::COUNT],
+            boost::shared_ptr<data::ArtLoader> artLoader, boost::shared_ptr<data::MapTexLoader> mapTexLoader);
+
+    /**
+     * ids are indexes in art.mul or texmaps.mul, depending on source.
+     * If startNewPage is true, the group does not share a page with the previous one
+     */
+    void addGroup(const std::string& name, unsigned int source, const std::vector<unsigned int>& ids, bool startNewPage);
+
+    /// Writes the entry table and the header. The output file is only created by this call
+    void finish();
+
+private:
+    static const unsigned int BATCH_SIZE = 512;
+    /// Longest time without any finished texture before the rest of a batch is given up
+    static const unsigned int WAIT_TIMEOUT_MILLIS = 30000;
+
+    boost::filesystem::path outputPath_;
+    boost::filesystem::path tempPath_;
+    boost::filesystem::ofstream stream_;
+
+    boost::shared_ptr<data::ArtLoader> artLoader_;
+    boost::shared_ptr<data::MapTexLoader> mapTexLoader_;
+
+    data::TexturePack::Header header_;
+    std::vector<data::TexturePack::Entry> entries_;
+    std::vector<uint8_t> masks_;
+    std::set<std::pair<unsigned int, unsigned int> > packedIds_;
+
+    AtlasLayout layout_;
+    std::vector<uint32_t> pagePixels_;
+
+    unsigned int finishedCount_; ///< Textures of the current batch that are read or failed
+
+    void onTextureFinished();
+    boost::shared_ptr<ui::Texture> load(unsigned int source, unsigned int id);
+    void add(unsigned int source, unsigned int id, boost::shared_ptr<ui::Texture> tex);
+    void flushPage();
+};
+
+}
+}
+
+#endif
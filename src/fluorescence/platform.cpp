@@ -79,8 +79,16 @@ int gettimeofday(struct timeval *tv, struct timezone *tz) {
 #endif
 
 
-#ifndef WIN32
+#ifdef WIN32
+#include <psapi.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
 #include <unistd.h>
+#include <sys/resource.h>
+#include <fstream>
+#include <string>
 #endif
 
 
@@ -90,6 +98,57 @@ namespace fluo {
         Sleep(ms);
 #else
         usleep(ms * 1000);
+#endif
+    }
+
+    void getProcessUsage(ProcessUsage& usage) {
+#ifdef WIN32
+        HANDLE process = GetCurrentProcess();
+
+        FILETIME creationTime, exitTime, kernelTime, userTime;
+        GetProcessTimes(process, &creationTime, &exitTime, &kernelTime, &userTime);
+        uint64_t kernel = ((uint64_t)kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime;
+        uint64_t user = ((uint64_t)userTime.dwHighDateTime << 32) | userTime.dwLowDateTime;
+        // filetimes are in 100 nanosecond intervals
+        usage.cpuMicros_ = (kernel + user) / 10;
+
+        IO_COUNTERS ioCounters;
+        if (GetProcessIoCounters(process, &ioCounters)) {
+            usage.bytesRead_ = ioCounters.ReadTransferCount;
+        } else {
+            usage.bytesRead_ = 0;
+        }
+
+        PROCESS_MEMORY_COUNTERS memoryCounters;
+        if (GetProcessMemoryInfo(process, &memoryCounters, sizeof(memoryCounters))) {
+            usage.peakRssBytes_ = memoryCounters.PeakWorkingSetSize;
+        } else {
+            usage.peakRssBytes_ = 0;
+        }
+#else
+        rusage resUsage;
+        getrusage(RUSAGE_SELF, &resUsage);
+        usage.cpuMicros_ = (uint64_t)(resUsage.ru_utime.tv_sec + resUsage.ru_stime.tv_sec) * 1000000 +
+                resUsage.ru_utime.tv_usec + resUsage.ru_stime.tv_usec;
+
+#ifdef __APPLE__
+        // bytes on mac os
+        usage.peakRssBytes_ = resUsage.ru_maxrss;
+#else
+        // kilobytes on linux
+        usage.peakRssBytes_ = (uint64_t)resUsage.ru_maxrss * 1024;
+#endif
+
+        usage.bytesRead_ = 0;
+        std::ifstream io("/proc/self/io");
+        std::string key;
+        uint64_t value;
+        while (io >> key >> value) {
+            if (key == "rchar:") {
+                usage.bytesRead_ = value;
+                break;
+            }
+        }
 #endif
     }
 }
@@ -47,9 +47,19 @@ int gettimeofday(struct timeval *tv, struct timezone *tz);
 #endif
 
 
+#include <stdint.h>
+
 // helper to sleep a certain amount of milliseconds
 namespace fluo {
     void sleepMs(unsigned int ms);
+
+    struct ProcessUsage {
+        uint64_t cpuMicros_; ///< user and system time of all threads
+        uint64_t bytesRead_; ///< by read calls, including data served from the os cache. Not available everywhere, then 0
+        uint64_t peakRssBytes_; ///< high water mark of the resident set size
+    };
+
+    void getProcessUsage(ProcessUsage& usage);
 }
 
 #endif
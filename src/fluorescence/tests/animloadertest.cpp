@@ -0,0 +1,285 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <data/animloader.hpp>
+#include <data/util.hpp>
+#include <ui/animation.hpp>
+#include <ui/texture.hpp>
+
+#include "testhelpers.hpp"
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+struct ReferenceFrame {
+    int centerX_;
+    int centerY_;
+    unsigned int width_;
+    unsigned int height_;
+    std::vector<uint32_t> pixels_;
+};
+
+template<typename T>
+void append(std::vector<int8_t>& buf, T value) {
+    buf.insert(buf.end(), reinterpret_cast<int8_t*>(&value), reinterpret_cast<int8_t*>(&value) + sizeof(T));
+}
+
+template<typename T>
+void put(std::vector<int8_t>& buf, unsigned int offset, T value) {
+    std::copy(reinterpret_cast<int8_t*>(&value), reinterpret_cast<int8_t*>(&value) + sizeof(T), buf.begin() + offset);
+}
+
+/**
+ * An animation entry: palette, frame count, frame offsets and the frames, each row of a frame stored as one run.
+ * Frames in emptyFrames get offset 0, like in some broken animations of the original files
+ */
+std::vector<int8_t> createAnimation(unsigned int frameCount, unsigned int size, const std::vector<unsigned int>& emptyFrames) {
+    std::vector<int8_t> ret;
+    for (unsigned int i = 0; i < 256; ++i) {
+        append<uint16_t>(ret, i == 0 ? 0 : ((i * 0x0123 + 0x1111) & 0xFFFF));
+    }
+
+    append<uint32_t>(ret, frameCount);
+    unsigned int offsetsStart = ret.size();
+    ret.resize(ret.size() + frameCount * 4, 0);
+
+    for (unsigned int frameIdx = 0; frameIdx < frameCount; ++frameIdx) {
+        if (std::find(emptyFrames.begin(), emptyFrames.end(), frameIdx) != emptyFrames.end()) {
+            continue;
+        }
+
+        put<uint32_t>(ret, offsetsStart + frameIdx * 4, ret.size() - 0x200);
+
+        unsigned int width = size + frameIdx;
+        unsigned int height = size;
+        int centerX = width / 2;
+        int centerY = height / 4;
+        append<int16_t>(ret, centerX);
+        append<int16_t>(ret, centerY);
+        append<uint16_t>(ret, width);
+        append<uint16_t>(ret, height);
+
+        for (unsigned int y = 0; y < height; ++y) {
+            unsigned int startX = y % 5;
+            unsigned int run = width - startX - (y % 3);
+            int xOffset = startX - centerX;
+            int yOffset = y - centerY - height;
+            append<uint32_t>(ret, ((xOffset & 0x3FF) << 22) | ((yOffset & 0x3FF) << 12) | run);
+            for (unsigned int x = startX; x < startX + run; ++x) {
+                append<uint8_t>(ret, (x * 7 + y * 3 + frameIdx) & 0xFF);
+            }
+        }
+        append<uint32_t>(ret, 0x7FFF7FFFu);
+    }
+
+    return ret;
+}
+
+/// The animation decoder before the frames were decoded in parallel: one pixel after the other, converting every palette lookup
+std::vector<ReferenceFrame> decodeReference(const std::vector<int8_t>& data) {
+    const int8_t* buf = &data[0];
+    const uint16_t* palette = reinterpret_cast<const uint16_t*>(buf);
+    uint32_t frameCount = *reinterpret_cast<const uint32_t*>(buf + 0x200);
+    const uint32_t* frameOffsets = reinterpret_cast<const uint32_t*>(buf + 0x200 + 4);
+
+    std::vector<ReferenceFrame> ret;
+    for (unsigned int frameIdx = 0; frameIdx < frameCount; ++frameIdx) {
+        if (frameOffsets[frameIdx] == 0) {
+            if (frameIdx > 0) {
+                ret.push_back(ret.back());
+            }
+            continue;
+        }
+
+        const uint8_t* ptr = reinterpret_cast<const uint8_t*>(buf) + 0x200 + frameOffsets[frameIdx];
+        ReferenceFrame curFrame;
+        curFrame.centerX_ = *reinterpret_cast<const int16_t*>(ptr);
+        curFrame.centerY_ = *reinterpret_cast<const int16_t*>(ptr + 2);
+        curFrame.width_ = *reinterpret_cast<const uint16_t*>(ptr + 4);
+        curFrame.height_ = *reinterpret_cast<const uint16_t*>(ptr + 6);
+        curFrame.pixels_.resize(curFrame.width_ * curFrame.height_, 0);
+        ptr += 8;
+
+        uint32_t header = *reinterpret_cast<const uint32_t*>(ptr);
+        ptr += 4;
+        while (header != 0x7FFF7FFFu) {
+            int xOffset = (header >> 22) & 0x3FF;
+            int yOffset = (header >> 12) & 0x3FF;
+            if ((xOffset & 0x200) == 0x200) {
+                xOffset |= 0xFFFFFE00;
+            }
+            if ((yOffset & 0x200) == 0x200) {
+                yOffset |= 0xFFFFFE00;
+            }
+
+            unsigned int yPixel = curFrame.centerY_ + yOffset + curFrame.height_;
+            unsigned int xRun = header & 0xFFF;
+            for (unsigned int px = 0; px < xRun; ++px) {
+                unsigned int xPixel = curFrame.centerX_ + xOffset + px;
+                curFrame.pixels_[yPixel * curFrame.width_ + xPixel] = data::Util::getColorRGBA(palette[*ptr]);
+                ++ptr;
+            }
+
+            header = *reinterpret_cast<const uint32_t*>(ptr);
+            ptr += 4;
+        }
+
+        ret.push_back(curFrame);
+    }
+
+    return ret;
+}
+
+void appendEntry(std::vector<int8_t>& idx, std::vector<int8_t>& mul, const std::vector<int8_t>& data) {
+    append<uint32_t>(idx, mul.size());
+    append<uint32_t>(idx, data.size());
+    append<uint32_t>(idx, 0);
+    mul.insert(mul.end(), data.begin(), data.end());
+}
+
+// ids of the test entries. Body 0 is a high detail body, so the entries are found at animId * 5 + direction
+const unsigned int SMALL_ANIM = 0;
+const unsigned int BIG_ANIM = 1;
+const unsigned int INVALID_FRAME_COUNT = 2;
+const unsigned int INVALID_FRAME_OFFSET = 3;
+
+std::vector<int8_t> createSmallAnimation() {
+    std::vector<unsigned int> emptyFrames;
+    emptyFrames.push_back(0);
+    emptyFrames.push_back(3);
+    return createAnimation(5, 20, emptyFrames);
+}
+
+/// Above AnimLoader's limit for parallel decoding
+std::vector<int8_t> createBigAnimation() {
+    std::vector<unsigned int> emptyFrames;
+    emptyFrames.push_back(4);
+    emptyFrames.push_back(5);
+    return createAnimation(12, 80, emptyFrames);
+}
+
+boost::shared_ptr<data::AnimLoader> createLoader(const boost::filesystem::path& directory) {
+    std::vector<int8_t> idx;
+    std::vector<int8_t> mul;
+    appendEntry(idx, mul, createSmallAnimation());
+    appendEntry(idx, mul, createBigAnimation());
+
+    std::vector<int8_t> invalidCount = createSmallAnimation();
+    put<uint32_t>(invalidCount, 0x200, 0x10000000u);
+    appendEntry(idx, mul, invalidCount);
+
+    std::vector<int8_t> invalidOffset = createSmallAnimation();
+    put<uint32_t>(invalidOffset, 0x204 + 4, invalidOffset.size());
+    appendEntry(idx, mul, invalidOffset);
+
+    writeFile(directory / "anim.idx", idx);
+    writeFile(directory / "anim.mul", mul);
+
+    return boost::shared_ptr<data::AnimLoader>(new data::AnimLoader(directory / "anim.idx", directory / "anim.mul", 1, 0));
+}
+
+void checkAnimation(boost::shared_ptr<ui::Animation> anim, const std::vector<int8_t>& data) {
+    BOOST_REQUIRE(waitForItem(anim));
+
+    std::vector<ReferenceFrame> expected = decodeReference(data);
+    BOOST_REQUIRE_EQUAL(anim->getFrameCount(), expected.size());
+
+    for (unsigned int frameIdx = 0; frameIdx < expected.size(); ++frameIdx) {
+        ui::AnimationFrame frame = anim->getFrame(frameIdx);
+        BOOST_CHECK_EQUAL(frame.centerX_, expected[frameIdx].centerX_);
+        BOOST_CHECK_EQUAL(frame.centerY_, expected[frameIdx].centerY_);
+
+        BOOST_REQUIRE(frame.texture_);
+        BOOST_REQUIRE_EQUAL(frame.texture_->getPixelBuffer().get_width(), expected[frameIdx].width_);
+        BOOST_REQUIRE_EQUAL(frame.texture_->getPixelBuffer().get_height(), expected[frameIdx].height_);
+
+        const uint32_t* pixels = frame.texture_->getPixelBufferData();
+        for (unsigned int i = 0; i < expected[frameIdx].pixels_.size(); ++i) {
+            if (pixels[i] != expected[frameIdx].pixels_[i]) {
+                BOOST_ERROR("Frame " << frameIdx << " pixel " << i << " differs: " << std::hex << pixels[i] << " != " << expected[frameIdx].pixels_[i]);
+                break;
+            }
+        }
+    }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(animloader)
+
+BOOST_AUTO_TEST_CASE(serial_decode_matches_reference) {
+    boost::shared_ptr<data::AnimLoader> loader = createLoader(getTestDirectory("animloader-serial"));
+    BOOST_REQUIRE(createSmallAnimation().size() < 32 * 1024);
+
+    checkAnimation(loader->getAnimation(0, 0, SMALL_ANIM), createSmallAnimation());
+}
+
+BOOST_AUTO_TEST_CASE(parallel_decode_matches_reference) {
+    boost::shared_ptr<data::AnimLoader> loader = createLoader(getTestDirectory("animloader-parallel"));
+    BOOST_REQUIRE(createBigAnimation().size() >= 32 * 1024);
+
+    checkAnimation(loader->getAnimation(0, 0, BIG_ANIM), createBigAnimation());
+}
+
+BOOST_AUTO_TEST_CASE(empty_frames_reuse_previous_texture) {
+    boost::shared_ptr<data::AnimLoader> loader = createLoader(getTestDirectory("animloader-empty"));
+
+    boost::shared_ptr<ui::Animation> anim = loader->getAnimation(0, 0, BIG_ANIM);
+    BOOST_REQUIRE(waitForItem(anim));
+
+    // frames 4 and 5 are empty
+    BOOST_CHECK(anim->getFrame(4).texture_ == anim->getFrame(3).texture_);
+    BOOST_CHECK(anim->getFrame(5).texture_ == anim->getFrame(3).texture_);
+    BOOST_CHECK(anim->getFrame(6).texture_ != anim->getFrame(3).texture_);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_frame_count_fails) {
+    boost::shared_ptr<data::AnimLoader> loader = createLoader(getTestDirectory("animloader-count"));
+
+    boost::shared_ptr<ui::Animation> anim = loader->getAnimation(0, 0, INVALID_FRAME_COUNT);
+    BOOST_CHECK(!waitForItem(anim));
+    BOOST_CHECK(anim->isReadFailed());
+}
+
+BOOST_AUTO_TEST_CASE(invalid_frame_offset_fails) {
+    boost::shared_ptr<data::AnimLoader> loader = createLoader(getTestDirectory("animloader-offset"));
+
+    boost::shared_ptr<ui::Animation> anim = loader->getAnimation(0, 0, INVALID_FRAME_OFFSET);
+    BOOST_CHECK(!waitForItem(anim));
+    BOOST_CHECK(anim->isReadFailed());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
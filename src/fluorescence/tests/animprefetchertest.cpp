@@ -0,0 +1,369 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <map>
+#include <vector>
+
+#include <data/animprefetcher.hpp>
+#include <data/workerpool.hpp>
+#include <ui/animation.hpp>
+#include <typedefs.hpp>
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+// frames between starting a load and its completion, like a busy anim thread
+const unsigned int LOAD_FRAMES = 3;
+
+const unsigned int DIRECTION_COUNT = 8;
+
+/// Stands in for Manager::getAnim. Loads of the same animation share their objects as long as they are referenced
+class FakeAnimLoader {
+public:
+    FakeAnimLoader() : frame_(0), requestCount_(0) {
+    }
+
+    std::vector<boost::shared_ptr<ui::Animation> > load(unsigned int bodyId, unsigned int animId, unsigned int priority) {
+        ++requestCount_;
+
+        std::vector<boost::weak_ptr<ui::Animation> >& cached = cache_[Key(bodyId, animId)];
+        std::vector<boost::shared_ptr<ui::Animation> > ret;
+        for (unsigned int i = 0; i < cached.size(); ++i) {
+            if (boost::shared_ptr<ui::Animation> anim = cached[i].lock()) {
+                ret.push_back(anim);
+            }
+        }
+
+        if (ret.size() != DIRECTION_COUNT) {
+            ret.clear();
+            cached.clear();
+            for (unsigned int i = 0; i < DIRECTION_COUNT; ++i) {
+                boost::shared_ptr<ui::Animation> anim(new ui::Animation());
+                cached.push_back(anim);
+                pending_.push_back(Pending(anim, frame_ + LOAD_FRAMES));
+                ret.push_back(anim);
+            }
+        }
+
+        return ret;
+    }
+
+    void nextFrame() {
+        ++frame_;
+
+        std::vector<Pending> stillPending;
+        for (unsigned int i = 0; i < pending_.size(); ++i) {
+            boost::shared_ptr<ui::Animation> anim = pending_[i].first.lock();
+            if (!anim) {
+                continue;
+            } else if (pending_[i].second <= frame_) {
+                anim->setReadComplete();
+            } else {
+                stillPending.push_back(pending_[i]);
+            }
+        }
+        pending_.swap(stillPending);
+    }
+
+    unsigned int getRequestCount() const {
+        return requestCount_;
+    }
+
+    bool isLoaded(unsigned int bodyId, unsigned int animId) const {
+        std::map<Key, std::vector<boost::weak_ptr<ui::Animation> > >::const_iterator iter = cache_.find(Key(bodyId, animId));
+        return iter != cache_.end() && !iter->second.empty() && !iter->second[0].expired();
+    }
+
+private:
+    typedef std::pair<unsigned int, unsigned int> Key;
+    typedef std::pair<boost::weak_ptr<ui::Animation>, unsigned int> Pending;
+
+    unsigned int frame_;
+    unsigned int requestCount_;
+    std::map<Key, std::vector<boost::weak_ptr<ui::Animation> > > cache_;
+    std::vector<Pending> pending_;
+};
+
+/// The state a mobile is in after its 0x77/0x78 packet
+struct RecordedMobile {
+    unsigned int bodyId_;
+    unsigned int animType_;
+    unsigned int weaponLayer_;
+    unsigned int equipmentAnimIds_[2];
+    unsigned int mountAnimId_;
+    unsigned int mountAnimType_;
+};
+
+const RecordedMobile MOBILES[] = {
+    // armed human with two pieces of equipment
+    { 0x190, AnimType::PEOPLE, Layer::ONEHANDED, { 0x3C4, 0x3CA }, 0, 0 },
+    // human on a horse, with a two-handed weapon
+    { 0x191, AnimType::PEOPLE, Layer::TWOHANDED, { 0x3CB, 0 }, 0xC8, AnimType::LOW_DETAIL },
+    // unarmed human on a high detail mount
+    { 0x190, AnimType::PEOPLE, 0, { 0x3C5, 0 }, 0x114, AnimType::HIGH_DETAIL },
+    { 0x09, AnimType::HIGH_DETAIL, 0, { 0, 0 }, 0, 0 },
+    { 0xCF, AnimType::LOW_DETAIL, 0, { 0, 0 }, 0, 0 },
+    // arrives just before it attacks
+    { 0x192, AnimType::PEOPLE, Layer::ONEHANDED, { 0x3C6, 0 }, 0, 0 },
+};
+
+enum {
+    EVENT_ENTER, // a 0x77/0x78 packet
+    EVENT_FRAMES, // some frames without anything new
+    EVENT_ANIMATE, // a movement or 0x6E packet, the animation is drawn in the next frame
+};
+
+struct Event {
+    unsigned int type_;
+    unsigned int value_; ///< the mobile or the frame count
+    unsigned int animId_;
+};
+
+const Event RECORDING[] = {
+    { EVENT_ENTER, 0, 0 },
+    { EVENT_ENTER, 1, 0 },
+    { EVENT_FRAMES, 2, 0 },
+    { EVENT_ENTER, 2, 0 },
+    { EVENT_ENTER, 3, 0 },
+    { EVENT_ENTER, 4, 0 },
+    { EVENT_FRAMES, 20, 0 },
+    { EVENT_ANIMATE, 0, 1 },
+    { EVENT_ANIMATE, 1, 23 },
+    { EVENT_ANIMATE, 3, 0 },
+    { EVENT_FRAMES, 1, 0 },
+    { EVENT_ANIMATE, 0, 3 },
+    { EVENT_ANIMATE, 1, 24 },
+    { EVENT_ANIMATE, 2, 23 },
+    { EVENT_ANIMATE, 4, 2 },
+    { EVENT_FRAMES, 1, 0 },
+    { EVENT_ENTER, 5, 0 },
+    { EVENT_ANIMATE, 5, 4 },
+    { EVENT_ANIMATE, 0, 7 },
+    { EVENT_ANIMATE, 1, 25 },
+    { EVENT_ANIMATE, 2, 24 },
+    { EVENT_ANIMATE, 3, 1 },
+    { EVENT_ANIMATE, 4, 1 },
+};
+
+struct ReplayResult {
+    ReplayResult() : readyCount_(0), loadingCount_(0), readyEquipmentCount_(0), readyMountCount_(0) {
+    }
+
+    unsigned int readyCount_; ///< complete when first drawn
+    unsigned int loadingCount_; ///< still loading when first drawn
+    unsigned int readyEquipmentCount_;
+    unsigned int readyMountCount_;
+};
+
+/// The action a mount plays while its rider plays animId, see world::DynamicItem::animate
+unsigned int getMountAction(const RecordedMobile& mobile, unsigned int animId) {
+    if (animId == 24) {
+        return mobile.mountAnimType_ == AnimType::HIGH_DETAIL ? 0 : 1;
+    } else if (animId == 23) {
+        return 1;
+    } else {
+        return mobile.mountAnimType_ == AnimType::HIGH_DETAIL ? 1 : 2;
+    }
+}
+
+/// Draws one animation like the client does: Manager::getAnim notifies the prefetcher before it loads
+bool draw(data::AnimPrefetcher& prefetcher, FakeAnimLoader& loader, unsigned int bodyId, unsigned int animId,
+        std::vector<std::vector<boost::shared_ptr<ui::Animation> > >& shown) {
+    prefetcher.onShow(bodyId, animId);
+    std::vector<boost::shared_ptr<ui::Animation> > directions = loader.load(bodyId, animId, data::LoadPriority::VISIBLE);
+    shown.push_back(directions);
+
+    for (unsigned int i = 0; i < directions.size(); ++i) {
+        if (!directions[i]->isReadComplete()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void count(ReplayResult& result, bool ready, unsigned int* readyPartCount) {
+    if (ready) {
+        ++result.readyCount_;
+        if (readyPartCount) {
+            ++(*readyPartCount);
+        }
+    } else {
+        ++result.loadingCount_;
+    }
+}
+
+/// Replays the recording, one frame is a prefetcher step followed by the loads the anim thread finished
+ReplayResult replay(data::AnimPrefetcher& prefetcher, FakeAnimLoader& loader, bool prefetchEnabled) {
+    ReplayResult ret;
+    // drawn animations stay referenced, like by the texture providers of the mobiles
+    std::vector<std::vector<boost::shared_ptr<ui::Animation> > > shown;
+
+    unsigned int eventCount = sizeof(RECORDING) / sizeof(RECORDING[0]);
+    for (unsigned int i = 0; i < eventCount; ++i) {
+        const Event& event = RECORDING[i];
+
+        if (event.type_ == EVENT_FRAMES) {
+            for (unsigned int frame = 0; frame < event.value_; ++frame) {
+                prefetcher.step();
+                loader.nextFrame();
+            }
+            continue;
+        }
+
+        const RecordedMobile& mobile = MOBILES[event.value_];
+        if (event.type_ == EVENT_ENTER) {
+            if (prefetchEnabled) {
+                data::AnimPrefetcher::MobileState state;
+                state.bodyId_ = mobile.bodyId_;
+                state.animType_ = mobile.animType_;
+                state.armed_ = mobile.weaponLayer_ != 0;
+                state.twoHanded_ = mobile.weaponLayer_ == Layer::TWOHANDED;
+                for (unsigned int j = 0; j < 2; ++j) {
+                    if (mobile.equipmentAnimIds_[j] != 0) {
+                        state.equipmentAnimIds_.push_back(mobile.equipmentAnimIds_[j]);
+                    }
+                }
+                state.mounted_ = mobile.mountAnimId_ != 0;
+                state.mountAnimId_ = mobile.mountAnimId_;
+                state.mountAnimType_ = mobile.mountAnimType_;
+                prefetcher.prefetchMobile(state);
+            }
+            continue;
+        }
+
+        count(ret, draw(prefetcher, loader, mobile.bodyId_, event.animId_, shown), NULL);
+        for (unsigned int j = 0; j < 2; ++j) {
+            if (mobile.equipmentAnimIds_[j] != 0) {
+                count(ret, draw(prefetcher, loader, mobile.equipmentAnimIds_[j], event.animId_, shown), &ret.readyEquipmentCount_);
+            }
+        }
+        if (mobile.mountAnimId_ != 0) {
+            count(ret, draw(prefetcher, loader, mobile.mountAnimId_, getMountAction(mobile, event.animId_), shown), &ret.readyMountCount_);
+        }
+    }
+
+    return ret;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(animprefetcher)
+
+BOOST_AUTO_TEST_CASE(replayed_fight_is_loaded_before_first_draw) {
+    FakeAnimLoader loader;
+    data::AnimPrefetcher prefetcher(256, 4, boost::bind(&FakeAnimLoader::load, &loader, _1, _2, _3));
+    ReplayResult result = replay(prefetcher, loader, true);
+
+    FakeAnimLoader coldLoader;
+    data::AnimPrefetcher coldPrefetcher(256, 4, boost::bind(&FakeAnimLoader::load, &coldLoader, _1, _2, _3));
+    ReplayResult coldResult = replay(coldPrefetcher, coldLoader, false);
+
+    BOOST_TEST_MESSAGE("Complete before first draw: " << result.readyCount_ << " with prefetching, " << coldResult.readyCount_ << " without");
+
+    // only the body and the equipment of the mobile that attacks right away are still loading
+    BOOST_CHECK_EQUAL(result.loadingCount_, 2u);
+    BOOST_CHECK_EQUAL(result.readyCount_ + result.loadingCount_, coldResult.readyCount_ + coldResult.loadingCount_);
+    BOOST_CHECK_EQUAL(coldResult.readyCount_, 0u);
+
+    // 0 walks, runs and stands in war mode with two items, 1 walks, runs and stands mounted and 2 walks and runs
+    // mounted, with one item each
+    BOOST_CHECK_EQUAL(result.readyEquipmentCount_, 3 * 2 + 3 + 2u);
+    BOOST_CHECK_EQUAL(result.readyMountCount_, 3 + 2u);
+
+    BOOST_CHECK_EQUAL(prefetcher.getShowReadyCount(), result.readyCount_);
+    BOOST_CHECK_EQUAL(prefetcher.getShowLoadingCount(), 0u);
+    BOOST_CHECK_EQUAL(prefetcher.getShowMissCount(), result.loadingCount_);
+    BOOST_CHECK_EQUAL(coldPrefetcher.getShowMissCount(), coldResult.loadingCount_);
+}
+
+BOOST_AUTO_TEST_CASE(steps_stay_within_budget) {
+    FakeAnimLoader loader;
+    data::AnimPrefetcher prefetcher(256, 3, boost::bind(&FakeAnimLoader::load, &loader, _1, _2, _3));
+
+    data::AnimPrefetcher::MobileState state;
+    state.bodyId_ = 0x190;
+    state.animType_ = AnimType::PEOPLE;
+    state.equipmentAnimIds_.push_back(0x3C4);
+    state.equipmentAnimIds_.push_back(0x3CA);
+    state.mounted_ = true;
+    state.mountAnimId_ = 0xC8;
+    state.mountAnimType_ = AnimType::LOW_DETAIL;
+
+    // the same state again does not queue anything twice
+    prefetcher.prefetchMobile(state);
+    prefetcher.prefetchMobile(state);
+
+    // mounted: 3 actions for the body and each item, 2 for the mount
+    const unsigned int expected = 3 * 3 + 2;
+    unsigned int lastCount = 0;
+    for (unsigned int i = 0; i < 10; ++i) {
+        prefetcher.step();
+        BOOST_REQUIRE_LE(loader.getRequestCount() - lastCount, 3u);
+        lastCount = loader.getRequestCount();
+    }
+    BOOST_CHECK_EQUAL(loader.getRequestCount(), expected);
+
+    BOOST_CHECK(loader.isLoaded(0x3CA, 25));
+    BOOST_CHECK(loader.isLoaded(0xC8, 2));
+    BOOST_CHECK(!loader.isLoaded(0x190, 4));
+}
+
+BOOST_AUTO_TEST_CASE(held_animations_are_limited) {
+    const unsigned int maxHeldCount = 8;
+
+    FakeAnimLoader loader;
+    data::AnimPrefetcher prefetcher(maxHeldCount, 2, boost::bind(&FakeAnimLoader::load, &loader, _1, _2, _3));
+
+    for (unsigned int round = 0; round < 5; ++round) {
+        for (unsigned int i = 0; i < 6; ++i) {
+            prefetcher.prefetch(round * 6 + i, 0);
+        }
+        for (unsigned int i = 0; i < 3; ++i) {
+            prefetcher.step();
+        }
+    }
+
+    unsigned int loadedCount = 0;
+    for (unsigned int i = 0; i < 30; ++i) {
+        if (loader.isLoaded(i, 0)) {
+            ++loadedCount;
+        }
+    }
+    BOOST_CHECK_EQUAL(loadedCount, maxHeldCount);
+    // the most recent ones are kept
+    BOOST_CHECK(loader.isLoaded(29, 0));
+    BOOST_CHECK(!loader.isLoaded(0, 0));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
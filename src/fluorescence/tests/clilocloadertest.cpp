@@ -0,0 +1,341 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <unicode/regex.h>
+
+#include <data/clilocloader.hpp>
+#include <misc/string.hpp>
+
+#include "testhelpers.hpp"
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+/// ClilocLoader::get(id, paramString) as it was implemented with regular expressions, the reference for the results
+UnicodeString formatReference(const UnicodeString& text, const UnicodeString& paramString) {
+    static UnicodeString params[9];
+    static UnicodeString paramRegex[9] = {
+        "~1_[^~]+~", "~2_[^~]+~", "~3_[^~]+~", "~4_[^~]+~", "~5_[^~]+~",
+        "~6_[^~]+~", "~7_[^~]+~", "~8_[^~]+~", "~9_[^~]+~",
+    };
+
+    UnicodeString str = text;
+
+    if (paramString.length() > 0) {
+        UErrorCode status = U_ZERO_ERROR;
+        RegexMatcher paramSplitter("\\t", 0, status);
+        unsigned int paramCount = paramSplitter.split(paramString, params, 9, status);
+
+        for (unsigned int i = 0; i < paramCount; ++i) {
+            RegexMatcher curParamMatcher(paramRegex[i], str, 0, status);
+
+            str = curParamMatcher.replaceAll(params[i], status);
+        }
+    }
+
+    return str;
+}
+
+/// Parts of templates and arguments, including broken placeholders and characters with a meaning in regex replacements
+const char* const TEMPLATE_TOKENS[] = {
+    "~1_NAME~", "~2_AMOUNT~", "~3_X~", "~9_LAST~", "~1_~", "~10_A~", "~", "~~", "~1_", "~2_", "1_", "2_A~", "_",
+    "You see ", " gold", "\xc3\xa4\xe2\x82\xac", " ", "$", "\\", "#",
+};
+
+const char* const ARGUMENT_TOKENS[] = {
+    "", "Bob", "12", "#1042", "#99", "$0", "$1", "${x}", "\\", "\\n", "~", "~2_B~", "2_b~", "~3_", "\xc3\xa4", " ",
+};
+
+template<typename T, unsigned int N>
+unsigned int count(T (&)[N]) {
+    return N;
+}
+
+/// Deterministic, so that a failure can be reproduced
+class Random {
+public:
+    Random() : state_(12345) {
+    }
+
+    unsigned int next(unsigned int max) {
+        state_ = state_ * 1103515245u + 12345u;
+        return (state_ >> 16) % max;
+    }
+
+private:
+    uint32_t state_;
+};
+
+void appendEntry(std::vector<int8_t>& file, uint32_t id, const std::string& text) {
+    const int8_t header[7] = { (int8_t)(id & 0xFF), (int8_t)((id >> 8) & 0xFF), (int8_t)((id >> 16) & 0xFF), (int8_t)(id >> 24), 0,
+            (int8_t)(text.size() & 0xFF), (int8_t)(text.size() >> 8) };
+    file.insert(file.end(), header, header + 7);
+    file.insert(file.end(), text.begin(), text.end());
+}
+
+std::string randomText(Random& random, const char* const* tokens, unsigned int tokenCount, unsigned int maxTokens) {
+    std::string ret;
+    unsigned int length = random.next(maxTokens + 1);
+    for (unsigned int i = 0; i < length; ++i) {
+        ret += tokens[random.next(tokenCount)];
+    }
+    return ret;
+}
+
+/// Up to 12 tab separated arguments, sometimes with a trailing tab
+UnicodeString randomParamString(Random& random) {
+    std::string ret;
+    unsigned int paramCount = 1 + random.next(12);
+    for (unsigned int i = 0; i < paramCount; ++i) {
+        if (i > 0) {
+            ret += "\t";
+        }
+        ret += randomText(random, ARGUMENT_TOKENS, count(ARGUMENT_TOKENS), 2);
+    }
+    if (random.next(8) == 0) {
+        ret += "\t";
+    }
+    return StringConverter::fromUtf8(ret);
+}
+
+/**
+ * The index loop of ClilocLoader before the files were loaded in one pass: entries are read one by one from the
+ * stream, later entries replace earlier ones with the same id, empty entries are skipped
+ */
+void readReference(const boost::filesystem::path& path, std::map<uint32_t, std::string>& entries) {
+    boost::filesystem::ifstream stream(path, std::ios::binary);
+    stream.seekg(6);
+
+    uint8_t indexBuffer[7];
+    while (stream.read(reinterpret_cast<char*>(indexBuffer), 7)) {
+        uint32_t id = indexBuffer[0] | (indexBuffer[1] << 8) | (indexBuffer[2] << 16) | ((uint32_t)indexBuffer[3] << 24);
+        uint16_t len = indexBuffer[5] | (indexBuffer[6] << 8);
+
+        std::string text(len, '\0');
+        if (len > 0 && !stream.read(&text[0], len)) {
+            break;
+        }
+        if (len > 0) {
+            entries[id] = text;
+        }
+    }
+}
+
+/// Unsorted ids with duplicates, empty entries and flags
+std::vector<int8_t> randomClilocFile(Random& random, unsigned int entryCount, unsigned int maxId) {
+    std::vector<int8_t> file(6, 0);
+    for (unsigned int i = 0; i < entryCount; ++i) {
+        uint32_t id = random.next(maxId);
+        if (random.next(20) == 0) {
+            // ids above 16 bit, as used by newer clients
+            id += 1000000;
+        }
+
+        std::string text;
+        if (random.next(10) != 0) {
+            text = randomText(random, TEMPLATE_TOKENS, count(TEMPLATE_TOKENS), 12);
+        }
+
+        unsigned int start = file.size();
+        appendEntry(file, id, text);
+        file[start + 4] = random.next(3);
+    }
+    return file;
+}
+
+void checkParity(data::ClilocLoader& loader, unsigned int id, const UnicodeString& text, const UnicodeString& paramString) {
+    UnicodeString expected = formatReference(text, paramString);
+    UnicodeString result = loader.get(id, paramString);
+    if (result != expected) {
+        BOOST_ERROR("Entry " << id << " differs: template=\"" << StringConverter::toUtf8String(text) << "\" params=\"" <<
+                StringConverter::toUtf8String(paramString) << "\" result=\"" << StringConverter::toUtf8String(result) <<
+                "\" expected=\"" << StringConverter::toUtf8String(expected) << "\"");
+    }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(clilocloader)
+
+BOOST_AUTO_TEST_CASE(arguments_match_regex_formatter) {
+    const unsigned int entryCount = 3000;
+    const unsigned int callsPerEntry = 20;
+
+    Random random;
+    std::vector<int8_t> file(6, 0);
+    std::vector<UnicodeString> texts;
+    for (unsigned int id = 1; id <= entryCount; ++id) {
+        std::string text = randomText(random, TEMPLATE_TOKENS, count(TEMPLATE_TOKENS), 8);
+        if (text.empty()) {
+            text = "~1_NAME~";
+        }
+        appendEntry(file, id, text);
+        texts.push_back(StringConverter::fromUtf8(text));
+    }
+
+    boost::filesystem::path path = getTestDirectory("clilocloader-parity") / "cliloc.enu";
+    writeFile(path, file);
+
+    data::ClilocLoader loader;
+    loader.indexFile(path, true);
+
+    for (unsigned int id = 1; id <= entryCount; ++id) {
+        for (unsigned int i = 0; i < callsPerEntry; ++i) {
+            checkParity(loader, id, texts[id - 1], randomParamString(random));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(vector_arguments_match_regex_formatter) {
+    std::vector<int8_t> file(6, 0);
+    appendEntry(file, 500000, "~1_A~ and ~2_B~ ~1_C~~3_D~ ~9_E~");
+
+    boost::filesystem::path path = getTestDirectory("clilocloader-vector") / "cliloc.enu";
+    writeFile(path, file);
+
+    data::ClilocLoader loader;
+    loader.indexFile(path, true);
+
+    Random random;
+    for (unsigned int i = 0; i < 2000; ++i) {
+        UnicodeString paramString = randomParamString(random);
+        if (paramString.length() == 0) {
+            // the string overload ignores it, a vector with an empty argument does not
+            continue;
+        }
+
+        // split like the string overload does, a tab separated string is the reference for the vector
+        std::vector<UnicodeString> params;
+        int32_t start = 0;
+        for (int32_t tab = paramString.indexOf((UChar)'\t'); tab >= 0 && params.size() < 8; tab = paramString.indexOf((UChar)'\t', start)) {
+            params.push_back(UnicodeString(paramString, start, tab - start));
+            start = tab + 1;
+        }
+        params.push_back(UnicodeString(paramString, start));
+
+        BOOST_REQUIRE(loader.get(500000, params) == loader.get(500000, paramString));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(bulk_load_matches_stream_index) {
+    Random random;
+    boost::filesystem::path directory = getTestDirectory("clilocloader-bulk");
+    writeFile(directory / "cliloc.enu", randomClilocFile(random, 4000, 3000));
+    writeFile(directory / "cliloc.deu", randomClilocFile(random, 1500, 3000));
+
+    // the language file is indexed after the english one and replaces its entries
+    std::map<uint32_t, std::string> reference;
+    readReference(directory / "cliloc.enu", reference);
+    readReference(directory / "cliloc.deu", reference);
+
+    data::ClilocLoader loader;
+    loader.indexFile(directory / "cliloc.enu", true);
+    loader.indexFile(directory / "cliloc.deu", false);
+
+    for (uint32_t id = 0; id < 3000; ++id) {
+        BOOST_REQUIRE_EQUAL(loader.hasEntry(id), reference.count(id) == 1);
+        BOOST_REQUIRE_EQUAL(loader.hasEntry(id + 1000000), reference.count(id + 1000000) == 1);
+    }
+
+    std::map<uint32_t, std::string>::const_iterator iter = reference.begin();
+    std::map<uint32_t, std::string>::const_iterator end = reference.end();
+    for (; iter != end; ++iter) {
+        // twice, the second call might be served from a cache
+        for (unsigned int i = 0; i < 2; ++i) {
+            if (loader.get(iter->first) != StringConverter::fromUtf8(iter->second)) {
+                BOOST_ERROR("Entry " << iter->first << " differs: \"" << StringConverter::toUtf8String(loader.get(iter->first)) <<
+                        "\" != \"" << iter->second << "\"");
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(truncated_file_keeps_complete_entries) {
+    std::vector<int8_t> file(6, 0);
+    appendEntry(file, 10, "first");
+    appendEntry(file, 11, "second");
+    appendEntry(file, 12, "cut off");
+    file.resize(file.size() - 3);
+
+    boost::filesystem::path path = getTestDirectory("clilocloader-truncated") / "cliloc.enu";
+    writeFile(path, file);
+
+    data::ClilocLoader loader;
+    loader.indexFile(path, true);
+
+    BOOST_CHECK(loader.get(10) == StringConverter::fromUtf8("first"));
+    BOOST_CHECK(loader.get(11) == StringConverter::fromUtf8("second"));
+    BOOST_CHECK(!loader.hasEntry(12));
+}
+
+/**
+ * Set FLUO_TEST_CLILOC to a cliloc file of the original client to check all its entries as well.
+ * Skipped without it, the files are not redistributable
+ */
+BOOST_AUTO_TEST_CASE(client_cliloc_matches_regex_formatter) {
+    const char* pathString = std::getenv("FLUO_TEST_CLILOC");
+    if (!pathString) {
+        BOOST_TEST_MESSAGE("FLUO_TEST_CLILOC not set, skipping the check of a client cliloc file");
+        return;
+    }
+
+    data::ClilocLoader loader;
+    loader.indexFile(pathString, true);
+
+    Random random;
+    unsigned int checkedCount = 0;
+    for (unsigned int id = 0; id < 0x1000000 && checkedCount < 100000; ++id) {
+        if (!loader.hasEntry(id)) {
+            continue;
+        }
+
+        UnicodeString text = loader.get(id);
+        if (text.indexOf((UChar)'~') < 0) {
+            continue;
+        }
+
+        for (unsigned int i = 0; i < 4; ++i) {
+            checkParity(loader, id, text, randomParamString(random));
+        }
+        ++checkedCount;
+    }
+
+    BOOST_TEST_MESSAGE("Checked " << checkedCount << " cliloc entries with placeholders");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
@@ -0,0 +1,242 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <atomic>
+#include <vector>
+
+#include <data/completionqueue.hpp>
+#include <data/ioscheduler.hpp>
+#include <data/ondemandreadable.hpp>
+#include <data/workerpool.hpp>
+
+#include "testhelpers.hpp"
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+const unsigned int PRODUCER_COUNT = 8;
+
+class StressItem : public data::OnDemandReadable<StressItem> {
+public:
+    StressItem() : value_(0), notifyCount_(0) {
+    }
+
+    // plain members, written by the loader thread and read by the listener. The completion has to order them
+    unsigned int value_;
+    unsigned int notifyCount_;
+};
+
+void receive(std::vector<unsigned int>* target, unsigned int value) {
+    target->push_back(value);
+}
+
+void postSequence(std::vector<std::vector<unsigned int> >* received, unsigned int producer, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        data::CompletionQueue::getSingleton()->post(boost::bind(&receive, &(*received)[producer], i));
+    }
+}
+
+void postSlowly(std::vector<unsigned int>* received, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        // gives the main thread time to drain everything and start waiting in between
+        if (i % 500 == 0) {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        } else if (i % 16 == 0) {
+            boost::this_thread::yield();
+        }
+        data::CompletionQueue::getSingleton()->post(boost::bind(&receive, received, i));
+    }
+}
+
+void loadItem(boost::shared_ptr<StressItem> item, unsigned int index) {
+    item->value_ = index;
+    if (index % 7 == 0) {
+        item->setReadFailed();
+    } else {
+        item->setReadComplete();
+    }
+}
+
+void onItemNotified(boost::shared_ptr<StressItem> item, unsigned int index, unsigned int* failedCount) {
+    ++item->notifyCount_;
+    if (item->isReadFailed()) {
+        ++(*failedCount);
+    } else {
+        BOOST_CHECK(item->isReadComplete());
+    }
+    // the listener must see what the loader thread wrote before completing the item
+    BOOST_CHECK_EQUAL(item->value_, index);
+}
+
+struct CancelOwner {
+    unsigned int id_;
+};
+
+void cancelRead(std::atomic<bool>* cancelled, std::atomic<unsigned int>* lateJobs, CancelOwner* owner) {
+    // a running job has to be finished when cancel returns, so a read that started too late is still running then
+    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    if (cancelled->load()) {
+        ++(*lateJobs);
+    }
+}
+
+void cancelLookup(std::atomic<bool>* cancelled, std::atomic<unsigned int>* lateJobs, CancelOwner* owner) {
+    if (cancelled->load()) {
+        ++(*lateJobs);
+    }
+    // like a decode cache miss, queues the read after the io pool might already be cancelled
+    boost::this_thread::yield();
+    data::IoScheduler::getSingleton()->enqueueRead(owner, boost::bind(&cancelRead, cancelled, lateJobs, owner), data::LoadPriority::VISIBLE);
+}
+
+}
+
+/**
+ * Stress tests for the lock-free handoff between loader threads and the main thread. They are run in the normal test
+ * executable, and in a ThreadSanitizer build if the compiler supports it
+ */
+BOOST_AUTO_TEST_SUITE(completionstress)
+
+BOOST_AUTO_TEST_CASE(concurrent_posts_keep_order) {
+    const unsigned int count = 20000;
+    std::vector<std::vector<unsigned int> > received(PRODUCER_COUNT);
+
+    boost::thread_group producers;
+    for (unsigned int i = 0; i < PRODUCER_COUNT; ++i) {
+        producers.create_thread(boost::bind(&postSequence, &received, i, count));
+    }
+
+    // draining while posting, like the main loop does
+    unsigned int drained = 0;
+    while (drained < PRODUCER_COUNT * count) {
+        drained += data::CompletionQueue::getSingleton()->drain();
+    }
+    producers.join_all();
+
+    BOOST_CHECK_EQUAL(data::CompletionQueue::getSingleton()->drain(), 0u);
+    for (unsigned int i = 0; i < PRODUCER_COUNT; ++i) {
+        BOOST_REQUIRE_EQUAL(received[i].size(), count);
+        for (unsigned int j = 0; j < count; ++j) {
+            BOOST_REQUIRE_EQUAL(received[i][j], j);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(waiting_for_posts_misses_no_wakeup) {
+    const unsigned int count = 20000;
+    std::vector<unsigned int> received;
+
+    BOOST_CHECK(!data::CompletionQueue::getSingleton()->waitForPost(10));
+
+    boost::thread producer(boost::bind(&postSlowly, &received, count));
+
+    // a missed wakeup shows up as a wait that only ends with the timeout
+    unsigned int drained = 0;
+    boost::posix_time::time_duration longestWait;
+    while (drained < count) {
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+        BOOST_REQUIRE(data::CompletionQueue::getSingleton()->waitForPost(ITEM_TIMEOUT_MILLIS));
+        longestWait = (std::max)(longestWait, boost::posix_time::microsec_clock::universal_time() - start);
+
+        drained += data::CompletionQueue::getSingleton()->drain();
+    }
+    producer.join();
+
+    BOOST_CHECK_LT(longestWait.total_milliseconds(), ITEM_TIMEOUT_MILLIS / 2);
+
+    BOOST_CHECK_EQUAL(received.size(), count);
+}
+
+BOOST_AUTO_TEST_CASE(listeners_race_with_completion) {
+    const unsigned int count = 20000;
+    std::vector<boost::shared_ptr<StressItem> > items(count);
+    unsigned int failedCount = 0;
+
+    {
+        data::WorkerPool pool("stress", PRODUCER_COUNT);
+
+        for (unsigned int i = 0; i < count; ++i) {
+            items[i].reset(new StressItem());
+
+            // half of the listeners are added before the load starts, the others race with it
+            if (i % 2 == 0) {
+                items[i]->addCompleteListener(&items, boost::bind(&onItemNotified, items[i], i, &failedCount));
+            }
+            pool.enqueue(&items, boost::bind(&loadItem, items[i], i));
+            if (i % 2 == 1) {
+                items[i]->addCompleteListener(&items, boost::bind(&onItemNotified, items[i], i, &failedCount));
+            }
+
+            if (i % 64 == 0) {
+                data::CompletionQueue::getSingleton()->drain();
+            }
+        }
+
+        // the pool drops queued jobs when it is destroyed
+        for (unsigned int i = 0; i < count; ++i) {
+            waitForItem(items[i]);
+        }
+    }
+    data::CompletionQueue::getSingleton()->drain();
+
+    for (unsigned int i = 0; i < count; ++i) {
+        BOOST_REQUIRE_EQUAL(items[i]->notifyCount_, 1u);
+    }
+    BOOST_CHECK_EQUAL(failedCount, (count + 6) / 7);
+}
+
+BOOST_AUTO_TEST_CASE(cancel_drops_jobs_queued_across_pools) {
+    boost::shared_ptr<data::IoScheduler> scheduler = data::IoScheduler::getSingleton();
+
+    for (unsigned int round = 0; round < 100; ++round) {
+        std::atomic<bool> cancelled(false);
+        std::atomic<unsigned int> lateJobs(0);
+        CancelOwner* owner = new CancelOwner();
+        owner->id_ = round;
+
+        for (unsigned int i = 0; i < 16; ++i) {
+            scheduler->enqueueDecode(owner, boost::bind(&cancelLookup, &cancelled, &lateJobs, owner), data::LoadPriority::VISIBLE);
+        }
+
+        scheduler->cancel(owner);
+        cancelled.store(true);
+        delete owner;
+
+        // a job that slipped through would run after this point and touch the deleted owner
+        boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+        BOOST_REQUIRE_EQUAL(lateJobs.load(), 0u);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
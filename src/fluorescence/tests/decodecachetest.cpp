@@ -0,0 +1,121 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <data/decodecache.hpp>
+
+#include "testhelpers.hpp"
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+const std::time_t DAY = 24 * 60 * 60;
+
+/// A cache directory of another version, with one file of the given size, last used daysAgo
+void addVersion(const boost::filesystem::path& directory, const std::string& name, unsigned int bytes, unsigned int daysAgo) {
+    boost::filesystem::path path = directory / name;
+    boost::filesystem::create_directories(path / "0");
+    writeFile(path / "0" / "1", std::vector<int8_t>(bytes));
+    boost::filesystem::last_write_time(path, std::time(NULL) - daysAgo * DAY);
+}
+
+boost::shared_ptr<data::DecodeCache> createCache(const boost::filesystem::path& directory, const boost::filesystem::path& source,
+        unsigned int maxMegabytes, unsigned int maxAgeDays) {
+    std::vector<boost::filesystem::path> indexFiles(1, source);
+    std::vector<boost::filesystem::path> dataFiles(1, source);
+    return boost::shared_ptr<data::DecodeCache>(new data::DecodeCache(directory, "art", indexFiles, dataFiles, maxMegabytes, maxAgeDays));
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(decodecache)
+
+BOOST_AUTO_TEST_CASE(other_versions_are_kept) {
+    boost::filesystem::path directory = getTestDirectory("decodecache-keep");
+    writeFile(directory / "art.mul", std::vector<int8_t>(16, 1));
+    addVersion(directory, "art-0000000000000001", 1024, 1);
+    addVersion(directory, "art-0000000000000002", 1024, 2);
+
+    createCache(directory, directory / "art.mul", 1, 30);
+
+    BOOST_CHECK(boost::filesystem::exists(directory / "art-0000000000000001"));
+    BOOST_CHECK(boost::filesystem::exists(directory / "art-0000000000000002"));
+}
+
+BOOST_AUTO_TEST_CASE(least_recently_used_versions_are_evicted) {
+    boost::filesystem::path directory = getTestDirectory("decodecache-evict");
+    writeFile(directory / "art.mul", std::vector<int8_t>(16, 1));
+    // 1mb in total allows two of them
+    addVersion(directory, "art-0000000000000001", 400 * 1024, 3);
+    addVersion(directory, "art-0000000000000002", 400 * 1024, 1);
+    addVersion(directory, "art-0000000000000003", 400 * 1024, 2);
+    addVersion(directory, "art-0000000000000004", 1024, 40);
+    // other files are never touched
+    addVersion(directory, "gumpart-0000000000000001", 2048 * 1024, 40);
+    addVersion(directory, "art2-000000000000001", 2048 * 1024, 40);
+
+    createCache(directory, directory / "art.mul", 1, 30);
+
+    BOOST_CHECK(!boost::filesystem::exists(directory / "art-0000000000000001"));
+    BOOST_CHECK(boost::filesystem::exists(directory / "art-0000000000000002"));
+    BOOST_CHECK(boost::filesystem::exists(directory / "art-0000000000000003"));
+    BOOST_CHECK(!boost::filesystem::exists(directory / "art-0000000000000004"));
+    BOOST_CHECK(boost::filesystem::exists(directory / "gumpart-0000000000000001"));
+    BOOST_CHECK(boost::filesystem::exists(directory / "art2-000000000000001"));
+}
+
+BOOST_AUTO_TEST_CASE(current_version_is_reused) {
+    boost::filesystem::path directory = getTestDirectory("decodecache-reuse");
+    writeFile(directory / "art.mul", std::vector<int8_t>(16, 1));
+
+    createCache(directory, directory / "art.mul", 1, 30);
+    unsigned int count = 0;
+    boost::filesystem::directory_iterator end;
+    for (boost::filesystem::directory_iterator iter(directory); iter != end; ++iter) {
+        ++count;
+    }
+
+    // a second start with the same files, even with a limit that the current version alone exceeds
+    createCache(directory, directory / "art.mul", 0, 0);
+    unsigned int secondCount = 0;
+    for (boost::filesystem::directory_iterator iter(directory); iter != end; ++iter) {
+        ++secondCount;
+    }
+
+    BOOST_CHECK_EQUAL(count, 2u);
+    BOOST_CHECK_EQUAL(secondCount, count);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
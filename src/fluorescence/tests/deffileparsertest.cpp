@@ -0,0 +1,304 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <string.h>
+
+#include <data/deffileparser.hpp>
+#include <misc/exception.hpp>
+
+#include "testhelpers.hpp"
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+class Random {
+public:
+    Random() : state_(2012) {
+    }
+
+    unsigned int next(unsigned int max) {
+        state_ = state_ * 1103515245u + 12345u;
+        return (state_ >> 16) % max;
+    }
+
+private:
+    uint32_t state_;
+};
+
+/// The std::istream based loop of DefFileLoader before DefFileParser, collecting the records instead of storing them
+void parseReference(const std::string& content, const char* pattern, data::DefFileRecords& records) {
+    std::istringstream ifs(content);
+
+    unsigned int patternCount = strlen(pattern);
+    char strBuf[256];
+    while (ifs.good()) {
+        if (ifs.peek() == '#' || ifs.peek() == '\n' || ifs.peek() == '\r') {
+            ifs.ignore(1000, '\n');
+            continue;
+        }
+
+        std::vector<int> numbers;
+        std::vector<std::string> strings;
+
+        for (unsigned int patternIdx = 0; patternIdx < patternCount; ++patternIdx) {
+            if (!ifs.good()) {
+                break;
+            }
+
+            switch (pattern[patternIdx]) {
+                case 'i': {
+                    int newNum = 0;
+                    ifs >> newNum;
+                    numbers.push_back(newNum);
+                    break;
+                }
+
+                case 'r': {
+                    ifs.ignore(100, '{');
+                    ifs.get(strBuf, 256, '}');
+                    ifs.ignore(1);
+                    std::istringstream iss(strBuf);
+
+                    std::vector<int> randNrs;
+                    while (iss.good()) {
+                        int newRand;
+                        iss >> newRand;
+                        if (!iss.fail()) {
+                            randNrs.push_back(newRand);
+                        }
+                        iss.ignore(100, ',');
+                    }
+
+                    if (randNrs.size() == 0 && ifs.good()) {
+                        throw Exception("Error parsing def file");
+                    } else if (randNrs.size() >= 1) {
+                        numbers.push_back(randNrs[0]);
+                    }
+                    break;
+                }
+
+                case 's': {
+                    ifs >> strBuf;
+                    strings.push_back(strBuf);
+                    break;
+                }
+            }
+        }
+
+        if (!ifs.fail()) {
+            records.numbers_.insert(records.numbers_.end(), numbers.begin(), numbers.end());
+            records.strings_.insert(records.strings_.end(), strings.begin(), strings.end());
+            ++records.count_;
+        }
+
+        ifs.ignore(1000, '\n');
+    }
+}
+
+std::string randomNumber(Random& random) {
+    std::ostringstream ret;
+    switch (random.next(8)) {
+        case 0:
+            ret << "-" << random.next(1000);
+            break;
+        case 1:
+            ret << "+" << random.next(1000);
+            break;
+        case 2:
+            ret << (unsigned int)random.next(2000000000);
+            break;
+        default:
+            ret << random.next(5000);
+            break;
+    }
+    return ret.str();
+}
+
+const char* const SPACES[] = { " ", "  ", "\t", " \t " };
+const char* const LINE_ENDS[] = { "\n", "\r\n", " \n", "\t# comment after the record\n" };
+const char* const STRINGS[] = { "name", "sound_01", "a-b.wav", "x", "Spell,Fire" };
+
+/// Def file content as found in the client files: comments, empty lines, random groups with one or more numbers
+std::string randomDefFile(Random& random, const char* pattern, bool malformedEnd) {
+    std::string ret;
+    unsigned int lineCount = random.next(80);
+    for (unsigned int line = 0; line < lineCount; ++line) {
+        switch (random.next(10)) {
+            case 0:
+                ret += "# some comment with numbers 1 2 {3}\n";
+                continue;
+            case 1:
+                ret += random.next(2) ? "\n" : "\r\n";
+                continue;
+            default:
+                break;
+        }
+
+        for (const char* cur = pattern; *cur; ++cur) {
+            if (cur != pattern) {
+                ret += SPACES[random.next(4)];
+            }
+
+            switch (*cur) {
+                case 'i':
+                    ret += randomNumber(random);
+                    break;
+                case 'r': {
+                    ret += "{";
+                    unsigned int count = 1 + random.next(4);
+                    for (unsigned int i = 0; i < count; ++i) {
+                        if (i > 0) {
+                            ret += random.next(2) ? ", " : ",";
+                        }
+                        ret += randomNumber(random);
+                    }
+                    ret += random.next(3) == 0 ? " }" : "}";
+                    break;
+                }
+                case 's':
+                    ret += STRINGS[random.next(5)];
+                    break;
+            }
+        }
+        ret += LINE_ENDS[random.next(4)];
+    }
+
+    if (malformedEnd) {
+        // everything after it is ignored
+        ret += random.next(2) ? "12 abc\n" : "{}\n";
+        ret += "1 2 3 4 5\n";
+    } else if (!ret.empty() && random.next(4) == 0) {
+        // no newline at the end of the file
+        ret.erase(ret.size() - 1);
+    }
+
+    return ret;
+}
+
+void checkParity(const std::string& content, const char* pattern, const boost::filesystem::path& path) {
+    data::DefFileRecords expected;
+    parseReference(content, pattern, expected);
+
+    data::DefFileRecords parsed;
+    data::DefFileParser::parse(content.empty() ? NULL : content.c_str(), content.size(), pattern, path, parsed);
+
+    BOOST_REQUIRE_EQUAL(parsed.count_, expected.count_);
+    BOOST_REQUIRE(parsed.numbers_ == expected.numbers_);
+    BOOST_REQUIRE(parsed.strings_ == expected.strings_);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(deffileparser)
+
+BOOST_AUTO_TEST_CASE(random_files_match_stream_parser) {
+    const char* const patterns[] = { "iri", "iiiii", "iiii", "ii", "is", "isi", "irri" };
+    Random random;
+
+    for (unsigned int round = 0; round < 500; ++round) {
+        const char* pattern = patterns[random.next(7)];
+        std::string content = randomDefFile(random, pattern, random.next(5) == 0);
+        checkParity(content, pattern, "random.def");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(group_without_number_throws) {
+    std::string content = "1 {2} 3\n4 {abc} 5\n";
+
+    data::DefFileRecords expected;
+    BOOST_CHECK_THROW(parseReference(content, "iri", expected), Exception);
+
+    data::DefFileRecords parsed;
+    BOOST_CHECK_THROW(data::DefFileParser::parse(content.c_str(), content.size(), "iri", "group.def", parsed), Exception);
+}
+
+BOOST_AUTO_TEST_CASE(cache_returns_parsed_records) {
+    Random random;
+    std::string content = randomDefFile(random, "iri", false);
+
+    boost::filesystem::path directory = getTestDirectory("deffileparser");
+    boost::filesystem::path path = directory / "body.def";
+    writeFile(path, std::vector<int8_t>(content.begin(), content.end()));
+
+    data::DefFileRecords parsed;
+    BOOST_REQUIRE(data::DefFileParser::load(path, "iri", directory / "body.cache", parsed));
+    BOOST_REQUIRE(boost::filesystem::exists(directory / "body.cache"));
+
+    data::DefFileRecords cached;
+    BOOST_REQUIRE(data::DefFileParser::load(path, "iri", directory / "body.cache", cached));
+    BOOST_CHECK_EQUAL(cached.count_, parsed.count_);
+    BOOST_CHECK(cached.numbers_ == parsed.numbers_);
+    BOOST_CHECK(cached.strings_ == parsed.strings_);
+}
+
+/**
+ * Set FLUO_TEST_DEF_DIRECTORY to the directory of the original client to check its def files as well.
+ * Skipped without it, the files are not redistributable
+ */
+BOOST_AUTO_TEST_CASE(client_def_files_match_stream_parser) {
+    const char* directory = std::getenv("FLUO_TEST_DEF_DIRECTORY");
+    if (!directory) {
+        BOOST_TEST_MESSAGE("FLUO_TEST_DEF_DIRECTORY not set, skipping the check of the client def files");
+        return;
+    }
+
+    // the patterns data::Manager uses
+    const char* const files[][2] = {
+        { "Body.def", "iri" }, { "Bodyconv.def", "iiiii" }, { "Paperdoll.def", "iiii" }, { "Gump.def", "iri" },
+        { "Mount.def", "ii" }, { "Sound.def", "iri" }, { "Equipconv.def", "iiiii" }, { "mobtypes.txt", "isi" },
+    };
+
+    for (unsigned int i = 0; i < sizeof(files) / sizeof(files[0]); ++i) {
+        boost::filesystem::path path = boost::filesystem::path(directory) / files[i][0];
+        if (!boost::filesystem::exists(path)) {
+            BOOST_TEST_MESSAGE(path << " not found");
+            continue;
+        }
+
+        std::vector<char> buf(boost::filesystem::file_size(path));
+        boost::filesystem::ifstream stream(path, std::ios_base::binary);
+        if (!buf.empty()) {
+            stream.read(&buf[0], buf.size());
+        }
+        checkParity(std::string(buf.begin(), buf.end()), files[i][1], path);
+        BOOST_TEST_MESSAGE("Checked " << path);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
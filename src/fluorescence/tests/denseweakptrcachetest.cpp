@@ -0,0 +1,232 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+#include <data/completionqueue.hpp>
+#include <data/denseweakptrcache.hpp>
+#include <data/ondemandreadable.hpp>
+#include <data/weakptrcache.hpp>
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+const unsigned int ID_COUNT = 200;
+
+class CachedItem : public data::OnDemandReadable<CachedItem> {
+};
+
+/// Creates the items synchronously and remembers them, so that the test can complete or fail them later
+template<typename KeyType, typename ValueType>
+class RecordingLoader {
+public:
+    RecordingLoader() : completeItems_(true) {
+    }
+
+    boost::shared_ptr<ValueType> get(const KeyType& id, unsigned int userData, unsigned int priority) {
+        boost::shared_ptr<ValueType> ret(new ValueType());
+        ret->setMemoryUsage(100 + (id % 7) * 100);
+        if (completeItems_) {
+            ret->setReadComplete();
+        }
+        created_.push_back(ret);
+        return ret;
+    }
+
+    void raisePriority(const boost::shared_ptr<ValueType>& item, unsigned int priority) {
+    }
+
+    unsigned int size() const {
+        return ID_COUNT;
+    }
+
+    bool completeItems_;
+    std::vector<boost::weak_ptr<ValueType> > created_;
+};
+
+typedef RecordingLoader<unsigned int, CachedItem> LoaderType;
+typedef data::WeakPtrCache<unsigned int, CachedItem, RecordingLoader> MapCacheType;
+typedef data::DenseWeakPtrCache<CachedItem, RecordingLoader> DenseCacheType;
+
+/// Deterministic, so that a failure can be reproduced
+class Random {
+public:
+    Random(uint32_t seed) : state_(seed) {
+    }
+
+    unsigned int next(unsigned int max) {
+        state_ = state_ * 1103515245u + 12345u;
+        return (state_ >> 16) % max;
+    }
+
+private:
+    uint32_t state_;
+};
+
+/// The same cache operations on both caches, with the results kept by the caller in the same slots
+class DifferentialRun {
+public:
+    DifferentialRun(unsigned int retentionBudget) :
+            mapLoader_(new LoaderType()), denseLoader_(new LoaderType()), mapHeld_(64), denseHeld_(64) {
+        mapCache_.init(mapLoader_);
+        denseCache_.init(denseLoader_);
+        mapCache_.setRetentionBudget(retentionBudget);
+        denseCache_.setRetentionBudget(retentionBudget);
+    }
+
+    void step(Random& random) {
+        unsigned int id = random.next(ID_COUNT);
+        unsigned int slot = random.next(mapHeld_.size());
+
+        switch (random.next(10)) {
+        case 0:
+        case 1:
+        case 2:
+            mapHeld_[slot] = mapCache_.get(id, 0, data::LoadPriority::VISIBLE);
+            denseHeld_[slot] = denseCache_.get(id, 0, data::LoadPriority::VISIBLE);
+            BOOST_REQUIRE_EQUAL(mapHeld_[slot]->isReadComplete(), denseHeld_[slot]->isReadComplete());
+            break;
+        case 3:
+            mapHeld_[slot].reset();
+            denseHeld_[slot].reset();
+            break;
+        case 4:
+            BOOST_REQUIRE_EQUAL(!mapCache_.getNoCreate(id), !denseCache_.getNoCreate(id));
+            BOOST_REQUIRE_EQUAL(mapCache_.hasId(id), denseCache_.hasId(id));
+            break;
+        case 5:
+            if (random.next(4) == 0) {
+                mapCache_.fixItem(id);
+                denseCache_.fixItem(id);
+            } else {
+                mapCache_.removeFixed(id);
+                denseCache_.removeFixed(id);
+            }
+            break;
+        case 6:
+            // loads that take a while
+            mapLoader_->completeItems_ = denseLoader_->completeItems_ = (random.next(3) != 0);
+            break;
+        case 7:
+            finishLoad(random.next(mapLoader_->created_.size() + 1), random.next(4) == 0);
+            break;
+        case 8:
+            // completion listeners of the retention tier
+            data::CompletionQueue::getSingleton()->drain();
+            break;
+        case 9:
+            if (random.next(50) == 0) {
+                mapCache_.clear();
+                denseCache_.clear();
+            }
+            break;
+        }
+
+        compare();
+    }
+
+private:
+    MapCacheType mapCache_;
+    DenseCacheType denseCache_;
+    boost::shared_ptr<LoaderType> mapLoader_;
+    boost::shared_ptr<LoaderType> denseLoader_;
+    std::vector<boost::shared_ptr<CachedItem> > mapHeld_;
+    std::vector<boost::shared_ptr<CachedItem> > denseHeld_;
+
+    void finishLoad(unsigned int index, bool failed) {
+        if (index >= mapLoader_->created_.size()) {
+            return;
+        }
+
+        boost::shared_ptr<CachedItem> mapItem = mapLoader_->created_[index].lock();
+        boost::shared_ptr<CachedItem> denseItem = denseLoader_->created_[index].lock();
+        BOOST_REQUIRE_EQUAL(!mapItem, !denseItem);
+        if (!mapItem || mapItem->isReadComplete() || mapItem->isReadFailed()) {
+            return;
+        }
+
+        if (failed) {
+            mapItem->setReadFailed();
+            denseItem->setReadFailed();
+        } else {
+            mapItem->setReadComplete();
+            denseItem->setReadComplete();
+        }
+    }
+
+    void compare() {
+        BOOST_REQUIRE_EQUAL(denseLoader_->created_.size(), mapLoader_->created_.size());
+        BOOST_REQUIRE_EQUAL(denseCache_.getHitCount(), mapCache_.getHitCount());
+        BOOST_REQUIRE_EQUAL(denseCache_.getMissCount(), mapCache_.getMissCount());
+        BOOST_REQUIRE_EQUAL(denseCache_.getRetainedHitCount(), mapCache_.getRetainedHitCount());
+        BOOST_REQUIRE_EQUAL(denseCache_.getRetainedItemCount(), mapCache_.getRetainedItemCount());
+        BOOST_REQUIRE_EQUAL(denseCache_.getRetainedBytes(), mapCache_.getRetainedBytes());
+    }
+};
+
+}
+
+BOOST_AUTO_TEST_SUITE(denseweakptrcache)
+
+BOOST_AUTO_TEST_CASE(random_operations_match_map_cache) {
+    for (unsigned int round = 0; round < 20; ++round) {
+        Random random(round + 1);
+        // every other round without retention
+        DifferentialRun run(round % 2 == 0 ? 0 : 1000 + random.next(10000));
+        for (unsigned int i = 0; i < 5000; ++i) {
+            run.step(random);
+        }
+    }
+
+    data::CompletionQueue::getSingleton()->drain();
+}
+
+BOOST_AUTO_TEST_CASE(ids_past_the_index_are_not_cached) {
+    boost::shared_ptr<LoaderType> loader(new LoaderType());
+    DenseCacheType cache;
+    cache.init(loader);
+
+    boost::shared_ptr<CachedItem> first = cache.get(ID_COUNT + 5);
+    boost::shared_ptr<CachedItem> second = cache.get(ID_COUNT + 5);
+    BOOST_CHECK(first != second);
+    BOOST_CHECK_EQUAL(loader->created_.size(), 2u);
+    BOOST_CHECK(!cache.getNoCreate(ID_COUNT + 5));
+    BOOST_CHECK(!cache.hasId(ID_COUNT + 5));
+
+    // the last id in range is cached as usual
+    first = cache.get(ID_COUNT - 1);
+    second = cache.get(ID_COUNT - 1);
+    BOOST_CHECK(first == second);
+    BOOST_CHECK(cache.hasId(ID_COUNT - 1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
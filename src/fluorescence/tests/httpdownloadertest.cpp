@@ -0,0 +1,316 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <data/ondemandhttploader.hpp>
+#include <data/ondemandreadable.hpp>
+#include <misc/string.hpp>
+
+#include "testhelpers.hpp"
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+class HttpItem : public data::OnDemandReadable<HttpItem> {
+public:
+    std::vector<int8_t> data_;
+};
+
+/// Like the texture callback of HttpLoader: data that can not be decoded marks the item as failed
+void readItem(const UnicodeString& url, boost::shared_ptr<HttpItem> item, const std::vector<int8_t>& data) {
+    if (data.empty() || data[0] == '!') {
+        item->setReadFailed();
+        return;
+    }
+
+    item->data_ = data;
+    item->setReadComplete();
+}
+
+std::vector<int8_t> createContent(unsigned int seed, unsigned int length) {
+    std::vector<int8_t> ret(length);
+    uint32_t state = seed;
+    for (unsigned int i = 0; i < length; ++i) {
+        state = state * 1103515245u + 12345u;
+        // '!' marks invalid data
+        ret[i] = (state >> 16) % 64 + 'A';
+    }
+    return ret;
+}
+
+UnicodeString fileUrl(const boost::filesystem::path& path) {
+    return StringConverter::fromUtf8("file://" + (boost::filesystem::current_path() / path).string());
+}
+
+/**
+ * A minimal http server on the loopback interface, standing in for a shard's web server. Every connection is served
+ * on its own thread.
+ *
+ * GET /<delay>/<name> answers after delay milliseconds with a body of the length of name, /stall/<name> only answers
+ * once releaseStalled is called and /missing/<name> answers with 404.
+ */
+class LatencyServer {
+public:
+    LatencyServer() : running_(true), released_(false), requestCount_(0) {
+        listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+        BOOST_REQUIRE(listenFd_ >= 0);
+
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        BOOST_REQUIRE(bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+        BOOST_REQUIRE(listen(listenFd_, 16) == 0);
+
+        socklen_t length = sizeof(address);
+        BOOST_REQUIRE(getsockname(listenFd_, reinterpret_cast<sockaddr*>(&address), &length) == 0);
+        port_ = ntohs(address.sin_port);
+
+        acceptThread_ = boost::thread(boost::bind(&LatencyServer::acceptLoop, this));
+    }
+
+    ~LatencyServer() {
+        running_.store(false);
+        releaseStalled();
+        acceptThread_.join();
+        connectionThreads_.join_all();
+        close(listenFd_);
+    }
+
+    UnicodeString getUrl(const std::string& path) const {
+        return StringConverter::fromUtf8("http://127.0.0.1:" + boost::lexical_cast<std::string>(port_) + path);
+    }
+
+    void releaseStalled() {
+        boost::mutex::scoped_lock lock(mutex_);
+        released_ = true;
+        releasedSignal_.notify_all();
+    }
+
+    unsigned int getRequestCount() const {
+        return requestCount_.load();
+    }
+
+private:
+    int listenFd_;
+    unsigned short port_;
+    std::atomic<bool> running_;
+
+    boost::mutex mutex_;
+    boost::condition_variable releasedSignal_;
+    bool released_;
+
+    std::atomic<unsigned int> requestCount_;
+
+    boost::thread acceptThread_;
+    boost::thread_group connectionThreads_;
+
+    void acceptLoop() {
+        while (running_.load()) {
+            pollfd pollFd = { listenFd_, POLLIN, 0 };
+            if (poll(&pollFd, 1, 20) <= 0) {
+                continue;
+            }
+
+            int fd = accept(listenFd_, NULL, NULL);
+            if (fd >= 0) {
+                connectionThreads_.create_thread(boost::bind(&LatencyServer::serve, this, fd));
+            }
+        }
+    }
+
+    void serve(int fd) {
+        std::string request;
+        char buf[512];
+        while (request.find("\r\n\r\n") == std::string::npos) {
+            ssize_t count = recv(fd, buf, sizeof(buf), 0);
+            if (count <= 0) {
+                close(fd);
+                return;
+            }
+            request.append(buf, count);
+        }
+        ++requestCount_;
+
+        // "GET /<kind>/<name> HTTP/1.1"
+        size_t pathStart = request.find(' ') + 1;
+        std::string path = request.substr(pathStart, request.find(' ', pathStart) - pathStart);
+        std::string kind = path.substr(1, path.find('/', 1) - 1);
+        std::string name = path.substr(path.find('/', 1) + 1);
+
+        std::string status = "200 OK";
+        if (kind == "stall") {
+            boost::mutex::scoped_lock lock(mutex_);
+            while (!released_) {
+                releasedSignal_.wait(lock);
+            }
+        } else if (kind == "missing") {
+            status = "404 Not Found";
+        } else {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(boost::lexical_cast<unsigned int>(kind)));
+        }
+
+        std::vector<int8_t> body = createContent(name.size(), name.size());
+        std::string response = "HTTP/1.1 " + status + "\r\nContent-Length: " + boost::lexical_cast<std::string>(body.size()) +
+                "\r\nConnection: close\r\n\r\n" + std::string(body.begin(), body.end());
+        send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+        close(fd);
+    }
+};
+
+void waitForFlag(std::atomic<bool>* flag) {
+    for (unsigned int i = 0; i < ITEM_TIMEOUT_MILLIS && !flag->load(); ++i) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+}
+
+/// The decode of the first url waits for the second one to be decoded, which deadlocks if both run on the download thread
+void readBlocking(const UnicodeString& url, boost::shared_ptr<HttpItem> item, const std::vector<int8_t>& data,
+        std::atomic<bool>* otherDecoded, std::atomic<bool>* sawOther) {
+    if (url.endsWith("first")) {
+        waitForFlag(otherDecoded);
+        sawOther->store(otherDecoded->load());
+    } else {
+        otherDecoded->store(true);
+    }
+
+    readItem(url, item, data);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(httpdownloader)
+
+BOOST_AUTO_TEST_CASE(file_urls_match_file_contents) {
+    boost::filesystem::path directory = getTestDirectory("httpdownloader-files");
+
+    data::OnDemandHttpLoader<UnicodeString, HttpItem> loader(&readItem, 3);
+
+    std::vector<boost::shared_ptr<HttpItem> > items;
+    for (unsigned int i = 0; i < 20; ++i) {
+        boost::filesystem::path path = directory / (boost::lexical_cast<std::string>(i) + ".bin");
+        writeFile(path, createContent(i, 1 + i * 997));
+        items.push_back(loader.get(fileUrl(path), 0));
+    }
+
+    for (unsigned int i = 0; i < items.size(); ++i) {
+        BOOST_REQUIRE(waitForItem(items[i]));
+        BOOST_REQUIRE(items[i]->data_ == createContent(i, 1 + i * 997));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(failed_downloads_are_marked) {
+    boost::filesystem::path directory = getTestDirectory("httpdownloader-failed");
+    std::vector<int8_t> invalid(10, '!');
+    writeFile(directory / "invalid.bin", invalid);
+
+    LatencyServer server;
+    data::OnDemandHttpLoader<UnicodeString, HttpItem> loader(&readItem);
+
+    boost::shared_ptr<HttpItem> missingFile = loader.get(fileUrl(directory / "missing.bin"), 0);
+    boost::shared_ptr<HttpItem> invalidFile = loader.get(fileUrl(directory / "invalid.bin"), 0);
+    boost::shared_ptr<HttpItem> missingUrl = loader.get(server.getUrl("/missing/abc"), 0);
+
+    BOOST_CHECK(!waitForItem(missingFile));
+    BOOST_CHECK(missingFile->isReadFailed());
+    BOOST_CHECK(!waitForItem(invalidFile));
+    BOOST_CHECK(invalidFile->isReadFailed());
+    BOOST_CHECK(!waitForItem(missingUrl));
+    BOOST_CHECK(missingUrl->isReadFailed());
+}
+
+BOOST_AUTO_TEST_CASE(decode_runs_off_the_download_thread) {
+    boost::filesystem::path directory = getTestDirectory("httpdownloader-decode");
+    writeFile(directory / "first", createContent(1, 100));
+    writeFile(directory / "second", createContent(2, 100));
+
+    std::atomic<bool> otherDecoded(false);
+    std::atomic<bool> sawOther(false);
+    data::OnDemandHttpLoader<UnicodeString, HttpItem> loader(boost::bind(&readBlocking, _1, _2, _3, &otherDecoded, &sawOther), 1);
+
+    boost::shared_ptr<HttpItem> first = loader.get(fileUrl(directory / "first"), 0);
+    boost::shared_ptr<HttpItem> second = loader.get(fileUrl(directory / "second"), 0);
+
+    BOOST_REQUIRE(waitForItem(first));
+    BOOST_REQUIRE(waitForItem(second));
+    BOOST_CHECK(sawOther.load());
+}
+
+BOOST_AUTO_TEST_CASE(stalled_request_does_not_delay_others) {
+    const unsigned int fastCount = 12;
+
+    LatencyServer server;
+    data::OnDemandHttpLoader<UnicodeString, HttpItem> loader(&readItem, 4);
+
+    boost::shared_ptr<HttpItem> stalled = loader.get(server.getUrl("/stall/stalled"), 0);
+
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    std::vector<boost::shared_ptr<HttpItem> > items;
+    for (unsigned int i = 0; i < fastCount; ++i) {
+        std::string name(1 + i, 'x');
+        items.push_back(loader.get(server.getUrl("/" + boost::lexical_cast<std::string>(10 + (i % 4) * 20) + "/" + name), 0));
+    }
+
+    for (unsigned int i = 0; i < fastCount; ++i) {
+        BOOST_REQUIRE(waitForItem(items[i]));
+        BOOST_REQUIRE(items[i]->data_ == createContent(1 + i, 1 + i));
+    }
+    boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+
+    // three connections are left for the fast requests, about a quarter of a second in total
+    BOOST_CHECK_LT(elapsed.total_milliseconds(), ITEM_TIMEOUT_MILLIS / 4);
+    BOOST_CHECK(!stalled->isReadComplete() && !stalled->isReadFailed());
+
+    server.releaseStalled();
+    BOOST_REQUIRE(waitForItem(stalled));
+    BOOST_CHECK(stalled->data_ == createContent(7, 7));
+    BOOST_CHECK_EQUAL(server.getRequestCount(), fastCount + 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
@@ -0,0 +1,222 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+
+#include <atomic>
+#include <vector>
+
+#include <data/fixedsizeondemandfileloader.hpp>
+#include <data/ioscheduler.hpp>
+#include <data/ondemandreadable.hpp>
+
+#include "testhelpers.hpp"
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+const unsigned int BLOCK_SIZE = 64;
+const unsigned int BLOCK_COUNT = 32;
+
+class BlockItem : public data::OnDemandReadable<BlockItem> {
+public:
+    std::vector<int8_t> data_;
+};
+
+void readBlock(unsigned int index, int8_t* buf, unsigned int len, boost::shared_ptr<BlockItem> item, unsigned int extra, unsigned int userData) {
+    item->data_.assign(buf, buf + len);
+}
+
+typedef data::FixedSizeOnDemandFileLoader<unsigned int, BlockItem> BlockLoader;
+
+boost::filesystem::path createBlockFile(const std::string& name) {
+    std::vector<int8_t> data(BLOCK_SIZE * BLOCK_COUNT);
+    for (unsigned int i = 0; i < data.size(); ++i) {
+        data[i] = i / BLOCK_SIZE;
+    }
+
+    boost::filesystem::path path = getTestDirectory(name) / "blocks.mul";
+    writeFile(path, data);
+    return path;
+}
+
+/// Number of threads of this process, 0 if unknown
+unsigned int getThreadCount() {
+    boost::filesystem::path taskDirectory("/proc/self/task");
+    if (!boost::filesystem::exists(taskDirectory)) {
+        return 0;
+    }
+
+    unsigned int ret = 0;
+    boost::filesystem::directory_iterator end;
+    for (boost::filesystem::directory_iterator iter(taskDirectory); iter != end; ++iter) {
+        ++ret;
+    }
+    return ret;
+}
+
+void countIndex(std::vector<std::atomic<unsigned int> >* counts, unsigned int index) {
+    ++(*counts)[index];
+}
+
+/// Runs a parallelDecode from within a decode job, like the animation loader does for its frames
+void decodeInParallel(std::vector<std::atomic<unsigned int> >* counts, std::atomic<bool>* done) {
+    data::IoScheduler::getSingleton()->parallelDecode(counts->size(), boost::bind(&countIndex, counts, _1));
+    done->store(true);
+}
+
+bool waitForFlag(const std::atomic<bool>& flag) {
+    for (unsigned int i = 0; i < ITEM_TIMEOUT_MILLIS && !flag.load(); ++i) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+    return flag.load();
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(ioscheduler)
+
+BOOST_AUTO_TEST_CASE(loaders_share_the_scheduler_threads) {
+    boost::filesystem::path path = createBlockFile("ioscheduler-threads");
+
+    unsigned int threadsBefore = getThreadCount();
+    if (threadsBefore == 0) {
+        BOOST_TEST_MESSAGE("/proc/self/task not available, skipping the thread count check");
+    }
+
+    // like the client with all its art, gump, anim, map and statics loaders
+    std::vector<boost::shared_ptr<BlockLoader> > loaders;
+    std::vector<boost::shared_ptr<BlockItem> > items;
+    for (unsigned int i = 0; i < 40; ++i) {
+        loaders.push_back(boost::shared_ptr<BlockLoader>(new BlockLoader(path, BLOCK_SIZE, &readBlock)));
+        for (unsigned int block = 0; block < BLOCK_COUNT; block += 7) {
+            items.push_back(loaders.back()->get(block, 0));
+        }
+    }
+
+    for (unsigned int i = 0; i < items.size(); ++i) {
+        BOOST_REQUIRE(waitForItem(items[i]));
+    }
+
+    if (threadsBefore != 0) {
+        BOOST_CHECK_EQUAL(getThreadCount(), threadsBefore);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(destroying_a_loader_keeps_the_jobs_of_others) {
+    boost::filesystem::path path = createBlockFile("ioscheduler-cancel");
+
+    boost::shared_ptr<BlockLoader> kept(new BlockLoader(path, BLOCK_SIZE, &readBlock));
+    boost::shared_ptr<BlockLoader> destroyed(new BlockLoader(path, BLOCK_SIZE, &readBlock));
+
+    std::vector<boost::shared_ptr<BlockItem> > keptItems;
+    std::vector<boost::shared_ptr<BlockItem> > destroyedItems;
+    {
+        SchedulerBlocker blocker;
+        BOOST_REQUIRE(blocker.blockReads(IO_THREAD_COUNT));
+
+        // both loaders queue into the same pools, interleaved
+        for (unsigned int block = 0; block < BLOCK_COUNT; ++block) {
+            keptItems.push_back(kept->get(block, 0));
+            destroyedItems.push_back(destroyed->get(block, 0));
+        }
+
+        destroyed.reset();
+    }
+
+    for (unsigned int block = 0; block < BLOCK_COUNT; ++block) {
+        BOOST_REQUIRE(waitForItem(keptItems[block]));
+        BOOST_REQUIRE_EQUAL(keptItems[block]->data_.size(), BLOCK_SIZE);
+        BOOST_REQUIRE_EQUAL(keptItems[block]->data_[0], (int8_t)block);
+    }
+
+    // the queued jobs of the destroyed loader are gone, they never complete or fail
+    for (unsigned int block = 0; block < BLOCK_COUNT; ++block) {
+        BOOST_REQUIRE(!destroyedItems[block]->isReadComplete());
+        BOOST_REQUIRE(!destroyedItems[block]->isReadFailed());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(reads_continue_while_decodes_are_busy) {
+    boost::filesystem::path path = createBlockFile("ioscheduler-split");
+    // the read buffers are owned by the jobs, the mapping would be read on the decode thread
+    BlockLoader loader(path, BLOCK_SIZE, &readBlock, false);
+
+    SchedulerBlocker decodeBlocker;
+    BOOST_REQUIRE(decodeBlocker.blockDecodes(DECODE_THREAD_COUNT));
+
+    std::vector<boost::shared_ptr<BlockItem> > items;
+    for (unsigned int block = 0; block < BLOCK_COUNT; ++block) {
+        items.push_back(loader.get(block, 0));
+    }
+
+    // queued behind the reads, so all of them are done once the io threads are blocked
+    SchedulerBlocker readBlocker;
+    BOOST_REQUIRE(readBlocker.blockReads(IO_THREAD_COUNT));
+
+    for (unsigned int block = 0; block < BLOCK_COUNT; ++block) {
+        BOOST_REQUIRE(!items[block]->isReadComplete());
+    }
+
+    // with no io thread left, the items can only complete if their data was read while the decodes were stalled
+    decodeBlocker.release();
+    for (unsigned int block = 0; block < BLOCK_COUNT; ++block) {
+        BOOST_REQUIRE(waitForItem(items[block]));
+        BOOST_REQUIRE_EQUAL(items[block]->data_[BLOCK_SIZE - 1], (int8_t)block);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parallel_decode_covers_every_index) {
+    std::vector<std::atomic<unsigned int> > counts(5000);
+    for (unsigned int i = 0; i < counts.size(); ++i) {
+        counts[i].store(0);
+    }
+
+    data::IoScheduler::getSingleton()->parallelDecode(counts.size(), boost::bind(&countIndex, &counts, _1));
+    for (unsigned int i = 0; i < counts.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(counts[i].load(), 1u);
+    }
+
+    // all other decode threads busy: the calling decode thread has to do all the work itself instead of waiting
+    SchedulerBlocker blocker;
+    BOOST_REQUIRE(blocker.blockDecodes(DECODE_THREAD_COUNT - 1));
+
+    std::atomic<bool> done(false);
+    data::IoScheduler::getSingleton()->enqueueDecode(&counts, boost::bind(&decodeInParallel, &counts, &done), data::LoadPriority::VISIBLE);
+    BOOST_REQUIRE(waitForFlag(done));
+    for (unsigned int i = 0; i < counts.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(counts[i].load(), 2u);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
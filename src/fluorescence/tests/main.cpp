@@ -0,0 +1,50 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+#define BOOST_TEST_MODULE fluorescence
+#include <boost/test/included/unit_test.hpp>
+
+#include <misc/log.hpp>
+#include <data/ioscheduler.hpp>
+
+#include "testhelpers.hpp"
+
+namespace fluo {
+namespace tests {
+
+/// The singletons the data layer expects from the client
+struct GlobalFixture {
+    GlobalFixture() {
+        LOG_INIT(LOG_LEVEL_WARN);
+        data::IoScheduler::create(IO_THREAD_COUNT, DECODE_THREAD_COUNT);
+    }
+
+    ~GlobalFixture() {
+        data::IoScheduler::destroy();
+        LOG_CLOSE;
+    }
+};
+
+BOOST_GLOBAL_FIXTURE(GlobalFixture);
+
+}
+}
@@ -0,0 +1,145 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+#include <data/maptexloader.hpp>
+#include <data/util.hpp>
+#include <ui/texture.hpp>
+
+#include "testhelpers.hpp"
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+/// FNV-1a over the decoded pixels of texture 1 of the test file. Changes if the decoded image changes
+const uint32_t GOLDEN_CHECKSUM_128 = 0x024CFD45u;
+
+/// A pattern covering all color bits, the alpha bit and transparent pixels, stored column by column
+std::vector<uint16_t> createTexmap(unsigned int width) {
+    std::vector<uint16_t> ret(width * width);
+    for (unsigned int x = 0; x < width; ++x) {
+        for (unsigned int y = 0; y < width; ++y) {
+            uint16_t color = ((x * 0x3D + y * 0x101) ^ (x << 9)) & 0xFFFF;
+            ret[(x * width) + y] = ((x + y) % 13 == 0) ? 0 : color;
+        }
+    }
+    return ret;
+}
+
+/// The texmap decoder before the conversion was done row by row: one pixel after the other, in file order
+std::vector<uint32_t> decodeReference(const std::vector<uint16_t>& input, unsigned int width) {
+    std::vector<uint32_t> ret(width * width);
+    for (unsigned int x = 0; x < width; ++x) {
+        for (unsigned int y = 0; y < width; ++y) {
+            ret[(y * width) + x] = data::Util::getColorRGBA(input[(x * width) + y]);
+        }
+    }
+    return ret;
+}
+
+uint32_t checksum(const uint32_t* pixels, unsigned int count) {
+    uint32_t ret = 2166136261u;
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(pixels);
+    for (unsigned int i = 0; i < count * 4; ++i) {
+        ret = (ret ^ bytes[i]) * 16777619u;
+    }
+    return ret;
+}
+
+void appendEntry(std::vector<int8_t>& idx, std::vector<int8_t>& mul, const int8_t* data, unsigned int length, uint32_t extra) {
+    uint32_t block[3] = { static_cast<uint32_t>(mul.size()), length, extra };
+    idx.insert(idx.end(), reinterpret_cast<int8_t*>(block), reinterpret_cast<int8_t*>(block) + sizeof(block));
+    mul.insert(mul.end(), data, data + length);
+}
+
+/// texmaps.mul with a 64x64 texture, a 128x128 texture and a 64x64 texture that is cut off
+boost::shared_ptr<data::MapTexLoader> createLoader(const boost::filesystem::path& directory) {
+    std::vector<uint16_t> small = createTexmap(64);
+    std::vector<uint16_t> big = createTexmap(128);
+
+    std::vector<int8_t> idx;
+    std::vector<int8_t> mul;
+    appendEntry(idx, mul, reinterpret_cast<int8_t*>(&small[0]), small.size() * 2, 0);
+    appendEntry(idx, mul, reinterpret_cast<int8_t*>(&big[0]), big.size() * 2, 1);
+    appendEntry(idx, mul, reinterpret_cast<int8_t*>(&small[0]), 100, 0);
+
+    writeFile(directory / "texidx.mul", idx);
+    writeFile(directory / "texmaps.mul", mul);
+
+    return boost::shared_ptr<data::MapTexLoader>(new data::MapTexLoader(directory / "texidx.mul", directory / "texmaps.mul"));
+}
+
+void checkTexture(boost::shared_ptr<ui::Texture> tex, unsigned int width) {
+    BOOST_REQUIRE(waitForItem(tex));
+    BOOST_REQUIRE_EQUAL(tex->getPixelBuffer().get_width(), width);
+    BOOST_REQUIRE_EQUAL(tex->getPixelBuffer().get_height(), width);
+
+    std::vector<uint32_t> expected = decodeReference(createTexmap(width), width);
+    const uint32_t* pixels = tex->getPixelBufferData();
+    for (unsigned int i = 0; i < expected.size(); ++i) {
+        if (pixels[i] != expected[i]) {
+            BOOST_ERROR("Pixel " << (i % width) << "/" << (i / width) << " differs: " << std::hex << pixels[i] << " != " << expected[i]);
+            return;
+        }
+    }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(maptexloader)
+
+BOOST_AUTO_TEST_CASE(textures_match_reference_decoder) {
+    boost::shared_ptr<data::MapTexLoader> loader = createLoader(getTestDirectory("maptexloader-reference"));
+
+    checkTexture(loader->get(0), 64);
+    checkTexture(loader->get(1), 128);
+}
+
+BOOST_AUTO_TEST_CASE(texture_matches_golden_image) {
+    boost::shared_ptr<data::MapTexLoader> loader = createLoader(getTestDirectory("maptexloader-golden"));
+
+    boost::shared_ptr<ui::Texture> tex = loader->get(1);
+    BOOST_REQUIRE(waitForItem(tex));
+    BOOST_CHECK_EQUAL(checksum(tex->getPixelBufferData(), 128 * 128), GOLDEN_CHECKSUM_128);
+}
+
+BOOST_AUTO_TEST_CASE(short_texture_fails) {
+    boost::shared_ptr<data::MapTexLoader> loader = createLoader(getTestDirectory("maptexloader-short"));
+
+    boost::shared_ptr<ui::Texture> tex = loader->get(2);
+    BOOST_CHECK(!waitForItem(tex));
+    BOOST_CHECK(tex->isReadFailed());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
@@ -0,0 +1,286 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <vector>
+
+#include <data/fixedsizeondemandfileloader.hpp>
+#include <data/indexedondemandfileloader.hpp>
+#include <data/ondemandreadable.hpp>
+
+#include "testhelpers.hpp"
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+class FileItem : public data::OnDemandReadable<FileItem> {
+public:
+    FileItem() : extra_(0), userData_(0) {
+    }
+
+    std::vector<int8_t> data_;
+    unsigned int extra_;
+    unsigned int userData_;
+};
+
+void readItem(unsigned int index, int8_t* buf, unsigned int len, boost::shared_ptr<FileItem> item, unsigned int extra, unsigned int userData) {
+    item->data_.assign(buf, buf + len);
+    item->extra_ = extra;
+    item->userData_ = userData;
+}
+
+/// Deterministic, so that a failure can be reproduced
+class Random {
+public:
+    Random() : state_(4711) {
+    }
+
+    unsigned int next(unsigned int max) {
+        state_ = state_ * 1103515245u + 12345u;
+        return (state_ >> 16) % max;
+    }
+
+private:
+    uint32_t state_;
+};
+
+struct Entry {
+    uint32_t offset_;
+    uint32_t length_;
+    uint32_t extra_;
+};
+
+/// Random entries in random order, some of them empty and some pointing past the end of the mul file
+void createIndexedFiles(const boost::filesystem::path& directory, unsigned int count, std::vector<Entry>& entries, std::vector<int8_t>& mul) {
+    Random random;
+    std::vector<int8_t> idx;
+    for (unsigned int i = 0; i < count; ++i) {
+        Entry entry;
+        entry.length_ = random.next(5000) + 1;
+        entry.extra_ = random.next(0x10000) | (random.next(0x10000) << 16);
+
+        unsigned int kind = random.next(16);
+        if (kind == 0) {
+            entry.offset_ = 0xFFFFFFFFu;
+        } else if (kind == 1 && !mul.empty()) {
+            // an entry that was already written, idx files of patched muls do this
+            entry.offset_ = entries[random.next(entries.size())].offset_;
+            entry.length_ = 0;
+        } else {
+            entry.offset_ = mul.size();
+            for (unsigned int j = 0; j < entry.length_; ++j) {
+                mul.push_back(random.next(256));
+            }
+        }
+        entries.push_back(entry);
+
+        const int8_t* bytes = reinterpret_cast<const int8_t*>(&entry);
+        idx.insert(idx.end(), bytes, bytes + sizeof(entry));
+    }
+
+    // points past the end, reading it has to fail
+    Entry broken = { static_cast<uint32_t>(mul.size() - 100), 200, 0 };
+    entries.push_back(broken);
+    const int8_t* bytes = reinterpret_cast<const int8_t*>(&broken);
+    idx.insert(idx.end(), bytes, bytes + sizeof(broken));
+
+    writeFile(directory / "test.idx", idx);
+    writeFile(directory / "test.mul", mul);
+}
+
+void recordOrder(unsigned int index, int8_t* buf, unsigned int len, boost::shared_ptr<FileItem> item, unsigned int extra, unsigned int userData,
+        boost::mutex* mutex, std::vector<unsigned int>* order) {
+    boost::mutex::scoped_lock lock(*mutex);
+    order->push_back(index);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(ondemandfileloader)
+
+BOOST_AUTO_TEST_CASE(indexed_reads_match_in_both_paths) {
+    boost::filesystem::path directory = getTestDirectory("ondemandfileloader-indexed");
+    std::vector<Entry> entries;
+    std::vector<int8_t> mul;
+    createIndexedFiles(directory, 600, entries, mul);
+
+    data::IndexedOnDemandFileLoader<unsigned int, FileItem> mapped(directory / "test.idx", directory / "test.mul", &readItem);
+    data::IndexedOnDemandFileLoader<unsigned int, FileItem> streamed(directory / "test.idx", directory / "test.mul", &readItem, false);
+    BOOST_REQUIRE(mapped.isMemoryMapped());
+    BOOST_REQUIRE(!streamed.isMemoryMapped());
+    BOOST_REQUIRE_EQUAL(mapped.size(), entries.size());
+
+    std::vector<boost::shared_ptr<FileItem> > mappedItems;
+    std::vector<boost::shared_ptr<FileItem> > streamedItems;
+    for (unsigned int i = 0; i < entries.size(); ++i) {
+        mappedItems.push_back(mapped.get(i, i * 3));
+        streamedItems.push_back(streamed.get(i, i * 3));
+    }
+
+    for (unsigned int i = 0; i + 1 < entries.size(); ++i) {
+        const Entry& entry = entries[i];
+        if (entry.offset_ == 0xFFFFFFFFu || entry.length_ == 0) {
+            BOOST_REQUIRE(!mappedItems[i]);
+            BOOST_REQUIRE(!streamedItems[i]);
+            continue;
+        }
+
+        BOOST_REQUIRE(waitForItem(mappedItems[i]));
+        BOOST_REQUIRE(waitForItem(streamedItems[i]));
+
+        std::vector<int8_t> expected(mul.begin() + entry.offset_, mul.begin() + entry.offset_ + entry.length_);
+        BOOST_REQUIRE(mappedItems[i]->data_ == expected);
+        BOOST_REQUIRE(streamedItems[i]->data_ == expected);
+        BOOST_REQUIRE_EQUAL(mappedItems[i]->extra_, entry.extra_);
+        BOOST_REQUIRE_EQUAL(streamedItems[i]->extra_, entry.extra_);
+        BOOST_REQUIRE_EQUAL(mappedItems[i]->userData_, i * 3);
+        BOOST_REQUIRE_EQUAL(streamedItems[i]->userData_, i * 3);
+    }
+
+    BOOST_CHECK(!waitForItem(mappedItems.back()));
+    BOOST_CHECK(mappedItems.back()->isReadFailed());
+    BOOST_CHECK(!waitForItem(streamedItems.back()));
+    BOOST_CHECK(streamedItems.back()->isReadFailed());
+}
+
+BOOST_AUTO_TEST_CASE(fixed_size_reads_match_in_both_paths) {
+    // the size of a map block
+    const unsigned int blockSize = 196;
+    const unsigned int blockCount = 300;
+
+    boost::filesystem::path directory = getTestDirectory("ondemandfileloader-fixed");
+    Random random;
+    // the last block is cut off
+    std::vector<int8_t> data(blockSize * blockCount - 10);
+    for (unsigned int i = 0; i < data.size(); ++i) {
+        data[i] = random.next(256);
+    }
+    writeFile(directory / "map.mul", data);
+
+    data::FixedSizeOnDemandFileLoader<unsigned int, FileItem> mapped(directory / "map.mul", blockSize, &readItem);
+    data::FixedSizeOnDemandFileLoader<unsigned int, FileItem> streamed(directory / "map.mul", blockSize, &readItem, false);
+    BOOST_REQUIRE(mapped.isMemoryMapped());
+    BOOST_REQUIRE(!streamed.isMemoryMapped());
+
+    // random access, like a player teleporting around
+    for (unsigned int i = 0; i < 1000; ++i) {
+        unsigned int block = random.next(blockCount);
+        boost::shared_ptr<FileItem> mappedItem = mapped.get(block, 0);
+        boost::shared_ptr<FileItem> streamedItem = streamed.get(block, 0);
+
+        if (block == blockCount - 1) {
+            BOOST_REQUIRE(!waitForItem(mappedItem));
+            BOOST_REQUIRE(!waitForItem(streamedItem));
+            continue;
+        }
+
+        BOOST_REQUIRE(waitForItem(mappedItem));
+        BOOST_REQUIRE(waitForItem(streamedItem));
+        std::vector<int8_t> expected(data.begin() + block * blockSize, data.begin() + (block + 1) * blockSize);
+        BOOST_REQUIRE(mappedItem->data_ == expected);
+        BOOST_REQUIRE(streamedItem->data_ == expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(empty_file_is_streamed) {
+    boost::filesystem::path directory = getTestDirectory("ondemandfileloader-empty");
+    writeFile(directory / "empty.mul", std::vector<int8_t>());
+
+    // empty files can not be mapped, the loader has to fall back to reading
+    data::FixedSizeOnDemandFileLoader<unsigned int, FileItem> loader(directory / "empty.mul", 196, &readItem);
+    BOOST_CHECK(!loader.isMemoryMapped());
+
+    boost::shared_ptr<FileItem> item = loader.get(0, 0);
+    BOOST_CHECK(!waitForItem(item));
+    BOOST_CHECK(item->isReadFailed());
+}
+
+BOOST_AUTO_TEST_CASE(loads_run_in_priority_order) {
+    const unsigned int itemCount = 60;
+
+    boost::filesystem::path directory = getTestDirectory("ondemandfileloader-priority");
+    writeFile(directory / "blocks.mul", std::vector<int8_t>(itemCount * 16, 1));
+
+    boost::mutex mutex;
+    std::vector<unsigned int> order;
+    data::FixedSizeOnDemandFileLoader<unsigned int, FileItem> loader(directory / "blocks.mul", 16,
+            boost::bind(&recordOrder, _1, _2, _3, _4, _5, _6, &mutex, &order));
+
+    // a slow disk: nothing is read until the requests are queued, then one read and one decode at a time
+    SchedulerBlocker firstRead;
+    SchedulerBlocker otherReads;
+    SchedulerBlocker decodes;
+    BOOST_REQUIRE(firstRead.blockReads(1));
+    BOOST_REQUIRE(otherReads.blockReads(IO_THREAD_COUNT - 1));
+    BOOST_REQUIRE(decodes.blockDecodes(DECODE_THREAD_COUNT - 1));
+
+    std::vector<boost::shared_ptr<FileItem> > items(itemCount);
+    for (unsigned int i = 0; i < itemCount; ++i) {
+        // every fifth item is dropped right away, like a sector the player already left
+        boost::shared_ptr<FileItem> item = loader.get(i, 0, i % data::LoadPriority::COUNT);
+        if (i % 5 != 0) {
+            items[i] = item;
+        }
+    }
+
+    // requested again while it is still queued, now for something visible
+    const unsigned int raised = 2;
+    BOOST_REQUIRE_EQUAL(items[raised]->getLoadPriority(), (unsigned int)data::LoadPriority::BACKGROUND);
+    loader.raisePriority(items[raised], data::LoadPriority::VISIBLE);
+
+    firstRead.release();
+    for (unsigned int i = 0; i < itemCount; ++i) {
+        if (items[i]) {
+            BOOST_REQUIRE(waitForItem(items[i]));
+        }
+    }
+
+    std::vector<unsigned int> expected;
+    for (unsigned int priority = 0; priority < data::LoadPriority::COUNT; ++priority) {
+        for (unsigned int i = 0; i < itemCount; ++i) {
+            if (items[i] && i % data::LoadPriority::COUNT == priority && i != raised) {
+                expected.push_back(i);
+            }
+        }
+        if (priority == data::LoadPriority::VISIBLE) {
+            // moved to the end of the visible queue
+            expected.push_back(raised);
+        }
+    }
+
+    boost::mutex::scoped_lock lock(mutex);
+    BOOST_CHECK_EQUAL_COLLECTIONS(order.begin(), order.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
@@ -0,0 +1,235 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+#include <data/ondemandreadable.hpp>
+#include <data/completionqueue.hpp>
+#include <data/retentiontier.hpp>
+#include <data/weakptrcache.hpp>
+#include <data/denseweakptrcache.hpp>
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+const unsigned int ITEM_SIZE = 1000;
+
+class FakeItem : public data::OnDemandReadable<FakeItem> {
+public:
+    unsigned int getWidth() const { return 1; }
+    unsigned int getHeight() const { return 1; }
+};
+
+/// Creates the items synchronously. With completeItems_ false, they stay loading until the test completes them
+template<typename KeyType, typename ValueType>
+class FakeLoader {
+public:
+    FakeLoader() : completeItems_(true), loadCount_(0) {
+    }
+
+    boost::shared_ptr<ValueType> get(const KeyType& id, unsigned int userData, unsigned int priority) {
+        boost::shared_ptr<ValueType> ret(new ValueType());
+        ret->setMemoryUsage(ITEM_SIZE);
+        if (completeItems_) {
+            ret->setReadComplete();
+        }
+        ++loadCount_;
+        return ret;
+    }
+
+    void raisePriority(const boost::shared_ptr<ValueType>& item, unsigned int priority) {
+    }
+
+    unsigned int size() const {
+        return 64;
+    }
+
+    bool completeItems_;
+    unsigned int loadCount_;
+};
+
+typedef FakeLoader<unsigned int, FakeItem> LoaderType;
+typedef data::RetentionTier<unsigned int, FakeItem> TierType;
+
+/// Walking back and forth over a sector border: two sets of ids, only the current one is held by the caller
+template<typename CacheType>
+void walkBorder(CacheType& cache, unsigned int budget) {
+    std::vector<boost::shared_ptr<FakeItem> > held;
+    for (unsigned int step = 0; step < 20; ++step) {
+        held.clear();
+        unsigned int firstId = (step % 2) * 4;
+        for (unsigned int id = firstId; id < firstId + 4; ++id) {
+            held.push_back(cache.get(id));
+            BOOST_CHECK_LE(cache.getRetainedBytes(), budget);
+        }
+    }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(retentiontier)
+
+BOOST_AUTO_TEST_CASE(border_thrash_hits_retained_items) {
+    boost::shared_ptr<LoaderType> loader(new LoaderType());
+    data::WeakPtrCache<unsigned int, FakeItem, FakeLoader> cache;
+    cache.init(loader);
+    cache.setRetentionBudget(8 * ITEM_SIZE);
+
+    walkBorder(cache, 8 * ITEM_SIZE);
+
+    // only the first visit of each id is a miss
+    BOOST_CHECK_EQUAL(loader->loadCount_, 8u);
+    BOOST_CHECK_EQUAL(cache.getMissCount(), 8u);
+    BOOST_CHECK_EQUAL(cache.getHitCount(), 72u);
+    BOOST_CHECK_EQUAL(cache.getRetainedHitCount(), 72u);
+}
+
+BOOST_AUTO_TEST_CASE(budget_evicts_least_recently_used) {
+    boost::shared_ptr<LoaderType> loader(new LoaderType());
+    data::WeakPtrCache<unsigned int, FakeItem, FakeLoader> cache;
+    cache.init(loader);
+    cache.setRetentionBudget(3 * ITEM_SIZE);
+
+    cache.get(0);
+    cache.get(1);
+    cache.get(2);
+    cache.get(0);
+    BOOST_CHECK_EQUAL(cache.getRetainedItemCount(), 3u);
+
+    // 1 is the least recently used one now
+    cache.get(3);
+    BOOST_CHECK_EQUAL(cache.getRetainedItemCount(), 3u);
+    BOOST_CHECK_EQUAL(cache.getRetainedBytes(), 3 * ITEM_SIZE);
+    BOOST_CHECK_EQUAL(loader->loadCount_, 4u);
+
+    cache.get(0);
+    cache.get(2);
+    cache.get(3);
+    BOOST_CHECK_EQUAL(loader->loadCount_, 4u);
+
+    cache.get(1);
+    BOOST_CHECK_EQUAL(loader->loadCount_, 5u);
+
+    cache.setRetentionBudget(0);
+    BOOST_CHECK_EQUAL(cache.getRetainedItemCount(), 0u);
+    BOOST_CHECK_EQUAL(cache.getRetainedBytes(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(dense_cache_matches_map_cache) {
+    boost::shared_ptr<LoaderType> mapLoader(new LoaderType());
+    data::WeakPtrCache<unsigned int, FakeItem, FakeLoader> mapCache;
+    mapCache.init(mapLoader);
+    mapCache.setRetentionBudget(6 * ITEM_SIZE);
+
+    boost::shared_ptr<LoaderType> denseLoader(new LoaderType());
+    data::DenseWeakPtrCache<FakeItem, FakeLoader> denseCache;
+    denseCache.init(denseLoader);
+    denseCache.setRetentionBudget(6 * ITEM_SIZE);
+
+    walkBorder(mapCache, 6 * ITEM_SIZE);
+    walkBorder(denseCache, 6 * ITEM_SIZE);
+
+    BOOST_CHECK_EQUAL(denseLoader->loadCount_, mapLoader->loadCount_);
+    BOOST_CHECK_EQUAL(denseCache.getHitCount(), mapCache.getHitCount());
+    BOOST_CHECK_EQUAL(denseCache.getRetainedHitCount(), mapCache.getRetainedHitCount());
+    BOOST_CHECK_EQUAL(denseCache.getRetainedBytes(), mapCache.getRetainedBytes());
+}
+
+BOOST_AUTO_TEST_CASE(loading_items_are_not_pinned) {
+    boost::shared_ptr<LoaderType> loader(new LoaderType());
+    loader->completeItems_ = false;
+    data::DenseWeakPtrCache<FakeItem, FakeLoader> cache;
+    cache.init(loader);
+    cache.setRetentionBudget(8 * ITEM_SIZE);
+
+    boost::shared_ptr<FakeItem> item = cache.get(1);
+    BOOST_CHECK_EQUAL(cache.getRetainedBytes(), 0u);
+
+    // held by the caller and the returned pointer, but not by the tier
+    cache.get(1);
+    BOOST_CHECK_EQUAL(cache.getHitCount(), 1u);
+    BOOST_CHECK_EQUAL(cache.getRetainedHitCount(), 0u);
+
+    item->setReadComplete();
+    data::CompletionQueue::getSingleton()->drain();
+    BOOST_CHECK_EQUAL(cache.getRetainedBytes(), ITEM_SIZE);
+
+    // now only the tier keeps it alive
+    item.reset();
+    cache.get(1);
+    BOOST_CHECK_EQUAL(cache.getRetainedHitCount(), 1u);
+    BOOST_CHECK_EQUAL(loader->loadCount_, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(failed_items_are_dropped) {
+    boost::shared_ptr<LoaderType> loader(new LoaderType());
+    loader->completeItems_ = false;
+    data::DenseWeakPtrCache<FakeItem, FakeLoader> cache;
+    cache.init(loader);
+    cache.setRetentionBudget(8 * ITEM_SIZE);
+
+    boost::shared_ptr<FakeItem> failed = cache.get(1);
+    boost::shared_ptr<FakeItem> complete = cache.get(2);
+    BOOST_CHECK_EQUAL(cache.getRetainedItemCount(), 2u);
+
+    failed->setReadFailed();
+    complete->setReadComplete();
+    data::CompletionQueue::getSingleton()->drain();
+
+    // the failed entry is evicted by the next insert
+    cache.get(3);
+    BOOST_CHECK_EQUAL(cache.getRetainedItemCount(), 2u);
+    BOOST_CHECK_EQUAL(cache.getRetainedBytes(), ITEM_SIZE);
+}
+
+BOOST_AUTO_TEST_CASE(expired_pending_items_are_dropped) {
+    TierType tier;
+    tier.setBudget(8 * ITEM_SIZE);
+
+    // nobody holds the items, so their listeners are never called
+    for (unsigned int i = 0; i < 1000; ++i) {
+        boost::shared_ptr<FakeItem> item(new FakeItem());
+        tier.insert(i, item);
+        while (tier.isOverBudget()) {
+            tier.evictOldest();
+        }
+
+        // the tier looks for expired items whenever the number of pending ones doubled
+        BOOST_CHECK_LE(tier.getPendingCount(), 128u);
+    }
+
+    BOOST_CHECK_EQUAL(tier.getItemCount(), tier.getPendingCount());
+    BOOST_CHECK_EQUAL(tier.getUsedBytes(), 0u);
+    BOOST_CHECK_EQUAL(tier.getEvictionCount(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
@@ -0,0 +1,358 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+
+#ifndef WIN32
+#include <sys/wait.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#include <data/sharedmemorycache.hpp>
+#include <ui/texture.hpp>
+
+namespace fluo {
+namespace tests {
+
+#ifndef WIN32
+
+namespace {
+
+const unsigned int CLIENT_COUNT = 4;
+const unsigned int ENTRY_COUNT = 2000;
+const unsigned int CACHE_SIZE = 16 * 1024 * 1024;
+
+/// Exit codes of the client processes
+const int CLIENT_OK = 0;
+const int CLIENT_WRONG_DATA = 1;
+const int CLIENT_EXCEPTION = 2;
+
+/// Different for every test run, so that segments of an earlier run do not interfere
+uint64_t makeHash(unsigned int testIndex) {
+    return (static_cast<uint64_t>(getpid()) << 16) | testIndex;
+}
+
+bool segmentExists(uint64_t hash) {
+    std::stringstream ss;
+    ss << "fluo-" << std::hex << std::setw(16) << std::setfill('0') << hash << "-";
+    std::string prefix = ss.str();
+
+    bool ret = false;
+    DIR* dir = opendir("/dev/shm");
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (std::string(entry->d_name).compare(0, prefix.size(), prefix) == 0) {
+                ret = true;
+            }
+        }
+        closedir(dir);
+    }
+    return ret;
+}
+
+/// The entry as decoded by client, different sizes for different ids
+std::vector<int8_t> createEntry(unsigned int id, unsigned int client) {
+    std::vector<int8_t> ret(1 + (id * 37) % 700);
+    for (unsigned int i = 0; i < ret.size(); ++i) {
+        ret[i] = (id * 7 + i + client * 101) & 0xFF;
+    }
+    return ret;
+}
+
+/// Checks that the shared entry is the complete copy of one of the clients, returns that client
+int findWriter(const int8_t* shared, unsigned int size, unsigned int id) {
+    for (unsigned int client = 0; client < CLIENT_COUNT; ++client) {
+        std::vector<int8_t> expected = createEntry(id, client);
+        if (size == expected.size() && std::equal(expected.begin(), expected.end(), shared)) {
+            return client;
+        }
+    }
+    return -1;
+}
+
+/// Called by a client, returns once all clients called it. Clients that do not call it are waited for when they exit
+void waitForOtherClients(int donePipe, int resumePipe, bool* waited) {
+    if (*waited) {
+        return;
+    }
+    *waited = true;
+
+    char buf = 0;
+    if (write(donePipe, &buf, 1) != 1) {
+        return;
+    }
+    while (read(resumePipe, &buf, 1) > 0) {
+    }
+}
+
+typedef boost::function<void ()> WaitFunction;
+typedef boost::function<int (unsigned int, const WaitFunction&)> ClientFunction;
+
+/**
+ * Runs the function in CLIENT_COUNT forked processes. They start at the same time, once all are forked.
+ * Returns the exit codes
+ */
+std::vector<int> runClients(const ClientFunction& function) {
+    int startPipe[2];
+    int donePipe[2];
+    int resumePipe[2];
+    BOOST_REQUIRE_EQUAL(pipe(startPipe), 0);
+    BOOST_REQUIRE_EQUAL(pipe(donePipe), 0);
+    BOOST_REQUIRE_EQUAL(pipe(resumePipe), 0);
+
+    std::vector<pid_t> pids;
+    for (unsigned int client = 0; client < CLIENT_COUNT; ++client) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(startPipe[1]);
+            close(donePipe[0]);
+            close(resumePipe[1]);
+            char buf;
+            while (read(startPipe[0], &buf, 1) > 0) {
+            }
+
+            bool waited = false;
+            int ret;
+            try {
+                ret = function(client, boost::bind(&waitForOtherClients, donePipe[1], resumePipe[0], &waited));
+            } catch (...) {
+                ret = CLIENT_EXCEPTION;
+            }
+            waitForOtherClients(donePipe[1], resumePipe[0], &waited);
+            // no destructors of the test process, and no test output
+            _exit(ret);
+        }
+        BOOST_REQUIRE(pid > 0);
+        pids.push_back(pid);
+    }
+
+    close(startPipe[0]);
+    close(startPipe[1]);
+    close(donePipe[1]);
+    close(resumePipe[0]);
+
+    unsigned int doneCount = 0;
+    char buf;
+    while (doneCount < CLIENT_COUNT && read(donePipe[0], &buf, 1) == 1) {
+        ++doneCount;
+    }
+    close(resumePipe[1]);
+    close(donePipe[0]);
+
+    std::vector<int> ret;
+    for (unsigned int i = 0; i < pids.size(); ++i) {
+        int status = 0;
+        waitpid(pids[i], &status, 0);
+        ret.push_back(WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+    }
+    return ret;
+}
+
+/// Every client publishes its share of the ids, then checks the entries of all the others
+int publishShare(uint64_t hash, unsigned int client, const WaitFunction& waitForOthers) {
+    data::SharedMemoryCache cache(hash, CACHE_SIZE);
+    for (unsigned int id = client; id < ENTRY_COUNT; id += CLIENT_COUNT) {
+        std::vector<int8_t> entry = createEntry(id, client);
+        if (!cache.store(data::SharedMemoryCache::Source::ART, id, &entry[0], entry.size())) {
+            return CLIENT_WRONG_DATA;
+        }
+    }
+
+    waitForOthers();
+
+    for (unsigned int id = 0; id < ENTRY_COUNT; ++id) {
+        unsigned int size = 0;
+        const int8_t* shared = cache.find(data::SharedMemoryCache::Source::ART, id, size);
+        if (!shared || findWriter(shared, size, id) != static_cast<int>(id % CLIENT_COUNT)) {
+            return CLIENT_WRONG_DATA;
+        }
+    }
+    return CLIENT_OK;
+}
+
+/**
+ * All clients publish the same ids at once. Only one copy of each may win, and it must not be replaced by a copy
+ * that is published later
+ */
+int publishSameIds(uint64_t hash, unsigned int firstId, unsigned int client, const WaitFunction& waitForOthers) {
+    data::SharedMemoryCache cache(hash, CACHE_SIZE);
+    std::vector<const int8_t*> stored(firstId + ENTRY_COUNT);
+    for (unsigned int id = firstId; id < firstId + ENTRY_COUNT; ++id) {
+        std::vector<int8_t> entry = createEntry(id, client);
+        // NULL if another client is still writing it
+        stored[id] = cache.store(data::SharedMemoryCache::Source::GUMPART, id, &entry[0], entry.size());
+    }
+
+    waitForOthers();
+
+    for (unsigned int id = firstId; id < firstId + ENTRY_COUNT; ++id) {
+        unsigned int size = 0;
+        const int8_t* found = cache.find(data::SharedMemoryCache::Source::GUMPART, id, size);
+        if (!found || (stored[id] && found != stored[id]) || findWriter(found, size, id) == -1) {
+            return CLIENT_WRONG_DATA;
+        }
+    }
+    return CLIENT_OK;
+}
+
+int publishTexture(uint64_t hash, unsigned int client, const WaitFunction& waitForOthers) {
+    data::SharedMemoryCache cache(hash, CACHE_SIZE);
+    boost::shared_ptr<ui::Texture> tex(new ui::Texture());
+    tex->initPixelBuffer(20, 10);
+    uint32_t* pixels = tex->getPixelBufferData();
+    for (unsigned int i = 0; i < 20 * 10; ++i) {
+        pixels[i] = i * 0x01010101u;
+    }
+    cache.storeTexture(data::SharedMemoryCache::Source::TEXMAP, 5, tex);
+    return CLIENT_OK;
+}
+
+/// Attaches and exits without detaching, like a crashed client
+int crash(uint64_t hash, unsigned int client, const WaitFunction& waitForOthers) {
+    new data::SharedMemoryCache(hash, CACHE_SIZE);
+    return CLIENT_OK;
+}
+
+void checkClients(const std::vector<int>& exitCodes) {
+    for (unsigned int i = 0; i < exitCodes.size(); ++i) {
+        BOOST_CHECK_EQUAL(exitCodes[i], CLIENT_OK);
+    }
+}
+
+}
+
+/**
+ * The clients are forked processes, each with its own SharedMemoryCache on the same segment
+ */
+BOOST_AUTO_TEST_SUITE(sharedmemorycache)
+
+BOOST_AUTO_TEST_CASE(entries_are_shared_between_processes) {
+    uint64_t hash = makeHash(1);
+    data::SharedMemoryCache cache(hash, CACHE_SIZE);
+
+    checkClients(runClients(boost::bind(&publishShare, hash, _1, _2)));
+
+    // the clients are gone, their entries are still there
+    for (unsigned int id = 0; id < ENTRY_COUNT; ++id) {
+        unsigned int size = 0;
+        const int8_t* shared = cache.find(data::SharedMemoryCache::Source::ART, id, size);
+        BOOST_REQUIRE(shared);
+        BOOST_REQUIRE_EQUAL(findWriter(shared, size, id), static_cast<int>(id % CLIENT_COUNT));
+
+        // published entries are not replaced
+        std::vector<int8_t> entry = createEntry(id, CLIENT_COUNT);
+        BOOST_REQUIRE(cache.store(data::SharedMemoryCache::Source::ART, id, &entry[0], entry.size()) == shared);
+    }
+
+    unsigned int size = 0;
+    BOOST_CHECK(!cache.find(data::SharedMemoryCache::Source::GUMPART, 0, size));
+    BOOST_CHECK(!cache.find(data::SharedMemoryCache::Source::ART, ENTRY_COUNT, size));
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_stores_publish_one_copy) {
+    uint64_t hash = makeHash(2);
+    data::SharedMemoryCache cache(hash, CACHE_SIZE);
+
+    // the clients collide rarely, so it is repeated with new ids
+    const unsigned int roundCount = 8;
+    for (unsigned int round = 0; round < roundCount; ++round) {
+        checkClients(runClients(boost::bind(&publishSameIds, hash, round * ENTRY_COUNT, _1, _2)));
+    }
+
+    std::vector<unsigned int> winCount(CLIENT_COUNT, 0);
+    for (unsigned int id = 0; id < roundCount * ENTRY_COUNT; ++id) {
+        unsigned int size = 0;
+        const int8_t* shared = cache.find(data::SharedMemoryCache::Source::GUMPART, id, size);
+        BOOST_REQUIRE(shared);
+        int writer = findWriter(shared, size, id);
+        BOOST_REQUIRE(writer != -1);
+        ++winCount[writer];
+    }
+    BOOST_TEST_MESSAGE("Entries published by each client: " << winCount[0] << " " << winCount[1] << " " << winCount[2] << " " << winCount[3]);
+}
+
+BOOST_AUTO_TEST_CASE(textures_use_the_shared_pixels) {
+    uint64_t hash = makeHash(3);
+    data::SharedMemoryCache cache(hash, CACHE_SIZE);
+
+    std::vector<int> exitCodes = runClients(boost::bind(&publishTexture, hash, _1, _2));
+    checkClients(exitCodes);
+
+    boost::shared_ptr<ui::Texture> tex(new ui::Texture());
+    BOOST_REQUIRE(cache.loadTexture(data::SharedMemoryCache::Source::TEXMAP, 5, tex));
+    BOOST_REQUIRE_EQUAL(tex->getPixelBuffer().get_width(), 20);
+    BOOST_REQUIRE_EQUAL(tex->getPixelBuffer().get_height(), 10);
+
+    // no copy, the pixels are in the segment
+    unsigned int size = 0;
+    const int8_t* shared = cache.find(data::SharedMemoryCache::Source::TEXMAP, 5, size);
+    BOOST_CHECK_EQUAL(size, (2 + 20 * 10) * sizeof(uint32_t));
+    BOOST_CHECK(tex->getPixelBuffer().get_data() == shared + 2 * sizeof(uint32_t));
+
+    const uint32_t* pixels = tex->getPixelBufferData();
+    for (unsigned int i = 0; i < 20 * 10; ++i) {
+        BOOST_REQUIRE_EQUAL(pixels[i], i * 0x01010101u);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(segments_are_removed_with_their_last_client) {
+    uint64_t hash = makeHash(4);
+    {
+        data::SharedMemoryCache cache(hash, CACHE_SIZE);
+        BOOST_CHECK(segmentExists(hash));
+
+        // the clients detach, the segment stays because of this one
+        checkClients(runClients(boost::bind(&publishTexture, hash, _1, _2)));
+        BOOST_CHECK(segmentExists(hash));
+    }
+    BOOST_CHECK(!segmentExists(hash));
+
+    // crashed clients leave the segment behind, the next client removes it
+    uint64_t crashedHash = makeHash(5);
+    checkClients(runClients(boost::bind(&crash, crashedHash, _1, _2)));
+    BOOST_CHECK(segmentExists(crashedHash));
+
+    {
+        data::SharedMemoryCache cache(makeHash(6), CACHE_SIZE);
+        BOOST_CHECK(!segmentExists(crashedHash));
+    }
+    BOOST_CHECK(!segmentExists(makeHash(6)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif
+
+}
+}
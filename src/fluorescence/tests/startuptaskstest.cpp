@@ -0,0 +1,248 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <data/startuptasks.hpp>
+#include <misc/exception.hpp>
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+const unsigned int TASK_COUNT = 24;
+const unsigned int NO_FAILURE = 0xFFFFFFFFu;
+
+class Random {
+public:
+    Random(uint32_t seed) : state_(seed) {
+    }
+
+    unsigned int next(unsigned int max) {
+        state_ = state_ * 1103515245u + 12345u;
+        return (state_ >> 16) % max;
+    }
+
+private:
+    uint32_t state_;
+};
+
+typedef std::vector<std::vector<unsigned int> > Graph;
+
+/// Like the loader tasks of the manager: the first tasks have no dependencies, the others up to 3 on earlier tasks
+Graph randomGraph(Random& random) {
+    Graph ret(TASK_COUNT);
+    for (unsigned int i = 4; i < TASK_COUNT; ++i) {
+        unsigned int count = random.next(4);
+        for (unsigned int j = 0; j < count; ++j) {
+            unsigned int dependency = random.next(i);
+            if (std::find(ret[i].begin(), ret[i].end(), dependency) == ret[i].end()) {
+                ret[i].push_back(dependency);
+            }
+        }
+    }
+    return ret;
+}
+
+std::string taskName(unsigned int index) {
+    std::stringstream sstr;
+    sstr << "task" << index;
+    return sstr.str();
+}
+
+/**
+ * What the tasks of one run did. Each task writes only its own value, like the loader tasks write only their own
+ * members, and reads the values of its dependencies without locking
+ */
+class TaskRun {
+public:
+    TaskRun(const Graph& graph) : graph_(graph), values_(graph.size(), 0), started_(graph.size(), false), finished_(graph.size(), false),
+            runningCount_(0), maxRunningCount_(0), orderViolations_(0) {
+    }
+
+    void runTask(unsigned int index, unsigned int sleepMillis, unsigned int failIndex) {
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            started_[index] = true;
+            threads_.push_back(boost::this_thread::get_id());
+            ++runningCount_;
+            maxRunningCount_ = (std::max)(maxRunningCount_, runningCount_);
+            for (unsigned int i = 0; i < graph_[index].size(); ++i) {
+                if (!finished_[graph_[index][i]]) {
+                    ++orderViolations_;
+                }
+            }
+        }
+
+        boost::this_thread::sleep(boost::posix_time::milliseconds(sleepMillis));
+
+        uint32_t value = 2166136261u ^ index;
+        for (unsigned int i = 0; i < graph_[index].size(); ++i) {
+            value = (value ^ values_[graph_[index][i]]) * 16777619u;
+        }
+        values_[index] = value;
+
+        boost::mutex::scoped_lock lock(mutex_);
+        --runningCount_;
+        if (index == failIndex) {
+            throw Exception("broken file");
+        }
+        finished_[index] = true;
+        finishOrder_.push_back(index);
+    }
+
+    const Graph& graph_;
+    std::vector<uint32_t> values_;
+
+    boost::mutex mutex_;
+    std::vector<bool> started_;
+    std::vector<bool> finished_;
+    std::vector<unsigned int> finishOrder_;
+    std::vector<boost::thread::id> threads_;
+    unsigned int runningCount_;
+    unsigned int maxRunningCount_;
+    unsigned int orderViolations_;
+};
+
+void addTasks(data::StartupTasks& tasks, TaskRun& run, Random& random, unsigned int failIndex) {
+    for (unsigned int i = 0; i < run.graph_.size(); ++i) {
+        std::vector<std::string> dependencies;
+        for (unsigned int j = 0; j < run.graph_[i].size(); ++j) {
+            dependencies.push_back(taskName(run.graph_[i][j]));
+        }
+        tasks.add(taskName(i), boost::bind(&TaskRun::runTask, &run, i, 1 + random.next(5), failIndex), dependencies);
+    }
+}
+
+/// Returns the error message, or an empty string if the run succeeded
+std::string runTasks(TaskRun& run, unsigned int threadCount, unsigned int failIndex) {
+    Random random(threadCount);
+    data::StartupTasks tasks;
+    addTasks(tasks, run, random, failIndex);
+
+    try {
+        tasks.run(threadCount);
+    } catch (const Exception& ex) {
+        return ex.what();
+    }
+    return std::string();
+}
+
+bool dependsOn(const Graph& graph, unsigned int index, unsigned int dependency) {
+    for (unsigned int i = 0; i < graph[index].size(); ++i) {
+        if (graph[index][i] == dependency || dependsOn(graph, graph[index][i], dependency)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(startuptasks)
+
+BOOST_AUTO_TEST_CASE(serial_run_keeps_the_order_of_adding) {
+    Random random(19);
+    Graph graph = randomGraph(random);
+
+    TaskRun run(graph);
+    BOOST_REQUIRE_EQUAL(runTasks(run, 1, NO_FAILURE), "");
+
+    BOOST_CHECK_EQUAL(run.maxRunningCount_, 1u);
+    BOOST_REQUIRE_EQUAL(run.finishOrder_.size(), TASK_COUNT);
+    for (unsigned int i = 0; i < TASK_COUNT; ++i) {
+        BOOST_CHECK_EQUAL(run.finishOrder_[i], i);
+        BOOST_CHECK(run.threads_[i] == boost::this_thread::get_id());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parallel_run_matches_serial_run) {
+    for (unsigned int round = 0; round < 10; ++round) {
+        Random random(round);
+        Graph graph = randomGraph(random);
+
+        TaskRun serial(graph);
+        BOOST_REQUIRE_EQUAL(runTasks(serial, 1, NO_FAILURE), "");
+
+        TaskRun parallel(graph);
+        BOOST_REQUIRE_EQUAL(runTasks(parallel, 4, NO_FAILURE), "");
+
+        BOOST_CHECK_EQUAL(parallel.orderViolations_, 0u);
+        BOOST_CHECK_GT(parallel.maxRunningCount_, 1u);
+        BOOST_CHECK_LE(parallel.maxRunningCount_, 4u);
+        BOOST_REQUIRE_EQUAL(parallel.finishOrder_.size(), TASK_COUNT);
+        for (unsigned int i = 0; i < TASK_COUNT; ++i) {
+            BOOST_REQUIRE_EQUAL(parallel.values_[i], serial.values_[i]);
+            BOOST_CHECK(parallel.threads_[i] != boost::this_thread::get_id());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(failed_task_stops_its_dependents) {
+    Random random(7);
+    Graph graph = randomGraph(random);
+    unsigned int failIndex = 5;
+
+    TaskRun serial(graph);
+    std::string serialError = runTasks(serial, 1, failIndex);
+    BOOST_CHECK_NE(serialError.find(taskName(failIndex)), std::string::npos);
+    BOOST_CHECK_NE(serialError.find("broken file"), std::string::npos);
+    for (unsigned int i = 0; i < TASK_COUNT; ++i) {
+        BOOST_CHECK_EQUAL(serial.started_[i], i <= failIndex);
+    }
+
+    TaskRun parallel(graph);
+    std::string parallelError = runTasks(parallel, 4, failIndex);
+    BOOST_CHECK_EQUAL(parallelError, serialError);
+    BOOST_CHECK_EQUAL(parallel.runningCount_, 0u);
+    for (unsigned int i = 0; i < TASK_COUNT; ++i) {
+        if (dependsOn(graph, i, failIndex)) {
+            BOOST_CHECK(!parallel.started_[i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(dependencies_must_be_added_first) {
+    data::StartupTasks tasks;
+    TaskRun run(Graph(1));
+
+    BOOST_CHECK_THROW(tasks.add("texturepack", boost::bind(&TaskRun::runTask, &run, 0, 0, NO_FAILURE), "art"), Exception);
+    tasks.add("art", boost::bind(&TaskRun::runTask, &run, 0, 0, NO_FAILURE));
+    BOOST_CHECK_THROW(tasks.add("art", boost::bind(&TaskRun::runTask, &run, 0, 0, NO_FAILURE)), Exception);
+    tasks.add("texturepack", boost::bind(&TaskRun::runTask, &run, 0, 0, NO_FAILURE), "art");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
@@ -0,0 +1,118 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include "testhelpers.hpp"
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/bind.hpp>
+
+#include <data/ioscheduler.hpp>
+
+#include <misc/exception.hpp>
+
+namespace fluo {
+namespace tests {
+
+boost::filesystem::path getTestDirectory(const std::string& name) {
+    boost::filesystem::path ret = boost::filesystem::path("fluo-tests-data") / name;
+    boost::filesystem::remove_all(ret);
+    boost::filesystem::create_directories(ret);
+    return ret;
+}
+
+void writeFile(const boost::filesystem::path& path, const std::vector<int8_t>& data) {
+    boost::filesystem::ofstream stream(path, std::ios_base::binary | std::ios_base::trunc);
+    if (!data.empty()) {
+        stream.write(reinterpret_cast<const char*>(&data[0]), data.size());
+    }
+
+    if (!stream.good()) {
+        throw Exception("Unable to write test file");
+    }
+}
+SchedulerBlocker::SchedulerBlocker() : released_(false), blockedCount_(0) {
+}
+
+SchedulerBlocker::~SchedulerBlocker() {
+    release();
+}
+
+bool SchedulerBlocker::blockReads(unsigned int threadCount) {
+    unsigned int expected;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        expected = blockedCount_ + threadCount;
+    }
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        data::IoScheduler::getSingleton()->enqueueRead(this, boost::bind(&SchedulerBlocker::block, this), data::LoadPriority::VISIBLE);
+    }
+    return waitForBlocked(expected);
+}
+
+bool SchedulerBlocker::blockDecodes(unsigned int threadCount) {
+    unsigned int expected;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        expected = blockedCount_ + threadCount;
+    }
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        data::IoScheduler::getSingleton()->enqueueDecode(this, boost::bind(&SchedulerBlocker::block, this), data::LoadPriority::VISIBLE);
+    }
+    return waitForBlocked(expected);
+}
+
+void SchedulerBlocker::release() {
+    boost::mutex::scoped_lock lock(mutex_);
+    released_ = true;
+    signal_.notify_all();
+    while (blockedCount_ > 0) {
+        signal_.wait(lock);
+    }
+}
+
+bool SchedulerBlocker::waitForBlocked(unsigned int count) {
+    boost::system_time timeout = boost::get_system_time() + boost::posix_time::milliseconds(ITEM_TIMEOUT_MILLIS);
+
+    boost::mutex::scoped_lock lock(mutex_);
+    while (blockedCount_ < count) {
+        if (!signal_.timed_wait(lock, timeout)) {
+            return blockedCount_ >= count;
+        }
+    }
+    return true;
+}
+
+void SchedulerBlocker::block() {
+    boost::mutex::scoped_lock lock(mutex_);
+    ++blockedCount_;
+    signal_.notify_all();
+    while (!released_) {
+        signal_.wait(lock);
+    }
+    --blockedCount_;
+    signal_.notify_all();
+}
+
+}
+}
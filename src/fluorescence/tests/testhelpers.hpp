@@ -0,0 +1,95 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+#ifndef FLUO_TESTS_TESTHELPERS_HPP
+#define FLUO_TESTS_TESTHELPERS_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <data/completionqueue.hpp>
+
+namespace fluo {
+namespace tests {
+
+/// Threads of the shared IoScheduler, created by the global fixture
+const unsigned int IO_THREAD_COUNT = 2;
+const unsigned int DECODE_THREAD_COUNT = 4;
+
+/// An empty directory below the working directory, removed and created again on every call
+boost::filesystem::path getTestDirectory(const std::string& name);
+
+void writeFile(const boost::filesystem::path& path, const std::vector<int8_t>& data);
+
+// reading a broken file might never complete
+const unsigned int ITEM_TIMEOUT_MILLIS = 10000;
+
+/// Waits until the item is read or failed, running the complete listeners like the main loop does
+template<typename T>
+bool waitForItem(const boost::shared_ptr<T>& item) {
+    for (unsigned int i = 0; i < ITEM_TIMEOUT_MILLIS && !item->isReadComplete() && !item->isReadFailed(); ++i) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+
+    data::CompletionQueue::getSingleton()->drain();
+    return item->isReadComplete();
+}
+
+/**
+ * \brief Occupies threads of the shared IoScheduler until release is called
+ *
+ * Used to queue up jobs and to control how many threads are left to work on them. Nothing else may be queued when
+ * blocking, the blocking jobs would wait behind it. Can not block again after release
+ */
+class SchedulerBlocker {
+public:
+    SchedulerBlocker();
+    ~SchedulerBlocker();
+
+    /// Returns once threadCount io threads are blocked, false if that did not happen within ITEM_TIMEOUT_MILLIS
+    bool blockReads(unsigned int threadCount);
+    /// Returns once threadCount decode threads are blocked, false if that did not happen within ITEM_TIMEOUT_MILLIS
+    bool blockDecodes(unsigned int threadCount);
+
+    /// Returns once all blocked threads are free again
+    void release();
+
+private:
+    boost::mutex mutex_;
+    boost::condition_variable signal_;
+    bool released_;
+    unsigned int blockedCount_;
+
+    bool waitForBlocked(unsigned int count);
+    void block();
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <data/maptexloader.hpp>
+#include <data/texturepack.hpp>
+#include <data/util.hpp>
+#include <packer/texturepacker.hpp>
+#include <misc/exception.hpp>
+
+#include "testhelpers.hpp"
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+const uint64_t SOURCE_HASH[data::TexturePack::Source::COUNT] = { 0x1234u, 0x5678u };
+
+/// Width of the textures in the test texmaps.mul. 0 is an entry that is too short to be read
+const unsigned int TEXTURE_WIDTHS[] = { 64, 128, 64, 0, 128 };
+const unsigned int TEXTURE_COUNT = sizeof(TEXTURE_WIDTHS) / sizeof(TEXTURE_WIDTHS[0]);
+
+uint16_t getTexmapColor(unsigned int id, unsigned int x, unsigned int y) {
+    return ((x + y + id) % 11 == 0) ? 0 : ((x * 0x21 + y * 0x403 + id * 0x1111) & 0xFFFF);
+}
+
+boost::shared_ptr<data::MapTexLoader> createLoader(const boost::filesystem::path& directory) {
+    std::vector<int8_t> idx;
+    std::vector<int8_t> mul;
+    for (unsigned int id = 0; id < TEXTURE_COUNT; ++id) {
+        unsigned int width = TEXTURE_WIDTHS[id];
+        std::vector<uint16_t> texture(width == 0 ? 50 : width * width);
+        // stored column by column
+        for (unsigned int x = 0; x < width; ++x) {
+            for (unsigned int y = 0; y < width; ++y) {
+                texture[(x * width) + y] = getTexmapColor(id, x, y);
+            }
+        }
+
+        uint32_t block[3] = { static_cast<uint32_t>(mul.size()), static_cast<uint32_t>(texture.size() * 2), width == 128 ? 1u : 0u };
+        idx.insert(idx.end(), reinterpret_cast<int8_t*>(block), reinterpret_cast<int8_t*>(block) + sizeof(block));
+        mul.insert(mul.end(), reinterpret_cast<int8_t*>(&texture[0]), reinterpret_cast<int8_t*>(&texture[0]) + texture.size() * 2);
+    }
+
+    writeFile(directory / "texidx.mul", idx);
+    writeFile(directory / "texmaps.mul", mul);
+
+    return boost::shared_ptr<data::MapTexLoader>(new data::MapTexLoader(directory / "texidx.mul", directory / "texmaps.mul"));
+}
+
+boost::filesystem::path createPack(const boost::filesystem::path& directory) {
+    boost::filesystem::path path = directory / "textures.fpk";
+
+    std::vector<unsigned int> ids;
+    for (unsigned int id = 0; id < TEXTURE_COUNT; ++id) {
+        ids.push_back(id);
+    }
+
+    packer::TexturePacker packer(path, SOURCE_HASH, boost::shared_ptr<data::ArtLoader>(), createLoader(directory));
+    packer.addGroup("texmaps", data::TexturePack::Source::TEXMAP, ids, true);
+    packer.finish();
+
+    return path;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(texturepack)
+
+BOOST_AUTO_TEST_CASE(packed_textures_match_source) {
+    boost::shared_ptr<data::TexturePack> pack(new data::TexturePack(createPack(getTestDirectory("texturepack-roundtrip")), SOURCE_HASH));
+    const data::TexturePack::Header& header = pack->getHeader();
+    std::vector<uint32_t> pixels(header.pageWidth_ * header.pageHeight_);
+
+    for (unsigned int id = 0; id < TEXTURE_COUNT; ++id) {
+        const data::TexturePack::Entry* entry = pack->getEntry(data::TexturePack::Source::TEXMAP, id);
+        unsigned int width = TEXTURE_WIDTHS[id];
+        if (width == 0) {
+            BOOST_CHECK(!entry);
+            continue;
+        }
+
+        BOOST_REQUIRE(entry);
+        BOOST_CHECK_EQUAL(entry->width_, width);
+        BOOST_CHECK_EQUAL(entry->height_, width);
+        BOOST_REQUIRE_EQUAL(entry->borderWidth_, 1u);
+        BOOST_REQUIRE(entry->x_ + width + 1 <= header.pageWidth_ && entry->y_ + width + 1 <= header.pageHeight_);
+        BOOST_REQUIRE(pack->readPage(entry->page_, &pixels[0]));
+
+        // the border repeats the edge pixels
+        unsigned int errorCount = 0;
+        for (int y = -1; y <= static_cast<int>(width); ++y) {
+            for (int x = -1; x <= static_cast<int>(width); ++x) {
+                unsigned int srcX = (std::min)((std::max)(x, 0), static_cast<int>(width) - 1);
+                unsigned int srcY = (std::min)((std::max)(y, 0), static_cast<int>(width) - 1);
+                uint32_t expected = data::Util::getColorRGBA(getTexmapColor(id, srcX, srcY));
+                uint32_t packed = pixels[(entry->y_ + y) * header.pageWidth_ + entry->x_ + x];
+                if (packed != expected && errorCount++ == 0) {
+                    BOOST_ERROR("Texture " << id << " pixel " << x << "/" << y << " differs: " << std::hex << packed << " != " << expected);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(packed_textures_do_not_overlap) {
+    boost::shared_ptr<data::TexturePack> pack(new data::TexturePack(createPack(getTestDirectory("texturepack-overlap")), SOURCE_HASH));
+
+    for (unsigned int id = 0; id < TEXTURE_COUNT; ++id) {
+        const data::TexturePack::Entry* a = pack->getEntry(data::TexturePack::Source::TEXMAP, id);
+        for (unsigned int other = id + 1; a && other < TEXTURE_COUNT; ++other) {
+            const data::TexturePack::Entry* b = pack->getEntry(data::TexturePack::Source::TEXMAP, other);
+            if (b && a->page_ == b->page_) {
+                // including the borders
+                bool separateX = a->x_ + a->width_ + a->borderWidth_ <= b->x_ - b->borderWidth_ ||
+                        b->x_ + b->width_ + b->borderWidth_ <= a->x_ - a->borderWidth_;
+                bool separateY = a->y_ + a->height_ + a->borderWidth_ <= b->y_ - b->borderWidth_ ||
+                        b->y_ + b->height_ + b->borderWidth_ <= a->y_ - a->borderWidth_;
+                BOOST_CHECK_MESSAGE(separateX || separateY, "Textures " << id << " and " << other << " overlap");
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pack_of_other_data_files_is_rejected) {
+    boost::filesystem::path path = createPack(getTestDirectory("texturepack-hash"));
+
+    uint64_t otherHash[data::TexturePack::Source::COUNT] = { SOURCE_HASH[0], SOURCE_HASH[1] + 1 };
+    BOOST_CHECK_THROW(data::TexturePack rejected(path, otherHash), Exception);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
@@ -0,0 +1,246 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem/path.hpp>
+
+#include <string>
+#include <vector>
+
+#include <string.h>
+
+#include <data/tiledataloader.hpp>
+
+#include "testhelpers.hpp"
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+class Random {
+public:
+    Random() : state_(1997) {
+    }
+
+    unsigned int next(unsigned int max) {
+        state_ = state_ * 1103515245u + 12345u;
+        return (state_ >> 16) % max;
+    }
+
+    uint8_t nextByte() {
+        return next(256);
+    }
+
+private:
+    uint32_t state_;
+};
+
+struct ReferenceLandTile {
+    uint32_t flags_;
+    uint16_t textureId_;
+    UnicodeString name_;
+};
+
+struct ReferenceStaticTile {
+    uint32_t flags_;
+    uint8_t weight_;
+    uint8_t quality_;
+    uint16_t unknown1_;
+    uint8_t unknown2_;
+    uint8_t quantity_;
+    uint16_t animId_;
+    uint8_t unknown3_;
+    uint8_t hue_;
+    uint8_t unknown4_;
+    uint8_t unknown5_;
+    uint8_t height_;
+    UnicodeString name_;
+};
+
+template<typename T>
+T readValue(const int8_t*& ptr) {
+    T ret;
+    memcpy(&ret, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return ret;
+}
+
+/// TileDataLoader::read before the tiles were stored in parallel arrays
+void readReference(const std::vector<int8_t>& file, bool highSeasFormat,
+        std::vector<ReferenceLandTile>& landTiles, std::vector<ReferenceStaticTile>& staticTiles) {
+    const int8_t* buf = &file[0];
+    const int8_t* ptr = buf;
+
+    landTiles.resize(data::TileDataLoader::LAND_TILE_COUNT);
+    for (unsigned int i = 0; i < landTiles.size(); ++i) {
+        // jump header
+        if ((i % 32) == 0) {
+            ptr += 4;
+        }
+
+        landTiles[i].flags_ = readValue<uint32_t>(ptr);
+        ptr += highSeasFormat ? 4 : 0;
+        landTiles[i].textureId_ = readValue<uint16_t>(ptr);
+        landTiles[i].name_ = StringConverter::fromUtf8(reinterpret_cast<const char*>(ptr), 20);
+        ptr += 20;
+    }
+
+    unsigned int blockSize = highSeasFormat ? 1316 : 1188;
+    staticTiles.resize(((file.size() - (ptr - buf)) / blockSize) * 32);
+    for (unsigned int i = 0; i < staticTiles.size(); ++i) {
+        if ((i % 32) == 0) {
+            ptr += 4;
+        }
+
+        ReferenceStaticTile& tile = staticTiles[i];
+        tile.flags_ = readValue<uint32_t>(ptr);
+        ptr += highSeasFormat ? 4 : 0;
+        tile.weight_ = readValue<uint8_t>(ptr);
+        tile.quality_ = readValue<uint8_t>(ptr);
+        tile.unknown1_ = readValue<uint16_t>(ptr);
+        tile.unknown2_ = readValue<uint8_t>(ptr);
+        tile.quantity_ = readValue<uint8_t>(ptr);
+        tile.animId_ = readValue<uint16_t>(ptr);
+        tile.unknown3_ = readValue<uint8_t>(ptr);
+        tile.hue_ = readValue<uint8_t>(ptr);
+        tile.unknown4_ = readValue<uint8_t>(ptr);
+        tile.unknown5_ = readValue<uint8_t>(ptr);
+        tile.height_ = readValue<uint8_t>(ptr);
+        tile.name_ = StringConverter::fromUtf8(reinterpret_cast<const char*>(ptr), 20);
+        ptr += 20;
+    }
+}
+
+const char* const NAMES[] = {
+    "", "grass", "a stone wall", "twenty letters name!", "Stäbe und Äxte", "abc\0garbage after it",
+};
+
+void appendRandom(std::vector<int8_t>& file, Random& random, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        file.push_back(random.nextByte());
+    }
+}
+
+void appendName(std::vector<int8_t>& file, Random& random) {
+    const unsigned int nameCount = sizeof(NAMES) / sizeof(NAMES[0]);
+    unsigned int nameIdx = random.next(nameCount);
+
+    // the name with the garbage after the terminator has to be copied with its full length
+    char name[20];
+    memset(name, 0, sizeof(name));
+    memcpy(name, NAMES[nameIdx], nameIdx == nameCount - 1 ? 20 : strlen(NAMES[nameIdx]));
+    file.insert(file.end(), name, name + 20);
+}
+
+/// Random values in every field, and a few bytes of an incomplete static block at the end
+std::vector<int8_t> createTileData(Random& random, bool highSeasFormat, unsigned int staticBlockCount) {
+    std::vector<int8_t> file;
+    unsigned int flagsSize = highSeasFormat ? 8 : 4;
+
+    for (unsigned int i = 0; i < data::TileDataLoader::LAND_TILE_COUNT; ++i) {
+        if ((i % 32) == 0) {
+            appendRandom(file, random, 4);
+        }
+        appendRandom(file, random, flagsSize + 2);
+        appendName(file, random);
+    }
+
+    for (unsigned int i = 0; i < staticBlockCount * 32; ++i) {
+        if ((i % 32) == 0) {
+            appendRandom(file, random, 4);
+        }
+        appendRandom(file, random, flagsSize + 13);
+        appendName(file, random);
+    }
+
+    appendRandom(file, random, random.next(100));
+    return file;
+}
+
+void checkParity(bool highSeasFormat) {
+    Random random;
+    std::vector<int8_t> file = createTileData(random, highSeasFormat, 40);
+
+    boost::filesystem::path path = getTestDirectory("tiledataloader") / "tiledata.mul";
+    writeFile(path, file);
+    data::TileDataLoader loader(path, highSeasFormat);
+
+    std::vector<ReferenceLandTile> landTiles;
+    std::vector<ReferenceStaticTile> staticTiles;
+    readReference(file, highSeasFormat, landTiles, staticTiles);
+
+    BOOST_REQUIRE_EQUAL(loader.getLandTileCount(), landTiles.size());
+    for (unsigned int i = 0; i < landTiles.size(); ++i) {
+        data::LandTileInfo info = loader.getLandTileInfo(i);
+        BOOST_REQUIRE_EQUAL(info.flags(), landTiles[i].flags_);
+        BOOST_REQUIRE_EQUAL(info.textureId(), landTiles[i].textureId_);
+        BOOST_REQUIRE(info.name() == landTiles[i].name_);
+
+        // every flag getter reads its own bit
+        BOOST_REQUIRE_EQUAL(info.background(), (landTiles[i].flags_ & 0x00000001) != 0);
+        BOOST_REQUIRE_EQUAL(info.stairRight(), (landTiles[i].flags_ & 0x80000000) != 0);
+    }
+
+    BOOST_REQUIRE_EQUAL(loader.getStaticTileCount(), staticTiles.size());
+    for (unsigned int i = 0; i < staticTiles.size(); ++i) {
+        data::StaticTileInfo info = loader.getStaticTileInfo(i);
+        const ReferenceStaticTile& expected = staticTiles[i];
+        BOOST_REQUIRE_EQUAL(info.flags(), expected.flags_);
+        BOOST_REQUIRE_EQUAL(info.height(), expected.height_);
+        BOOST_REQUIRE_EQUAL(info.animId(), expected.animId_);
+        BOOST_REQUIRE(info.name() == expected.name_);
+
+        const data::StaticTileDetails& details = info.details();
+        BOOST_REQUIRE_EQUAL(details.weight_, expected.weight_);
+        BOOST_REQUIRE_EQUAL(details.quality_, expected.quality_);
+        BOOST_REQUIRE_EQUAL(details.unknown1_, expected.unknown1_);
+        BOOST_REQUIRE_EQUAL(details.unknown2_, expected.unknown2_);
+        BOOST_REQUIRE_EQUAL(details.quantity_, expected.quantity_);
+        BOOST_REQUIRE_EQUAL(details.unknown3_, expected.unknown3_);
+        BOOST_REQUIRE_EQUAL(details.hue_, expected.hue_);
+        BOOST_REQUIRE_EQUAL(details.unknown4_, expected.unknown4_);
+        BOOST_REQUIRE_EQUAL(details.unknown5_, expected.unknown5_);
+
+        BOOST_REQUIRE_EQUAL(info.impassable(), (expected.flags_ & 0x00000040) != 0);
+        BOOST_REQUIRE_EQUAL(info.door(), (expected.flags_ & 0x20000000) != 0);
+    }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(tiledataloader)
+
+BOOST_AUTO_TEST_CASE(fields_match_struct_loader) {
+    checkParity(false);
+}
+
+BOOST_AUTO_TEST_CASE(high_seas_fields_match_struct_loader) {
+    checkParity(true);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
@@ -0,0 +1,312 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem/path.hpp>
+
+#include <map>
+#include <vector>
+
+#include <data/unifontloader.hpp>
+
+#include "testhelpers.hpp"
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+const unsigned int OFFSET_TABLE_SIZE = 0x40000;
+
+const uint32_t TEXT = 1;
+const uint32_t BORDER = 2;
+
+class Random {
+public:
+    Random() : state_(4711) {
+    }
+
+    unsigned int next(unsigned int max) {
+        state_ = state_ * 1103515245u + 12345u;
+        return (state_ >> 16) % max;
+    }
+
+private:
+    uint32_t state_;
+};
+
+struct Glyph {
+    int xOffset_;
+    int yOffset_;
+    unsigned int width_;
+    unsigned int height_;
+    std::vector<uint8_t> pixels_; ///< 1 for set pixels, line by line
+};
+
+typedef std::map<unsigned int, Glyph> GlyphMap;
+
+Glyph randomGlyph(Random& random, unsigned int maxSize) {
+    Glyph ret;
+    ret.xOffset_ = random.next(4);
+    ret.yOffset_ = random.next(7);
+    ret.width_ = 1 + random.next(maxSize);
+    ret.height_ = 1 + random.next(maxSize);
+    ret.pixels_.resize(ret.width_ * ret.height_);
+    for (unsigned int i = 0; i < ret.pixels_.size(); ++i) {
+        ret.pixels_[i] = random.next(5) < 2 ? 1 : 0;
+    }
+    return ret;
+}
+
+void appendUint32(std::vector<int8_t>& file, unsigned int pos, uint32_t value) {
+    for (unsigned int i = 0; i < 4; ++i) {
+        file[pos + i] = (value >> (i * 8)) & 0xFF;
+    }
+}
+
+/// Header and one bit per pixel, each line starts at a new byte
+void appendGlyph(std::vector<int8_t>& file, const Glyph& glyph) {
+    file.push_back(glyph.xOffset_);
+    file.push_back(glyph.yOffset_);
+    file.push_back(glyph.width_);
+    file.push_back(glyph.height_);
+
+    unsigned int lineWidth = (glyph.width_ - 1) / 8 + 1;
+    for (unsigned int y = 0; y < glyph.height_; ++y) {
+        std::vector<uint8_t> line(lineWidth, 0);
+        for (unsigned int x = 0; x < glyph.width_; ++x) {
+            if (glyph.pixels_[y * glyph.width_ + x]) {
+                line[x / 8] |= 0x80 >> (x % 8);
+            }
+        }
+        file.insert(file.end(), line.begin(), line.end());
+    }
+}
+
+std::vector<int8_t> createFont(const GlyphMap& glyphs) {
+    std::vector<int8_t> file(OFFSET_TABLE_SIZE, 0);
+    for (GlyphMap::const_iterator iter = glyphs.begin(); iter != glyphs.end(); ++iter) {
+        appendUint32(file, iter->first * 4, file.size());
+        appendGlyph(file, iter->second);
+    }
+    return file;
+}
+
+class Canvas {
+public:
+    Canvas(unsigned int width, unsigned int height) : width_(width), height_(height), pixels_(width * height, 0) {
+    }
+
+    void set(int x, int y, uint32_t value) {
+        BOOST_REQUIRE(x >= 0 && x < (int)width_ && y >= 0 && y < (int)height_);
+        pixels_[y * width_ + x] = value;
+    }
+
+    unsigned int width_;
+    unsigned int height_;
+    std::vector<uint32_t> pixels_;
+};
+
+/// The border the way UoFontProvider drew it before it was stored in the atlas: each glyph shifted into all directions
+void drawReference(Canvas& canvas, const GlyphMap& glyphs, const std::vector<unsigned int>& text, unsigned int spaceWidth) {
+    for (unsigned int pass = 0; pass < 2; ++pass) {
+        int curX = 1;
+        for (unsigned int i = 0; i < text.size(); ++i) {
+            const Glyph& glyph = glyphs.find(text[i])->second;
+            int border = pass == 0 ? 1 : 0;
+            for (int offY = -border; offY <= border; ++offY) {
+                for (int offX = -border; offX <= border; ++offX) {
+                    for (unsigned int y = 0; y < glyph.height_; ++y) {
+                        for (unsigned int x = 0; x < glyph.width_; ++x) {
+                            if (glyph.pixels_[y * glyph.width_ + x]) {
+                                canvas.set(curX + glyph.xOffset_ + x + offX, 1 + glyph.yOffset_ + y + offY, pass == 0 ? BORDER : TEXT);
+                            }
+                        }
+                    }
+                }
+            }
+            curX += glyph.xOffset_ + glyph.width_ + spaceWidth;
+        }
+    }
+}
+
+/// Like UoFontProvider draws it now: one quad for the border and one for the glyph, textured from the atlas
+void drawFromAtlas(Canvas& canvas, data::UniFontLoader& loader, const std::vector<unsigned int>& text, unsigned int spaceWidth) {
+    int border = data::UniFontLoader::ATLAS_BORDER_WIDTH;
+    for (unsigned int pass = 0; pass < 2; ++pass) {
+        int padding = pass == 0 ? border : 0;
+        int curX = 1;
+        for (unsigned int i = 0; i < text.size(); ++i) {
+            const data::UnicodeCharacter* character = loader.getCharacter(text[i]);
+            BOOST_REQUIRE(character);
+            const uint8_t* page = loader.getAtlasPageData(character->atlasPage_);
+            for (int y = -padding; y < (int)character->height_ + padding; ++y) {
+                for (int x = -padding; x < (int)character->width_ + padding; ++x) {
+                    uint8_t value = page[(character->atlasY_ + y) * data::UniFontLoader::ATLAS_WIDTH + character->atlasX_ + x];
+                    if (pass == 0 && value != 0) {
+                        canvas.set(curX + character->xOffset_ + x, 1 + character->yOffset_ + y, BORDER);
+                    } else if (pass == 1 && value == data::UniFontLoader::ATLAS_GLYPH) {
+                        canvas.set(curX + character->xOffset_ + x, 1 + character->yOffset_ + y, TEXT);
+                    }
+                }
+            }
+            curX += character->getTotalWidth() + spaceWidth;
+        }
+    }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(unifontloader)
+
+BOOST_AUTO_TEST_CASE(atlas_border_matches_shifted_glyphs) {
+    Random random;
+    GlyphMap glyphs;
+    for (unsigned int i = 'A'; i <= 'z'; ++i) {
+        glyphs[i] = randomGlyph(random, 16);
+    }
+    // a full glyph has a border only around it
+    Glyph full = randomGlyph(random, 16);
+    full.pixels_.assign(full.pixels_.size(), 1);
+    glyphs['#'] = full;
+
+    boost::filesystem::path path = getTestDirectory("unifontloader") / "unifont.mul";
+    writeFile(path, createFont(glyphs));
+    data::UniFontLoader loader(path);
+
+    for (unsigned int round = 0; round < 50; ++round) {
+        std::vector<unsigned int> text;
+        unsigned int length = 1 + random.next(20);
+        for (unsigned int i = 0; i < length; ++i) {
+            text.push_back(random.next(8) == 0 ? '#' : 'A' + random.next('z' - 'A' + 1));
+        }
+
+        Canvas reference(length * 24 + 2, 26);
+        drawReference(reference, glyphs, text, 1);
+        Canvas atlas(reference.width_, reference.height_);
+        drawFromAtlas(atlas, loader, text, 1);
+
+        BOOST_REQUIRE(reference.pixels_ == atlas.pixels_);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(full_atlas_page_starts_a_new_one) {
+    Random random;
+    GlyphMap glyphs;
+    for (unsigned int i = 0x1000; i < 0x1000 + 1500; ++i) {
+        glyphs[i] = randomGlyph(random, 24);
+    }
+
+    boost::filesystem::path path = getTestDirectory("unifontloader") / "unifont.mul";
+    writeFile(path, createFont(glyphs));
+    data::UniFontLoader loader(path);
+
+    for (GlyphMap::const_iterator iter = glyphs.begin(); iter != glyphs.end(); ++iter) {
+        const data::UnicodeCharacter* character = loader.getCharacter(iter->first);
+        BOOST_REQUIRE(character);
+        BOOST_REQUIRE(character->atlasX_ >= 1 && character->atlasX_ + character->width_ + 1 <= data::UniFontLoader::ATLAS_WIDTH);
+        BOOST_REQUIRE(character->atlasY_ >= 1 && character->atlasY_ + character->height_ + 1 <= data::UniFontLoader::ATLAS_PAGE_HEIGHT);
+    }
+    BOOST_CHECK_GT(loader.getAtlasPageCount(), 2u);
+
+    // no character was overwritten by a later one
+    for (GlyphMap::const_iterator iter = glyphs.begin(); iter != glyphs.end(); ++iter) {
+        const data::UnicodeCharacter* character = loader.getCharacter(iter->first);
+        const uint8_t* page = loader.getAtlasPageData(character->atlasPage_);
+        for (unsigned int y = 0; y < character->height_; ++y) {
+            for (unsigned int x = 0; x < character->width_; ++x) {
+                bool set = page[(character->atlasY_ + y) * data::UniFontLoader::ATLAS_WIDTH + character->atlasX_ + x] == data::UniFontLoader::ATLAS_GLYPH;
+                BOOST_REQUIRE_EQUAL(set, iter->second.pixels_[y * character->width_ + x] == 1);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(short_file_has_no_characters_past_the_table) {
+    Random random;
+    Glyph glyph = randomGlyph(random, 8);
+
+    // offsets for the first 0x100 characters, followed by the glyph
+    std::vector<int8_t> file(0x400, 0);
+    appendUint32(file, 'A' * 4, file.size());
+    appendGlyph(file, glyph);
+
+    boost::filesystem::path path = getTestDirectory("unifontloader") / "unifont.mul";
+    writeFile(path, file);
+    data::UniFontLoader loader(path);
+
+    const data::UnicodeCharacter* character = loader.getCharacter('A');
+    BOOST_REQUIRE(character);
+    BOOST_CHECK_EQUAL(character->width_, glyph.width_);
+    BOOST_CHECK_EQUAL(character->height_, glyph.height_);
+
+    // the glyph data is read as offsets of characters past 0x100
+    for (unsigned int i = 0x100; i < 0x10000; ++i) {
+        BOOST_CHECK(!loader.getCharacter(i));
+    }
+
+    writeFile(path, std::vector<int8_t>());
+    data::UniFontLoader emptyLoader(path);
+    BOOST_CHECK(!emptyLoader.getCharacter('A'));
+    BOOST_CHECK(emptyLoader.getCharacter(' '));
+}
+
+BOOST_AUTO_TEST_CASE(offsets_past_the_end_are_not_available) {
+    Random random;
+    Glyph glyph = randomGlyph(random, 8);
+    glyph.width_ = 9;
+    glyph.height_ = 4;
+    glyph.pixels_.assign(9 * 4, 1);
+
+    std::vector<int8_t> file(OFFSET_TABLE_SIZE, 0);
+    appendUint32(file, 'A' * 4, file.size());
+    appendGlyph(file, glyph);
+    // only one of the pixel lines, the header after it does not make up for the others
+    appendUint32(file, 'B' * 4, file.size());
+    appendGlyph(file, glyph);
+    file.resize(file.size() - 6);
+    // a header without pixels
+    int8_t header[4] = { 0, 0, 8, 2 };
+    file.insert(file.end(), header, header + 4);
+
+    appendUint32(file, 'C' * 4, file.size() - 4);
+    appendUint32(file, 'D' * 4, file.size() - 3);
+    appendUint32(file, 'E' * 4, file.size());
+    appendUint32(file, 'F' * 4, 0xFFFFFFFFu);
+    appendUint32(file, 'G' * 4, 0xFFFFFFFDu);
+
+    boost::filesystem::path path = getTestDirectory("unifontloader") / "unifont.mul";
+    writeFile(path, file);
+    data::UniFontLoader loader(path);
+
+    BOOST_CHECK(loader.getCharacter('A'));
+    for (unsigned int i = 'B'; i <= 'G'; ++i) {
+        BOOST_CHECK(!loader.getCharacter(i));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
@@ -0,0 +1,330 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include <data/fixedsizeondemandfileloader.hpp>
+#include <data/indexedondemandfileloader.hpp>
+#include <data/ondemandreadable.hpp>
+#include <data/uopfile.hpp>
+
+#include "testhelpers.hpp"
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+class FileItem : public data::OnDemandReadable<FileItem> {
+public:
+    FileItem() : extra_(0) {
+    }
+
+    std::vector<int8_t> data_;
+    unsigned int extra_;
+};
+
+void readItem(unsigned int index, int8_t* buf, unsigned int len, boost::shared_ptr<FileItem> item, unsigned int extra, unsigned int userData) {
+    item->data_.assign(buf, buf + len);
+    item->extra_ = extra;
+}
+
+/// Deterministic, so that a failure can be reproduced
+class Random {
+public:
+    Random() : state_(1701) {
+    }
+
+    unsigned int next(unsigned int max) {
+        state_ = state_ * 1103515245u + 12345u;
+        return (state_ >> 16) % max;
+    }
+
+private:
+    uint32_t state_;
+};
+
+template<typename T>
+void appendValue(std::vector<int8_t>& file, T value) {
+    const int8_t* bytes = reinterpret_cast<const int8_t*>(&value);
+    file.insert(file.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+void setValue(std::vector<int8_t>& file, unsigned int offset, T value) {
+    const int8_t* bytes = reinterpret_cast<const int8_t*>(&value);
+    std::copy(bytes, bytes + sizeof(T), file.begin() + offset);
+}
+
+std::string entryName(const char* directory, unsigned int id, const char* extension) {
+    char idStr[16];
+    snprintf(idStr, 16, "%08u", id);
+    return std::string("build/") + directory + "/" + idStr + extension;
+}
+
+struct UopEntry {
+    std::string name_;
+    std::vector<int8_t> data_;
+    bool compressed_;
+};
+
+/**
+ * Writes the entries in random order, into chained tables of tableCapacity slots. Every entry has a data header of
+ * random length in front of it, the last table has unused slots
+ */
+void writeUop(const boost::filesystem::path& path, std::vector<UopEntry> entries, unsigned int tableCapacity, Random& random) {
+    for (unsigned int i = entries.size(); i > 1; --i) {
+        std::swap(entries[i - 1], entries[random.next(i)]);
+    }
+
+    std::vector<int8_t> file;
+    appendValue<uint32_t>(file, data::UopFile::MAGIC);
+    appendValue<uint32_t>(file, 5); // version
+    appendValue<uint32_t>(file, 0xFD23EC43u); // signature
+    unsigned int nextTablePosition = file.size();
+    appendValue<uint64_t>(file, 0);
+    appendValue<uint32_t>(file, tableCapacity);
+    appendValue<uint32_t>(file, entries.size());
+    file.resize(file.size() + 12, 0);
+
+    for (unsigned int tableStart = 0; tableStart < entries.size(); tableStart += tableCapacity) {
+        setValue<uint64_t>(file, nextTablePosition, file.size());
+        appendValue<uint32_t>(file, tableCapacity);
+        nextTablePosition = file.size();
+        appendValue<uint64_t>(file, 0);
+
+        unsigned int slotPosition = file.size();
+        // offset, header length, compressed length, decompressed length, hash, adler32, compression
+        const unsigned int slotSize = 8 + 4 + 4 + 4 + 8 + 4 + 2;
+        file.resize(file.size() + tableCapacity * slotSize, 0);
+
+        for (unsigned int i = tableStart; i < entries.size() && i < tableStart + tableCapacity; ++i) {
+            const UopEntry& entry = entries[i];
+
+            std::vector<int8_t> stored = entry.data_;
+            if (entry.compressed_) {
+                uLongf compressedLength = compressBound(entry.data_.size());
+                stored.resize(compressedLength);
+                BOOST_REQUIRE_EQUAL(compress2(reinterpret_cast<Bytef*>(&stored[0]), &compressedLength,
+                        reinterpret_cast<const Bytef*>(&entry.data_[0]), entry.data_.size(), 9), Z_OK);
+                stored.resize(compressedLength);
+            }
+
+            uint64_t headerOffset = file.size();
+            uint32_t headerLength = random.next(3) * 4;
+            for (unsigned int j = 0; j < headerLength; ++j) {
+                file.push_back(random.next(256));
+            }
+            file.insert(file.end(), stored.begin(), stored.end());
+
+            setValue<uint64_t>(file, slotPosition, headerOffset);
+            setValue<uint32_t>(file, slotPosition + 8, headerLength);
+            setValue<uint32_t>(file, slotPosition + 12, stored.size());
+            setValue<uint32_t>(file, slotPosition + 16, entry.data_.size());
+            setValue<uint64_t>(file, slotPosition + 20, data::UopFile::hashName(entry.name_));
+            setValue<uint32_t>(file, slotPosition + 28, adler32(1, reinterpret_cast<const Bytef*>(&stored[0]), stored.size()));
+            setValue<uint16_t>(file, slotPosition + 32, entry.compressed_ ? data::UopFile::Compression::ZLIB : data::UopFile::Compression::NONE);
+            slotPosition += slotSize;
+        }
+    }
+
+    writeFile(path, file);
+}
+
+/**
+ * Sparse ids with data that compresses a little. With gump art, width and height are stored in the idx extra of the
+ * mul and in front of the data in the uop
+ */
+void createIndexedFiles(const boost::filesystem::path& directory, const char* uopName, const char* uopDirectory, bool gumps,
+        unsigned int idCount, std::vector<std::vector<int8_t> >& expectedData, std::vector<uint32_t>& expectedExtra) {
+    Random random;
+    std::vector<int8_t> idx;
+    std::vector<int8_t> mul;
+    std::vector<UopEntry> uopEntries;
+
+    expectedData.resize(idCount);
+    expectedExtra.resize(idCount, 0);
+    for (unsigned int id = 0; id < idCount; ++id) {
+        // the uop index ends with the last entry, as does the idx of a real client
+        if (id + 1 < idCount && random.next(4) != 0) {
+            appendValue<uint32_t>(idx, 0xFFFFFFFFu);
+            appendValue<uint32_t>(idx, 0);
+            appendValue<uint32_t>(idx, 0);
+            continue;
+        }
+
+        std::vector<int8_t>& data = expectedData[id];
+        data.resize(1 + random.next(3000));
+        for (unsigned int i = 0; i < data.size(); ++i) {
+            data[i] = random.next(4) == 0 ? random.next(256) : 0x20;
+        }
+
+        UopEntry entry;
+        entry.name_ = entryName(uopDirectory, id, ".tga");
+        entry.compressed_ = false;
+        if (gumps) {
+            uint32_t width = 1 + random.next(640);
+            uint32_t height = 1 + random.next(480);
+            expectedExtra[id] = (width << 16) | height;
+            appendValue<uint32_t>(entry.data_, width);
+            appendValue<uint32_t>(entry.data_, height);
+        } else {
+            entry.compressed_ = random.next(2) == 0;
+        }
+        entry.data_.insert(entry.data_.end(), data.begin(), data.end());
+        uopEntries.push_back(entry);
+
+        appendValue<uint32_t>(idx, mul.size());
+        appendValue<uint32_t>(idx, data.size());
+        appendValue<uint32_t>(idx, expectedExtra[id]);
+        mul.insert(mul.end(), data.begin(), data.end());
+    }
+
+    writeFile(directory / "test.idx", idx);
+    writeFile(directory / "test.mul", mul);
+    writeUop(directory / uopName, uopEntries, 100, random);
+}
+
+typedef data::IndexedOnDemandFileLoader<unsigned int, FileItem> IndexedLoader;
+
+void checkIndexedLoaders(const boost::filesystem::path& directory, const char* uopName, const std::vector<std::vector<int8_t> >& expectedData,
+        const std::vector<uint32_t>& expectedExtra) {
+    IndexedLoader mul(directory / "test.idx", directory / "test.mul", &readItem);
+    IndexedLoader uopMapped(directory / uopName, directory / uopName, &readItem);
+    IndexedLoader uopStreamed(directory / uopName, directory / uopName, &readItem, false);
+    BOOST_REQUIRE_EQUAL(uopMapped.size(), mul.size());
+
+    IndexedLoader* loaders[] = { &mul, &uopMapped, &uopStreamed };
+    for (unsigned int i = 0; i < 3; ++i) {
+        std::vector<boost::shared_ptr<FileItem> > items;
+        for (unsigned int id = 0; id < expectedData.size(); ++id) {
+            items.push_back(loaders[i]->get(id, 0));
+        }
+
+        for (unsigned int id = 0; id < expectedData.size(); ++id) {
+            if (expectedData[id].empty()) {
+                BOOST_REQUIRE(!items[id]);
+                continue;
+            }
+
+            BOOST_REQUIRE(waitForItem(items[id]));
+            if (items[id]->data_ != expectedData[id] || items[id]->extra_ != expectedExtra[id]) {
+                BOOST_ERROR("Entry " << id << " of loader " << i << " differs from the mul data");
+            }
+        }
+    }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(uopfile)
+
+BOOST_AUTO_TEST_CASE(name_hash_matches_lookup3) {
+    // test vectors of hashlittle2 from lookup3.c, with both seeds 0. The client uses b as the high word
+    BOOST_CHECK_EQUAL(data::UopFile::hashName(""), 0xDEADBEEFDEADBEEFull);
+    BOOST_CHECK_EQUAL(data::UopFile::hashName("Four score and seven years ago"), 0xCE7226E617770551ull);
+
+    boost::filesystem::path directory = getTestDirectory("uopfile-names");
+    Random random;
+    writeUop(directory / "artLegacyMUL.uop", std::vector<UopEntry>(), 10, random);
+    writeUop(directory / "map2LegacyMUL.uop", std::vector<UopEntry>(), 10, random);
+
+    BOOST_CHECK_EQUAL(data::UopFile(directory / "artLegacyMUL.uop").getEntryName(1234), "build/artlegacymul/00001234.tga");
+    BOOST_CHECK_EQUAL(data::UopFile(directory / "map2LegacyMUL.uop").getEntryName(7), "build/map2legacymul/00000007.dat");
+}
+
+BOOST_AUTO_TEST_CASE(art_reads_match_mul) {
+    boost::filesystem::path directory = getTestDirectory("uopfile-art");
+    std::vector<std::vector<int8_t> > expectedData;
+    std::vector<uint32_t> expectedExtra;
+    createIndexedFiles(directory, "artLegacyMUL.uop", "artlegacymul", false, 1200, expectedData, expectedExtra);
+
+    checkIndexedLoaders(directory, "artLegacyMUL.uop", expectedData, expectedExtra);
+}
+
+BOOST_AUTO_TEST_CASE(gump_reads_match_mul) {
+    boost::filesystem::path directory = getTestDirectory("uopfile-gumps");
+    std::vector<std::vector<int8_t> > expectedData;
+    std::vector<uint32_t> expectedExtra;
+    createIndexedFiles(directory, "gumpartLegacyMUL.uop", "gumpartlegacymul", true, 800, expectedData, expectedExtra);
+
+    checkIndexedLoaders(directory, "gumpartLegacyMUL.uop", expectedData, expectedExtra);
+}
+
+BOOST_AUTO_TEST_CASE(map_reads_match_mul) {
+    // the size of a map block. Like in the client files, the chunks hold whole blocks and the last one is shorter
+    const unsigned int blockSize = 196;
+    const unsigned int blockCount = 1000;
+    const unsigned int chunkBlocks = 64;
+
+    boost::filesystem::path directory = getTestDirectory("uopfile-map");
+    Random random;
+    std::vector<int8_t> mul(blockSize * blockCount);
+    for (unsigned int i = 0; i < mul.size(); ++i) {
+        mul[i] = random.next(256);
+    }
+
+    std::vector<UopEntry> uopEntries;
+    for (unsigned int start = 0; start < blockCount; start += chunkBlocks) {
+        UopEntry entry;
+        entry.name_ = entryName("map0legacymul", uopEntries.size(), ".dat");
+        entry.compressed_ = false;
+        unsigned int end = (std::min)(start + chunkBlocks, blockCount);
+        entry.data_.assign(mul.begin() + start * blockSize, mul.begin() + end * blockSize);
+        uopEntries.push_back(entry);
+    }
+
+    writeFile(directory / "map0.mul", mul);
+    writeUop(directory / "map0LegacyMUL.uop", uopEntries, 5, random);
+
+    data::FixedSizeOnDemandFileLoader<unsigned int, FileItem> mulLoader(directory / "map0.mul", blockSize, &readItem);
+    data::FixedSizeOnDemandFileLoader<unsigned int, FileItem> uopLoader(directory / "map0LegacyMUL.uop", blockSize, &readItem);
+
+    for (unsigned int block = 0; block < blockCount; ++block) {
+        boost::shared_ptr<FileItem> mulItem = mulLoader.get(block, 0);
+        boost::shared_ptr<FileItem> uopItem = uopLoader.get(block, 0);
+        BOOST_REQUIRE(waitForItem(mulItem));
+        BOOST_REQUIRE(waitForItem(uopItem));
+        if (uopItem->data_ != mulItem->data_) {
+            BOOST_ERROR("Block " << block << " differs from the mul data");
+        }
+    }
+
+    // past the end of the map
+    BOOST_CHECK(!waitForItem(mulLoader.get(blockCount, 0)));
+    BOOST_CHECK(!waitForItem(uopLoader.get(blockCount, 0)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
@@ -0,0 +1,109 @@
+/*
+ * fluorescence is a free, customizable Ultima Online client.
+ * Copyright (C) 2011-2012, http://fluorescence-client.org
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include <data/util.hpp>
+
+namespace fluo {
+namespace tests {
+
+namespace {
+
+const char* const KERNEL_NAMES[] = { "scalar", "sse2", "avx2", "neon" };
+
+const uint32_t GUARD = 0xDEADBEEFu;
+
+}
+
+BOOST_AUTO_TEST_SUITE(util)
+
+BOOST_AUTO_TEST_CASE(kernels_convert_all_colors_like_getcolorrgba) {
+    std::vector<uint16_t> colors(0x10000);
+    for (unsigned int i = 0; i < colors.size(); ++i) {
+        colors[i] = i;
+    }
+
+    for (unsigned int kernel = 0; kernel < data::Util::KERNEL_COUNT; ++kernel) {
+        std::vector<uint32_t> converted(colors.size());
+        if (!data::Util::convertRow1555With(kernel, &colors[0], &converted[0], colors.size())) {
+            BOOST_TEST_MESSAGE("Kernel " << KERNEL_NAMES[kernel] << " is not available");
+            continue;
+        }
+
+        BOOST_TEST_MESSAGE("Checking kernel " << KERNEL_NAMES[kernel]);
+        for (unsigned int i = 0; i < colors.size(); ++i) {
+            BOOST_REQUIRE_EQUAL(converted[i], data::Util::getColorRGBA(colors[i]));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(kernels_handle_every_length_and_alignment) {
+    std::vector<uint16_t> colors(128);
+    for (unsigned int i = 0; i < colors.size(); ++i) {
+        // transparent pixels in between, and all bits set
+        colors[i] = (i % 5 == 0) ? 0 : (i * 0x2F13u) | (i % 7 == 0 ? 0xFFFF : 0);
+    }
+
+    for (unsigned int kernel = 0; kernel < data::Util::KERNEL_COUNT; ++kernel) {
+        for (unsigned int srcOffset = 0; srcOffset < 8; ++srcOffset) {
+            for (unsigned int dstOffset = 0; dstOffset < 4; ++dstOffset) {
+                for (unsigned int count = 0; count <= 70; ++count) {
+                    std::vector<uint32_t> converted(count + 8, GUARD);
+                    if (!data::Util::convertRow1555With(kernel, &colors[srcOffset], &converted[dstOffset], count)) {
+                        break;
+                    }
+
+                    for (unsigned int i = 0; i < converted.size(); ++i) {
+                        if (i < dstOffset || i >= dstOffset + count) {
+                            // nothing written outside of the row
+                            BOOST_REQUIRE_EQUAL(converted[i], GUARD);
+                        } else {
+                            BOOST_REQUIRE_EQUAL(converted[i], data::Util::getColorRGBA(colors[srcOffset + i - dstOffset]));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(selected_kernel_matches_getcolorrgba) {
+    std::vector<uint16_t> colors(0x10000);
+    for (unsigned int i = 0; i < colors.size(); ++i) {
+        colors[i] = i;
+    }
+
+    std::vector<uint32_t> converted(colors.size());
+    data::Util::convertRow1555(&colors[0], &converted[0], colors.size());
+    for (unsigned int i = 0; i < colors.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(converted[i], data::Util::getColorRGBA(colors[i]));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+}
@@ -24,6 +24,11 @@ namespace fluo {
 namespace ui {
 
 void Animation::addFrame(const AnimationFrame& frame) {
+    // repeated frames share the texture of their predecessor
+    if (frames_.empty() || frames_.back().texture_ != frame.texture_) {
+        setMemoryUsage(getMemoryUsage() + frame.texture_->getMemoryUsage());
+    }
+
     frames_.push_back(frame);
 }
 
@@ -35,6 +35,7 @@ namespace ui {
 
 struct AnimationFrame {
     AnimationFrame() : centerX_(0), centerY_(0), texture_(new ui::Texture) { }
+    explicit AnimationFrame(const boost::shared_ptr<ui::Texture>& texture) : centerX_(0), centerY_(0), texture_(texture) { }
 
     int centerX_;
     int centerY_;
@@ -87,6 +87,8 @@ void AudioManager::step() {
             if ((*iter)->isReadComplete()) {
                 playSound(*iter);
                 waitingDone.push_back(*iter);
+            } else if ((*iter)->isReadFailed()) {
+                waitingDone.push_back(*iter);
             }
         }
 
@@ -60,7 +60,7 @@ void BitMask::init(const CL_PixelBuffer& pixBuf) {
     if (!bitStore_) {
         width_ = pixBuf.get_width();
         height_ = pixBuf.get_height();
-        bitStoreSize_ = ((width_ * height_) / 8) + 1;
+        bitStoreSize_ = getBitStoreSize(width_, height_);
         bitStore_ = reinterpret_cast<uint8_t*>(malloc(bitStoreSize_));
         memset(bitStore_, 0, bitStoreSize_);
 
@@ -77,5 +77,27 @@ void BitMask::init(const CL_PixelBuffer& pixBuf) {
     }
 }
 
+void BitMask::init(unsigned int width, unsigned int height, const uint8_t* bitStore) {
+    if (!bitStore_) {
+        width_ = width;
+        height_ = height;
+        bitStoreSize_ = getBitStoreSize(width_, height_);
+        bitStore_ = reinterpret_cast<uint8_t*>(malloc(bitStoreSize_));
+        memcpy(bitStore_, bitStore, bitStoreSize_);
+    }
+}
+
+const uint8_t* BitMask::getBitStore() const {
+    return bitStore_;
+}
+
+unsigned int BitMask::getBitStoreSize() const {
+    return bitStoreSize_;
+}
+
+unsigned int BitMask::getBitStoreSize(unsigned int width, unsigned int height) {
+    return ((width * height) / 8) + 1;
+}
+
 }
 }
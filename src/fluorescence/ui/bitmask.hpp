@@ -35,8 +35,17 @@ public:
 
     void init(const CL_PixelBuffer& pixBuf);
 
+    /// Initializes the mask from bits previously obtained by getBitStore, e.g. from a texture pack
+    void init(unsigned int width, unsigned int height, const uint8_t* bitStore);
+
     bool hasPixel(unsigned int pixelX, unsigned int pixelY);
 
+    const uint8_t* getBitStore() const;
+    unsigned int getBitStoreSize() const;
+
+    /// Size of the bit store for the given texture size
+    static unsigned int getBitStoreSize(unsigned int width, unsigned int height);
+
 private:
     unsigned int width_;
     unsigned int height_;
@@ -25,23 +25,29 @@
 
 #include <data/manager.hpp>
 #include <data/artloader.hpp>
+#include <misc/log.hpp>
 
 #ifndef WIN32
 #include <X11/Xcursor/Xcursor.h>
 #endif
 
 #include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
 
 namespace fluo {
 namespace ui {
 
-CursorImage::CursorImage() {
+CursorImage::CursorImage() : ready_(false) {
 #ifndef WIN32
     unixCursor_ = 0;
 #endif
 }
 
 CursorImage::~CursorImage() {
+    if (texture_) {
+        texture_->removeCompleteListeners(this);
+    }
+
 #ifndef WIN32
     boost::shared_ptr<CL_DisplayWindow> clWindow = ui::Manager::getSingleton()->getMainWindow();
     if (unixCursor_) {
@@ -51,16 +57,33 @@ CursorImage::~CursorImage() {
 #endif
 }
 
-void CursorImage::set(unsigned int cursorId, unsigned int artId, boost::shared_ptr<CL_DisplayWindow> window) {
+void CursorImage::set(unsigned int cursorId, unsigned int artId, boost::shared_ptr<CL_DisplayWindow> window, const ReadyCallback& readyCallback) {
     cursorId_ = cursorId;
-    boost::shared_ptr<ui::Texture> texture = data::Manager::getTexture(data::TextureSource::STATICART, artId);
-    setHotspotFromTexture(texture);
+    window_ = window;
+    readyCallback_ = readyCallback;
+
+    if (texture_) {
+        texture_->removeCompleteListeners(this);
+    }
+    // the hotspot is read from the pixels, so the texture pack can not be used
+    texture_ = data::Manager::getTexture(data::TextureSource::STATICART, artId, true);
+    texture_->addCompleteListener(this, boost::bind(&CursorImage::onTextureLoaded, this));
+}
+
+void CursorImage::onTextureLoaded() {
+    if (texture_->isReadFailed()) {
+        // the cursor never becomes ready, the previous one stays active
+        LOG_WARN << "Unable to load texture for cursor " << cursorId_ << std::endl;
+        return;
+    }
+
+    setHotspotFromTexture(texture_);
 
 #ifdef WIN32
     CL_Point hotspot(hotspotX_, hotspotY_);
     CL_SpriteDescription desc;
-    desc.add_frame(texture->getPixelBuffer());
-    winCursor_ = CL_Cursor(*window.get(), desc, hotspot);
+    desc.add_frame(texture_->getPixelBuffer());
+    winCursor_ = CL_Cursor(*window_.get(), desc, hotspot);
 #else
     XcursorImage* cursorImage = XcursorImageCreate(width_, height_);
     cursorImage->xhot = hotspotX_;
@@ -68,21 +91,21 @@ void CursorImage::set(unsigned int cursorId, unsigned int artId, boost::shared_p
 
     // X11 expects cursor image pixels to be 32bit in argb8 format
     CL_PixelBuffer convertedBuffer = CL_PixelBuffer(width_, height_, cl_argb8);
-    texture->getPixelBuffer().convert(convertedBuffer);
+    texture_->getPixelBuffer().convert(convertedBuffer);
 
     int byteCount = width_ * height_ * sizeof(XcursorPixel);
     memcpy(cursorImage->pixels, convertedBuffer.get_data(), byteCount);
 
-    unixCursor_ = XcursorImageLoadCursor(window->get_display(), cursorImage);
+    unixCursor_ = XcursorImageLoadCursor(window_->get_display(), cursorImage);
 #endif
-}
 
-void CursorImage::setHotspotFromTexture(boost::shared_ptr<ui::Texture> tex) {
-    // TODO: find something better than busy waiting here
-    while (!tex->isReadComplete()) {
-        fluo::sleepMs(1);
+    ready_ = true;
+    if (readyCallback_) {
+        readyCallback_(cursorId_);
     }
+}
 
+void CursorImage::setHotspotFromTexture(boost::shared_ptr<ui::Texture> tex) {
     hotspotX_ = 0;
     hotspotY_ = 0;
 
@@ -116,6 +139,10 @@ void CursorImage::setHotspotFromTexture(boost::shared_ptr<ui::Texture> tex) {
 }
 
 void CursorImage::activate() {
+    if (!ready_) {
+        return;
+    }
+
     boost::shared_ptr<CL_DisplayWindow> clWindow = ui::Manager::getSingleton()->getMainWindow();
 
 #ifdef WIN32
@@ -21,6 +21,7 @@
 #define FLUO_UI_CURSORIMAGE_HPP
 
 #include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
 
 #ifdef WIN32
 #include <ClanLib/Display/Window/cursor.h>
@@ -40,13 +41,23 @@ public:
     CursorImage();
     ~CursorImage();
 
-    void set(unsigned int cursorId, unsigned int artId, boost::shared_ptr<CL_DisplayWindow> window);
+    typedef boost::function<void (unsigned int)> ReadyCallback;
 
+    /// The cursor is created once the art texture is loaded, readyCallback is called with the cursor id then
+    void set(unsigned int cursorId, unsigned int artId, boost::shared_ptr<CL_DisplayWindow> window, const ReadyCallback& readyCallback);
+
+    /// Does nothing if the cursor is not ready yet
     void activate();
 
 private:
     unsigned int cursorId_;
 
+    boost::shared_ptr<ui::Texture> texture_;
+    boost::shared_ptr<CL_DisplayWindow> window_;
+    ReadyCallback readyCallback_;
+    bool ready_;
+    void onTextureLoaded();
+
     int hotspotX_;
     int hotspotY_;
 
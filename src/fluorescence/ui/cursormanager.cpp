@@ -23,6 +23,7 @@
 #include <ClanLib/Display/2D/draw.h>
 #include <ClanLib/Display/Render/texture.h>
 #include <ClanLib/Core/Math/quad.h>
+#include <boost/bind.hpp>
 
 #include <client.hpp>
 #include <misc/config.hpp>
@@ -35,7 +36,7 @@ namespace fluo {
 namespace ui {
 
 CursorManager::CursorManager(Config& config, boost::shared_ptr<CL_DisplayWindow> window) :
-        isDragging_(false), enableFlags_(CursorEnableFlags::NONE), warMode_(false),
+        currentCursorId_(0xFFFFFFFFu), isDragging_(false), enableFlags_(CursorEnableFlags::NONE), warMode_(false),
         cursorDirection_(CursorType::GAME_WEST), cursorOverride_(0xFFFFFFFFu) {
 
     unsigned int artIdStart = config["/fluo/ui/cursor@normal-artid-start"].asInt();
@@ -76,7 +77,13 @@ void CursorManager::setCursorImage(unsigned int id, unsigned int artId, bool war
     if (warMode) {
         id += CursorType::COUNT;
     }
-    cursorImages_[id].set(id, artId, window);
+    cursorImages_[id].set(id, artId, window, boost::bind(&CursorManager::onCursorImageReady, this, _1));
+}
+
+void CursorManager::onCursorImageReady(unsigned int id) {
+    if (id == currentCursorId_) {
+        cursorImages_[id].activate();
+    }
 }
 
 void CursorManager::updateCursor() {
@@ -100,6 +107,7 @@ void CursorManager::updateCursor() {
             //<< " target?: " << hasTarget()
             //<< " warmode?: " << warMode_
             //<< std::endl;
+    currentCursorId_ = cursorId;
     cursorImages_[cursorId].activate();
 }
 
@@ -105,6 +105,7 @@ private:
     void setCursorImage(unsigned int id, unsigned int artId, bool warMode, boost::shared_ptr<CL_DisplayWindow> window);
 
     void updateCursor();
+    void onCursorImageReady(unsigned int id);
 
     void startDragging();
     bool isDragging_;
@@ -89,7 +89,7 @@ void FontEngine::calculateSizeAndLinebreaks(unsigned int fontId, const UnicodeSt
 
     while (iter.hasNext()) {
         unsigned int charCode = iter.nextPostInc();
-        boost::shared_ptr<data::UnicodeCharacter> curChar = fontLoader->getCharacter(charCode);
+        const data::UnicodeCharacter* curChar = fontLoader->getCharacter(charCode);
 
         unsigned int curCharWidth;
 
@@ -180,19 +180,22 @@ boost::shared_ptr<ui::Texture> FontEngine::getUniFontTexture(unsigned int uniFon
             }
         }
 
-        boost::shared_ptr<data::UnicodeCharacter> curChar = fontLoader->getCharacter(charCode);
+        const data::UnicodeCharacter* curChar = fontLoader->getCharacter(charCode);
 
         if (!curChar) {
             LOG_DEBUG << "Trying to render invalid char code " << charCode << std::endl;
             continue;
         }
 
+        const uint8_t* atlasPtr = fontLoader->getAtlasPageData(curChar->atlasPage_) +
+                curChar->atlasY_ * data::UniFontLoader::ATLAS_WIDTH + curChar->atlasX_;
         for (unsigned int y = 0; y < curChar->height_; ++y) {
             for (unsigned int x = 0; x < curChar->width_; ++x) {
-                if (curChar->data_[y * curChar->width_ + x] == 1) {
+                if (atlasPtr[x] == data::UniFontLoader::ATLAS_GLYPH) {
                     pixBufPtr[(curY + curChar->yOffset_ + y) * width + (curX + curChar->xOffset_ + x)] = color;
                 }
             }
+            atlasPtr += data::UniFontLoader::ATLAS_WIDTH;
         }
 
         curX += curChar->getTotalWidth() + uniCharSpacing_;
@@ -42,6 +42,7 @@
 
 #include <misc/log.hpp>
 #include <misc/exception.hpp>
+#include <misc/profiler.hpp>
 
 #include <world/ingameobject.hpp>
 #include <world/manager.hpp>
@@ -119,6 +120,7 @@ Manager::Manager() : worldView_(nullptr), promptSerial_(0) {
     setTheme("preshard");
 
     LOG_DEBUG << "Initializing Python" << std::endl;
+    ProfilePhase phase("python::ScriptLoader::init");
     pythonLoader_.reset(new python::ScriptLoader());
     pythonLoader_->init();
     pythonLoader_->setThemePath(getThemePath());
@@ -168,6 +170,7 @@ bool Manager::setShardConfig(Config& config) {
 
     setTheme(config["/fluo/ui/theme@name"].asString());
 
+    ProfilePhase phase("python::ScriptLoader::setShardConfig");
     pythonLoader_->setShardConfig(config);
 
     return true;
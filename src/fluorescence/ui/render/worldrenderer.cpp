@@ -21,6 +21,7 @@
 #include "worldrenderer.hpp"
 
 #include <ClanLib/Display/Render/program_object.h>
+#include <boost/bind.hpp>
 
 #include "material.hpp"
 
@@ -58,21 +59,30 @@ WorldRenderer::WorldRenderer(components::WorldView* worldView) :
         batchFill_(0), forceRepaint_(false) {
     initBufferControls();
 
-    boost::shared_ptr<ui::Texture> effTex = data::Manager::getTexture(data::TextureSource::FILE, "effects/textures/rendereffects.png");
-    effTex->setUsage(Texture::USAGE_EFFECT);
-    if (!effTex) {
+    renderEffectSource_ = data::Manager::getTexture(data::TextureSource::FILE, "effects/textures/rendereffects.png");
+    if (!renderEffectSource_) {
         LOG_ERROR << "Error loading the render effect texture" << std::endl;
         throw Exception("Error loading the render effect texture");
     }
+    renderEffectSource_->setUsage(Texture::USAGE_EFFECT);
 
-    // find something better than busy waiting here
-    while (!effTex->isReadComplete()) {
-        fluo::sleepMs(1);
-    }
-    renderEffectTexture_ = effTex->getTexture();
+    // the world is not drawn until the texture is available
+    renderEffectSource_->addCompleteListener(this, boost::bind(&WorldRenderer::onRenderEffectTextureLoaded, this));
 }
 
 WorldRenderer::~WorldRenderer() {
+    renderEffectSource_->removeCompleteListeners(this);
+}
+
+void WorldRenderer::onRenderEffectTextureLoaded() {
+    if (renderEffectSource_->isReadFailed()) {
+        // the world stays black, but the gumps keep working
+        LOG_ERROR << "Error loading the render effect texture" << std::endl;
+        return;
+    }
+
+    renderEffectTexture_ = renderEffectSource_->getTexture();
+    forceRepaint_ = true;
 }
 
 void WorldRenderer::checkTextureSize() {
@@ -117,7 +127,7 @@ CL_Texture WorldRenderer::getTexture(CL_GraphicContext& gc) {
     boost::recursive_mutex::scoped_lock clipManLock(clipRectMan->mutex_);
     clipRectMan->clamp(clippingTopLeftCorner, worldView_->getDrawSize());
 
-    if (clipRectMan->size() > 0) {
+    if (clipRectMan->size() > 0 && !renderEffectTexture_.is_null()) {
         prepareStencil(gc);
         render(gc);
     } else {
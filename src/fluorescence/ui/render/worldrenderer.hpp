@@ -101,7 +101,9 @@ private:
     CL_BufferControl bufferControlObjects_;
     CL_BufferControl bufferControlParticles_;
 
+    boost::shared_ptr<ui::Texture> renderEffectSource_;
     CL_Texture renderEffectTexture_;
+    void onRenderEffectTextureLoaded();
 };
 
 }
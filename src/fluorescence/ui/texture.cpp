@@ -31,14 +31,14 @@
 namespace fluo {
 namespace ui {
 
-Texture::Texture(bool useBitMask) : useBitMask_(useBitMask), textureUsage_(0xFFFFFFFF), borderWidth_(0) {
+Texture::Texture(bool useBitMask) : sharedPixelBuffer_(false), useBitMask_(useBitMask), textureUsage_(0xFFFFFFFF), borderWidth_(0), atlasTexture_(false) {
 }
 
-Texture::Texture(Usage usage, bool useBitMask) : useBitMask_(useBitMask), textureUsage_(usage), borderWidth_(0) {
+Texture::Texture(Usage usage, bool useBitMask) : sharedPixelBuffer_(false), useBitMask_(useBitMask), textureUsage_(usage), borderWidth_(0), atlasTexture_(false) {
 }
 
 Texture::~Texture() {
-    if (!texture_.is_null()) {
+    if (!texture_.is_null() && !atlasTexture_) {
         ui::Manager::getSingleton()->freeTexture(textureUsage_, texture_);
     }
 }
@@ -52,11 +52,26 @@ void Texture::setUsage(unsigned int usage) {
 
 void Texture::initPixelBuffer(unsigned int width, unsigned int height) {
     pixelBuffer_ = CL_PixelBuffer(width, height, cl_rgba8);
+    sharedPixelBuffer_ = false;
 
     memset(getPixelBufferData(), 0, width * height * sizeof(uint32_t));
+    setMemoryUsage(width * height * sizeof(uint32_t));
+}
+
+void Texture::initSharedPixelBuffer(unsigned int width, unsigned int height, const uint32_t* data) {
+    // only references the data, which is read only
+    pixelBuffer_ = CL_PixelBuffer(width, height, cl_rgba8, data, true);
+    sharedPixelBuffer_ = true;
+    setMemoryUsage(width * height * sizeof(uint32_t));
 }
 
 uint32_t* Texture::getPixelBufferData() {
+    if (sharedPixelBuffer_) {
+        // the caller might write to the buffer
+        pixelBuffer_ = pixelBuffer_.copy();
+        sharedPixelBuffer_ = false;
+    }
+
     return reinterpret_cast<uint32_t*>(pixelBuffer_.get_data());
 }
 
@@ -80,6 +95,7 @@ CL_Texture Texture::getTexture() {
 void Texture::setTexture(const CL_PixelBuffer& pixBuf) {
     if (texture_.is_null()) {
         pixelBuffer_ = pixBuf.copy();
+        sharedPixelBuffer_ = false;
 
         if (useBitMask_) {
             bitMask_.init(pixelBuffer_);
@@ -89,6 +105,29 @@ void Texture::setTexture(const CL_PixelBuffer& pixBuf) {
     }
 }
 
+void Texture::initFromAtlas(const CL_Texture& page, const CL_Rect& geometry, unsigned int borderWidth, const uint8_t* bitMask) {
+    borderWidth_ = borderWidth;
+    atlasTexture_ = true;
+
+    CL_Rect geometryWithBorder = geometry;
+    geometryWithBorder.expand(borderWidth_);
+    texture_ = CL_Subtexture(page, geometryWithBorder);
+    borderlessGeometry_ = geometry;
+
+    if (useBitMask_) {
+        bitMask_.init(geometry.get_width(), geometry.get_height(), bitMask);
+    }
+
+    normalizedTextureCoords_ = borderlessGeometry_;
+    normalizedTextureCoords_.top /= ui::Manager::TEXTURE_GROUP_HEIGHT;
+    normalizedTextureCoords_.left /= ui::Manager::TEXTURE_GROUP_WIDTH;
+    normalizedTextureCoords_.right /= ui::Manager::TEXTURE_GROUP_WIDTH;
+    normalizedTextureCoords_.bottom /= ui::Manager::TEXTURE_GROUP_HEIGHT;
+
+    setMemoryUsage(bitMask_.getBitStoreSize());
+    setReadComplete();
+}
+
 float Texture::getWidth() {
     if (!texture_.is_null()) {
         return getTextureCoords().get_width();
@@ -156,6 +195,7 @@ void Texture::initSubTexture() {
     }
 
     pixelBuffer_ = CL_PixelBuffer();
+    sharedPixelBuffer_ = false;
 
     normalizedTextureCoords_ = borderlessGeometry_;
     normalizedTextureCoords_.top /= ui::Manager::TEXTURE_GROUP_HEIGHT;
@@ -186,6 +226,10 @@ void Texture::setBorderWidth(unsigned int width) {
     borderWidth_ = width;
 }
 
+unsigned int Texture::getBorderWidth() const {
+    return borderWidth_;
+}
+
 void Texture::debugSaveToFile(const char* filename) {
     if (isReadComplete()) {
         CL_PixelBuffer pxBuf = getTexture().get_pixeldata();
@@ -47,12 +47,22 @@ public:
     void setUsage(unsigned int usage);
 
     void initPixelBuffer(unsigned int width, unsigned int height);
+    /// Uses the data without copying it, e.g. from data::SharedMemoryCache. The data has to outlive the pixel buffer
+    void initSharedPixelBuffer(unsigned int width, unsigned int height, const uint32_t* data);
+    /// Copies a shared pixel buffer first, so that it can be written to
     uint32_t* getPixelBufferData();
 
     CL_PixelBuffer getPixelBuffer();
 
     CL_Texture getTexture();
     void setTexture(const CL_PixelBuffer& pixBuf);
+
+    /**
+     * Uses a part of an already uploaded atlas page (see data::TexturePack) instead of a pixel buffer.
+     * geometry is the area of the texture on the page, without border. Marks the texture as read complete
+     */
+    void initFromAtlas(const CL_Texture& page, const CL_Rect& geometry, unsigned int borderWidth, const uint8_t* bitMask);
+
     CL_Rectf getTextureCoords();
     CL_Rectf getNormalizedTextureCoords();
 
@@ -65,11 +75,13 @@ public:
     CL_Texture extractSingleTexture();
 
     void setBorderWidth(unsigned int width);
+    unsigned int getBorderWidth() const;
 
     void debugSaveToFile(const char* filename);
 
 private:
     CL_PixelBuffer pixelBuffer_;
+    bool sharedPixelBuffer_;
     CL_Subtexture texture_;
     bool useBitMask_;
     BitMask bitMask_;
@@ -80,6 +92,8 @@ private:
 
     unsigned int borderWidth_;
     CL_Rectf borderlessGeometry_;
+
+    bool atlasTexture_; ///< Part of an atlas page that is not managed by ui::Manager's texture groups
 };
 }
 }
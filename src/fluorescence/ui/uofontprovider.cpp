@@ -25,18 +25,19 @@
 #include <data/unifontloader.hpp>
 #include <data/huesloader.hpp>
 
-#include "texture.hpp"
+#include "manager.hpp"
 
-#include <ClanLib/Display/Render/texture.h>
-#include <ClanLib/Display/2D/draw.h>
-#include <ClanLib/Core/Math/quad.h>
+#include <ClanLib/Display/Render/graphic_context.h>
+#include <ClanLib/Display/Render/primitives_array.h>
+#include <ClanLib/Display/Render/program_object.h>
+#include <ClanLib/Display/Image/pixel_buffer.h>
 
 
 namespace fluo {
 namespace ui {
 
-UoFontProvider::UoFontProvider(unsigned int unifontId, bool border) : unifontId_(unifontId), borderWidth_(border ? 1 : 0),
-        historyIndex_(0), historySize_(0) {
+UoFontProvider::UoFontProvider(unsigned int unifontId, bool border) :
+        unifontId_(unifontId), borderWidth_(border ? data::UniFontLoader::ATLAS_BORDER_WIDTH : 0), uploadedCharacterCount_(0) {
     fontLoader_ = data::Manager::getUniFontLoader(unifontId);
 
     initFontMetrics();
@@ -48,15 +49,196 @@ CL_FontMetrics UoFontProvider::get_font_metrics() {
 
 void UoFontProvider::destroy() {
     fontLoader_.reset();
+    atlasPages_.clear();
 }
 
 void UoFontProvider::draw_text(CL_GraphicContext& gc, float x, float y, const CL_StringRef& text, const CL_Colorf& color) {
-    boost::shared_ptr<ui::Texture> tex = getTexture(gc, text, color);
+    UnicodeString uniStr = StringConverter::fromUtf8(text.c_str());
+
+    // load all characters first, to update the atlas texture only once
+    std::vector<const data::UnicodeCharacter*> characters;
+    characters.reserve(uniStr.length());
+
+    StringCharacterIterator iter(uniStr);
+    while (iter.hasNext()) {
+        unsigned int charCode = iter.nextPostInc();
+        const data::UnicodeCharacter* curChar = fontLoader_->getCharacter(charCode);
+
+        if (!curChar) {
+            LOG_DEBUG << "Trying to render invalid char code " << charCode << std::endl;
+            continue;
+        }
+
+        characters.push_back(curChar);
+    }
+
+    if (characters.empty()) {
+        return;
+    }
+
+    updateAtlasTextures();
+
+    // dirty fix to avoid a filled rectangle...
+    CL_Colorf borderColor = CL_Colorf::black;
+    uint32_t uintColor = clToUintColor(color);
+    if (uintColor == clToUintColor(borderColor)) {
+        uint32_t uintBorderColor = uintColor - 1;
+        borderColor = CL_Colorf(CL_Color((uintBorderColor >> 24) & 0xFF, (uintBorderColor >> 16) & 0xFF, (uintBorderColor >> 8) & 0xFF, uintBorderColor & 0xFF));
+    }
+
+    unsigned int pageCount = atlasPages_.size();
+    glyphBatches_.resize(pageCount);
+    borderBatches_.resize(pageCount);
+    for (unsigned int i = 0; i < pageCount; ++i) {
+        glyphBatches_[i].positions_.clear();
+        glyphBatches_[i].texCoords_.clear();
+        glyphBatches_[i].colors_.clear();
+        borderBatches_[i].positions_.clear();
+        borderBatches_[i].texCoords_.clear();
+        borderBatches_[i].colors_.clear();
+    }
+
+    // y is the bottom of the text including the border
+    float top = y - (fontLoader_->getMaxHeight() + borderWidth_ * 2) + borderWidth_;
+    float left = x + borderWidth_;
+
+    float curX = left;
+    for (unsigned int i = 0; i < characters.size(); ++i) {
+        const data::UnicodeCharacter* curChar = characters[i];
+        if (borderWidth_ > 0) {
+            addCharacterQuad(borderBatches_[curChar->atlasPage_], curChar, curX, top, borderWidth_, borderColor);
+        }
+        addCharacterQuad(glyphBatches_[curChar->atlasPage_], curChar, curX, top, 0, color);
+
+        curX += curChar->getTotalWidth() + spaceWidth_;
+    }
+
+    // the border of a character may overlap the neighbouring characters, so all borders are drawn first
+    gc.set_program_object(cl_program_single_texture);
+    if (borderWidth_ > 0) {
+        for (unsigned int i = 0; i < pageCount; ++i) {
+            drawBatch(gc, borderBatches_[i], atlasPages_[i].borderTexture_);
+        }
+    }
+    for (unsigned int i = 0; i < pageCount; ++i) {
+        drawBatch(gc, glyphBatches_[i], atlasPages_[i].glyphTexture_);
+    }
+    gc.reset_program_object();
+    gc.reset_texture(0);
+}
+
+void UoFontProvider::drawBatch(CL_GraphicContext& gc, const QuadBatch& batch, const CL_Texture& texture) {
+    if (batch.positions_.empty()) {
+        return;
+    }
+
+    CL_PrimitivesArray primarray(gc);
+    primarray.set_attributes(0, &batch.positions_[0]);
+    primarray.set_attributes(1, &batch.colors_[0]);
+    primarray.set_attributes(2, &batch.texCoords_[0]);
+
+    gc.set_texture(0, texture);
+    gc.draw_primitives(cl_triangles, batch.positions_.size(), primarray);
+}
+
+void UoFontProvider::addCharacterQuad(QuadBatch& batch, const data::UnicodeCharacter* character, float x, float y, int padding,
+        const CL_Colorf& color) {
+    if (character->width_ == 0 || character->height_ == 0) {
+        return;
+    }
+
+    CL_Rectf rect(x + character->xOffset_ - padding, y + character->yOffset_ - padding,
+            CL_Sizef(character->width_ + padding * 2, character->height_ + padding * 2));
+    CL_Rectf texRect(
+            (float)((int)character->atlasX_ - padding) / data::UniFontLoader::ATLAS_WIDTH,
+            (float)((int)character->atlasY_ - padding) / data::UniFontLoader::ATLAS_PAGE_HEIGHT,
+            (float)(character->atlasX_ + character->width_ + padding) / data::UniFontLoader::ATLAS_WIDTH,
+            (float)(character->atlasY_ + character->height_ + padding) / data::UniFontLoader::ATLAS_PAGE_HEIGHT);
+
+    batch.positions_.push_back(CL_Vec2f(rect.left, rect.top));
+    batch.positions_.push_back(CL_Vec2f(rect.right, rect.top));
+    batch.positions_.push_back(CL_Vec2f(rect.left, rect.bottom));
+    batch.positions_.push_back(CL_Vec2f(rect.right, rect.top));
+    batch.positions_.push_back(CL_Vec2f(rect.left, rect.bottom));
+    batch.positions_.push_back(CL_Vec2f(rect.right, rect.bottom));
+
+    batch.texCoords_.push_back(CL_Vec2f(texRect.left, texRect.top));
+    batch.texCoords_.push_back(CL_Vec2f(texRect.right, texRect.top));
+    batch.texCoords_.push_back(CL_Vec2f(texRect.left, texRect.bottom));
+    batch.texCoords_.push_back(CL_Vec2f(texRect.right, texRect.top));
+    batch.texCoords_.push_back(CL_Vec2f(texRect.left, texRect.bottom));
+    batch.texCoords_.push_back(CL_Vec2f(texRect.right, texRect.bottom));
+
+    batch.colors_.insert(batch.colors_.end(), 6, color);
+}
+
+void UoFontProvider::updateAtlasTextures() {
+    unsigned int characterCount = fontLoader_->getCharacterCount();
+    if (characterCount == uploadedCharacterCount_) {
+        return;
+    }
+
+    unsigned int pageCount = fontLoader_->getAtlasPageCount();
+    unsigned int oldPageCount = atlasPages_.size();
+    atlasPages_.resize(pageCount);
+    for (unsigned int i = oldPageCount; i < pageCount; ++i) {
+        atlasPages_[i].glyphTexture_ = createAtlasTexture();
+        if (borderWidth_ > 0) {
+            atlasPages_[i].borderTexture_ = createAtlasTexture();
+        }
+    }
+
+    // rows of each page that contain new characters, including their border
+    std::vector<unsigned int> firstRows(pageCount, data::UniFontLoader::ATLAS_PAGE_HEIGHT);
+    std::vector<unsigned int> endRows(pageCount, 0);
+    for (unsigned int i = uploadedCharacterCount_; i < characterCount; ++i) {
+        const data::UnicodeCharacter* curChar = fontLoader_->getCharacterByIndex(i);
+        if (curChar->width_ == 0 || curChar->height_ == 0) {
+            continue;
+        }
+
+        unsigned int page = curChar->atlasPage_;
+        firstRows[page] = (std::min)(firstRows[page], curChar->atlasY_ - data::UniFontLoader::ATLAS_BORDER_WIDTH);
+        endRows[page] = (std::max)(endRows[page], curChar->atlasY_ + curChar->height_ + data::UniFontLoader::ATLAS_BORDER_WIDTH);
+    }
+
+    uploadedCharacterCount_ = characterCount;
+
+    for (unsigned int i = 0; i < pageCount; ++i) {
+        if (firstRows[i] < endRows[i]) {
+            uploadAtlasRows(i, firstRows[i], endRows[i]);
+        }
+    }
+}
+
+CL_Texture UoFontProvider::createAtlasTexture() const {
+    CL_Texture ret = ui::Manager::getSingleton()->providerRenderBufferTexture(
+            CL_Size(data::UniFontLoader::ATLAS_WIDTH, data::UniFontLoader::ATLAS_PAGE_HEIGHT), cl_rgba8);
+    ret.set_min_filter(cl_filter_nearest);
+    ret.set_mag_filter(cl_filter_nearest);
+    return ret;
+}
 
-    CL_Rectf rect(x, y - tex->getHeight(), CL_Sizef(tex->getWidth(), tex->getHeight()));
-    //LOG_DEBUG << "draw_text: at " << rect << ": " << text.c_str() << std::endl;
+void UoFontProvider::uploadAtlasRows(unsigned int page, unsigned int firstRow, unsigned int endRow) {
+    unsigned int rowCount = endRow - firstRow;
+    unsigned int pixelCount = rowCount * data::UniFontLoader::ATLAS_WIDTH;
+    const uint8_t* atlasPtr = fontLoader_->getAtlasPageData(page) + firstRow * data::UniFontLoader::ATLAS_WIDTH;
 
-    CL_Draw::texture(gc, tex->getTexture(), CL_Quadf(rect), CL_Colorf::white, tex->getNormalizedTextureCoords());
+    CL_PixelBuffer pixels(data::UniFontLoader::ATLAS_WIDTH, rowCount, cl_rgba8);
+    uint32_t* pixelPtr = reinterpret_cast<uint32_t*>(pixels.get_data());
+
+    // white, so the quads can be colored with the vertex color
+    for (unsigned int i = 0; i < pixelCount; ++i) {
+        pixelPtr[i] = atlasPtr[i] == data::UniFontLoader::ATLAS_GLYPH ? 0xFFFFFFFFu : 0;
+    }
+    atlasPages_[page].glyphTexture_.set_subimage(0, firstRow, pixels, CL_Rect(0, 0, data::UniFontLoader::ATLAS_WIDTH, rowCount));
+
+    if (borderWidth_ > 0) {
+        for (unsigned int i = 0; i < pixelCount; ++i) {
+            pixelPtr[i] = atlasPtr[i] != 0 ? 0xFFFFFFFFu : 0;
+        }
+        atlasPages_[page].borderTexture_.set_subimage(0, firstRow, pixels, CL_Rect(0, 0, data::UniFontLoader::ATLAS_WIDTH, rowCount));
+    }
 }
 
 CL_Size UoFontProvider::get_text_size(CL_GraphicContext& gc, const CL_StringRef& text) {
@@ -68,7 +250,7 @@ CL_Size UoFontProvider::get_text_size(CL_GraphicContext& gc, const CL_StringRef&
 
     while (iter.hasNext()) {
         unsigned int charCode = iter.nextPostInc();
-        boost::shared_ptr<data::UnicodeCharacter> curChar = fontLoader_->getCharacter(charCode);
+        const data::UnicodeCharacter* curChar = fontLoader_->getCharacter(charCode);
 
         if (!curChar) {
             LOG_DEBUG << "Trying to render invalid char code " << charCode << std::endl;
@@ -112,7 +294,7 @@ int UoFontProvider::get_character_index(CL_GraphicContext& gc, const CL_String&
         }
         if (curY >= targetYMin && curY < targetYMax) {
             // this is the line we really need to look at
-            boost::shared_ptr<data::UnicodeCharacter> curChar = fontLoader_->getCharacter(charCode);
+            const data::UnicodeCharacter* curChar = fontLoader_->getCharacter(charCode);
             if (point.x >= curX && point.x < (curX + (int)curChar->getTotalWidth())) {
                 return p;
             } else {
@@ -133,26 +315,26 @@ void UoFontProvider::initFontMetrics() {
     unsigned int height, ascent, descent, avgWidth, maxWidth;
     height = ascent = descent = avgWidth = maxWidth = 0;
 
-    boost::shared_ptr<data::UnicodeCharacter> charM = fontLoader_->getCharacter('M');
+    const data::UnicodeCharacter* charM = fontLoader_->getCharacter('M');
     if (charM) {
         height = charM->getTotalHeight();
     }
 
-    boost::shared_ptr<data::UnicodeCharacter> charARing = fontLoader_->getCharacter(0xc5); // Å
+    const data::UnicodeCharacter* charARing = fontLoader_->getCharacter(0xc5); // Å
     if (charARing) {
         ascent = charARing->getTotalHeight();
     } else {
         ascent = height + 1;
     }
 
-    boost::shared_ptr<data::UnicodeCharacter> charg = fontLoader_->getCharacter('g');
+    const data::UnicodeCharacter* charg = fontLoader_->getCharacter('g');
     if (charg) {
         //descent = charg->getTotalHeight() - charM->getTotalHeight();
         avgWidth = charg->getTotalWidth();
     }
     descent = 0;
 
-    boost::shared_ptr<data::UnicodeCharacter> charW = fontLoader_->getCharacter('W');
+    const data::UnicodeCharacter* charW = fontLoader_->getCharacter('W');
     if (charW) {
         maxWidth = charW->getTotalWidth();
     }
@@ -175,96 +357,6 @@ void UoFontProvider::initFontMetrics() {
         false);        // fixed_pitch
 }
 
-void UoFontProvider::applyBorder(CL_PixelBuffer pxBuf, const CL_Colorf& clcolor, unsigned int borderWidth, const CL_Colorf& clborderColor) {
-    uint32_t color = clToUintColor(clcolor);
-    uint32_t borderColor = clToUintColor(clborderColor);
-
-    // dirty fix to avoid a filled rectangle...
-    if (color == borderColor) {
-        borderColor = color - 1;
-    }
-
-    unsigned int width = pxBuf.get_width();
-    unsigned int height = pxBuf.get_height();
-
-    uint32_t* pixBufPtr = (uint32_t*)pxBuf.get_data();
-    int iBorderWidth = borderWidth;
-
-    for (unsigned int y = borderWidth; y < height - borderWidth; ++y) {
-        for (unsigned int x = borderWidth; x < width -borderWidth; ++x) {
-            unsigned int curIndex = y * width + x;
-            if (pixBufPtr[curIndex] == color) {
-                for (int i = -iBorderWidth; i <= iBorderWidth; ++i) {
-                    for (int j = -iBorderWidth; j <= iBorderWidth; ++j) {
-                        int idx = (i+y) * width + j+x;
-                        if (pixBufPtr[idx] != color) {
-                            pixBufPtr[idx] = borderColor;
-                        }
-                    }
-                }
-            }
-        }
-    }
-}
-
-boost::shared_ptr<ui::Texture> UoFontProvider::getTexture(CL_GraphicContext& gc, const CL_StringRef& cltext, const CL_Colorf& clcolor) {
-    UnicodeString text(cltext.c_str());
-
-    // check history first!
-    boost::shared_ptr<ui::Texture> tex = findInHistory(text, clcolor);
-    if (tex) {
-        return tex;
-    }
-
-    //LOG_DEBUG << "Texture not found in history" << std::endl;
-
-    uint32_t color = clToUintColor(clcolor);
-
-    CL_Size texSize = get_text_size(gc, cltext);
-    unsigned int width = texSize.width;
-    unsigned int height = texSize.height;
-
-    tex.reset(new ui::Texture(ui::Texture::USAGE_FONT));
-    tex->initPixelBuffer(width, height);
-    uint32_t* pixBufPtr = tex->getPixelBufferData();
-
-    unsigned int curX = borderWidth_;
-    unsigned int curY = borderWidth_;
-
-    StringCharacterIterator iter(text);
-    while (iter.hasNext()) {
-        unsigned int charCode = iter.nextPostInc();
-
-        boost::shared_ptr<data::UnicodeCharacter> curChar = fontLoader_->getCharacter(charCode);
-
-        if (!curChar) {
-            LOG_DEBUG << "Trying to render invalid char code " << charCode << std::endl;
-            continue;
-        }
-
-        for (unsigned int y = 0; y < curChar->height_; ++y) {
-            for (unsigned int x = 0; x < curChar->width_; ++x) {
-                if (curChar->data_[y * curChar->width_ + x] == 1) {
-                    pixBufPtr[(curY + curChar->yOffset_ + y) * width + (curX + curChar->xOffset_ + x)] = color;
-                }
-            }
-        }
-
-        curX += curChar->getTotalWidth() + spaceWidth_;
-    }
-
-
-    if (borderWidth_ > 0) {
-        applyBorder(tex->getPixelBuffer(), clcolor, borderWidth_, CL_Colorf::black);
-    }
-
-    tex->setReadComplete();
-
-    addToHistory(text, clcolor, tex);
-
-    return tex;
-}
-
 uint32_t UoFontProvider::clToUintColor(const CL_Colorf& clcolor) const {
     unsigned int r = (clcolor.get_red()) * 255;
     unsigned int g = (clcolor.get_green()) * 255;
@@ -278,37 +370,5 @@ uint32_t UoFontProvider::clToUintColor(const CL_Colorf& clcolor) const {
     return ret;
 }
 
-boost::shared_ptr<ui::Texture> UoFontProvider::findInHistory(const UnicodeString& str, const CL_Colorf& color) {
-    int32_t hash = str.hashCode();
-    boost::shared_ptr<ui::Texture> ret;
-
-    boost::mutex::scoped_lock myLock(historyMutex_);
-
-    for (unsigned int i = 0; i < historySize_; ++i) {
-        if (textureHistory_[i].hash_ == hash && textureHistory_[i].color_ == color) {
-            ret = textureHistory_[i].texture_;
-            break;
-        }
-    }
-
-    return ret;
-}
-
-void UoFontProvider::addToHistory(const UnicodeString& str, const CL_Colorf& color, boost::shared_ptr<ui::Texture> tex) {
-    int32_t hash = str.hashCode();
-    boost::mutex::scoped_lock myLock(historyMutex_);
-
-    textureHistory_[historyIndex_].hash_ = hash;
-    textureHistory_[historyIndex_].color_ = color;
-    textureHistory_[historyIndex_].texture_ = tex;
-
-    ++historyIndex_;
-    historyIndex_ %= HISTORY_SIZE;
-
-    if (historySize_ < HISTORY_SIZE) {
-        ++historySize_;
-    }
-}
-
 }
 }
@@ -23,11 +23,14 @@
 #include <ClanLib/Core/Text/string_types.h>
 #include <ClanLib/Display/TargetProviders/font_provider.h>
 #include <ClanLib/Display/Font/font_metrics.h>
-#include <ClanLib/Display/Image/pixel_buffer.h>
+#include <ClanLib/Display/Render/texture.h>
 #include <ClanLib/Display/2D/color.h>
+#include <ClanLib/Core/Math/vec2.h>
+#include <ClanLib/Core/Math/vec4.h>
 
 #include <boost/shared_ptr.hpp>
-#include <boost/thread/mutex.hpp>
+
+#include <vector>
 
 #include <misc/string.hpp>
 
@@ -35,12 +38,18 @@ namespace fluo {
 
 namespace data {
 class UniFontLoader;
+class UnicodeCharacter;
 }
 
 namespace ui {
 
-class Texture;
-
+/**
+ * \brief Draws text in a unifont as one quad per character, and one more per character for the border
+ *
+ * The quads are textured from a copy of the glyph atlas pages of the data::UniFontLoader. The border is taken from the
+ * border pixels in the atlas, which are uploaded to a second texture per page. Characters that were added to the atlas
+ * since the last draw call are uploaded before drawing.
+ */
 class UoFontProvider : public CL_FontProvider {
 public:
     UoFontProvider(unsigned int unifontId, bool border);
@@ -64,27 +73,30 @@ private:
     CL_FontMetrics fontMetrics_;
 
 
-    boost::shared_ptr<ui::Texture> getTexture(CL_GraphicContext& gc, const CL_StringRef& text, const CL_Colorf& clcolor);
-    void applyBorder(CL_PixelBuffer pxBuf, const CL_Colorf& clcolor, unsigned int borderWidth, const CL_Colorf& clborderColor);
-
     uint32_t clToUintColor(const CL_Colorf& clcolor) const;
 
-
-    // history stuff
-    struct HistoryEntry {
-        int32_t hash_;
-        CL_Colorf color_;
-        boost::shared_ptr<ui::Texture> texture_;
+    struct AtlasPage {
+        CL_Texture glyphTexture_;
+        CL_Texture borderTexture_; ///< Glyph and border pixels, only used if the font has a border
     };
+    std::vector<AtlasPage> atlasPages_;
+    unsigned int uploadedCharacterCount_;
+
+    void updateAtlasTextures();
+    CL_Texture createAtlasTexture() const;
+    void uploadAtlasRows(unsigned int page, unsigned int firstRow, unsigned int endRow);
+
+    // vertex data of the current draw call for each atlas page, kept to avoid allocations
+    struct QuadBatch {
+        std::vector<CL_Vec2f> positions_;
+        std::vector<CL_Vec2f> texCoords_;
+        std::vector<CL_Vec4f> colors_;
+    };
+    std::vector<QuadBatch> glyphBatches_;
+    std::vector<QuadBatch> borderBatches_;
 
-    boost::mutex historyMutex_;
-    static const unsigned int HISTORY_SIZE = 30;
-    unsigned int historyIndex_;
-    unsigned int historySize_;
-    HistoryEntry textureHistory_[HISTORY_SIZE];
-
-    boost::shared_ptr<ui::Texture> findInHistory(const UnicodeString& str, const CL_Colorf& color);
-    void addToHistory(const UnicodeString& str, const CL_Colorf& color, boost::shared_ptr<ui::Texture> tex);
+    void addCharacterQuad(QuadBatch& batch, const data::UnicodeCharacter* character, float x, float y, int padding, const CL_Colorf& color);
+    void drawBatch(CL_GraphicContext& gc, const QuadBatch& batch, const CL_Texture& texture);
 };
 
 }
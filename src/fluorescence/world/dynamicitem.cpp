@@ -56,7 +56,7 @@ namespace fluo {
 namespace world {
 
 DynamicItem::DynamicItem(Serial serial) : ServerObject(serial, IngameObject::TYPE_DYNAMIC_ITEM),
-        artId_(0), tileDataInfo_(nullptr), equipped_(false), spellbookGump_(nullptr), containerView_(nullptr), isSpellbook_(false) {
+        artId_(0), equipped_(false), spellbookGump_(nullptr), containerView_(nullptr), isSpellbook_(false) {
 }
 
 boost::shared_ptr<ui::Texture> DynamicItem::getIngameTexture() const {
@@ -76,11 +76,11 @@ unsigned int DynamicItem::getArtId() const {
 }
 
 void DynamicItem::setArtId(unsigned int artId) {
-    if (!tileDataInfo_ || artId_ != artId) { // not initialized or other art id
+    if (!tileDataInfo_.isValid() || artId_ != artId) { // not initialized or other art id
         artId_ = artId;
         tileDataInfo_ = data::Manager::getTileDataLoader()->getStaticTileInfo(artId_);
-        worldRenderData_.hueInfo_[0u] = tileDataInfo_->partialHue() ? 1.0 : 0.0;
-        worldRenderData_.hueInfo_[2u] = tileDataInfo_->translucent() ? 0.8 : 1.0;
+        worldRenderData_.hueInfo_[0u] = tileDataInfo_.partialHue() ? 1.0 : 0.0;
+        worldRenderData_.hueInfo_[2u] = tileDataInfo_.translucent() ? 0.8 : 1.0;
 
         setIgnored(ui::Manager::isStaticIdIgnored(artId_));
         if (ui::Manager::isStaticIdWater(artId_)) {
@@ -201,17 +201,17 @@ void DynamicItem::updateRenderDepth() {
         worldRenderData_.setRenderDepth(parent->getLocXGame(), parent->getLocYGame(), z, order, layerPriorities[parent->getDirection()][layerTmp], getSerial() & 0xFF);
     } else {
         int8_t z = getLocZGame();
-        if (tileDataInfo_->background() && tileDataInfo_->surface()) {
+        if (tileDataInfo_.background() && tileDataInfo_.surface()) {
             z += 4;
-        } else if (tileDataInfo_->background()) {
+        } else if (tileDataInfo_.background()) {
             z += 2;
-        } else if (tileDataInfo_->surface()) {
+        } else if (tileDataInfo_.surface()) {
             z += 5;
         } else {
             z += 6;
         }
 
-        worldRenderData_.setRenderDepth(getLocXGame(), getLocYGame(), z, 20, tileDataInfo_->height_, getSerial() & 0xFF);
+        worldRenderData_.setRenderDepth(getLocXGame(), getLocYGame(), z, 20, tileDataInfo_.height(), getSerial() & 0xFF);
     }
 }
 
@@ -231,7 +231,7 @@ void DynamicItem::updateTextureProvider() {
                 idleAnim = 2;
             }
         } else {
-            animId = tileDataInfo_->animId_;
+            animId = tileDataInfo_.animId();
         }
 
         animTextureProvider_.reset(new ui::AnimTextureProvider(animId, idleAnim));
@@ -258,13 +258,13 @@ bool DynamicItem::updateAnimation(unsigned int elapsedMillis) {
 }
 
 const data::StaticTileInfo* DynamicItem::getTileDataInfo() const {
-    return tileDataInfo_;
+    return &tileDataInfo_;
 }
 
 void DynamicItem::onClick() {
     LOG_INFO << "Clicked dynamic, id=" << std::hex << getArtId() << std::dec << " loc=(" << getLocXGame() << "/" << getLocYGame() << "/" <<
-            getLocZGame() << ") name=" << tileDataInfo_->name_ << " equipped=" << equipped_ << std::endl;
-    //LOG_INFO << "impassable=" << tileDataInfo_->impassable() << " surface=" << tileDataInfo_->surface() << " bridge=" << tileDataInfo_->bridge() << " height=" << (unsigned int)tileDataInfo_->height_ << std::endl;
+            getLocZGame() << ") name=" << tileDataInfo_.name() << " equipped=" << equipped_ << std::endl;
+    //LOG_INFO << "impassable=" << tileDataInfo_.impassable() << " surface=" << tileDataInfo_.surface() << " bridge=" << tileDataInfo_.bridge() << " height=" << (unsigned int)tileDataInfo_.height() << std::endl;
 
     //printRenderDepth();
 
@@ -274,7 +274,7 @@ void DynamicItem::onClick() {
 
 void DynamicItem::onDoubleClick() {
     LOG_INFO << "Double clicked dynamic, id=" << std::hex << getArtId() << std::dec << " loc=(" << getLocXGame() << "/" << getLocYGame() << "/" <<
-            getLocZGame() << ") name=" << tileDataInfo_->name_ << std::endl;
+            getLocZGame() << ") name=" << tileDataInfo_.name() << std::endl;
 
     net::packets::DoubleClick pkt(getSerial());
     net::Manager::getSingleton()->send(pkt);
@@ -104,7 +104,7 @@ private:
     boost::shared_ptr<ui::TextureProvider> textureProvider_;
     boost::shared_ptr<ui::TextureProvider> gumpTextureProvider_;
 
-    const data::StaticTileInfo* tileDataInfo_;
+    data::StaticTileInfo tileDataInfo_;
 
     void updateVertexCoordinates();
     void updateRenderDepth();
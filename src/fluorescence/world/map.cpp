@@ -95,7 +95,7 @@ void MapTile::updateVertexCoordinates() {
 }
 
 void MapTile::calculateIsFlat() {
-    isFlat_ = (zLeft_ == zRight_ && zLeft_ == zBottom_ && zLeft_ == getLocZGame()) || tileDataInfo_->textureId_ <= 0;
+    isFlat_ = (zLeft_ == zRight_ && zLeft_ == zBottom_ && zLeft_ == getLocZGame()) || tileDataInfo_.textureId() <= 0;
 }
 
 void MapTile::updateRenderDepth() {
@@ -108,7 +108,7 @@ void MapTile::updateTextureProvider() {
     if (isFlat_) {
         texture_ = data::Manager::getTexture(data::TextureSource::MAPART, artId_);
     } else {
-        texture_ = data::Manager::getTexture(data::TextureSource::MAPTEX, tileDataInfo_->textureId_);
+        texture_ = data::Manager::getTexture(data::TextureSource::MAPTEX, tileDataInfo_.textureId());
     }
 }
 
@@ -136,7 +136,7 @@ unsigned int MapTile::getArtId() {
 }
 
 const data::LandTileInfo* MapTile::getTileDataInfo() {
-    return tileDataInfo_;
+    return &tileDataInfo_;
 }
 
 bool MapTile::overlaps(const CL_Rectf& rect) const {
@@ -190,7 +190,7 @@ void MapTile::setVertexNormals(const CL_Vec3f& top, const CL_Vec3f& right, const
 
 void MapTile::onClick() {
     LOG_INFO << "Clicked map, id=" << std::hex << getArtId() << std::dec << " loc=(" << getLocXGame() << "/" << getLocYGame() << "/" <<
-            getLocZGame() << ") name=" << tileDataInfo_->name_ << " flat=" << isFlat_ << std::endl;
+            getLocZGame() << ") name=" << tileDataInfo_.name() << " flat=" << isFlat_ << std::endl;
 
     LOG_INFO << "z value: self=" << getLocZGame() << " right=" << zRight_ << " bottom=" << zBottom_ << " left=" << zLeft_ << std::endl;
 
@@ -60,7 +60,7 @@ public:
 private:
     unsigned int artId_;
 
-    const data::LandTileInfo* tileDataInfo_;
+    data::LandTileInfo tileDataInfo_;
 
     boost::shared_ptr<ui::Texture> texture_;
 
@@ -32,6 +32,7 @@
 
 #include <data/manager.hpp>
 #include <data/huesloader.hpp>
+#include <data/animprefetcher.hpp>
 
 #include <ui/manager.hpp>
 #include <ui/gumpmenu.hpp>
@@ -486,6 +487,39 @@ unsigned int Mobile::getIdleAnim() const {
     }
 }
 
+void Mobile::prefetchAnimations() {
+    boost::shared_ptr<data::AnimPrefetcher> prefetcher = data::Manager::getAnimPrefetcher();
+    if (!prefetcher) {
+        return;
+    }
+
+    data::AnimPrefetcher::MobileState state;
+    state.bodyId_ = bodyId_;
+    state.animType_ = animType_;
+    state.armed_ = hasItemOnLayer(Layer::ONEHANDED) || hasItemOnLayer(Layer::TWOHANDED);
+    state.twoHanded_ = hasItemOnLayer(Layer::TWOHANDED);
+
+    std::list<boost::shared_ptr<IngameObject> >::iterator iter = childObjects_.begin();
+    std::list<boost::shared_ptr<IngameObject> >::iterator end = childObjects_.end();
+
+    for (; iter != end; ++iter) {
+        if (!(*iter)->isDynamicItem()) {
+            continue;
+        }
+
+        boost::shared_ptr<DynamicItem> itm = boost::static_pointer_cast<DynamicItem>(*iter);
+        if (itm->getLayer() == Layer::MOUNT) {
+            state.mounted_ = true;
+            state.mountAnimId_ = data::Manager::getMountDef(itm->getArtId()).animId_;
+            state.mountAnimType_ = data::Manager::getAnimType(state.mountAnimId_);
+        } else if (itm->getTileDataInfo()->isValid() && itm->getTileDataInfo()->animId() != 0) {
+            state.equipmentAnimIds_.push_back(itm->getTileDataInfo()->animId());
+        }
+    }
+
+    prefetcher->prefetchMobile(state);
+}
+
 void Mobile::onAddedToSector(world::Sector* sector) {
     std::list<boost::shared_ptr<IngameObject> >::iterator iter = childObjects_.begin();
     std::list<boost::shared_ptr<IngameObject> >::iterator end = childObjects_.end();
@@ -66,6 +66,9 @@ public:
     unsigned int getMoveAnim() const;
     unsigned int getIdleAnim() const;
     void updateIdleAnim();
+
+    /// Queues the animations this mobile will probably show next, see data::AnimPrefetcher
+    void prefetchAnimations();
     unsigned int getMovementDuration() const;
 
     virtual bool isMirrored() const;
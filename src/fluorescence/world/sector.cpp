@@ -20,6 +20,8 @@
 
 #include "sector.hpp"
 
+#include <boost/bind.hpp>
+
 #include "dynamicitem.hpp"
 #include "manager.hpp"
 #include "sectormanager.hpp"
@@ -33,23 +35,34 @@
 #include <ui/cliprectmanager.hpp>
 #include <ui/render/material.hpp>
 
+#include <misc/log.hpp>
+
 namespace fluo {
 namespace world {
 
-Sector::Sector(unsigned int mapId, const IsoIndex& sectorId, bool fullLoad) :
+Sector::Sector(unsigned int mapId, const IsoIndex& sectorId, bool fullLoad, unsigned int loadPriority) :
         mapId_(mapId), id_(sectorId),
-        mapAddedToList_(false), staticsAddedToList_(false),
+        mapBlockLoaded_(false), mapAddedToList_(false), staticBlockLoaded_(false), staticsAddedToList_(false),
         visible_(true), fullUpdateRenderDataRequired_(true), repaintRequired_(false),
-        requireFullLoad_(fullLoad) {
+        requireFullLoad_(fullLoad), loadPriority_(loadPriority) {
 
     //LOG_DEBUG << "Sector construct, map=" << mapId_ << " x=" << getLocX() << " y=" << getLocY() << std::endl;
 
-    mapBlock_ = data::Manager::getMapLoader(mapId_)->get(getLocX(), getLocY());
-    staticBlock_ = data::Manager::getStaticsLoader(mapId_)->get(getLocX(), getLocY());
+    mapBlock_ = data::Manager::getMapLoader(mapId_)->get(getLocX(), getLocY(), loadPriority);
+    staticBlock_ = data::Manager::getStaticsLoader(mapId_)->get(getLocX(), getLocY(), loadPriority);
+
+    mapBlock_->addCompleteListener(this, boost::bind(&Sector::onMapBlockLoaded, this));
+    if (staticBlock_) {
+        staticBlock_->addCompleteListener(this, boost::bind(&Sector::onStaticBlockLoaded, this));
+    }
 }
 
 Sector::~Sector() {
     //LOG_DEBUG << "Sector destruct, map=" << mapId_ << " x=" << getLocX() << " y=" << getLocY() << std::endl;
+    mapBlock_->removeCompleteListeners(this);
+    if (staticBlock_) {
+        staticBlock_->removeCompleteListeners(this);
+    }
 }
 
 unsigned int Sector::getLocX() const {
@@ -71,21 +84,43 @@ const IsoIndex& Sector::getSectorId() const {
     return id_;
 }
 
-void Sector::update(unsigned int elapsedMillis) {
-    repaintRequired_ = false;
+void Sector::onMapBlockLoaded() {
+    if (mapBlock_->isReadFailed()) {
+        // the sector stays empty
+        LOG_WARN << "Unable to load map block at " << getLocX() << "/" << getLocY() << " on map " << mapId_ << std::endl;
+        return;
+    }
+
+    mapBlockLoaded_ = true;
+    addLoadedBlocks();
+}
+
+void Sector::onStaticBlockLoaded() {
+    if (staticBlock_->isReadFailed()) {
+        // treated like a sector without statics, the map tiles can still be shown
+        LOG_WARN << "Unable to load static block at " << getLocX() << "/" << getLocY() << " on map " << mapId_ << std::endl;
+        staticBlock_.reset();
+        addLoadedBlocks();
+        return;
+    }
+
+    staticBlockLoaded_ = true;
+    addLoadedBlocks();
+}
 
-    if (!miniMapBlock_ && mapBlock_->isReadComplete() && (!staticBlock_ || staticBlock_->isReadComplete())) {
+void Sector::addLoadedBlocks() {
+    if (!miniMapBlock_ && mapBlockLoaded_ && (!staticBlock_ || staticBlockLoaded_)) {
         // init minimap pixels
         miniMapBlock_ = world::Manager::getSingleton()->getSectorManager()->getMiniMapBlock(id_);
         miniMapBlock_->updateSector(this);
     }
 
-    // if this sector is loaded only for the minimap, don't waste time updating it
+    // if this sector is loaded only for the minimap, there is no need to generate the items
     if (!requireFullLoad_) {
         return;
     }
 
-    if (!mapAddedToList_ && mapBlock_ && mapBlock_->isReadComplete()) {
+    if (!mapAddedToList_ && mapBlockLoaded_) {
         mapBlock_->generateItemsFromRawData();
 
         // map block is now loaded => add to list
@@ -99,7 +134,7 @@ void Sector::update(unsigned int elapsedMillis) {
         mapAddedToList_ = true;
     }
 
-    if (!staticsAddedToList_ && staticBlock_ && staticBlock_->isReadComplete()) {
+    if (!staticsAddedToList_ && staticBlockLoaded_) {
         staticBlock_->generateItemsFromRawData();
 
         // static block is now loaded => add to list
@@ -114,6 +149,10 @@ void Sector::update(unsigned int elapsedMillis) {
         fullUpdateRenderDataRequired_ = true;
         staticsAddedToList_ = true;
     }
+}
+
+void Sector::update(unsigned int elapsedMillis) {
+    repaintRequired_ = false;
 
     if (mapBlock_->repaintRequested_) {
         // happens when the neighboring z values of a map block change
@@ -355,16 +394,16 @@ bool Sector::checkMovement(const CL_Vec3f& curLocation, int stepReach, CL_Vec3f&
 
             bool isBridge = tileInfo->bridge();
             int newZ = curObj->getLocZGame();
-            int checkZ = newZ + tileInfo->height_;
+            int checkZ = newZ + tileInfo->height();
             if (isBridge) {
                 // with bridge items, check that we can reach the base of the item
                 if (newZ > stepReach) {
                     continue;
                 }
-                newZ += floorf(tileInfo->height_ / 2.0f);
+                newZ += floorf(tileInfo->height() / 2.0f);
             } else {
                 // for non-bridges, we have to be able to reach the top
-                newZ += tileInfo->height_;
+                newZ += tileInfo->height();
                 if (newZ > stepReach) {
                     continue;
                 }
@@ -402,12 +441,12 @@ bool Sector::checkFreeSpace(const std::list<world::IngameObject*>& checkList, in
         } else if (curObj->isStaticItem()) {
             world::StaticItem* staticObj = (world::StaticItem*)(curObj);
             const data::StaticTileInfo* tileInfo = staticObj->getTileDataInfo();
-            itemTop += tileInfo->bridge() ? ceilf(tileInfo->height_ / 2.0) :  tileInfo->height_;
+            itemTop += tileInfo->bridge() ? ceilf(tileInfo->height() / 2.0) :  tileInfo->height();
             canPass = !tileInfo->surface() && !tileInfo->impassable();
         } else if (curObj->isDynamicItem()) {
             world::DynamicItem* dynamicObj = (world::DynamicItem*)(curObj);
             const data::StaticTileInfo* tileInfo = dynamicObj->getTileDataInfo();
-            itemTop += tileInfo->bridge() ? ceilf(tileInfo->height_ / 2.0) :  tileInfo->height_;
+            itemTop += tileInfo->bridge() ? ceilf(tileInfo->height() / 2.0) :  tileInfo->height();
             canPass = !tileInfo->surface() && !tileInfo->impassable();
         }
 
@@ -444,14 +483,14 @@ int Sector::getStepReach(const CL_Vec3f& loc) const {
             world::StaticItem* staticObj = (world::StaticItem*)(curObj);
             const data::StaticTileInfo* tileInfo = staticObj->getTileDataInfo();
 
-            int top = curObj->getLocZGame() + tileInfo->height_ + 2;
+            int top = curObj->getLocZGame() + tileInfo->height() + 2;
             if (!tileInfo->impassable() && tileInfo->surface() && tileInfo->bridge() && top > ret) {
                 ret = top;
             }
         } else if (curObj->isDynamicItem()) {
             world::DynamicItem* dynamicObj = (world::DynamicItem*)(curObj);
             const data::StaticTileInfo* tileInfo = dynamicObj->getTileDataInfo();
-            int top = curObj->getLocZGame() + tileInfo->height_ + 2;
+            int top = curObj->getLocZGame() + tileInfo->height() + 2;
             if (!tileInfo->impassable() && tileInfo->surface() && tileInfo->bridge() && top > ret) {
                 ret = top;
             }
@@ -474,7 +513,7 @@ int Sector::getMapZAt(unsigned int worldX, unsigned int worldY) const {
 }
 
 void Sector::invalidateAllTextures() {
-    if (mapBlock_ && mapBlock_->isReadComplete()) {
+    if (mapBlockLoaded_) {
         for (unsigned int x = 0; x < 8; ++x) {
             for (unsigned int y = 0; y < 8; ++y) {
                 mapBlock_->get(x, y)->invalidateTextureProvider();
@@ -482,7 +521,7 @@ void Sector::invalidateAllTextures() {
         }
     }
 
-    if (staticBlock_ && staticBlock_->isReadComplete()) {
+    if (staticBlockLoaded_) {
         std::list<boost::shared_ptr<world::StaticItem> >::iterator it = staticBlock_->getItemList().begin();
         std::list<boost::shared_ptr<world::StaticItem> >::iterator end = staticBlock_->getItemList().end();
 
@@ -529,6 +568,7 @@ void Sector::setRequireFullLoad(bool value) {
         if (staticBlock_) {
             staticBlock_->generateItemsFromRawData();
         }
+        addLoadedBlocks();
     } else {
         // drop map and statics igitems, revert sector to primitive state
         mapAddedToList_ = false;
@@ -546,5 +586,18 @@ void Sector::setRequireFullLoad(bool value) {
     }
 }
 
+void Sector::raiseLoadPriority(unsigned int loadPriority) {
+    if (loadPriority >= loadPriority_) {
+        return;
+    }
+
+    loadPriority_ = loadPriority;
+    if (!mapBlockLoaded_ || (staticBlock_ && !staticBlockLoaded_)) {
+        // the loaders return the pending blocks again and move their queued reads up
+        data::Manager::getMapLoader(mapId_)->get(getLocX(), getLocY(), loadPriority);
+        data::Manager::getStaticsLoader(mapId_)->get(getLocX(), getLocY(), loadPriority);
+    }
+}
+
 }
 }
@@ -39,7 +39,8 @@ class MiniMapBlock;
 class Sector {
 
 public:
-    Sector(unsigned int mapId, const IsoIndex& sectorId, bool fullLoad);
+    /// loadPriority is one of data::LoadPriority and is used for the map and statics block requests
+    Sector(unsigned int mapId, const IsoIndex& sectorId, bool fullLoad, unsigned int loadPriority);
     ~Sector();
 
     const IsoIndex& getSectorId() const;
@@ -84,16 +85,27 @@ public:
     bool requireFullLoad() const;
     void setRequireFullLoad(bool value);
 
+    /// Moves the requests for blocks that are not loaded yet up to the given data::LoadPriority, if it is higher
+    void raiseLoadPriority(unsigned int loadPriority);
+
 private:
     unsigned int mapId_;
     IsoIndex id_;
 
     boost::shared_ptr<MapBlock> mapBlock_;
+    bool mapBlockLoaded_;
     bool mapAddedToList_;
 
     boost::shared_ptr<StaticBlock> staticBlock_;
+    bool staticBlockLoaded_;
     bool staticsAddedToList_;
 
+    // called from data::CompletionQueue::drain once the blocks are read
+    void onMapBlockLoaded();
+    void onStaticBlockLoaded();
+    // initializes the minimap block and, if the sector is fully loaded, fills the render list with the loaded blocks
+    void addLoadedBlocks();
+
     bool visible_;
 
     bool fullUpdateRenderDataRequired_;
@@ -112,6 +124,8 @@ private:
 
     // if false, this sector is only required for the minimap (no need to update it)
     bool requireFullLoad_;
+
+    unsigned int loadPriority_;
 };
 
 }
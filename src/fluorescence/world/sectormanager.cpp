@@ -70,6 +70,15 @@ void SectorManager::updateSectorList() {
     std::set<IsoIndex> sectorsMiniMap;
     buildSectorRequiredList(sectorsFullLoad, sectorsMiniMap, sectorAddDistanceCache_, mapId);
 
+    // sectors that are actually on screen are loaded first, the cache distance is only prefetched
+    std::set<IsoIndex> sectorsVisible;
+    if (sectorAddDistanceCache_ > 0) {
+        std::set<IsoIndex> tmpMiniMap;
+        buildSectorRequiredList(sectorsVisible, tmpMiniMap, 0, mapId);
+    } else {
+        sectorsVisible = sectorsFullLoad;
+    }
+
     // iterate over all stored sectors and remove the ones we do not need anymore
     std::map<IsoIndex, boost::shared_ptr<world::Sector> >::iterator iter = sectorMap_.begin();
     std::map<IsoIndex, boost::shared_ptr<world::Sector> >::iterator end = sectorMap_.end();
@@ -90,11 +99,14 @@ void SectorManager::updateSectorList() {
 
     for (; requiredIter != requiredEnd; ++requiredIter) {
         sectorFound = sectorMap_.find(*requiredIter);
+        unsigned int priority = sectorsVisible.count(*requiredIter) > 0 ? data::LoadPriority::VISIBLE : data::LoadPriority::PREFETCH;
         if (sectorFound == notFound) {
-            boost::shared_ptr<Sector> newSec(new Sector(mapId, *requiredIter, true));
+            boost::shared_ptr<Sector> newSec(new Sector(mapId, *requiredIter, true, priority));
             sectorMap_[*requiredIter] = newSec;
         } else {
             sectorFound->second->setRequireFullLoad(true);
+            // e.g. a minimap sector that came into view while its blocks are still queued in the background
+            sectorFound->second->raiseLoadPriority(priority);
         }
     }
 
@@ -104,7 +116,7 @@ void SectorManager::updateSectorList() {
     for (; requiredIter != requiredEnd; ++requiredIter) {
         sectorFound = sectorMap_.find(*requiredIter);
         if (sectorFound == notFound) {
-            boost::shared_ptr<Sector> newSec(new Sector(mapId, *requiredIter, false));
+            boost::shared_ptr<Sector> newSec(new Sector(mapId, *requiredIter, false, data::LoadPriority::BACKGROUND));
             sectorMap_[*requiredIter] = newSec;
         } else {
             sectorFound->second->setRequireFullLoad(false);
@@ -172,7 +184,7 @@ boost::shared_ptr<world::Sector> SectorManager::getSectorForCoordinates(unsigned
     if (iter != sectorMap_.end()) {
         return iter->second;
     } else {
-        boost::shared_ptr<Sector> newSec(new Sector(world::Manager::getSingleton()->getCurrentMapId(), secIdx, false));
+        boost::shared_ptr<Sector> newSec(new Sector(world::Manager::getSingleton()->getCurrentMapId(), secIdx, false, data::LoadPriority::PREFETCH));
         sectorMap_[secIdx] = newSec;
         return newSec;
     }
@@ -56,9 +56,9 @@ void StaticItem::set(int locX, int locY, int locZ, unsigned int artId, unsigned
 
     setLocation(locX, locY, locZ);
 
-    worldRenderData_.hueInfo_[0u] = tileDataInfo_->partialHue() ? 1.0 : 0.0;
+    worldRenderData_.hueInfo_[0u] = tileDataInfo_.partialHue() ? 1.0 : 0.0;
     worldRenderData_.hueInfo_[1u] = data::Manager::getHuesLoader()->translateHue(hue_);
-    worldRenderData_.hueInfo_[2u] = tileDataInfo_->translucent() ? 0.8 : 1.0;
+    worldRenderData_.hueInfo_[2u] = tileDataInfo_.translucent() ? 0.8 : 1.0;
 
     setIgnored(ui::Manager::isStaticIdIgnored(artId_));
     if (ui::Manager::isStaticIdWater(artId_)) {
@@ -84,17 +84,17 @@ void StaticItem::updateRenderDepth() {
 
     // level 1 z and tiledata flags
     int8_t z = getLocZGame();
-    if (tileDataInfo_->background() && tileDataInfo_->surface()) {
+    if (tileDataInfo_.background() && tileDataInfo_.surface()) {
         z += 4;
-    } else if (tileDataInfo_->background()) {
+    } else if (tileDataInfo_.background()) {
         z += 2;
-    } else if (tileDataInfo_->surface()) {
+    } else if (tileDataInfo_.surface()) {
         z += 5;
     } else {
         z += 6;
     }
 
-    worldRenderData_.setRenderDepth(getLocXGame(), getLocYGame(), z, 10, tileDataInfo_->height_, indexInBlock_);
+    worldRenderData_.setRenderDepth(getLocXGame(), getLocYGame(), z, 10, tileDataInfo_.height(), indexInBlock_);
 }
 
 void StaticItem::updateTextureProvider() {
@@ -106,16 +106,16 @@ bool StaticItem::updateAnimation(unsigned int elapsedMillis) {
 }
 
 const data::StaticTileInfo* StaticItem::getTileDataInfo() const {
-    return tileDataInfo_;
+    return &tileDataInfo_;
 }
 
 void StaticItem::onClick() {
     LOG_INFO << "Clicked static, id=" << std::hex << getArtId() << std::dec << " loc=(" << getLocXGame() << "/" << getLocYGame() << "/" <<
-            getLocZGame() << ") name=" << " hue=" << hue_ << " " << tileDataInfo_->name_ << std::endl;
+            getLocZGame() << ") name=" << " hue=" << hue_ << " " << tileDataInfo_.name() << std::endl;
 
-    LOG_INFO << "impassable=" << tileDataInfo_->impassable() << " surface=" << tileDataInfo_->surface() << " bridge=" << tileDataInfo_->bridge() << " height=" << (unsigned int)tileDataInfo_->height_ << std::endl;
+    LOG_INFO << "impassable=" << tileDataInfo_.impassable() << " surface=" << tileDataInfo_.surface() << " bridge=" << tileDataInfo_.bridge() << " height=" << (unsigned int)tileDataInfo_.height() << std::endl;
 
-    //LOG_INFO << "background=" << tileDataInfo_->background() << " surface=" << tileDataInfo_->surface() << " height=" << (unsigned int)tileDataInfo_->height_ <<
+    //LOG_INFO << "background=" << tileDataInfo_.background() << " surface=" << tileDataInfo_.surface() << " height=" << (unsigned int)tileDataInfo_.height() <<
             //" hue=" << hue_ << " indexInBlock=" << indexInBlock_ << std::endl;
 
     if (sector_) {
@@ -126,7 +126,7 @@ void StaticItem::onClick() {
 }
 
 bool StaticItem::periodicRenderUpdateRequired() const {
-    return tileDataInfo_->animation();
+    return tileDataInfo_.animation();
 }
 
 
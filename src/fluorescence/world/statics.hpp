@@ -72,7 +72,7 @@ private:
 
     boost::shared_ptr<ui::TextureProvider> textureProvider_;
 
-    const data::StaticTileInfo* tileDataInfo_;
+    data::StaticTileInfo tileDataInfo_;
 
     void set(int locX, int locY, int locZ, unsigned int artId, unsigned int hue);
 